@@ -3,26 +3,47 @@
 #include <CLI/App.hpp>
 #include <CLI/Config.hpp>
 #include <CLI/Formatter.hpp>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 
 // Core engine stuff
+#include <engine/assets/CookedMesh.hpp>
+#include <engine/assets/GltfLoader.hpp>
+#include <engine/core/BindlessDescriptors.hpp>
 #include <engine/core/Buffer.hpp>
 #include <engine/core/CommandPool.hpp>
+#include <engine/core/Descriptors.hpp>
 #include <engine/core/Device.hpp>
 #include <engine/core/GraphicsPipeline.hpp>
+#include <engine/core/InstanceData.hpp>
 #include <engine/core/Instance.hpp>
+#include <engine/core/PipelineCache.hpp>
 #include <engine/core/RenderPass.hpp>
 #include <engine/core/ShaderModule.hpp>
 #include <engine/core/Swapchain.hpp>
 #include <engine/core/Sync.hpp>
+#include <engine/render/DepthPyramid.hpp>
+#include <engine/render/Frustum.hpp>
+#include <engine/render/FrustumCuller.hpp>
+#include <engine/render/GpuCuller.hpp>
+#include <engine/render/InstancedDrawList.hpp>
+#include <engine/render/MeshPool.hpp>
+#include <engine/render/RenderGraph.hpp>
+#include <engine/scene/SceneGraph.hpp>
+#include <engine/utils/ThreadPool.hpp>
 #include <engine/utils/to_string.hpp>
 
 // Platform specific code
 #include <engine/win32/GlfwWindowSystem.hpp>
 #include <exception>
+#include <filesystem>
 #include <fmtlog/Log.hpp>
 #include <fstream>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -36,12 +57,32 @@ Swapchain* swapchain;
 RenderPass* renderPass;
 Subpass* playerViewSubpass;
 
+// Shared by every frame in flight: the render pass clears it before each frame tests against it
+Image* depthImage;
+ImageView* depthImageView;
+
+// Depth pre-pass: the scene's depth is drawn first by a depth-only pipeline, then shaded with an
+// EQUAL depth test, so each pixel runs the fragment shader once. Enabled on the command line
+bool useDepthPrePass = false;
+Subpass* depthPrePassSubpass = nullptr;
+
+// The frame's passes, recorded into every command buffer with the barriers between them. Built
+// with the render pass, whose attachments take their ops from it
+RenderGraph* frameGraph = nullptr;
+RenderGraph::Resource frameColor;
+RenderGraph::Resource frameDepth;
+size_t frameGraphImage = 0;  // Index of the command buffer the graph's passes are recording
+
 VkDebugUtilsMessengerEXT debugMessenger;
 
 const Layers validationLayers = {"VK_LAYER_KHRONOS_validation"};
 
 const std::vector<std::string> deviceExtensionsCpp = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+// Enabled when available
+const std::vector<std::string> optionalDeviceExtensions = {
+    VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME};
+
 #ifdef DEBUG_BUILD
 constexpr bool enableValidationLayers = true;
 #else
@@ -53,13 +94,25 @@ constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
 LogicalDevice* device;
 
+// Compiled pipelines, kept next to the executable across runs
+constexpr const char* PIPELINE_CACHE_FILE = "pipeline.cache";
+PipelineCache* pipelineCache;
+
+// Descriptor set layouts outlive swapchain recreation, so pipelines rebuilt with it find theirs
+DescriptorSetLayoutCache* descriptorLayouts;
+
+// Every texture, storage buffer and sampler, indexed by materials. Null when the device lacks
+// descriptor indexing
+BindlessDescriptors* bindless = nullptr;
+
 QueueFamilyRequest graphicsQueueRequest;
 QueueFamilyRequest presentationQueueRequest;
 QueueFamilyRequest transferQueueRequest;
 
 VkSurfaceKHR surface;
 
-GraphicsPipeline<Vertex>* graphicsPipeline;
+GraphicsPipeline<InstancedVertexLayout>* graphicsPipeline;
+GraphicsPipeline<InstancedVertexLayout>* depthPrePassPipeline = nullptr;
 CommandPool* graphicsCommandPool;
 CommandPool* transferCommandPool;
 
@@ -68,6 +121,11 @@ std::vector<Semaphore> renderFinishedSemaphores;
 
 std::vector<Fence> inFlightFences;
 
+// The fence of the frame that last rendered to each swapchain image, if any. Frames in flight and
+// swapchain images don't line up one to one, so this is what tells us an image's per-image
+// resources (its instance buffer) are no longer read by the GPU
+std::vector<Fence*> imagesInFlight;
+
 // TODO: find a way to only expose graphics vkCmd and transfer vkCmds to command Buffers with a
 // certain type of queue
 std::vector<CommandBuffer> graphicsCommandBuffers;
@@ -92,15 +150,59 @@ size_t currentFrame = 0;
 
 bool framebufferResized = false;
 
-Buffer<Vertex>* vertexBuffer;
 const std::vector<Vertex> vertices = {{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
                                       {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
                                       {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
                                       {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}};
 
-Buffer<uint16_t>* indexBuffer;
 const std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
 
+// Quad demo: a grid of QUAD_GRID_SIZE x QUAD_GRID_SIZE instances of the quad, all in one draw
+constexpr int QUAD_GRID_SIZE = 4;
+
+// The quads hang off a common root in the scene graph, one node per grid cell in row order
+SceneGraph sceneGraph;
+std::vector<SceneNode> quadNodes;
+
+// Optional scene passed on the command line, either a glTF file or a cooked .vkmesh file produced
+// by asset-cook. When loaded, it is drawn instead of the quad
+std::string sceneFile;
+std::vector<GpuMesh> sceneMeshes;
+std::vector<MeshInstance> sceneInstances;
+
+// Every mesh instance drawn each frame, one instanced draw per mesh
+InstancedDrawList drawList;
+
+// One per swapchain image, rewritten with the draw list's instances before each frame
+std::vector<std::unique_ptr<InstanceBuffer<InstanceData>>> instanceBuffers;
+
+// Indirect path: every mesh lives in meshPool (instead of sceneMeshes), and the whole draw list is
+// drawn with a single multi-draw indirect call per frame. Picked when the device supports it,
+// unless disabled on the command line
+bool disableIndirect = false;
+bool useIndirect = false;
+MeshPool* meshPool = nullptr;
+
+// GPU culling, on top of the indirect path: a compute pass writes the indirect commands instead of
+// the CPU. Replaces the buffers above when enabled. It also culls against a depth pyramid of the
+// previous frame, built from the depth buffer once the scene is drawn
+bool disableGpuCulling = false;
+GpuCuller* gpuCuller = nullptr;
+DepthPyramid* depthPyramid = nullptr;
+
+// Without GPU culling, the indirect path culls on the CPU: only the visible instances are written
+// to the instance buffer, and the indirect commands are rebuilt around them every frame
+FrustumCuller* cpuCuller = nullptr;
+SphereBounds cullBounds;
+std::vector<InstanceData> visibleInstances;
+
+// There is no camera yet: the scene is drawn straight in clip space, and culled against it
+const glm::mat4 viewProjection(1.0f);
+
+std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+ThreadPool* threadPool;
+
 // TODO: avoid pointer usage
 template <class InputType>
 OnDeviceBuffer<InputType>* copyToDevice(const CommandPool& transferCommandPool,
@@ -118,23 +220,8 @@ OnDeviceBuffer<InputType>* copyToDevice(const CommandPool& transferCommandPool,
   transferBuffer.copyBuffer(srcBuffer, *dstBuffer);
   transferBuffer.end();
 
-  VkCommandBuffer local = transferBuffer;
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &local;
-
-  // TODO: could we use a vulkan semaphore to figure out when the transfer is done?
-  if (vkQueueSubmit(transferCommandPool.getQueue().getQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
-      VK_SUCCESS) {
-    LOG_F("failed to submit draw command buffer!");
-  }
-
-  // TODO: this blocks until the queue is empty / idle, which isn't great for performance.
-  // Could we implement this as some kind of async / await system that uses Vulkan semaphores or
-  // something similar?
-  vkQueueWaitIdle(transferCommandPool.getQueue().getQueue());
+  // Only blocks until this copy has finished, rather than waiting for the whole queue to go idle
+  transferBuffer.submitAndWait();
 
   return dstBuffer;
 }
@@ -237,12 +324,55 @@ void createLogicalDevice(PhysicalDevice&& physicalDevice) {
     }
   }
 
-  device = new LogicalDevice(*instance, std::move(physicalDevice), deviceExtensionsCpp, requests);
+  DeviceFeatures requestedFeatures;
+  requestedFeatures.core.features.fullDrawIndexUint32 = VK_TRUE;
+  requestedFeatures.indexTypeUint8.indexTypeUint8 = VK_TRUE;
+  requestedFeatures.core.features.multiDrawIndirect = VK_TRUE;
+  requestedFeatures.core.features.drawIndirectFirstInstance = VK_TRUE;
+  requestedFeatures.vulkan12.drawIndirectCount = VK_TRUE;
+  BindlessDescriptors::requestFeatures(requestedFeatures);
+  DepthPyramid::requestFeatures(requestedFeatures);
+
+  device = new LogicalDevice(*instance,
+                             std::move(physicalDevice),
+                             deviceExtensionsCpp,
+                             requests,
+                             optionalDeviceExtensions,
+                             requestedFeatures);
 
   if (graphicsQueueRequest.getQueue() == VK_NULL_HANDLE ||
       presentationQueueRequest.getQueue() == VK_NULL_HANDLE) {
     LOG_F("Failed to get valid queue");
   }
+
+  // Batches start at arbitrary instances, which indirect draws can only express with
+  // drawIndirectFirstInstance. multiDrawIndirect is optional: without it every command is its own
+  // call, which still saves rebinding buffers between meshes
+  useIndirect =
+      !disableIndirect && device->getEnabledFeatures().core.features.drawIndirectFirstInstance;
+
+  LOG_I("Using {} draws{}",
+        useIndirect ? "indirect" : "direct",
+        useIndirect && device->getEnabledFeatures().vulkan12.drawIndirectCount
+            ? " with drawIndirectCount"
+            : "");
+
+  pipelineCache = new PipelineCache(*device, PIPELINE_CACHE_FILE);
+  descriptorLayouts = new DescriptorSetLayoutCache(*device);
+
+  if (BindlessDescriptors::isSupported(*device)) {
+    bindless = new BindlessDescriptors(*device, *descriptorLayouts);
+  }
+
+  if (useIndirect && !disableGpuCulling && !DepthPyramid::isSupported(*device)) {
+    LOG_W("The depth pyramid can't be built on this device, culling on the CPU instead");
+    disableGpuCulling = true;
+  }
+
+  if (useIndirect && disableGpuCulling) {
+    cpuCuller = new FrustumCuller(threadPool);
+    LOG_I("Frustum culling on the CPU, {} kernel", getCullKernelName(cpuCuller->getKernel()));
+  }
 }
 
 void createSwapChain(const LogicalDevice& device) {
@@ -289,20 +419,147 @@ VkShaderModule createShaderModule(const std::vector<char>& shaderSpirv) {
   return shaderModule;
 }
 
+// Record the scene's draws into the current subpass of command buffer `i`
+void recordSceneDraws(size_t i) {
+  // The batches are fixed once recorded: only the contents of the instance buffer change per
+  // frame. With drawIndirectCount, the number of draws may change too
+  if (!useIndirect) {
+    drawList.record(graphicsCommandBuffers[i], sceneMeshes, *instanceBuffers[i]);
+  } else if (gpuCuller) {
+    gpuCuller->recordDraw(graphicsCommandBuffers[i], i);
+  } else if (device->getEnabledFeatures().vulkan12.drawIndirectCount) {
+    drawList.recordIndirectCount(graphicsCommandBuffers[i], *meshPool, *instanceBuffers[i], i);
+  } else {
+    drawList.recordIndirect(graphicsCommandBuffers[i],
+                            *meshPool,
+                            *instanceBuffers[i],
+                            drawList.getIndirectBuffer(i));
+  }
+}
+
+// Build the frame's passes. Returns the one drawing the scene, whose render pass attachments take
+// their ops from the graph
+const RenderGraph::Pass& createFrameGraph() {
+  frameGraph = new RenderGraph();
+
+  bool useGpuCulling = useIndirect && !disableGpuCulling;
+
+  // The depth buffer is shared by the frames in flight: the previous frame may still test against
+  // it, or build its depth pyramid from it, and its contents are discarded
+  VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  if (useGpuCulling) {
+    depthStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  }
+
+  frameColor = frameGraph->importImage("swapchain", ResourceState::acquired());
+  frameDepth = frameGraph->importImage(
+      "depth",
+      {depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED});
+  frameGraph->markOutput(frameColor, ResourceState::present());
+
+  // Compute work can't run inside a render pass. The depth pyramid stays in GENERAL: like buffers,
+  // it only needs memory barriers. The previous frame built it, and the next one reads it
+  std::optional<RenderGraph::Resource> drawCommands;
+  std::optional<RenderGraph::Resource> pyramid;
+  if (useGpuCulling) {
+    drawCommands = frameGraph->importBuffer("draw commands");
+    pyramid = frameGraph->importBuffer(
+        "depth pyramid", {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT});
+    frameGraph->markOutput(*pyramid);
+
+    RenderGraph::Pass& cull = frameGraph->addPass("cull", [](CommandBuffer& commandBuffer) {
+      gpuCuller->recordCull(commandBuffer, frameGraphImage, false);
+    });
+    cull.write(*drawCommands, ResourceUsage::ComputeShader);
+    cull.read(*pyramid, ResourceUsage::ComputeShader);
+  }
+
+  RenderGraph::Pass& scene = frameGraph->addPass("scene", [](CommandBuffer& commandBuffer) {
+    commandBuffer.beginRenderPass(*renderPass, swapChainFramebuffers[frameGraphImage]);
+
+    // The same draws twice: depth only, then shading only the visible fragments
+    if (depthPrePassPipeline) {
+      commandBuffer.bindPipeline(*depthPrePassPipeline);
+      recordSceneDraws(frameGraphImage);
+      commandBuffer.nextSubpass();
+    }
+
+    commandBuffer.bindPipeline(*graphicsPipeline);
+    recordSceneDraws(frameGraphImage);
+
+    commandBuffer.endRenderPass();
+  });
+  if (drawCommands) {
+    scene.read(*drawCommands, ResourceUsage::IndirectCommand);
+  }
+  scene.write(frameColor, ResourceUsage::ColorAttachment);
+  scene.write(frameDepth, ResourceUsage::DepthAttachment);
+
+  if (pyramid) {
+    RenderGraph::Pass& build = frameGraph->addPass(
+        "depth pyramid", [](CommandBuffer& commandBuffer) { depthPyramid->record(commandBuffer); });
+    build.read(frameDepth, ResourceUsage::ComputeShader);
+    build.write(*pyramid, ResourceUsage::ComputeShader);
+  }
+
+  return scene;
+}
+
 void createRenderPass() {
+  const RenderGraph::Pass& scenePass = createFrameGraph();
+
   renderPass = new RenderPass(*device, swapchain->getExtent().width, swapchain->getExtent().height);
 
-  // Our render pass is only going to need a single attachment
-  const Attachment& outputColorAttachment = renderPass->createAttachment(swapchain->getFormat());
+  // Our render pass needs the swapchain image and a depth buffer of the same size. The graph
+  // transitions both around the pass: only the swapchain image is kept once it ends, and the
+  // depth buffer if the depth pyramid reads it. Depth is cleared every frame
+  const Attachment& outputColorAttachment = renderPass->createAttachment(
+      swapchain->getFormat(), frameGraph->getAttachmentOps(scenePass, frameColor));
+
+  VkFormat depthFormat = findDepthFormat(*device);
+  AttachmentOps depthOps = frameGraph->getAttachmentOps(scenePass, frameDepth);
+  const Attachment& depthAttachment = renderPass->createAttachment(depthFormat, depthOps);
+
+  // Unless the depth pyramid reads it, never stored, so tile-based GPUs can keep it in tile memory
+  // only, without backing it
+  VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  VkMemoryPropertyFlags depthMemory = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (useIndirect && !disableGpuCulling) {
+    depthUsage |= DepthPyramid::DEPTH_USAGE;
+  } else if (*depthOps.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE &&
+             device->getPhysicalDevice().hasMemoryType(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+    depthUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    depthMemory |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  }
+
+  depthImage = new Image(*device,
+                         swapchain->getExtent(),
+                         depthFormat,
+                         depthUsage,
+                         1,
+                         1,
+                         VK_SAMPLE_COUNT_1_BIT,
+                         depthMemory);
+  depthImageView = new ImageView(*depthImage);
+
+  if (useDepthPrePass) {
+    depthPrePassSubpass = &renderPass->createSubpass({}, &depthAttachment);
+    depthPrePassSubpass->addStartExternalDependency();
+  }
 
-  // Create a subpass within the render pass for rendering the player view
-  // Currently this is the only subpass in the render pass
-  playerViewSubpass = &renderPass->createSubpass({outputColorAttachment});
+  // Create a subpass within the render pass for rendering the player view. After a depth
+  // pre-pass, it only tests against the depth the pre-pass wrote
+  playerViewSubpass =
+      &renderPass->createSubpass({outputColorAttachment}, &depthAttachment, useDepthPrePass);
 
   // Indicate that this subpass depends on the completion of the previous
   // frame's commmand buffer
   playerViewSubpass->addStartExternalDependency();
 
+  if (depthPrePassSubpass) {
+    playerViewSubpass->dependOn(*depthPrePassSubpass);
+  }
+
   // Indicate that we're finished building the render pass
   renderPass->finalize();
 
@@ -310,17 +567,23 @@ void createRenderPass() {
   // acquired from the swapchain
   LOG_D("Creating {} framebuffers", swapChainImageViews.size());
   for (const auto& swapchainImageView : swapChainImageViews) {
-    swapChainFramebuffers.emplace_back(
-        renderPass->createFramebuffer({{outputColorAttachment, swapchainImageView}}));
+    swapChainFramebuffers.emplace_back(renderPass->createFramebuffer(
+        {{outputColorAttachment, swapchainImageView}, {depthAttachment, *depthImageView}}));
   }
 }
 
 void createGraphicsPipeline() {
-  VertexShaderModule<Vertex> vertexShader(*device, "shaders/shader.vert.spv");
+  VertexShaderModule<InstancedVertexLayout> vertexShader(*device, "shaders/shader.vert.spv");
   ShaderModule fragmentShader(*device, "shaders/shader.frag.spv");
 
-  graphicsPipeline =
-      new GraphicsPipeline(*device, *swapchain, *playerViewSubpass, vertexShader, fragmentShader);
+  if (useDepthPrePass) {
+    depthPrePassPipeline =
+        new GraphicsPipeline(*device, *swapchain, *depthPrePassSubpass, vertexShader);
+  }
+
+  DepthState depthState = useDepthPrePass ? DepthState::afterPrePass() : DepthState{};
+  graphicsPipeline = new GraphicsPipeline(
+      *device, *swapchain, *playerViewSubpass, vertexShader, fragmentShader, {}, {}, depthState);
 }
 
 // Command pools are memory regions from which we allocate a command buffer
@@ -332,33 +595,130 @@ void createCommandPool() {
 }
 
 void createCommandBuffers() {
-  // Create a command buffer for each framebuffer in the swapchain
+  // Create a command buffer and an instance buffer for each framebuffer in the swapchain
   for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
     graphicsCommandBuffers.emplace_back(graphicsCommandPool->allocateCommandBuffer());
+    // Vulkan doesn't allow empty buffers
+    size_t capacity = std::max<size_t>(drawList.getInstanceCount(), 1);
+    instanceBuffers.push_back(std::make_unique<InstanceBuffer<InstanceData>>(*device, capacity));
+
   }
 
-  // Start command buffer recording
+  if (useIndirect && disableGpuCulling) {
+    drawList.createIndirectBuffers(*device,
+                                   swapChainFramebuffers.size(),
+                                   drawList.getBatches().size());
+  }
+
+  imagesInFlight.assign(swapChainFramebuffers.size(), nullptr);
+
+  if (useIndirect && !disableGpuCulling) {
+    std::vector<const InstanceBuffer<InstanceData>*> cullInstances;
+    for (const auto& buffer : instanceBuffers) {
+      cullInstances.push_back(buffer.get());
+    }
+
+    ShaderModule downsampleShader(*device, "shaders/downsample.comp.spv");
+    depthPyramid = new DepthPyramid(*device,
+                                    *graphicsCommandPool,
+                                    *depthImage,
+                                    downsampleShader,
+                                    *descriptorLayouts,
+                                    pipelineCache);
+
+    ShaderModule cullShader(*device, "shaders/cull.comp.spv");
+    gpuCuller = new GpuCuller(*device,
+                              *meshPool,
+                              *depthPyramid,
+                              cullShader,
+                              *descriptorLayouts,
+                              cullInstances,
+                              drawList.getInstanceCount(),
+                              pipelineCache);
+  }
+
+  // Start command buffer recording. The graph compiles on the first one; the others replay its
+  // barriers with their own swapchain image
+  frameGraph->setImage(frameDepth, *depthImage);
   for (size_t i = 0; i < graphicsCommandBuffers.size(); i++) {
     graphicsCommandBuffers[i].begin();
 
-    graphicsCommandBuffers[i].beginRenderPass(*renderPass, swapChainFramebuffers[i]);
+    frameGraphImage = i;
+    frameGraph->setImage(frameColor, swapChainImageViews[i].getImage());
+    frameGraph->record(graphicsCommandBuffers[i]);
+
+    graphicsCommandBuffers[i].end();
+  }
 
-    graphicsCommandBuffers[i].bindPipeline(*graphicsPipeline);
+  LOG_D("Frame graph records {} barriers per frame", frameGraph->getBarrierCount());
+}
 
-    graphicsCommandBuffers[i].bindVertexBuffers(*vertexBuffer);
+// Fill the draw list. The number of instances per mesh must stay the same from frame to frame,
+// since the command buffers are only recorded once
+void buildDrawList(float seconds) {
+  drawList.clear();
 
-    graphicsCommandBuffers[i].bindIndexBuffer(*indexBuffer);
+  if (!sceneFile.empty()) {
+    for (const auto& instance : sceneInstances) {
+      drawList.add(instance.meshIndex, {instance.transform});
+    }
+  } else {
+    float cell = 2.0f / QUAD_GRID_SIZE;
+    if (quadNodes.empty()) {
+      SceneNode root = sceneGraph.addNode();
+      for (int y = 0; y < QUAD_GRID_SIZE; y++) {
+        for (int x = 0; x < QUAD_GRID_SIZE; x++) {
+          glm::vec3 center(-1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f), 0.0f);
+          quadNodes.push_back(sceneGraph.addNode(
+              root, center, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(cell * 0.7f)));
+        }
+      }
+    }
 
-    graphicsCommandBuffers[i].drawIndexed(indexBuffer->getNumElements(),  // Num Vertices to draw
-                                          1,                              // Instance count
-                                          0,                              // firstIndexOffset
-                                          0,                              // indexValueOffset
-                                          0                               // instance offset
-    );
+    for (int y = 0; y < QUAD_GRID_SIZE; y++) {
+      for (int x = 0; x < QUAD_GRID_SIZE; x++) {
+        sceneGraph.setRotation(quadNodes[y * QUAD_GRID_SIZE + x],
+                               glm::angleAxis(seconds + x + y, glm::vec3(0.0f, 0.0f, 1.0f)));
+      }
+    }
+    sceneGraph.update(threadPool);
 
-    graphicsCommandBuffers[i].endRenderPass();
+    for (int y = 0; y < QUAD_GRID_SIZE; y++) {
+      for (int x = 0; x < QUAD_GRID_SIZE; x++) {
+        glm::vec4 color(float(x + 1) / QUAD_GRID_SIZE, float(y + 1) / QUAD_GRID_SIZE, 1.0f, 1.0f);
 
-    graphicsCommandBuffers[i].end();
+        drawList.add(0, {sceneGraph.getWorldTransform(quadNodes[y * QUAD_GRID_SIZE + x]), color});
+      }
+    }
+  }
+
+  drawList.build();
+}
+
+// Write this frame's instances into the image's instance buffer. Only call once nothing in flight
+// reads from it
+void updateInstances(uint32_t imageIndex) {
+  // Only the quad demo animates; scene instances are static and the list was built once
+  if (sceneFile.empty()) {
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime)
+                        .count();
+    buildDrawList(seconds);
+  }
+
+  if (gpuCuller) {
+    instanceBuffers[imageIndex]->write(drawList.getInstances());
+    gpuCuller->update(imageIndex, drawList, viewProjection);
+  } else if (useIndirect) {
+    drawList.getBoundingSpheres(*meshPool, cullBounds);
+    const std::vector<uint32_t>& visible =
+        cpuCuller->cull(Frustum::fromMatrix(viewProjection), cullBounds);
+
+    std::vector<VkDrawIndexedIndirectCommand> commands =
+        drawList.getVisibleIndirectCommands(*meshPool, visible, visibleInstances);
+    instanceBuffers[imageIndex]->write(visibleInstances);
+    drawList.writeIndirect(imageIndex, commands);
+  } else {
+    instanceBuffers[imageIndex]->write(drawList.getInstances());
   }
 }
 
@@ -379,7 +739,19 @@ void createSyncObjects() {
 void cleanupSwapChain() {
   graphicsCommandBuffers.clear();
 
+  // References the instance buffers and the depth pyramid, which reads the depth buffer
+  delete gpuCuller;
+  gpuCuller = nullptr;
+  delete depthPyramid;
+  depthPyramid = nullptr;
+
+  instanceBuffers.clear();
+  drawList.destroyIndirectBuffers();
+  imagesInFlight.clear();
+
   delete graphicsPipeline;
+  delete depthPrePassPipeline;
+  depthPrePassPipeline = nullptr;
 
   // These references are now invalid since we're about to destroy the
   // underlying framebuffers
@@ -387,6 +759,15 @@ void cleanupSwapChain() {
 
   // Destroy the render pass, all associated framebuffers and attachments
   delete renderPass;
+  depthPrePassSubpass = nullptr;
+
+  // Its attachments took their ops from the graph, which is rebuilt with it
+  delete frameGraph;
+  frameGraph = nullptr;
+
+  // No framebuffer references the depth buffer anymore
+  delete depthImageView;
+  delete depthImage;
 
   // Delete all the swapchain image views
   swapChainImageViews.clear();
@@ -440,6 +821,14 @@ void drawFrame() {
     throw std::runtime_error("failed to acquire swapchain image!");
   }
 
+  // A previous frame may still be rendering to this image, and reading its instance buffer
+  if (imagesInFlight[imageIndex] != nullptr) {
+    imagesInFlight[imageIndex]->wait();
+  }
+  imagesInFlight[imageIndex] = &inFlightFences[currentFrame];
+
+  updateInstances(imageIndex);
+
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -504,9 +893,93 @@ void drawFrame() {
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void createVertexBuffer() { vertexBuffer = copyToDevice(*transferCommandPool, vertices); }
+// The quad demo's mesh, drawn when no scene is loaded
+void createQuadMesh() {
+  if (useIndirect) {
+    std::vector<uint32_t> quadIndices(indices.begin(), indices.end());
+    meshPool->addMesh(vertices.data(), vertices.size(), quadIndices.data(), quadIndices.size());
+    meshPool->upload(*transferCommandPool);
+    return;
+  }
+
+  GpuMesh quad;
+  quad.vertexBuffer.reset(copyToDevice(*transferCommandPool, vertices));
+
+  std::vector<uint8_t> indexBytes(indices.size() * sizeof(uint16_t));
+  memcpy(indexBytes.data(), indices.data(), indexBytes.size());
+
+  TransferBuffer<uint8_t> staging(*device, indexBytes);
+  quad.indexBuffer = std::make_unique<IndexBuffer>(*device, VK_INDEX_TYPE_UINT16, indices.size());
+
+  CommandBuffer transferBuffer = transferCommandPool->allocateCommandBuffer();
+  transferBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  transferBuffer.copyBuffer(staging, *quad.indexBuffer);
+  transferBuffer.end();
+  transferBuffer.submitAndWait();
+
+  sceneMeshes.push_back(std::move(quad));
+}
+
+void loadScene() {
+  if (useIndirect) {
+    meshPool = new MeshPool(*device);
+  }
+
+  if (sceneFile.empty()) {
+    createQuadMesh();
+    buildDrawList(0.0f);
+    return;
+  }
+
+  // Cooked meshes are already in GPU layout: map the file and copy straight into staging buffers
+  if (std::filesystem::path(sceneFile).extension() == ".vkmesh") {
+    CookedMeshFile cookedFile(sceneFile);
+
+    if (useIndirect) {
+      for (size_t i = 0; i < cookedFile.getMeshCount(); i++) {
+        const CookedMeshEntry& entry = cookedFile.getEntry(i);
+        std::vector<uint32_t> meshIndices = cookedFile.decodeIndices(i);
+        meshPool->addMesh(
+            cookedFile.getVertices(i), entry.vertexCount, meshIndices.data(), meshIndices.size());
+      }
+      meshPool->upload(*transferCommandPool);
+    } else {
+      sceneMeshes = cookedFile.uploadAll(*device, *transferCommandPool);
+    }
+
+    LOG_I("Loaded {} cooked meshes from '{}'", cookedFile.getMeshCount(), sceneFile);
+
+    // Placed as the source scene's node hierarchy placed them
+    sceneInstances = cookedFile.getInstances();
 
-void createIndexBuffer() { indexBuffer = copyToDevice(*transferCommandPool, indices); }
+    buildDrawList(0.0f);
+    return;
+  }
+
+  GltfLoader loader(*threadPool);
+  GltfLoadStats stats;
+
+  GltfScene scene = loader.load(sceneFile, &stats);
+
+  if (useIndirect) {
+    for (const auto& mesh : scene.meshes) {
+      meshPool->addMesh(mesh);
+    }
+    meshPool->upload(*transferCommandPool);
+  } else {
+    sceneMeshes = loader.upload(scene.meshes, *device, transferQueueRequest, &stats);
+  }
+
+  sceneInstances = std::move(scene.instances);
+
+  stats.log();
+
+  buildDrawList(0.0f);
+  LOG_I("Drawing {} instances of {} meshes in {} instanced draws",
+        drawList.getInstanceCount(),
+        scene.meshes.size(),
+        drawList.getBatches().size());
+}
 
 void initVulkan() {
   createInstance();
@@ -534,9 +1007,7 @@ void initVulkan() {
 
   createSyncObjects();
 
-  createVertexBuffer();
-
-  createIndexBuffer();
+  loadScene();
 
   createCommandBuffers();
 }
@@ -553,9 +1024,16 @@ void mainLoop() {
 void cleanup() {
   cleanupSwapChain();
 
-  delete vertexBuffer;
+  sceneMeshes.clear();
 
-  delete indexBuffer;
+  delete meshPool;
+
+  delete cpuCuller;
+
+  pipelineCache->save();
+  delete pipelineCache;
+  delete bindless;
+  delete descriptorLayouts;
 
   renderFinishedSemaphores.clear();
 
@@ -573,16 +1051,22 @@ void cleanup() {
   delete instance;
 
   delete windowSystem;
+
+  delete threadPool;
 }
 
 int main(int argc, char** argv) {
   CLI::App app{"Vulkan Engine"};
 
-  std::string filename = "default";
-  app.add_option("-f,--file", filename, "A help string");
+  app.add_option("-f,--file", sceneFile, "glTF 2.0 scene (.gltf or .glb) to load");
+  app.add_flag("--no-indirect", disableIndirect, "Record one draw call per mesh");
+  app.add_flag("--no-gpu-cull", disableGpuCulling, "Frustum cull on the CPU instead of on the GPU");
+  app.add_flag("--depth-prepass", useDepthPrePass, "Draw depth first, then shade visible pixels");
 
   CLI11_PARSE(app, argc, argv);
 
+  threadPool = new ThreadPool();
+
   initWindow();
   initVulkan();
 
@@ -4,10 +4,17 @@
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
+// Per-instance inputs (InstanceData)
+layout(location = 2) in mat4 inTransform;
+layout(location = 6) in vec4 inInstanceColor;
+
 // Shader Outputs
 layout(location = 0) out vec3 fragColor;
 
+// The depth pre-pass runs this shader too: both must produce bit-identical depths for its EQUAL test
+invariant gl_Position;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    gl_Position = inTransform * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor.rgb;
+}
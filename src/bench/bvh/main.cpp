@@ -0,0 +1,161 @@
+#include <fmt/core.h>
+
+#include <CLI/App.hpp>
+#include <CLI/Config.hpp>
+#include <CLI/Formatter.hpp>
+#include <algorithm>
+#include <bench/common/timing.hpp>
+#include <engine/render/Bvh.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * bvh-bench: how building, updating and querying the BVH scale with scene size.
+ *
+ * For every object count it times a full SAH build, a refit after every object moved a little
+ * (the animated case), incremental updates of a few objects, and frustum, box and ray queries.
+ * SAH cost and height are printed after each step, to show how well refits and rotations keep the
+ * tree in shape:
+ *
+ *   bvh-bench
+ *   bvh-bench -n 50000 -n 200000
+ */
+
+namespace {
+
+constexpr float WORLD_SIZE = 1000.0f;
+
+Aabb randomBox(std::mt19937& rng) {
+  std::uniform_real_distribution<float> position(-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f);
+  std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+  glm::vec3 center(position(rng), position(rng), position(rng));
+  glm::vec3 extent(size(rng), size(rng), size(rng));
+  return Aabb(center - extent, center + extent);
+}
+
+Aabb moveBox(const Aabb& box, std::mt19937& rng, float distance) {
+  std::uniform_real_distribution<float> offset(-distance, distance);
+  glm::vec3 delta(offset(rng), offset(rng), offset(rng));
+  return Aabb(box.min + delta, box.max + delta);
+}
+
+void printTree(const char* stage, const Bvh& bvh, double ms) {
+  fmt::print("  {:<22} {:10.3f} ms   SAH cost {:8.2f}  height {:3}\n",
+             stage,
+             ms,
+             bvh.getSahCost(),
+             bvh.getHeight());
+}
+
+void printQuery(const char* stage, double ms, size_t queries, size_t results) {
+  fmt::print("  {:<22} {:10.3f} ms   {:9.3f} us/query  {} results\n",
+             stage,
+             ms,
+             ms * 1000.0 / queries,
+             results);
+}
+
+void benchmark(size_t count, ThreadPool& threadPool) {
+  fmt::print("{} objects\n", count);
+
+  std::mt19937 rng(1234);
+  std::vector<Aabb> boxes(count);
+  for (auto& box : boxes) {
+    box = randomBox(rng);
+  }
+
+  Bvh bvh;
+  printTree("build, 1 thread", bvh, timeMs([&]() { bvh.build(boxes); }));
+  printTree(fmt::format("build, {} threads", threadPool.getThreadCount() + 1).c_str(),
+            bvh,
+            timeMs([&]() { bvh.build(boxes, &threadPool); }));
+
+  // Animated scene: everything drifts a little, then one refit per frame
+  for (uint32_t frame = 0; frame < 10; frame++) {
+    for (size_t i = 0; i < count; i++) {
+      boxes[i] = moveBox(boxes[i], rng, 2.0f);
+      bvh.setBounds(static_cast<uint32_t>(i), boxes[i]);
+    }
+
+    double ms = timeMs([&]() { bvh.refit(&threadPool); });
+    if (frame == 0 || frame == 9) {
+      printTree(frame == 0 ? "refit, frame 1" : "refit, frame 10", bvh, ms);
+    }
+  }
+
+  // A few objects moving far, one at a time
+  size_t updateCount = std::max<size_t>(count / 100, 1);
+  std::uniform_int_distribution<size_t> pickObject(0, count - 1);
+  printTree(fmt::format("{} updates", updateCount).c_str(), bvh, timeMs([&]() {
+              for (size_t i = 0; i < updateCount; i++) {
+                size_t object = pickObject(rng);
+                boxes[object] = moveBox(boxes[object], rng, WORLD_SIZE * 0.1f);
+                bvh.update(static_cast<uint32_t>(object), boxes[object]);
+              }
+            }));
+
+  glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+  glm::mat4 view =
+      glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum = Frustum::fromMatrix(projection * view);
+
+  std::vector<uint32_t> objects;
+  double ms = timeMs([&]() { bvh.queryFrustum(frustum, objects); });
+  printQuery("frustum, 1 thread", ms, 1, objects.size());
+
+  objects.clear();
+  ms = timeMs([&]() { bvh.queryFrustum(frustum, objects, &threadPool); });
+  printQuery("frustum, pool", ms, 1, objects.size());
+
+  constexpr size_t QUERY_COUNT = 10000;
+  objects.clear();
+  ms = timeMs([&]() {
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+      Aabb box = randomBox(rng);
+      bvh.queryAabb(Aabb(box.min - glm::vec3(10.0f), box.max + glm::vec3(10.0f)), objects);
+    }
+  });
+  printQuery("box (20 units)", ms, QUERY_COUNT, objects.size());
+
+  // Rays from random points towards random points, so most of them cross the whole scene
+  std::vector<BvhRay> rays(QUERY_COUNT);
+  for (auto& ray : rays) {
+    ray.origin = randomBox(rng).getCenter();
+    ray.direction = randomBox(rng).getCenter() - ray.origin;
+  }
+
+  std::vector<BvhRayHit> hits;
+  auto countHits = [&hits]() {
+    return static_cast<size_t>(std::count_if(hits.begin(), hits.end(), [](const BvhRayHit& hit) {
+      return hit.object != Bvh::NO_OBJECT;
+    }));
+  };
+
+  ms = timeMs([&]() { bvh.raycast(rays, hits); });
+  printQuery("rays, 1 thread", ms, QUERY_COUNT, countHits());
+
+  ms = timeMs([&]() { bvh.raycast(rays, hits, &threadPool); });
+  printQuery("rays, pool", ms, QUERY_COUNT, countHits());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CLI::App app{"BVH benchmark"};
+
+  std::vector<size_t> counts = {10000, 100000, 1000000};
+  app.add_option("-n,--count", counts, "Object counts to benchmark");
+
+  CLI11_PARSE(app, argc, argv);
+
+  ThreadPool threadPool;
+  for (size_t count : counts) {
+    benchmark(count, threadPool);
+  }
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Wall-clock time of one call to `fn`, in milliseconds
+template <class Fn>
+double timeMs(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Median of `iterations` runs, which is less noisy than the mean on a busy machine
+template <class Fn>
+double medianMs(int iterations, Fn&& fn) {
+  std::vector<double> times;
+  for (int i = 0; i < iterations; i++) {
+    times.push_back(timeMs(fn));
+  }
+
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
@@ -0,0 +1,188 @@
+#include <fmt/core.h>
+
+#include <CLI/App.hpp>
+#include <CLI/Config.hpp>
+#include <CLI/Formatter.hpp>
+#include <algorithm>
+#include <bench/common/timing.hpp>
+#include <cfloat>
+#include <cmath>
+#include <engine/render/FrustumCuller.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <initializer_list>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * frustum-cull-bench: times the CPU frustum culling kernels on 10k, 100k and 1M random bounding
+ * spheres and boxes, single-threaded and split across a thread pool.
+ *
+ * Objects are scattered uniformly around a camera with a 60 degree field of view, so roughly a
+ * tenth of them end up visible:
+ *
+ *   frustum-cull-bench
+ *   frustum-cull-bench -n 250000 -i 50
+ */
+
+namespace {
+
+constexpr float WORLD_SIZE = 1000.0f;
+
+Frustum makeFrustum() {
+  glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+  glm::mat4 view =
+      glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  return Frustum::fromMatrix(projection * view);
+}
+
+void fillBounds(size_t count, SphereBounds& spheres, BoxBounds& boxes, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> position(-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f);
+  std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+  spheres.resize(count);
+  boxes.resize(count);
+
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    glm::vec3 extent(size(rng), size(rng), size(rng));
+
+    spheres.set(i, glm::vec4(center, glm::length(extent)));
+    boxes.set(i, center - extent, center + extent);
+  }
+}
+
+// Kernels sum the plane distance terms in different orders, with or without FMA, so a volume that
+// touches a plane can land on either side of it depending on the kernel. Volumes the kernels
+// disagree on must be within this fraction of the summed terms' magnitude of a plane
+constexpr double PLANE_TOLERANCE = 1e-5;
+
+// Sum of `terms` relative to the sum of their magnitudes, which bounds its rounding error
+double getRelativeSum(std::initializer_list<double> terms) {
+  double sum = 0.0;
+  double magnitude = 0.0;
+  for (double term : terms) {
+    sum += term;
+    magnitude += std::fabs(term);
+  }
+  return magnitude > 0.0 ? sum / magnitude : 0.0;
+}
+
+// Relative distance of volume `i` past the plane it is furthest behind, computed in double
+// precision. Negative when the volume is culled
+double getRelativeMargin(const Frustum& frustum, const SphereBounds& bounds, size_t i) {
+  double margin = DBL_MAX;
+  for (const auto& plane : frustum.planes) {
+    glm::dvec4 p(plane);
+    margin = std::min(margin,
+                      getRelativeSum({p.x * bounds.getX()[i],
+                                      p.y * bounds.getY()[i],
+                                      p.z * bounds.getZ()[i],
+                                      p.w,
+                                      bounds.getRadius()[i]}));
+  }
+  return margin;
+}
+
+double getRelativeMargin(const Frustum& frustum, const BoxBounds& bounds, size_t i) {
+  double margin = DBL_MAX;
+  for (const auto& plane : frustum.planes) {
+    glm::dvec4 p(plane);
+    margin = std::min(margin,
+                      getRelativeSum({p.x * bounds.getCenterX()[i],
+                                      p.y * bounds.getCenterY()[i],
+                                      p.z * bounds.getCenterZ()[i],
+                                      p.w,
+                                      std::fabs(p.x) * bounds.getExtentX()[i],
+                                      std::fabs(p.y) * bounds.getExtentY()[i],
+                                      std::fabs(p.z) * bounds.getExtentZ()[i]}));
+  }
+  return margin;
+}
+
+// Whether `visible` only differs from `expected` by volumes touching a plane, within rounding
+template <class Bounds>
+bool matchesReference(const std::vector<uint32_t>& expected,
+                      const std::vector<uint32_t>& visible,
+                      const Frustum& frustum,
+                      const Bounds& bounds) {
+  std::vector<uint32_t> differences;
+  std::set_symmetric_difference(expected.begin(),
+                                expected.end(),
+                                visible.begin(),
+                                visible.end(),
+                                std::back_inserter(differences));
+
+  return std::all_of(differences.begin(), differences.end(), [&](uint32_t i) {
+    return std::fabs(getRelativeMargin(frustum, bounds, i)) <= PLANE_TOLERANCE;
+  });
+}
+
+template <class Bounds>
+void benchmark(const char* shape,
+               const Frustum& frustum,
+               const Bounds& bounds,
+               ThreadPool& threadPool,
+               int iterations) {
+  // The scalar kernel is the reference every other kernel has to agree with
+  FrustumCuller reference(nullptr, CullKernel::Scalar);
+  std::vector<uint32_t> expected = reference.cull(frustum, bounds);
+
+  fmt::print("  {} ({} visible)\n", shape, expected.size());
+
+  for (CullKernel kernel :
+       {CullKernel::Scalar, CullKernel::SSE, CullKernel::AVX2, CullKernel::NEON}) {
+    if (!isCullKernelSupported(kernel)) {
+      continue;
+    }
+
+    FrustumCuller serial(nullptr, kernel);
+    FrustumCuller parallel(&threadPool, kernel);
+
+    double serialMs = medianMs(iterations, [&]() { serial.cull(frustum, bounds); });
+    double parallelMs = medianMs(iterations, [&]() { parallel.cull(frustum, bounds); });
+
+    bool matches = matchesReference(expected, serial.getVisible(), frustum, bounds) &&
+                   matchesReference(expected, parallel.getVisible(), frustum, bounds);
+
+    fmt::print("    {:<7} 1 thread {:9.3f} ms {:7.2f} ns/object   {} threads {:9.3f} ms{}\n",
+               getCullKernelName(kernel),
+               serialMs,
+               serialMs * 1e6 / bounds.size(),
+               threadPool.getThreadCount() + 1,
+               parallelMs,
+               matches ? "" : "   MISMATCH");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CLI::App app{"Frustum culling benchmark"};
+
+  std::vector<size_t> counts = {10000, 100000, 1000000};
+  app.add_option("-n,--count", counts, "Object counts to benchmark");
+
+  int iterations = 20;
+  app.add_option("-i,--iterations", iterations, "Runs per measurement");
+
+  CLI11_PARSE(app, argc, argv);
+
+  ThreadPool threadPool;
+  Frustum frustum = makeFrustum();
+
+  for (size_t count : counts) {
+    SphereBounds spheres;
+    BoxBounds boxes;
+    fillBounds(count, spheres, boxes, 1234);
+
+    fmt::print("{} objects\n", count);
+    benchmark("spheres", frustum, spheres, threadPool, iterations);
+    benchmark("boxes", frustum, boxes, threadPool, iterations);
+  }
+
+  return 0;
+}
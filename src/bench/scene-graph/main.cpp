@@ -0,0 +1,116 @@
+#include <fmt/core.h>
+
+#include <CLI/App.hpp>
+#include <CLI/Config.hpp>
+#include <CLI/Formatter.hpp>
+#include <bench/common/timing.hpp>
+#include <engine/scene/SceneGraph.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+#include <vector>
+
+/**
+ * scene-graph-bench: how long SceneGraph::update() takes for an animated hierarchy.
+ *
+ * The graph is a forest of shallow trees (a root with a few levels of children under it, like a
+ * set of characters or props). Every frame either all nodes are animated, or only a fraction of
+ * them, and update() is timed with and without the thread pool:
+ *
+ *   scene-graph-bench
+ *   scene-graph-bench -n 100000 --frames 200
+ */
+
+namespace {
+
+// Roots with CHILD_COUNT children per node, DEPTH levels deep, until `count` nodes exist
+void buildForest(SceneGraph& graph, size_t count, std::mt19937& rng) {
+  constexpr size_t CHILD_COUNT = 4;
+  constexpr size_t DEPTH = 4;
+
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+  auto randomOffset = [&]() { return glm::vec3(offset(rng), offset(rng), offset(rng)); };
+
+  std::vector<SceneNode> level;
+  std::vector<SceneNode> nextLevel;
+  while (graph.getNodeCount() < count) {
+    level.assign(1, graph.addNode(SceneGraph::NO_NODE, randomOffset() * 100.0f));
+
+    for (size_t depth = 1; depth < DEPTH && graph.getNodeCount() < count; depth++) {
+      nextLevel.clear();
+      for (SceneNode parent : level) {
+        for (size_t i = 0; i < CHILD_COUNT && graph.getNodeCount() < count; i++) {
+          nextLevel.push_back(graph.addNode(parent, randomOffset()));
+        }
+      }
+      std::swap(level, nextLevel);
+    }
+  }
+}
+
+void benchmark(size_t count, uint32_t frames, ThreadPool& threadPool) {
+  fmt::print("{} nodes\n", count);
+
+  std::mt19937 rng(1234);
+  SceneGraph graph;
+  buildForest(graph, count, rng);
+
+  auto animate = [&](uint32_t frame, size_t stride) {
+    for (size_t node = frame % stride; node < count; node += stride) {
+      float angle = 0.01f * frame + 0.001f * node;
+      graph.setRotation(static_cast<SceneNode>(node),
+                        glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+  };
+
+  struct Case {
+    const char* name;
+    size_t stride;  // Animate every stride-th node
+    ThreadPool* threadPool;
+  };
+  const Case cases[] = {{"all dirty, 1 thread", 1, nullptr},
+                        {"all dirty, pool", 1, &threadPool},
+                        {"1/10 dirty, 1 thread", 10, nullptr},
+                        {"1/10 dirty, pool", 10, &threadPool},
+                        {"1/1000 dirty, 1 thread", 1000, nullptr},
+                        {"1/1000 dirty, pool", 1000, &threadPool}};
+
+  // Settle the initial layout
+  graph.update(&threadPool);
+
+  for (const Case& c : cases) {
+    double total = 0.0;
+    size_t updated = 0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      animate(frame, c.stride);
+      total += timeMs([&]() { graph.update(c.threadPool); });
+      updated += graph.getUpdatedCount();
+    }
+
+    fmt::print("  {:<24} {:8.3f} ms/frame  {:9} nodes/frame\n",
+               c.name,
+               total / frames,
+               updated / frames);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CLI::App app{"Scene graph benchmark"};
+
+  std::vector<size_t> counts = {10000, 100000, 1000000};
+  app.add_option("-n,--count", counts, "Node counts to benchmark");
+
+  uint32_t frames = 100;
+  app.add_option("--frames", frames, "Frames to average over");
+
+  CLI11_PARSE(app, argc, argv);
+
+  ThreadPool threadPool;
+  for (size_t count : counts) {
+    benchmark(count, frames, threadPool);
+  }
+
+  return 0;
+}
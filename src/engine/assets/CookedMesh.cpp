@@ -0,0 +1,324 @@
+#include "CookedMesh.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fmtlog/Log.hpp>
+#include <fstream>
+#include <limits>
+
+using namespace std::filesystem;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Pad the stream with zeroes up to `offset`
+static void padTo(std::ofstream& out, uint64_t offset) {
+  static const char zeroes[COOKED_DATA_ALIGNMENT] = {};
+
+  uint64_t position = static_cast<uint64_t>(out.tellp());
+  while (position < offset) {
+    uint64_t count = std::min<uint64_t>(offset - position, sizeof(zeroes));
+    out.write(zeroes, count);
+    position += count;
+  }
+}
+
+size_t writeCookedMeshFile(const path& file, const GltfScene& scene, bool allowUint8Indices) {
+  // Convert everything up front, so the table of contents can be written in one go
+  std::vector<std::vector<Vertex>> vertexBlobs;
+  std::vector<std::vector<uint8_t>> indexBlobs;
+  std::vector<CookedMeshEntry> toc;
+
+  // Index of each of the scene's meshes in the table of contents, for the instances
+  constexpr uint32_t SKIPPED = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> cookedIndices(scene.meshes.size(), SKIPPED);
+
+  for (size_t m = 0; m < scene.meshes.size(); m++) {
+    const MeshData& mesh = scene.meshes[m];
+    if (mesh.getVertexCount() == 0 || mesh.getIndexCount() == 0) {
+      LOG_W("Mesh '{}' is empty, not cooking it", mesh.name);
+      continue;
+    }
+
+    if (mesh.getVertexCount() > std::numeric_limits<uint32_t>::max()) {
+      LOG_W("Mesh '{}' has {} vertices, which doesn't fit 32-bit indices, not cooking it",
+            mesh.name,
+            mesh.getVertexCount());
+      continue;
+    }
+
+    CookedMeshEntry entry{};
+    std::strncpy(entry.name, mesh.name.c_str(), sizeof(entry.name) - 1);
+
+    entry.vertexCount = static_cast<uint32_t>(mesh.getVertexCount());
+    entry.vertexStride = sizeof(Vertex);
+    entry.vertexSize = entry.vertexCount * sizeof(Vertex);
+    entry.vertexFormat = CookedVertexFormat::Vertex;
+
+    entry.indexType = selectIndexType(mesh.getVertexCount(), allowUint8Indices);
+    entry.indexCount = static_cast<uint32_t>(mesh.getIndexCount());
+    entry.indexSize = entry.indexCount * getIndexTypeSize(entry.indexType);
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    mesh.getBounds(boundsMin, boundsMax);
+
+    for (int i = 0; i < 3; i++) {
+      entry.boundsMin[i] = boundsMin[i];
+      entry.boundsMax[i] = boundsMax[i];
+    }
+
+    vertexBlobs.push_back(mesh.toVertices());
+    indexBlobs.push_back(mesh.encodeIndices(entry.indexType));
+    cookedIndices[m] = static_cast<uint32_t>(toc.size());
+    toc.push_back(entry);
+  }
+
+  std::vector<CookedInstance> instances;
+  for (const auto& instance : scene.instances) {
+    if (instance.meshIndex >= cookedIndices.size() ||
+        cookedIndices[instance.meshIndex] == SKIPPED) {
+      continue;
+    }
+
+    CookedInstance cooked{};
+    cooked.meshIndex = cookedIndices[instance.meshIndex];
+    std::memcpy(cooked.transform, &instance.transform[0][0], sizeof(cooked.transform));
+    instances.push_back(cooked);
+  }
+
+  // Lay out the file: header, table of contents, instances, then every blob on an aligned boundary
+  CookedFileHeader header{};
+  std::memcpy(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic));
+  header.version = COOKED_MESH_VERSION;
+  header.meshCount = static_cast<uint32_t>(toc.size());
+  header.instanceCount = static_cast<uint32_t>(instances.size());
+  header.tocOffset = sizeof(CookedFileHeader);
+  header.instanceOffset = header.tocOffset + toc.size() * sizeof(CookedMeshEntry);
+
+  uint64_t offset = header.instanceOffset + instances.size() * sizeof(CookedInstance);
+  for (auto& entry : toc) {
+    entry.vertexOffset = alignUp(offset, COOKED_DATA_ALIGNMENT);
+    entry.indexOffset = alignUp(entry.vertexOffset + entry.vertexSize, COOKED_DATA_ALIGNMENT);
+    offset = entry.indexOffset + entry.indexSize;
+  }
+  header.fileSize = offset;
+
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    LOG_F("Failed to open '{}' for writing", file.generic_string());
+  }
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(CookedMeshEntry));
+  out.write(reinterpret_cast<const char*>(instances.data()),
+            instances.size() * sizeof(CookedInstance));
+
+  for (size_t i = 0; i < toc.size(); i++) {
+    padTo(out, toc[i].vertexOffset);
+    out.write(reinterpret_cast<const char*>(vertexBlobs[i].data()), toc[i].vertexSize);
+
+    padTo(out, toc[i].indexOffset);
+    out.write(reinterpret_cast<const char*>(indexBlobs[i].data()), toc[i].indexSize);
+  }
+
+  if (!out.good()) {
+    LOG_F("Failed to write cooked mesh file '{}'", file.generic_string());
+  }
+
+  return toc.size();
+}
+
+CookedMeshFile::CookedMeshFile(const path& file) : path_(file), file_(file) {
+  if (!file_.isOpen()) {
+    LOG_F("Failed to map cooked mesh file '{}'", path_.generic_string());
+  }
+
+  if (file_.size() < sizeof(CookedFileHeader)) {
+    LOG_F("'{}' is too small to be a cooked mesh file", path_.generic_string());
+  }
+
+  header_ = reinterpret_cast<const CookedFileHeader*>(file_.data());
+
+  if (std::memcmp(header_->magic, COOKED_MESH_MAGIC, sizeof(COOKED_MESH_MAGIC)) != 0) {
+    LOG_F("'{}' is not a cooked mesh file", path_.generic_string());
+  }
+
+  if (header_->version != COOKED_MESH_VERSION) {
+    LOG_F("'{}' has version {}, expected {}: re-cook the asset",
+          path_.generic_string(),
+          header_->version,
+          COOKED_MESH_VERSION);
+  }
+
+  // Offsets and sizes come from the file: compare them without sums that could wrap around
+  if (header_->fileSize != file_.size() || header_->tocOffset > file_.size() ||
+      uint64_t(header_->meshCount) * sizeof(CookedMeshEntry) > file_.size() - header_->tocOffset ||
+      header_->tocOffset % alignof(CookedMeshEntry) != 0) {
+    LOG_F("'{}' is truncated", path_.generic_string());
+  }
+
+  toc_ = reinterpret_cast<const CookedMeshEntry*>(file_.data() + header_->tocOffset);
+
+  if (header_->instanceOffset > file_.size() ||
+      uint64_t(header_->instanceCount) * sizeof(CookedInstance) >
+          file_.size() - header_->instanceOffset ||
+      header_->instanceOffset % alignof(CookedInstance) != 0) {
+    LOG_F("'{}' is truncated", path_.generic_string());
+  }
+
+  instances_ = reinterpret_cast<const CookedInstance*>(file_.data() + header_->instanceOffset);
+
+  for (size_t i = 0; i < header_->instanceCount; i++) {
+    if (instances_[i].meshIndex >= header_->meshCount) {
+      LOG_F("Instance {} in '{}' places mesh {}, but there are only {}",
+            i,
+            path_.generic_string(),
+            instances_[i].meshIndex,
+            header_->meshCount);
+    }
+  }
+
+  for (size_t i = 0; i < header_->meshCount; i++) {
+    const CookedMeshEntry& entry = toc_[i];
+
+    if (entry.vertexFormat != CookedVertexFormat::Vertex || entry.vertexStride != sizeof(Vertex) ||
+        entry.vertexSize != uint64_t(entry.vertexCount) * entry.vertexStride ||
+        entry.vertexOffset % alignof(Vertex) != 0 || getIndexTypeSize(entry.indexType) == 0 ||
+        entry.indexSize != uint64_t(entry.indexCount) * getIndexTypeSize(entry.indexType)) {
+      LOG_F("Mesh {} in '{}' uses an unsupported layout", i, path_.generic_string());
+    }
+
+    if (entry.vertexOffset > file_.size() || entry.vertexSize > file_.size() - entry.vertexOffset ||
+        entry.indexOffset > file_.size() || entry.indexSize > file_.size() - entry.indexOffset) {
+      LOG_F("Mesh {} in '{}' points outside the file", i, path_.generic_string());
+    }
+  }
+}
+
+std::vector<MeshInstance> CookedMeshFile::getInstances() const {
+  std::vector<MeshInstance> instances(header_->instanceCount);
+  for (size_t i = 0; i < instances.size(); i++) {
+    instances[i].meshIndex = instances_[i].meshIndex;
+    std::memcpy(&instances[i].transform[0][0],
+                instances_[i].transform,
+                sizeof(instances_[i].transform));
+  }
+
+  return instances;
+}
+
+const Vertex* CookedMeshFile::getVertices(size_t mesh) const {
+  return reinterpret_cast<const Vertex*>(file_.data() + toc_[mesh].vertexOffset);
+}
+
+const uint8_t* CookedMeshFile::getIndexData(size_t mesh) const {
+  return reinterpret_cast<const uint8_t*>(file_.data() + toc_[mesh].indexOffset);
+}
+
+std::vector<uint32_t> CookedMeshFile::decodeIndices(size_t mesh) const {
+  const CookedMeshEntry& entry = toc_[mesh];
+  const uint8_t* data = getIndexData(mesh);
+  std::vector<uint32_t> indices(entry.indexCount);
+
+  for (size_t i = 0; i < entry.indexCount; i++) {
+    switch (entry.indexType) {
+      case VK_INDEX_TYPE_UINT8_EXT:
+        indices[i] = data[i];
+        break;
+
+      case VK_INDEX_TYPE_UINT16: {
+        uint16_t index;
+        std::memcpy(&index, data + i * sizeof(index), sizeof(index));
+        indices[i] = index;
+        break;
+      }
+
+      default:
+        std::memcpy(&indices[i], data + i * sizeof(uint32_t), sizeof(uint32_t));
+        break;
+    }
+  }
+
+  return indices;
+}
+
+void CookedMeshFile::recordUpload(
+    size_t mesh,
+    const LogicalDevice& device,
+    CommandBuffer& commandBuffer,
+    GpuMesh& gpuMesh,
+    std::vector<std::unique_ptr<TransferBuffer<Vertex>>>& vertexStaging,
+    std::vector<std::unique_ptr<TransferBuffer<uint8_t>>>& indexStaging) const {
+  const CookedMeshEntry& entry = toc_[mesh];
+
+  // The only CPU-side copy: straight out of the mapping into the staging buffers
+  vertexStaging.push_back(
+      std::make_unique<TransferBuffer<Vertex>>(device, getVertices(mesh), entry.vertexCount));
+
+  if (entry.indexType == VK_INDEX_TYPE_UINT8_EXT &&
+      !device.getEnabledFeatures().indexTypeUint8.indexTypeUint8) {
+    // No VK_EXT_index_type_uint8 on this device: widen to 16 bits on the way through
+    const uint8_t* narrow = getIndexData(mesh);
+    std::vector<uint8_t> widened(entry.indexCount * sizeof(uint16_t));
+
+    for (size_t i = 0; i < entry.indexCount; i++) {
+      uint16_t index = narrow[i];
+      std::memcpy(widened.data() + i * sizeof(uint16_t), &index, sizeof(index));
+    }
+
+    indexStaging.push_back(std::make_unique<TransferBuffer<uint8_t>>(device, widened));
+    gpuMesh.indexBuffer =
+        std::make_unique<IndexBuffer>(device, VK_INDEX_TYPE_UINT16, entry.indexCount);
+  } else {
+    indexStaging.push_back(
+        std::make_unique<TransferBuffer<uint8_t>>(device, getIndexData(mesh), entry.indexSize));
+    gpuMesh.indexBuffer = std::make_unique<IndexBuffer>(device, entry.indexType, entry.indexCount);
+  }
+
+  gpuMesh.vertexBuffer = std::make_unique<OnDeviceBuffer<Vertex>>(device, entry.vertexCount);
+
+  commandBuffer.copyBuffer(*vertexStaging.back(), *gpuMesh.vertexBuffer);
+  commandBuffer.copyBuffer(*indexStaging.back(), *gpuMesh.indexBuffer);
+}
+
+GpuMesh CookedMeshFile::upload(size_t mesh,
+                               const LogicalDevice& device,
+                               const CommandPool& transferPool) const {
+  if (mesh >= getMeshCount()) {
+    LOG_F("Mesh index {} is out of range, '{}' has {} meshes",
+          mesh,
+          path_.generic_string(),
+          getMeshCount());
+  }
+
+  std::vector<std::unique_ptr<TransferBuffer<Vertex>>> vertexStaging;
+  std::vector<std::unique_ptr<TransferBuffer<uint8_t>>> indexStaging;
+  GpuMesh gpuMesh;
+
+  CommandBuffer commandBuffer = transferPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  recordUpload(mesh, device, commandBuffer, gpuMesh, vertexStaging, indexStaging);
+  commandBuffer.end();
+  commandBuffer.submitAndWait();
+
+  return gpuMesh;
+}
+
+std::vector<GpuMesh> CookedMeshFile::uploadAll(const LogicalDevice& device,
+                                               const CommandPool& transferPool) const {
+  std::vector<std::unique_ptr<TransferBuffer<Vertex>>> vertexStaging;
+  std::vector<std::unique_ptr<TransferBuffer<uint8_t>>> indexStaging;
+  std::vector<GpuMesh> gpuMeshes(getMeshCount());
+
+  CommandBuffer commandBuffer = transferPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  for (size_t i = 0; i < getMeshCount(); i++) {
+    recordUpload(i, device, commandBuffer, gpuMeshes[i], vertexStaging, indexStaging);
+  }
+  commandBuffer.end();
+  commandBuffer.submitAndWait();
+
+  return gpuMeshes;
+}
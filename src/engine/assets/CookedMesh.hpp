@@ -0,0 +1,155 @@
+#pragma once
+
+#include <engine/assets/GltfLoader.hpp>
+#include <engine/assets/MeshData.hpp>
+#include <engine/core/CommandPool.hpp>
+#include <engine/utils/MappedFile.hpp>
+#include <filesystem>
+#include <vector>
+
+/**
+ * Cooked mesh files (.vkmesh) hold mesh data already laid out in the exact format the GPU buffers
+ * expect, so loading one is a memory map followed by one staging copy per mesh.
+ *
+ * File layout (little-endian):
+ *
+ *   CookedFileHeader
+ *   CookedMeshEntry[meshCount]      <- table of contents, at header.tocOffset
+ *   CookedInstance[instanceCount]   <- where the meshes are placed, at header.instanceOffset
+ *   ...vertex / index blobs, each starting on a COOKED_DATA_ALIGNMENT boundary
+ *
+ * Blob offsets are absolute file offsets, so any single mesh can be located and uploaded without
+ * touching the rest of the file. The instances keep what the node hierarchy of the source scene
+ * did with the meshes, flattened into world transforms.
+ */
+
+constexpr char COOKED_MESH_MAGIC[4] = {'V', 'K', 'M', 'S'};
+
+// Bump whenever the layout of any structure below, or of the vertex formats, changes. Files of any
+// other version are rejected:
+//   1: 16-bit indices only
+//   2: 8, 16 or 32-bit indices, per mesh (CookedMeshEntry::indexType)
+//   3: mesh instances, with their world transforms
+constexpr uint32_t COOKED_MESH_VERSION = 3;
+
+// Every blob starts on this boundary, which covers optimalBufferCopyOffsetAlignment and
+// nonCoherentAtomSize on all current hardware, and keeps SIMD reads of the data aligned
+constexpr uint64_t COOKED_DATA_ALIGNMENT = 256;
+
+// Identifies the vertex structure stored in a blob
+enum class CookedVertexFormat : uint32_t {
+  Vertex = 0,  // engine/core/Vertex.hpp
+};
+
+struct CookedFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t meshCount;
+  uint32_t instanceCount;
+  uint64_t tocOffset;
+  uint64_t instanceOffset;
+  uint64_t fileSize;
+};
+
+struct CookedMeshEntry {
+  char name[64];  // Null terminated, truncated if needed
+
+  uint64_t vertexOffset;
+  uint64_t vertexSize;
+  uint32_t vertexCount;
+  uint32_t vertexStride;
+  CookedVertexFormat vertexFormat;
+
+  VkIndexType indexType;
+  uint64_t indexOffset;
+  uint64_t indexSize;
+  uint32_t indexCount;
+  uint32_t reserved;
+
+  // Object-space bounding box
+  float boundsMin[3];
+  float boundsMax[3];
+};
+
+// One placement of a mesh (MeshInstance)
+struct CookedInstance {
+  uint32_t meshIndex;  // Into the table of contents
+  uint32_t reserved;
+  float transform[16];  // World transform, column-major
+};
+
+static_assert(sizeof(CookedFileHeader) == 40, "CookedFileHeader layout changed");
+static_assert(sizeof(CookedMeshEntry) == 144, "CookedMeshEntry layout changed");
+static_assert(sizeof(CookedInstance) == 72, "CookedInstance layout changed");
+
+/**
+ * @brief Write the meshes of `scene` and their instances into a cooked mesh file. Meshes that
+ * cannot be represented are skipped with a warning, along with their instances. Calls LOG_F if the
+ * file can't be written.
+ *
+ * Each mesh's indices are stored in the narrowest type that fits its vertex count. 8-bit indices
+ * are only used with `allowUint8Indices`; readers widen them on devices without
+ * VK_EXT_index_type_uint8.
+ *
+ * @return the number of meshes written
+ */
+size_t writeCookedMeshFile(const std::filesystem::path& file,
+                           const GltfScene& scene,
+                           bool allowUint8Indices = false);
+
+/**
+ * @brief Read-only view of a cooked mesh file, backed by a memory mapping.
+ */
+class CookedMeshFile {
+ public:
+  CookedMeshFile() = delete;
+  CookedMeshFile(CookedMeshFile& other) = delete;
+
+  // Maps and validates the file. Calls LOG_F if it is missing or malformed.
+  explicit CookedMeshFile(const std::filesystem::path& file);
+
+  size_t getMeshCount() const { return header_->meshCount; }
+
+  const CookedMeshEntry& getEntry(size_t mesh) const { return toc_[mesh]; }
+
+  size_t getInstanceCount() const { return header_->instanceCount; }
+
+  // Every placement of the meshes, with mesh indices into the file's table of contents
+  std::vector<MeshInstance> getInstances() const;
+
+  // Vertex data, readable in place from the mapping
+  const Vertex* getVertices(size_t mesh) const;
+
+  // Raw index data in the entry's indexType, readable in place from the mapping
+  const uint8_t* getIndexData(size_t mesh) const;
+
+  // The mesh's indices widened to 32 bits, e.g. for repacking into a shared index buffer
+  std::vector<uint32_t> decodeIndices(size_t mesh) const;
+
+  /**
+   * @brief Upload a single mesh: one staging copy out of the mapping, then a GPU copy into
+   * device-local memory. Blocks until the copy has finished.
+   */
+  GpuMesh upload(size_t mesh, const LogicalDevice& device, const CommandPool& transferPool) const;
+
+  /**
+   * @brief Upload every mesh in the file, recording all copies into a single submission.
+   */
+  std::vector<GpuMesh> uploadAll(const LogicalDevice& device,
+                                 const CommandPool& transferPool) const;
+
+ private:
+  void recordUpload(size_t mesh,
+                    const LogicalDevice& device,
+                    CommandBuffer& commandBuffer,
+                    GpuMesh& gpuMesh,
+                    std::vector<std::unique_ptr<TransferBuffer<Vertex>>>& vertexStaging,
+                    std::vector<std::unique_ptr<TransferBuffer<uint8_t>>>& indexStaging) const;
+
+ private:
+  std::filesystem::path path_;
+  MappedFile file_;
+  const CookedFileHeader* header_;
+  const CookedMeshEntry* toc_;
+  const CookedInstance* instances_;
+};
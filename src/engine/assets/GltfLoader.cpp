@@ -0,0 +1,540 @@
+#include "GltfLoader.hpp"
+
+#include <tiny_gltf.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <engine/core/CommandPool.hpp>
+#include <engine/utils/memory.hpp>
+#include <fmtlog/Log.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+
+using namespace std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Meshes only need geometry: skip decoding images entirely, which saves both time and memory on
+// texture-heavy scenes
+static bool skipImageLoad(tinygltf::Image*,
+                          const int,
+                          std::string*,
+                          std::string*,
+                          int,
+                          int,
+                          const unsigned char*,
+                          int,
+                          void*) {
+  return true;
+}
+
+static float readComponent(const uint8_t* data, int componentType, bool normalized) {
+  switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      float value;
+      std::memcpy(&value, data, sizeof(value));
+      return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+      uint8_t value = *data;
+      return normalized ? value / 255.0f : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+      int8_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return normalized ? std::max(value / 127.0f, -1.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return normalized ? value / 65535.0f : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      int16_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+      uint32_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return static_cast<float>(value);
+    }
+  }
+
+  LOG_F("Unsupported accessor component type {}", componentType);
+}
+
+// Accessor `index` of `model`, after checking it exists
+static const tinygltf::Accessor& getAccessor(const tinygltf::Model& model, int index) {
+  if (index < 0 || static_cast<size_t>(index) >= model.accessors.size()) {
+    LOG_F("Accessor {} doesn't exist: there are only {}", index, model.accessors.size());
+  }
+
+  return model.accessors[index];
+}
+
+// Returns a pointer to the first element of an accessor, after checking that every element lies
+// within the underlying buffer
+static const uint8_t* getAccessorData(const tinygltf::Model& model,
+                                      const tinygltf::Accessor& accessor,
+                                      size_t& stride) {
+  if (accessor.bufferView < 0 ||
+      static_cast<size_t>(accessor.bufferView) >= model.bufferViews.size()) {
+    LOG_F("Accessor '{}' uses buffer view {}, but there are only {}",
+          accessor.name,
+          accessor.bufferView,
+          model.bufferViews.size());
+  }
+  const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+
+  if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= model.buffers.size()) {
+    LOG_F("Buffer view {} of accessor '{}' uses buffer {}, but there are only {}",
+          accessor.bufferView,
+          accessor.name,
+          view.buffer,
+          model.buffers.size());
+  }
+  const tinygltf::Buffer& buffer = model.buffers[view.buffer];
+
+  int byteStride = accessor.ByteStride(view);
+  if (byteStride <= 0) {
+    LOG_F("Accessor '{}' has an invalid byte stride", accessor.name);
+  }
+  stride = static_cast<size_t>(byteStride);
+
+  size_t elementSize = tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+                       tinygltf::GetNumComponentsInType(accessor.type);
+  size_t start = view.byteOffset + accessor.byteOffset;
+  size_t end = start + stride * (accessor.count - 1) + elementSize;
+
+  if (accessor.count > 0 && end > buffer.data.size()) {
+    LOG_F("Accessor '{}' reads past the end of its buffer", accessor.name);
+  }
+
+  return buffer.data.data() + start;
+}
+
+template <int N>
+static std::vector<glm::vec<N, float>> readFloatAccessor(const tinygltf::Model& model,
+                                                         int accessorIndex,
+                                                         glm::vec<N, float> defaultValue) {
+  using VecType = glm::vec<N, float>;
+
+  const tinygltf::Accessor& accessor = getAccessor(model, accessorIndex);
+  std::vector<VecType> values(accessor.count, defaultValue);
+
+  if (accessor.sparse.isSparse) {
+    LOG_W("Sparse accessor '{}' is not supported, ignoring sparse values", accessor.name);
+  }
+
+  // An accessor without a buffer view is all zeros (normally paired with sparse data)
+  if (accessor.bufferView < 0 || accessor.count == 0) {
+    return values;
+  }
+
+  size_t stride;
+  const uint8_t* data = getAccessorData(model, accessor, stride);
+
+  int components = std::min(N, tinygltf::GetNumComponentsInType(accessor.type));
+  size_t componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+
+  // Tightly packed floats with matching width: a straight copy
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && components == N &&
+      stride == sizeof(VecType)) {
+    std::memcpy(values.data(), data, accessor.count * sizeof(VecType));
+    return values;
+  }
+
+  for (size_t i = 0; i < accessor.count; i++) {
+    const uint8_t* element = data + i * stride;
+    for (int c = 0; c < components; c++) {
+      values[i][c] =
+          readComponent(element + c * componentSize, accessor.componentType, accessor.normalized);
+    }
+  }
+
+  return values;
+}
+
+static std::vector<uint32_t> readIndices(const tinygltf::Model& model, int accessorIndex) {
+  const tinygltf::Accessor& accessor = getAccessor(model, accessorIndex);
+  std::vector<uint32_t> indices(accessor.count);
+
+  if (accessor.bufferView < 0 || accessor.count == 0) {
+    return indices;
+  }
+
+  size_t stride;
+  const uint8_t* data = getAccessorData(model, accessor, stride);
+
+  for (size_t i = 0; i < accessor.count; i++) {
+    const uint8_t* element = data + i * stride;
+    switch (accessor.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        indices[i] = *element;
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        uint16_t value;
+        std::memcpy(&value, element, sizeof(value));
+        indices[i] = value;
+        break;
+      }
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        std::memcpy(&indices[i], element, sizeof(uint32_t));
+        break;
+      default:
+        LOG_F("Unsupported index component type {}", accessor.componentType);
+    }
+  }
+
+  return indices;
+}
+
+// An optional vertex stream must have one element per position, if present at all
+static void checkStreamSize(const std::string& primitive,
+                            const char* attribute,
+                            size_t size,
+                            size_t positionCount) {
+  if (size != 0 && size != positionCount) {
+    LOG_F("Primitive '{}' has {} {} values but {} positions",
+          primitive,
+          size,
+          attribute,
+          positionCount);
+  }
+}
+
+static MeshData decodePrimitive(const tinygltf::Model& model,
+                                const tinygltf::Mesh& mesh,
+                                size_t primitiveIndex) {
+  const tinygltf::Primitive& primitive = mesh.primitives[primitiveIndex];
+
+  MeshData data;
+  data.name = fmt::format("{}[{}]", mesh.name, primitiveIndex);
+
+  // Older tinygltf versions report a missing mode as -1, which means triangles per the spec
+  if (primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != -1) {
+    LOG_W("Primitive '{}' uses mode {}, only triangle lists are supported",
+          data.name,
+          primitive.mode);
+    return data;
+  }
+
+  auto position = primitive.attributes.find("POSITION");
+  if (position == primitive.attributes.end()) {
+    LOG_W("Primitive '{}' has no POSITION attribute, skipping", data.name);
+    return data;
+  }
+
+  data.positions = readFloatAccessor<3>(model, position->second, glm::vec3(0.0f));
+
+  auto normal = primitive.attributes.find("NORMAL");
+  if (normal != primitive.attributes.end()) {
+    data.normals = readFloatAccessor<3>(model, normal->second, glm::vec3(0.0f));
+  }
+
+  auto texcoord = primitive.attributes.find("TEXCOORD_0");
+  if (texcoord != primitive.attributes.end()) {
+    data.texcoords = readFloatAccessor<2>(model, texcoord->second, glm::vec2(0.0f));
+  }
+
+  // COLOR_0 may be RGB or RGBA: RGB colors keep the default alpha of 1
+  auto color = primitive.attributes.find("COLOR_0");
+  if (color != primitive.attributes.end()) {
+    data.colors = readFloatAccessor<4>(model, color->second, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  }
+
+  // Every stream is indexed by the same vertex indices as the positions
+  checkStreamSize(data.name, "NORMAL", data.normals.size(), data.positions.size());
+  checkStreamSize(data.name, "TEXCOORD_0", data.texcoords.size(), data.positions.size());
+  checkStreamSize(data.name, "COLOR_0", data.colors.size(), data.positions.size());
+
+  if (primitive.indices >= 0) {
+    data.indices = readIndices(model, primitive.indices);
+  } else {
+    // Non-indexed geometry: every three consecutive vertices form a triangle
+    data.indices.resize(data.positions.size());
+    for (size_t i = 0; i < data.indices.size(); i++) {
+      data.indices[i] = static_cast<uint32_t>(i);
+    }
+  }
+
+  for (uint32_t index : data.indices) {
+    if (index >= data.positions.size()) {
+      LOG_F("Primitive '{}' references vertex {} but only has {}",
+            data.name,
+            index,
+            data.positions.size());
+    }
+  }
+
+  return data;
+}
+
+static glm::mat4 getLocalTransform(const tinygltf::Node& node) {
+  if (node.matrix.size() == 16) {
+    glm::mat4 matrix;
+    for (int i = 0; i < 16; i++) {
+      glm::value_ptr(matrix)[i] = static_cast<float>(node.matrix[i]);
+    }
+    return matrix;
+  }
+
+  glm::mat4 transform(1.0f);
+
+  if (node.translation.size() == 3) {
+    transform = glm::translate(transform,
+                               glm::vec3(node.translation[0],
+                                         node.translation[1],
+                                         node.translation[2]));
+  }
+
+  if (node.rotation.size() == 4) {
+    // glTF stores quaternions as (x, y, z, w), glm::quat takes (w, x, y, z)
+    glm::quat rotation(static_cast<float>(node.rotation[3]),
+                       static_cast<float>(node.rotation[0]),
+                       static_cast<float>(node.rotation[1]),
+                       static_cast<float>(node.rotation[2]));
+    transform = transform * glm::mat4_cast(rotation);
+  }
+
+  if (node.scale.size() == 3) {
+    transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+  }
+
+  return transform;
+}
+
+// meshRanges[i] is the [first, first + count) range of MeshData entries created for glTF mesh i
+static void collectInstances(const tinygltf::Model& model,
+                             int nodeIndex,
+                             const glm::mat4& parentTransform,
+                             const std::vector<std::pair<uint32_t, uint32_t>>& meshRanges,
+                             std::vector<MeshInstance>& instances) {
+  const tinygltf::Node& node = model.nodes[nodeIndex];
+  glm::mat4 transform = parentTransform * getLocalTransform(node);
+
+  if (node.mesh >= 0) {
+    const auto& range = meshRanges[node.mesh];
+    for (uint32_t i = 0; i < range.second; i++) {
+      instances.push_back({range.first + i, transform});
+    }
+  }
+
+  for (int child : node.children) {
+    collectInstances(model, child, transform, meshRanges, instances);
+  }
+}
+
+void GltfLoadStats::log() const {
+  LOG_I("glTF load finished in {:.2f} ms", totalMs);
+  LOG_I("\tParse:\t{:.2f} ms", parseMs);
+  LOG_I("\tDecode:\t{:.2f} ms", decodeMs);
+  LOG_I("\tUpload:\t{:.2f} ms", uploadMs);
+  LOG_I("\tMeshes:\t{}", meshCount);
+  LOG_I("\tVertices:\t{}", vertexCount);
+  LOG_I("\tIndices:\t{}", indexCount);
+  LOG_I("\tDecoded size:\t{:.2f} MiB", decodedBytes / (1024.0 * 1024.0));
+  LOG_I("\tPeak resident memory:\t{:.2f} MiB", peakResidentBytes / (1024.0 * 1024.0));
+}
+
+GltfLoader::GltfLoader(ThreadPool& threadPool) : threadPool_(threadPool) {}
+
+GltfScene GltfLoader::load(const path& file, GltfLoadStats* stats) {
+  Clock::time_point start = Clock::now();
+
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(skipImageLoad, nullptr);
+
+  tinygltf::Model model;
+  std::string error;
+  std::string warning;
+  bool loaded = false;
+
+  if (file.extension() == ".glb") {
+    loaded = loader.LoadBinaryFromFile(&model, &error, &warning, file.generic_string());
+  } else {
+    loaded = loader.LoadASCIIFromFile(&model, &error, &warning, file.generic_string());
+  }
+
+  if (!warning.empty()) {
+    LOG_W("glTF warning while loading '{}': {}", file.generic_string(), warning);
+  }
+
+  if (!loaded) {
+    LOG_F("Failed to load glTF file '{}': {}", file.generic_string(), error);
+  }
+
+  double parseMs = millisecondsSince(start);
+  Clock::time_point decodeStart = Clock::now();
+
+  // Flatten every primitive of every mesh into a single job list, so the decode work is spread
+  // evenly even when a scene has a few huge meshes and many small ones
+  std::vector<std::pair<uint32_t, uint32_t>> meshRanges;
+  std::vector<std::pair<size_t, size_t>> jobs;  // (mesh, primitive)
+
+  for (size_t m = 0; m < model.meshes.size(); m++) {
+    meshRanges.push_back({static_cast<uint32_t>(jobs.size()),
+                          static_cast<uint32_t>(model.meshes[m].primitives.size())});
+    for (size_t p = 0; p < model.meshes[m].primitives.size(); p++) {
+      jobs.push_back({m, p});
+    }
+  }
+
+  GltfScene scene;
+  scene.meshes.resize(jobs.size());
+
+  threadPool_.parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      scene.meshes[i] = decodePrimitive(model, model.meshes[jobs[i].first], jobs[i].second);
+    }
+  });
+
+  if (!model.scenes.empty()) {
+    int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+    for (int node : model.scenes[sceneIndex].nodes) {
+      collectInstances(model, node, glm::mat4(1.0f), meshRanges, scene.instances);
+    }
+  } else {
+    // No scene description: place every mesh once at the origin
+    for (uint32_t i = 0; i < scene.meshes.size(); i++) {
+      scene.instances.push_back({i, glm::mat4(1.0f)});
+    }
+  }
+
+  if (stats) {
+    stats->parseMs = parseMs;
+    stats->decodeMs = millisecondsSince(decodeStart);
+    stats->meshCount = scene.meshes.size();
+    stats->vertexCount = 0;
+    stats->indexCount = 0;
+    stats->decodedBytes = 0;
+
+    for (const auto& mesh : scene.meshes) {
+      stats->vertexCount += mesh.getVertexCount();
+      stats->indexCount += mesh.getIndexCount();
+      stats->decodedBytes += mesh.getSizeInBytes();
+    }
+
+    stats->totalMs = millisecondsSince(start);
+    stats->peakResidentBytes = getPeakResidentMemory();
+  }
+
+  return scene;
+}
+
+void splitSceneMeshes(GltfScene& scene, size_t maxVertices) {
+  std::vector<MeshData> meshes;
+  std::vector<MeshInstance> instances;
+
+  // Where each original mesh's pieces ended up
+  std::vector<std::pair<uint32_t, uint32_t>> pieceRanges;
+
+  for (auto& mesh : scene.meshes) {
+    uint32_t first = static_cast<uint32_t>(meshes.size());
+
+    if (mesh.getVertexCount() <= maxVertices) {
+      meshes.push_back(std::move(mesh));
+    } else {
+      std::vector<MeshData> pieces = splitMesh(mesh, maxVertices);
+      LOG_I("Split mesh '{}' ({} vertices) into {} pieces",
+            mesh.name,
+            mesh.getVertexCount(),
+            pieces.size());
+
+      for (auto& piece : pieces) {
+        meshes.push_back(std::move(piece));
+      }
+    }
+
+    pieceRanges.emplace_back(first, static_cast<uint32_t>(meshes.size()));
+  }
+
+  for (const auto& instance : scene.instances) {
+    for (uint32_t piece = pieceRanges[instance.meshIndex].first;
+         piece < pieceRanges[instance.meshIndex].second;
+         piece++) {
+      instances.push_back({piece, instance.transform});
+    }
+  }
+
+  scene.meshes = std::move(meshes);
+  scene.instances = std::move(instances);
+}
+
+std::vector<GpuMesh> GltfLoader::upload(const std::vector<MeshData>& meshes,
+                                        const LogicalDevice& device,
+                                        const QueueFamilyRequest& transferQueue,
+                                        GltfLoadStats* stats) {
+  Clock::time_point start = Clock::now();
+
+  std::vector<GpuMesh> gpuMeshes(meshes.size());
+
+  bool allowUint8 = device.getEnabledFeatures().indexTypeUint8.indexTypeUint8;
+  size_t maxIndexValue =
+      device.getPhysicalDevice().getProperties().limits.maxDrawIndexedIndexValue;
+
+  // One chunk per thread: each chunk is recorded into a single command buffer and submitted once
+  size_t threads = threadPool_.getThreadCount() + 1;
+  size_t chunkSize = (meshes.size() + threads - 1) / threads;
+
+  threadPool_.parallelFor(meshes.size(), chunkSize, [&](size_t begin, size_t end) {
+    // Command pools must only be used from one thread at a time, so each chunk gets its own
+    CommandPool commandPool(device, transferQueue);
+
+    // Staging buffers have to outlive the submission
+    std::vector<std::unique_ptr<TransferBuffer<Vertex>>> vertexStaging;
+    std::vector<std::unique_ptr<TransferBuffer<uint8_t>>> indexStaging;
+
+    CommandBuffer commandBuffer = commandPool.allocateCommandBuffer();
+    commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    for (size_t i = begin; i < end; i++) {
+      const MeshData& mesh = meshes[i];
+
+      if (mesh.getVertexCount() == 0 || mesh.getIndexCount() == 0) {
+        LOG_W("Mesh '{}' is empty, skipping upload", mesh.name);
+        continue;
+      }
+
+      if (mesh.getVertexCount() - 1 > maxIndexValue) {
+        LOG_W("Mesh '{}' has {} vertices, more than the device can index, skipping upload",
+              mesh.name,
+              mesh.getVertexCount());
+        continue;
+      }
+
+      std::vector<Vertex> vertices = mesh.toVertices();
+      VkIndexType indexType = selectIndexType(mesh.getVertexCount(), allowUint8);
+      std::vector<uint8_t> indices = mesh.encodeIndices(indexType);
+
+      vertexStaging.push_back(std::make_unique<TransferBuffer<Vertex>>(device, vertices));
+      indexStaging.push_back(std::make_unique<TransferBuffer<uint8_t>>(device, indices));
+
+      gpuMeshes[i].vertexBuffer = std::make_unique<OnDeviceBuffer<Vertex>>(device, vertices);
+      gpuMeshes[i].indexBuffer =
+          std::make_unique<IndexBuffer>(device, indexType, mesh.getIndexCount());
+
+      commandBuffer.copyBuffer(*vertexStaging.back(), *gpuMeshes[i].vertexBuffer);
+      commandBuffer.copyBuffer(*indexStaging.back(), *gpuMeshes[i].indexBuffer);
+    }
+
+    commandBuffer.end();
+    commandBuffer.submitAndWait(&queueMutex_);
+  });
+
+  if (stats) {
+    stats->uploadMs = millisecondsSince(start);
+    stats->totalMs += stats->uploadMs;
+    stats->peakResidentBytes = getPeakResidentMemory();
+  }
+
+  return gpuMeshes;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <engine/assets/MeshData.hpp>
+#include <engine/core/Device.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief One placement of a mesh in the scene: which mesh, and the world transform accumulated
+ * from the glTF node hierarchy.
+ */
+struct MeshInstance {
+  uint32_t meshIndex;
+  glm::mat4 transform;
+};
+
+/**
+ * @brief Everything a glTF scene contributes, in CPU memory.
+ *
+ * Each glTF primitive becomes its own MeshData, since primitives are the unit that gets drawn.
+ * Instances reference meshes by index into `meshes`.
+ */
+struct GltfScene {
+  std::vector<MeshData> meshes;
+  std::vector<MeshInstance> instances;
+};
+
+/**
+ * @brief Split every mesh of the scene that references more than `maxVertices` vertices (see
+ * splitMesh()), and duplicate the instances of split meshes so every piece is placed.
+ */
+void splitSceneMeshes(GltfScene& scene, size_t maxVertices);
+
+/**
+ * @brief Timing and memory figures collected while loading a scene. Times are in milliseconds.
+ */
+struct GltfLoadStats {
+  double parseMs = 0.0;   // Reading the file and parsing the JSON / GLB container
+  double decodeMs = 0.0;  // Converting accessors into MeshData streams
+  double uploadMs = 0.0;  // Staging and copying meshes into device-local buffers
+  double totalMs = 0.0;
+
+  size_t meshCount = 0;
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+  size_t decodedBytes = 0;        // CPU memory held by the decoded MeshData
+  size_t peakResidentBytes = 0;   // Process peak resident memory once loading finished
+
+  void log() const;
+};
+
+/**
+ * @brief Loads .gltf and .glb files through tinygltf.
+ *
+ * Parsing happens on the calling thread (the JSON parse is inherently serial), while accessor
+ * decoding and GPU uploads are spread across a ThreadPool.
+ */
+class GltfLoader {
+ public:
+  GltfLoader() = delete;
+  GltfLoader(GltfLoader& other) = delete;
+
+  GltfLoader(ThreadPool& threadPool);
+
+  /**
+   * @brief Parse a .gltf or .glb file and decode all of its meshes into CPU memory.
+   * Calls LOG_F on failure.
+   */
+  GltfScene load(const std::filesystem::path& file, GltfLoadStats* stats = nullptr);
+
+  /**
+   * @brief Upload meshes into device-local buffers through staging buffers on the given transfer
+   * queue. Each worker thread records its share of the meshes into its own command pool, and
+   * submissions to the queue are serialized internally.
+   *
+   * Each mesh gets the narrowest index type the device can use. Meshes with more vertices than
+   * the device can index are skipped; split them with splitSceneMeshes() first.
+   *
+   * The transfer queue must not be used by other threads while this runs.
+   */
+  std::vector<GpuMesh> upload(const std::vector<MeshData>& meshes,
+                              const LogicalDevice& device,
+                              const QueueFamilyRequest& transferQueue,
+                              GltfLoadStats* stats = nullptr);
+
+ private:
+  ThreadPool& threadPool_;
+  std::mutex queueMutex_;
+};
@@ -0,0 +1,348 @@
+#include "Ktx2Texture.hpp"
+
+#include <cstring>
+#include <engine/core/Buffer.hpp>
+#include <engine/core/MipGenerator.hpp>
+#include <engine/utils/Inflate.hpp>
+#include <fmtlog/Log.hpp>
+
+using namespace std::filesystem;
+
+namespace {
+
+// Levels are placed in the staging buffer on this boundary, a multiple of every supported texel
+// block size, as vkCmdCopyBufferToImage requires
+constexpr VkDeviceSize STAGING_LEVEL_ALIGNMENT = 16;
+
+const char* getSupercompressionName(Ktx2Supercompression scheme) {
+  switch (scheme) {
+    case Ktx2Supercompression::None:
+      return "none";
+    case Ktx2Supercompression::BasisLZ:
+      return "BasisLZ";
+    case Ktx2Supercompression::Zstandard:
+      return "Zstandard";
+    case Ktx2Supercompression::Zlib:
+      return "zlib";
+  }
+
+  return "an unknown scheme";
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+TextureCompression getTextureCompression(VkFormat format) {
+  if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) {
+    return TextureCompression::BC;
+  }
+
+  if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) {
+    return TextureCompression::ETC2;
+  }
+
+  if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+    return TextureCompression::ASTC;
+  }
+
+  return TextureCompression::None;
+}
+
+Ktx2TextureFile::Ktx2TextureFile(const path& file) : path_(file), file_(file) {
+  if (!file_.isOpen()) {
+    LOG_F("Failed to map KTX2 file '{}'", path_.generic_string());
+  }
+
+  if (file_.size() < sizeof(Ktx2Header)) {
+    LOG_F("'{}' is too small to be a KTX2 file", path_.generic_string());
+  }
+
+  header_ = reinterpret_cast<const Ktx2Header*>(file_.data());
+
+  if (std::memcmp(header_->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+    LOG_F("'{}' is not a KTX2 file", path_.generic_string());
+  }
+
+  if (header_->vkFormat == VK_FORMAT_UNDEFINED) {
+    LOG_F("'{}' is Basis Universal encoded, which needs a transcoder: re-encode it to a block "
+          "format",
+          path_.generic_string());
+  }
+
+  if (getFormatBlock(header_->vkFormat).bytes == 0) {
+    LOG_F("'{}' uses format {}, which isn't supported",
+          path_.generic_string(),
+          static_cast<int>(header_->vkFormat));
+  }
+
+  if (header_->pixelWidth == 0 || header_->pixelHeight == 0 || header_->pixelDepth != 0 ||
+      header_->faceCount != 1) {
+    LOG_F("'{}' isn't a 2D texture or 2D array: 1D, 3D and cube map textures aren't supported",
+          path_.generic_string());
+  }
+
+  if (header_->supercompressionScheme != Ktx2Supercompression::None &&
+      header_->supercompressionScheme != Ktx2Supercompression::Zlib) {
+    LOG_F("'{}' is supercompressed with {}, which can't be decoded: re-encode it with zlib or "
+          "without supercompression",
+          path_.generic_string(),
+          getSupercompressionName(header_->supercompressionScheme));
+  }
+
+  if (getLevelCount() > Image::getFullMipLevels(getExtent())) {
+    LOG_F("'{}' has {} mip levels, more than a {}x{} texture can have",
+          path_.generic_string(),
+          getLevelCount(),
+          header_->pixelWidth,
+          header_->pixelHeight);
+  }
+
+  if (sizeof(Ktx2Header) + getLevelCount() * sizeof(Ktx2LevelIndex) > file_.size()) {
+    LOG_F("'{}' is truncated", path_.generic_string());
+  }
+
+  levels_ = reinterpret_cast<const Ktx2LevelIndex*>(file_.data() + sizeof(Ktx2Header));
+
+  for (uint32_t level = 0; level < getLevelCount(); level++) {
+    const Ktx2LevelIndex& index = levels_[level];
+
+    if (index.byteOffset > file_.size() || index.byteLength > file_.size() - index.byteOffset) {
+      LOG_F("Level {} of '{}' points outside the file", level, path_.generic_string());
+    }
+
+    // Every level is decoded straight into a staging buffer sized from the format, so the sizes
+    // the file gives must match it exactly
+    uint64_t expected = getLevelSize(level);
+    if (index.uncompressedByteLength != expected ||
+        (getSupercompression() == Ktx2Supercompression::None && index.byteLength != expected)) {
+      LOG_F("Level {} of '{}' holds {} bytes, expected {}",
+            level,
+            path_.generic_string(),
+            index.uncompressedByteLength,
+            expected);
+    }
+  }
+}
+
+std::unique_ptr<Ktx2TextureFile> Ktx2TextureFile::openSupported(const LogicalDevice& device,
+                                                                const std::vector<path>& files) {
+  for (const auto& file : files) {
+    auto texture = std::make_unique<Ktx2TextureFile>(file);
+    if (isFormatSupported(device, texture->getFormat())) {
+      return texture;
+    }
+
+    LOG_I("Skipping '{}': this device can't sample format {}",
+          file.generic_string(),
+          static_cast<int>(texture->getFormat()));
+  }
+
+  LOG_F("None of the {} texture files given has a format this device can sample", files.size());
+  return nullptr;
+}
+
+void Ktx2TextureFile::requestFeatures(DeviceFeatures& features) {
+  features.core.features.textureCompressionBC = VK_TRUE;
+  features.core.features.textureCompressionETC2 = VK_TRUE;
+  features.core.features.textureCompressionASTC_LDR = VK_TRUE;
+}
+
+bool Ktx2TextureFile::isFormatSupported(const LogicalDevice& device, VkFormat format) {
+  // Formats of a compression family can only be used with its feature enabled, whatever the format
+  // properties say
+  const VkPhysicalDeviceFeatures& enabled = device.getEnabledFeatures().core.features;
+  switch (getTextureCompression(format)) {
+    case TextureCompression::BC:
+      if (!enabled.textureCompressionBC) {
+        return false;
+      }
+      break;
+    case TextureCompression::ETC2:
+      if (!enabled.textureCompressionETC2) {
+        return false;
+      }
+      break;
+    case TextureCompression::ASTC:
+      if (!enabled.textureCompressionASTC_LDR) {
+        return false;
+      }
+      break;
+    case TextureCompression::None:
+      break;
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &properties);
+  return properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+const uint8_t* Ktx2TextureFile::getLevelData(uint32_t level) const {
+  return file_.data() + levels_[level].byteOffset;
+}
+
+uint64_t Ktx2TextureFile::getLevelSize(uint32_t level) const {
+  FormatBlock block = getFormatBlock(getFormat());
+  uint64_t width = std::max(header_->pixelWidth >> level, 1u);
+  uint64_t height = std::max(header_->pixelHeight >> level, 1u);
+
+  // Partial blocks at the edges are stored whole
+  uint64_t blocksX = (width + block.width - 1) / block.width;
+  uint64_t blocksY = (height + block.height - 1) / block.height;
+  return blocksX * blocksY * block.bytes * getArrayLayers();
+}
+
+std::unique_ptr<Image> Ktx2TextureFile::upload(const LogicalDevice& device,
+                                               const CommandPool& commandPool,
+                                               VkImageLayout finalLayout,
+                                               MipGenerator* mipGenerator,
+                                               const QueueFamilyRequests sharingQueues) const {
+  return uploadFrom(
+      device, commandPool, 0, finalLayout, mipGenerator, sharingQueues, nullptr /* queueMutex */);
+}
+
+std::unique_ptr<Image> Ktx2TextureFile::uploadLevels(const LogicalDevice& device,
+                                                     const CommandPool& commandPool,
+                                                     uint32_t baseLevel,
+                                                     const QueueFamilyRequests sharingQueues,
+                                                     std::mutex* queueMutex) const {
+  return uploadFrom(device,
+                    commandPool,
+                    baseLevel,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    nullptr /* mipGenerator */,
+                    sharingQueues,
+                    queueMutex);
+}
+
+std::unique_ptr<Image> Ktx2TextureFile::uploadFrom(const LogicalDevice& device,
+                                                   const CommandPool& commandPool,
+                                                   uint32_t baseLevel,
+                                                   VkImageLayout finalLayout,
+                                                   MipGenerator* mipGenerator,
+                                                   const QueueFamilyRequests sharingQueues,
+                                                   std::mutex* queueMutex) const {
+  if (!isFormatSupported(device, getFormat())) {
+    LOG_F("'{}' uses format {}, which this device can't sample",
+          path_.generic_string(),
+          static_cast<int>(getFormat()));
+  }
+
+  if (baseLevel >= getLevelCount()) {
+    LOG_F("Uploading '{}' from level {}, but it has {} levels",
+          path_.generic_string(),
+          baseLevel,
+          getLevelCount());
+  }
+
+  uint32_t storedLevels = getLevelCount() - baseLevel;
+  VkExtent2D extent = {std::max(header_->pixelWidth >> baseLevel, 1u),
+                       std::max(header_->pixelHeight >> baseLevel, 1u)};
+  uint32_t mipLevels = needsMipGeneration() ? Image::getFullMipLevels(extent) : storedLevels;
+  bool generateMips = mipLevels > storedLevels;
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (generateMips) {
+    // Blits read the image; the compute downsampler writes it as a storage image
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), getFormat(), &properties);
+    if (mipGenerator && (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+      usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+  }
+
+  auto image = std::make_unique<Image>(device,
+                                       extent,
+                                       getFormat(),
+                                       usage,
+                                       mipLevels,
+                                       getArrayLayers(),
+                                       VK_SAMPLE_COUNT_1_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       sharingQueues);
+
+  bool blitMips = generateMips && MipGenerator::canBlit(device, *image);
+  if (generateMips && !blitMips && !(mipGenerator && mipGenerator->canDownsample(*image))) {
+    LOG_F("'{}' asks for generated mip levels, but format {} can't be blitted{}",
+          path_.generic_string(),
+          static_cast<int>(getFormat()),
+          mipGenerator ? " or downsampled" : " and no MipGenerator was given");
+  }
+
+  // Transfer-only queues can copy the stored levels but generate none of the others
+  const QueueFamily& family = commandPool.getQueue().family;
+  if (blitMips && !family.graphics) {
+    LOG_F("'{}' asks for generated mip levels, which are blitted: upload it with a pool on a "
+          "graphics queue, not queue family {}",
+          path_.generic_string(),
+          family.index);
+  }
+  if (generateMips && !blitMips && !family.compute) {
+    LOG_F("'{}' asks for generated mip levels, which are downsampled: upload it with a pool on a "
+          "compute queue, not queue family {}",
+          path_.generic_string(),
+          family.index);
+  }
+
+  // Every level back to back in one staging buffer, in the layout vkCmdCopyBufferToImage expects
+  std::vector<VkDeviceSize> offsets(storedLevels);
+  VkDeviceSize stagingSize = 0;
+  for (uint32_t i = 0; i < storedLevels; i++) {
+    offsets[i] = alignUp(stagingSize, STAGING_LEVEL_ALIGNMENT);
+    stagingSize = offsets[i] + getLevelSize(baseLevel + i);
+  }
+
+  // The only CPU-side pass over the texels: straight from the mapping into the staging memory
+  MappedBuffer<uint8_t> staging(device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  for (uint32_t i = 0; i < storedLevels; i++) {
+    uint32_t level = baseLevel + i;
+    uint8_t* destination = staging.getMapped() + offsets[i];
+    uint64_t size = getLevelSize(level);
+
+    if (getSupercompression() == Ktx2Supercompression::Zlib) {
+      if (!inflateZlib(getLevelData(level), levels_[level].byteLength, destination, size)) {
+        LOG_F("Level {} of '{}' is corrupt: it doesn't inflate to {} bytes",
+              level,
+              path_.generic_string(),
+              size);
+      }
+    } else {
+      std::memcpy(destination, getLevelData(level), size);
+    }
+  }
+
+  CommandBuffer commandBuffer = commandPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  commandBuffer.transitionImageLayout(*image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  for (uint32_t i = 0; i < storedLevels; i++) {
+    commandBuffer.copyBufferToImage(staging, *image, i, offsets[i]);
+  }
+
+  if (blitMips) {
+    MipGenerator::recordBlits(commandBuffer, *image);
+  } else if (generateMips) {
+    mipGenerator->record(commandBuffer, *image);
+  }
+
+  // As in Image::upload(), the pool's queue may be transfer-only: waiting for the submission is
+  // what orders the upload before the image's first use
+  commandBuffer.imageBarrier(*image,
+                             finalLayout,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_ACCESS_MEMORY_WRITE_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0);
+  commandBuffer.end();
+
+  commandBuffer.submitAndWait(queueMutex);
+
+  if (mipGenerator) {
+    mipGenerator->reset();
+  }
+
+  return image;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/Image.hpp>
+#include <engine/utils/MappedFile.hpp>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * KTX2 texture files (.ktx2, https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) hold
+ * the texels of every mip level already encoded in a Vulkan format, usually a block-compressed
+ * one, so loading one is a memory map followed by a copy of each level into a staging buffer.
+ *
+ * File layout (little-endian):
+ *
+ *   Ktx2Header
+ *   Ktx2LevelIndex[max(levelCount, 1)]   <- level 0 (the largest) first
+ *   ...data format descriptor, key/value data, supercompression global data
+ *   ...level data, smallest level first, each level holding every layer one after the other
+ *
+ * Supported: 2D textures and 2D arrays in the block-compressed BC1-7, ETC2/EAC and ASTC LDR
+ * formats and in the common uncompressed color formats, stored as is or supercompressed with
+ * zlib. 1D, 3D and cube map textures, Basis Universal (which needs a transcoder) and Zstandard or
+ * BasisLZ supercompression are rejected.
+ */
+
+constexpr uint8_t KTX2_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+enum class Ktx2Supercompression : uint32_t {
+  None = 0,
+  BasisLZ = 1,
+  Zstandard = 2,
+  Zlib = 3,
+};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  VkFormat vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;  // 0 for a texture that isn't an array
+  uint32_t faceCount;
+  uint32_t levelCount;  // 0 asks the loader to generate the mip chain
+  Ktx2Supercompression supercompressionScheme;
+
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header layout changed");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "Ktx2LevelIndex layout changed");
+
+// Block-compressed format families, each sampled only with its own device feature
+enum class TextureCompression {
+  None,
+  BC,    // textureCompressionBC, mostly desktop GPUs
+  ETC2,  // textureCompressionETC2, mostly mobile GPUs
+  ASTC,  // textureCompressionASTC_LDR, mostly mobile GPUs
+};
+
+TextureCompression getTextureCompression(VkFormat format);
+
+/**
+ * @brief Read-only view of a KTX2 texture file, backed by a memory mapping.
+ *
+ * Compressed textures are usually shipped in one file per format family, and the first one the
+ * device supports is loaded. The families' features must have been enabled (see requestFeatures()):
+ *
+ *   auto texture = Ktx2TextureFile::openSupported(device, {"albedo.bc7.ktx2",
+ *                                                          "albedo.astc.ktx2",
+ *                                                          "albedo.etc2.ktx2"});
+ *   std::unique_ptr<Image> image = texture->upload(device, graphicsCommandPool);
+ *
+ * A transfer-only pool is enough for uploadLevels(), and for upload() of files that store their
+ * whole mip chain.
+ */
+class Ktx2TextureFile {
+ public:
+  Ktx2TextureFile() = delete;
+  Ktx2TextureFile(Ktx2TextureFile& other) = delete;
+
+  // Maps and validates the file. Calls LOG_F if it is missing, malformed or unsupported.
+  explicit Ktx2TextureFile(const std::filesystem::path& file);
+
+  /**
+   * @brief Open the first of `files` whose format the device can sample, in order of preference.
+   * Calls LOG_F if there is none.
+   */
+  static std::unique_ptr<Ktx2TextureFile> openSupported(
+      const LogicalDevice& device,
+      const std::vector<std::filesystem::path>& files);
+
+  // Add the block compression features to `features`, for the device to enable what it supports
+  static void requestFeatures(DeviceFeatures& features);
+
+  // True if images of `format` can be sampled on `device`, with any feature the format needs
+  static bool isFormatSupported(const LogicalDevice& device, VkFormat format);
+
+  VkFormat getFormat() const { return header_->vkFormat; }
+
+  VkExtent2D getExtent() const { return {header_->pixelWidth, header_->pixelHeight}; }
+
+  uint32_t getArrayLayers() const { return std::max(header_->layerCount, 1u); }
+
+  // Mip levels stored in the file
+  uint32_t getLevelCount() const { return std::max(header_->levelCount, 1u); }
+
+  // True if the file asks for its mip chain to be generated from level 0
+  bool needsMipGeneration() const { return header_->levelCount == 0; }
+
+  Ktx2Supercompression getSupercompression() const { return header_->supercompressionScheme; }
+
+  // Data of `level`, as stored (possibly supercompressed), readable in place from the mapping
+  const uint8_t* getLevelData(uint32_t level) const;
+
+  const Ktx2LevelIndex& getLevelIndex(uint32_t level) const { return levels_[level]; }
+
+  /**
+   * @brief Create a sampled image of the file's format and copy every level into it: one staging
+   * buffer holds all of them, written straight out of the mapping (or inflated straight into it),
+   * then every level is copied in the same submission. Blocks until the copies have finished and
+   * the image is in `finalLayout`.
+   *
+   * Files with a levelCount of 0 get a full mip chain generated from level 0, which needs a format
+   * that can be blitted or downsampled (see MipGenerator), so never a block-compressed one. Blits
+   * need `commandPool` on a graphics queue; downsampling needs `mipGenerator` and a compute queue.
+   * Calls LOG_F if the pool's queue family can't do the one the format needs.
+   */
+  std::unique_ptr<Image> upload(
+      const LogicalDevice& device,
+      const CommandPool& commandPool,
+      VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      MipGenerator* mipGenerator = nullptr,
+      const QueueFamilyRequests sharingQueues = {}) const;
+
+  /**
+   * @brief Like upload(), but only with the levels from `baseLevel` down, so that level
+   * `baseLevel` of the file becomes level 0 of the image: for streaming, which keeps only the
+   * smaller levels of distant textures resident. `queueMutex` serializes the submission with other
+   * threads submitting to the same queue. The image ends up in SHADER_READ_ONLY_OPTIMAL.
+   */
+  std::unique_ptr<Image> uploadLevels(const LogicalDevice& device,
+                                      const CommandPool& commandPool,
+                                      uint32_t baseLevel,
+                                      const QueueFamilyRequests sharingQueues = {},
+                                      std::mutex* queueMutex = nullptr) const;
+
+  // Size of mip level `level` once decompressed, every layer included
+  uint64_t getLevelSize(uint32_t level) const;
+
+ private:
+  std::unique_ptr<Image> uploadFrom(const LogicalDevice& device,
+                                    const CommandPool& commandPool,
+                                    uint32_t baseLevel,
+                                    VkImageLayout finalLayout,
+                                    MipGenerator* mipGenerator,
+                                    const QueueFamilyRequests sharingQueues,
+                                    std::mutex* queueMutex) const;
+
+ private:
+  std::filesystem::path path_;
+  MappedFile file_;
+  const Ktx2Header* header_;
+  const Ktx2LevelIndex* levels_;
+};
@@ -0,0 +1,201 @@
+#include "MeshData.hpp"
+
+#include <cstring>
+#include <fmt/core.h>
+#include <fmtlog/Log.hpp>
+#include <limits>
+
+size_t MeshData::getSizeInBytes() const {
+  return positions.size() * sizeof(glm::vec3) + normals.size() * sizeof(glm::vec3) +
+         texcoords.size() * sizeof(glm::vec2) + colors.size() * sizeof(glm::vec4) +
+         indices.size() * sizeof(uint32_t);
+}
+
+std::vector<Vertex> MeshData::toVertices() const {
+  std::vector<Vertex> vertices(positions.size());
+
+  for (size_t i = 0; i < positions.size(); i++) {
+    vertices[i].pos = glm::vec2(positions[i]);
+
+    if (!colors.empty()) {
+      vertices[i].color = glm::vec3(colors[i]);
+    } else if (!normals.empty()) {
+      // Visualize the normal so there is something to look at
+      vertices[i].color = normals[i] * 0.5f + 0.5f;
+    } else {
+      vertices[i].color = glm::vec3(1.0f);
+    }
+  }
+
+  return vertices;
+}
+
+void MeshData::getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+  boundsMin = glm::vec3(std::numeric_limits<float>::max());
+  boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+  for (const auto& position : positions) {
+    boundsMin = glm::min(boundsMin, position);
+    boundsMax = glm::max(boundsMax, position);
+  }
+}
+
+QuantizationRange MeshData::getQuantizationRange() const {
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+  getBounds(boundsMin, boundsMax);
+
+  return QuantizationRange::fromBounds(boundsMin, boundsMax);
+}
+
+std::vector<PackedVertex> MeshData::toPackedVertices(const QuantizationRange& range) const {
+  std::vector<PackedVertex> vertices(positions.size());
+
+  if (vertices.empty()) {
+    return vertices;
+  }
+
+  constexpr size_t stride = sizeof(PackedVertex);
+
+  encodePositionsSnorm16(positions.data(), positions.size(), range, vertices[0].position, stride);
+
+  // Vertices start out zeroed, which is already +Z in octahedral form and (0, 0) as texcoords
+  if (!normals.empty()) {
+    encodeNormalsOctahedral16(normals.data(), normals.size(), vertices[0].normal, stride);
+  }
+
+  if (!texcoords.empty()) {
+    encodeTexcoordsHalf(texcoords.data(), texcoords.size(), vertices[0].texcoord, stride);
+  }
+
+  if (!colors.empty()) {
+    encodeColorsUnorm8(colors.data(), colors.size(), vertices[0].color, stride);
+  } else {
+    for (auto& vertex : vertices) {
+      vertex.color[0] = vertex.color[1] = vertex.color[2] = vertex.color[3] = 255;
+    }
+  }
+
+  return vertices;
+}
+
+std::vector<uint8_t> encodeIndices(const std::vector<uint32_t>& indices, VkIndexType indexType) {
+  size_t indexSize = getIndexTypeSize(indexType);
+  std::vector<uint8_t> bytes(indices.size() * indexSize);
+
+  switch (indexType) {
+    case VK_INDEX_TYPE_UINT8_EXT:
+      for (size_t i = 0; i < indices.size(); i++) {
+        bytes[i] = static_cast<uint8_t>(indices[i]);
+      }
+      break;
+
+    case VK_INDEX_TYPE_UINT16:
+      for (size_t i = 0; i < indices.size(); i++) {
+        uint16_t index = static_cast<uint16_t>(indices[i]);
+        std::memcpy(&bytes[i * sizeof(index)], &index, sizeof(index));
+      }
+      break;
+
+    case VK_INDEX_TYPE_UINT32:
+      std::memcpy(bytes.data(), indices.data(), bytes.size());
+      break;
+
+    default:
+      LOG_F("Unsupported index type {}", static_cast<int>(indexType));
+  }
+
+  return bytes;
+}
+
+std::vector<uint8_t> MeshData::encodeIndices(VkIndexType indexType) const {
+  return ::encodeIndices(indices, indexType);
+}
+
+VkIndexType selectIndexType(size_t vertexCount, bool allowUint8) {
+  if (allowUint8 && vertexCount <= std::numeric_limits<uint8_t>::max() + size_t(1)) {
+    return VK_INDEX_TYPE_UINT8_EXT;
+  }
+
+  if (vertexCount <= std::numeric_limits<uint16_t>::max() + size_t(1)) {
+    return VK_INDEX_TYPE_UINT16;
+  }
+
+  return VK_INDEX_TYPE_UINT32;
+}
+
+// Copy the attributes of `vertex` from `source` onto the end of every stream `piece` carries
+static void appendVertex(MeshData& piece, const MeshData& source, uint32_t vertex) {
+  piece.positions.push_back(source.positions[vertex]);
+
+  if (!source.normals.empty()) {
+    piece.normals.push_back(source.normals[vertex]);
+  }
+
+  if (!source.texcoords.empty()) {
+    piece.texcoords.push_back(source.texcoords[vertex]);
+  }
+
+  if (!source.colors.empty()) {
+    piece.colors.push_back(source.colors[vertex]);
+  }
+}
+
+std::vector<MeshData> splitMesh(const MeshData& mesh, size_t maxVertices) {
+  if (mesh.getVertexCount() <= maxVertices) {
+    return {mesh};
+  }
+
+  if (maxVertices < 3) {
+    LOG_F("Can't split mesh '{}' into pieces of fewer than 3 vertices", mesh.name);
+  }
+
+  constexpr uint32_t UNMAPPED = std::numeric_limits<uint32_t>::max();
+
+  std::vector<MeshData> pieces;
+  std::vector<uint32_t> remap(mesh.getVertexCount(), UNMAPPED);
+  std::vector<uint32_t> mapped;  // Vertices with a remap entry in the current piece
+
+  auto startPiece = [&]() {
+    for (uint32_t vertex : mapped) {
+      remap[vertex] = UNMAPPED;
+    }
+    mapped.clear();
+
+    pieces.emplace_back();
+    pieces.back().name = fmt::format("{}#{}", mesh.name, pieces.size() - 1);
+  };
+
+  startPiece();
+
+  for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    const uint32_t* triangle = &mesh.indices[t];
+
+    size_t newVertices = 0;
+    for (size_t k = 0; k < 3; k++) {
+      // Count each new vertex once, even if the triangle is degenerate
+      bool seen = remap[triangle[k]] != UNMAPPED ||
+                  (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+      newVertices += seen ? 0 : 1;
+    }
+
+    if (pieces.back().getVertexCount() + newVertices > maxVertices) {
+      startPiece();
+    }
+
+    MeshData& piece = pieces.back();
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t vertex = triangle[k];
+
+      if (remap[vertex] == UNMAPPED) {
+        remap[vertex] = static_cast<uint32_t>(piece.getVertexCount());
+        mapped.push_back(vertex);
+        appendVertex(piece, mesh, vertex);
+      }
+
+      piece.indices.push_back(remap[vertex]);
+    }
+  }
+
+  return pieces;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <engine/core/Buffer.hpp>
+#include <engine/core/PackedVertex.hpp>
+#include <engine/core/Vertex.hpp>
+#include <engine/core/VertexEncoding.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief CPU-side mesh data as produced by an importer, before it is converted into the vertex
+ * format used for rendering.
+ *
+ * Attribute streams are stored separately (struct-of-arrays). `positions` is always populated;
+ * the other streams are either empty or have exactly one entry per position.
+ */
+struct MeshData {
+  std::string name;
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> texcoords;
+  std::vector<glm::vec4> colors;
+
+  // Triangle list
+  std::vector<uint32_t> indices;
+
+  size_t getVertexCount() const { return positions.size(); }
+
+  size_t getIndexCount() const { return indices.size(); }
+
+  // Approximate CPU memory held by this mesh
+  size_t getSizeInBytes() const;
+
+  /**
+   * @brief Convert the attribute streams into the engine's interleaved Vertex format.
+   *
+   * Vertex only carries a 2D position and a color: the position is projected onto XY, and the
+   * color comes from COLOR_0 if present, otherwise from the normal, otherwise white.
+   */
+  std::vector<Vertex> toVertices() const;
+
+  // Object-space bounding box of the positions
+  void getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+  // Quantization range covering the bounding box, for toPackedVertices()
+  QuantizationRange getQuantizationRange() const;
+
+  /**
+   * @brief Encode the attribute streams into PackedVertex, with positions quantized to `range`.
+   *
+   * Missing normals encode as +Z, missing texcoords as zero and missing colors as white.
+   */
+  std::vector<PackedVertex> toPackedVertices(const QuantizationRange& range) const;
+
+  /**
+   * @brief Narrow the index buffer to `indexType` and return it as raw bytes, ready for an
+   * IndexBuffer. Every index must be representable in that type.
+   */
+  std::vector<uint8_t> encodeIndices(VkIndexType indexType) const;
+};
+
+/**
+ * @brief Narrow `indices` to `indexType` and return them as raw bytes. Every index must be
+ * representable in that type.
+ */
+std::vector<uint8_t> encodeIndices(const std::vector<uint32_t>& indices, VkIndexType indexType);
+
+/**
+ * @brief The narrowest index type able to address `vertexCount` vertices. UINT8 is only picked
+ * when `allowUint8` is set, since it needs VK_EXT_index_type_uint8.
+ */
+VkIndexType selectIndexType(size_t vertexCount, bool allowUint8);
+
+/**
+ * @brief Split a mesh into pieces that each reference at most `maxVertices` vertices, e.g. 65536
+ * to keep every piece within 16-bit indices. Triangles keep their order, so a cache-optimized
+ * mesh stays cache-friendly, and each piece's vertices are stored in first-use order.
+ *
+ * Meshes that already fit are returned as a single piece.
+ */
+std::vector<MeshData> splitMesh(const MeshData& mesh, size_t maxVertices);
+
+/**
+ * @brief A mesh that has been uploaded into device-local memory and is ready to be drawn.
+ */
+struct GpuMesh {
+  std::unique_ptr<OnDeviceBuffer<Vertex>> vertexBuffer;
+
+  // Index width varies per mesh, see IndexBuffer::getIndexType()
+  std::unique_ptr<IndexBuffer> indexBuffer;
+};
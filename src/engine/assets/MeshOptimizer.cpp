@@ -0,0 +1,450 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <engine/utils/hash.hpp>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t UNUSED_VERTEX = std::numeric_limits<uint32_t>::max();
+
+// Apply remap[oldIndex] = newIndex to one attribute stream. Vertices mapped to UNUSED_VERTEX are
+// dropped; several old vertices may map to the same new one (they are identical by then).
+template <class T>
+void remapStream(std::vector<T>& stream, const std::vector<uint32_t>& remap, size_t newCount) {
+  if (stream.empty()) {
+    return;
+  }
+
+  std::vector<T> remapped(newCount);
+  for (size_t i = 0; i < stream.size(); i++) {
+    if (remap[i] != UNUSED_VERTEX) {
+      remapped[remap[i]] = stream[i];
+    }
+  }
+
+  stream.swap(remapped);
+}
+
+void remapMesh(MeshData& mesh, const std::vector<uint32_t>& remap, size_t newCount) {
+  remapStream(mesh.positions, remap, newCount);
+  remapStream(mesh.normals, remap, newCount);
+  remapStream(mesh.texcoords, remap, newCount);
+  remapStream(mesh.colors, remap, newCount);
+
+  for (auto& index : mesh.indices) {
+    index = remap[index];
+  }
+}
+
+// All attributes of one vertex, compared bitwise. Missing streams are left as zero.
+struct VertexKey {
+  float values[12];
+
+  bool operator==(const VertexKey& other) const {
+    return std::memcmp(values, other.values, sizeof(values)) == 0;
+  }
+};
+
+struct VertexKeyHash {
+  size_t operator()(const VertexKey& key) const {
+    return hashBytes(key.values, sizeof(key.values));
+  }
+};
+
+VertexKey makeVertexKey(const MeshData& mesh, size_t vertex) {
+  VertexKey key{};
+
+  std::memcpy(&key.values[0], &mesh.positions[vertex], sizeof(glm::vec3));
+
+  if (!mesh.normals.empty()) {
+    std::memcpy(&key.values[3], &mesh.normals[vertex], sizeof(glm::vec3));
+  }
+
+  if (!mesh.texcoords.empty()) {
+    std::memcpy(&key.values[6], &mesh.texcoords[vertex], sizeof(glm::vec2));
+  }
+
+  if (!mesh.colors.empty()) {
+    std::memcpy(&key.values[8], &mesh.colors[vertex], sizeof(glm::vec4));
+  }
+
+  return key;
+}
+
+// Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr size_t FORSYTH_CACHE_SIZE = 32;
+constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+  // Nothing left to draw with this vertex, so it should never attract a triangle
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+
+  float score = 0.0f;
+
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // Vertices of the triangle we just emitted get a fixed score, so the algorithm doesn't
+      // prefer strip-like orders that reuse exactly the last triangle's edge
+      score = FORSYTH_LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+    }
+  }
+
+  // Favor vertices with few triangles left, so lone triangles don't get stranded
+  score += FORSYTH_VALENCE_BOOST_SCALE *
+           std::pow(static_cast<float>(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+
+  return score;
+}
+
+}  // namespace
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices,
+                                    size_t vertexCount,
+                                    size_t cacheSize) {
+  VertexCacheStats stats;
+
+  // No triangle to divide by: 0 rather than inf or NaN, which would spoil any totals
+  if (indices.size() < 3 || vertexCount == 0) {
+    return stats;
+  }
+
+  // FIFO simulation with timestamps: a vertex is in the cache if it was inserted within the last
+  // `cacheSize` misses
+  std::vector<size_t> insertedAt(vertexCount, 0);
+  size_t timestamp = cacheSize + 1;
+  size_t misses = 0;
+
+  std::vector<bool> referenced(vertexCount, false);
+  size_t uniqueVertices = 0;
+
+  for (uint32_t index : indices) {
+    if (timestamp - insertedAt[index] > cacheSize) {
+      insertedAt[index] = timestamp++;
+      misses++;
+    }
+
+    if (!referenced[index]) {
+      referenced[index] = true;
+      uniqueVertices++;
+    }
+  }
+
+  stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+  stats.atvr = static_cast<float>(misses) / uniqueVertices;
+
+  return stats;
+}
+
+size_t weldVertices(MeshData& mesh) {
+  size_t vertexCount = mesh.getVertexCount();
+
+  std::unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices;
+  uniqueVertices.reserve(vertexCount);
+
+  std::vector<uint32_t> remap(vertexCount);
+  uint32_t newCount = 0;
+
+  for (size_t i = 0; i < vertexCount; i++) {
+    auto inserted = uniqueVertices.insert({makeVertexKey(mesh, i), newCount});
+    if (inserted.second) {
+      newCount++;
+    }
+    remap[i] = inserted.first->second;
+  }
+
+  if (newCount == vertexCount) {
+    return 0;
+  }
+
+  remapMesh(mesh, remap, newCount);
+
+  return vertexCount - newCount;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+
+  if (triangleCount == 0 || vertexCount == 0) {
+    return;
+  }
+
+  // Vertex -> triangle adjacency, stored as one flat array with per-vertex slices. The first
+  // remainingTriangles[v] entries of a slice are the triangles not emitted yet.
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (uint32_t index : indices) {
+    adjacencyOffsets[index + 1]++;
+  }
+  std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      adjacency[adjacencyOffsets[v] + remainingTriangles[v]++] = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> vertexScore(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScore[v] = forsythVertexScore(-1, remainingTriangles[v]);
+  }
+
+  std::vector<float> triangleScore(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                       vertexScore[indices[t * 3 + 2]];
+  }
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  size_t scanCursor = 0;
+  int64_t best = -1;
+
+  for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+    if (best < 0) {
+      // Nothing in the cache touches a remaining triangle: restart from the next one in input
+      // order, which keeps the scan linear overall
+      while (emitted[scanCursor]) {
+        scanCursor++;
+      }
+      best = static_cast<int64_t>(scanCursor);
+    }
+
+    const uint32_t* triangle = &indices[best * 3];
+    emitted[best] = true;
+    output.insert(output.end(), triangle, triangle + 3);
+
+    // The emitted triangle's vertices go to the front of the cache
+    newCache.clear();
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t v = triangle[k];
+      newCache.push_back(v);
+
+      // Remove the triangle from the vertex's live slice
+      uint32_t* slice = &adjacency[adjacencyOffsets[v]];
+      uint32_t live = remainingTriangles[v];
+      for (uint32_t i = 0; i < live; i++) {
+        if (slice[i] == static_cast<uint32_t>(best)) {
+          std::swap(slice[i], slice[live - 1]);
+          break;
+        }
+      }
+      remainingTriangles[v]--;
+    }
+
+    for (uint32_t v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache.push_back(v);
+      }
+    }
+
+    // Update vertex scores and propagate the difference to the vertex's remaining triangles,
+    // including vertices that just fell out of the cache
+    for (size_t i = 0; i < newCache.size(); i++) {
+      uint32_t v = newCache[i];
+      int position = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+      cachePosition[v] = position;
+      float score = forsythVertexScore(position, remainingTriangles[v]);
+      float delta = score - vertexScore[v];
+      vertexScore[v] = score;
+
+      const uint32_t* slice = &adjacency[adjacencyOffsets[v]];
+      for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+        triangleScore[slice[j]] += delta;
+      }
+    }
+
+    if (newCache.size() > FORSYTH_CACHE_SIZE) {
+      newCache.resize(FORSYTH_CACHE_SIZE);
+    }
+    cache.swap(newCache);
+
+    // The next triangle is the best scoring one that touches the cache
+    best = -1;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (uint32_t v : cache) {
+      const uint32_t* slice = &adjacency[adjacencyOffsets[v]];
+      for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+        uint32_t t = slice[j];
+        if (triangleScore[t] > bestScore) {
+          bestScore = triangleScore[t];
+          best = t;
+        }
+      }
+    }
+  }
+
+  indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<glm::vec3>& positions,
+                      float threshold) {
+  constexpr size_t CACHE_SIZE = 16;
+  constexpr size_t MIN_CLUSTER_TRIANGLES = 16;
+
+  size_t triangleCount = indices.size() / 3;
+  size_t vertexCount = positions.size();
+
+  if (triangleCount <= MIN_CLUSTER_TRIANGLES) {
+    return;
+  }
+
+  VertexCacheStats before = analyzeVertexCache(indices, vertexCount, CACHE_SIZE);
+
+  // Split the cache-optimized order into clusters at points where the cache restarts (a triangle
+  // whose three vertices all miss). Reordering whole clusters keeps the cache behaviour within
+  // each cluster intact, so the ACMR only degrades slightly at the seams.
+  std::vector<size_t> clusterStarts = {0};
+  {
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t timestamp = CACHE_SIZE + 1;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+      int misses = 0;
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        if (timestamp - insertedAt[v] > CACHE_SIZE) {
+          insertedAt[v] = timestamp++;
+          misses++;
+        }
+      }
+
+      if (misses == 3 && t - clusterStarts.back() >= MIN_CLUSTER_TRIANGLES) {
+        clusterStarts.push_back(t);
+      }
+    }
+  }
+  clusterStarts.push_back(triangleCount);
+
+  size_t clusterCount = clusterStarts.size() - 1;
+  if (clusterCount <= 1) {
+    return;
+  }
+
+  // Area-weighted centroid and normal for every cluster, and for the mesh as a whole
+  std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+  std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+
+  for (size_t c = 0; c < clusterCount; c++) {
+    float clusterArea = 0.0f;
+
+    for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+      const glm::vec3& a = positions[indices[t * 3]];
+      const glm::vec3& b = positions[indices[t * 3 + 1]];
+      const glm::vec3& d = positions[indices[t * 3 + 2]];
+
+      // Twice the triangle area, pointing along the face normal
+      glm::vec3 normal = glm::cross(b - a, d - a);
+      float area = glm::length(normal);
+
+      clusterNormals[c] += normal;
+      clusterCentroids[c] += (a + b + d) * (area / 3.0f);
+      clusterArea += area;
+    }
+
+    meshCentroid += clusterCentroids[c];
+    meshArea += clusterArea;
+
+    if (clusterArea > 0.0f) {
+      clusterCentroids[c] /= clusterArea;
+    }
+  }
+
+  if (meshArea > 0.0f) {
+    meshCentroid /= meshArea;
+  }
+
+  // Clusters that face away from the center of the mesh are likely to occlude the rest of it, so
+  // they get drawn first
+  std::vector<float> sortKeys(clusterCount, 0.0f);
+  for (size_t c = 0; c < clusterCount; c++) {
+    float normalLength = glm::length(clusterNormals[c]);
+    if (normalLength > 0.0f) {
+      sortKeys[c] =
+          glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength);
+    }
+  }
+
+  std::vector<size_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) {
+    return sortKeys[a] > sortKeys[b];
+  });
+
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indices.size());
+  for (size_t c : order) {
+    reordered.insert(reordered.end(),
+                     indices.begin() + clusterStarts[c] * 3,
+                     indices.begin() + clusterStarts[c + 1] * 3);
+  }
+
+  VertexCacheStats after = analyzeVertexCache(reordered, vertexCount, CACHE_SIZE);
+
+  if (after.acmr <= before.acmr * threshold) {
+    indices.swap(reordered);
+  }
+}
+
+size_t optimizeVertexFetch(MeshData& mesh) {
+  std::vector<uint32_t> remap(mesh.getVertexCount(), UNUSED_VERTEX);
+  uint32_t newCount = 0;
+
+  for (uint32_t index : mesh.indices) {
+    if (remap[index] == UNUSED_VERTEX) {
+      remap[index] = newCount++;
+    }
+  }
+
+  remapMesh(mesh, remap, newCount);
+
+  return newCount;
+}
+
+void optimizeMesh(MeshData& mesh, const MeshOptimizeOptions& options) {
+  if (mesh.getVertexCount() == 0 || mesh.getIndexCount() == 0) {
+    return;
+  }
+
+  if (options.weld) {
+    weldVertices(mesh);
+  }
+
+  if (options.vertexCache) {
+    optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+  }
+
+  if (options.overdraw) {
+    optimizeOverdraw(mesh.indices, mesh.positions, options.overdrawThreshold);
+  }
+
+  if (options.vertexFetch) {
+    optimizeVertexFetch(mesh);
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <engine/assets/MeshData.hpp>
+#include <vector>
+
+/**
+ * Offline mesh optimization, run when assets are imported or cooked.
+ *
+ * The passes are meant to be run in this order, which is what optimizeMesh() does:
+ *  1. weldVertices:        merge vertices whose attributes are bitwise identical
+ *  2. optimizeVertexCache: reorder triangles so the post-transform cache gets reused
+ *  3. optimizeOverdraw:    reorder clusters of triangles so outward-facing geometry is drawn
+ *                          first, without giving back much of the cache gain
+ *  4. optimizeVertexFetch: reorder vertices in the order the index buffer first touches them
+ *
+ * None of the passes change what is rendered, only the order things are fetched in.
+ */
+
+struct VertexCacheStats {
+  // Average Cache Miss Ratio: vertex shader invocations per triangle. 0.5 is the ideal for large
+  // regular meshes, 3.0 is the worst case
+  float acmr = 0.0f;
+
+  // Average Transformed Vertex Ratio: vertex shader invocations per unique vertex. 1.0 is ideal
+  float atvr = 0.0f;
+};
+
+struct MeshOptimizeOptions {
+  bool weld = true;
+  bool vertexCache = true;
+  bool overdraw = true;
+  bool vertexFetch = true;
+
+  // Overdraw ordering may make the ACMR this much worse, relative to the cache-optimized order
+  float overdrawThreshold = 1.05f;
+};
+
+/**
+ * @brief Simulate a FIFO post-transform vertex cache over a triangle list. Both ratios are 0 for
+ * meshes without a triangle.
+ */
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices,
+                                    size_t vertexCount,
+                                    size_t cacheSize = 16);
+
+/**
+ * @brief Merge vertices with identical attributes, and rewrite the index buffer to match.
+ *
+ * @return the number of vertices removed
+ */
+size_t weldVertices(MeshData& mesh);
+
+/**
+ * @brief Reorder triangles for post-transform vertex cache efficiency (Forsyth's linear-speed
+ * algorithm).
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+/**
+ * @brief Reorder clusters of triangles to reduce overdraw, keeping the ACMR within `threshold`
+ * of its value on entry. Expects a cache-optimized index buffer.
+ */
+void optimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<glm::vec3>& positions,
+                      float threshold = 1.05f);
+
+/**
+ * @brief Reorder the vertex streams in first-use order, dropping vertices no triangle references.
+ *
+ * @return the number of vertices left
+ */
+size_t optimizeVertexFetch(MeshData& mesh);
+
+/**
+ * @brief Run every enabled pass, in the recommended order.
+ */
+void optimizeMesh(MeshData& mesh, const MeshOptimizeOptions& options = {});
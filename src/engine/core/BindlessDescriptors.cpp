@@ -0,0 +1,186 @@
+#include "BindlessDescriptors.hpp"
+
+#include <algorithm>
+#include <fmtlog/Log.hpp>
+
+namespace {
+
+constexpr const char* BINDING_NAMES[BindlessDescriptors::BindingCount] = {"texture",
+                                                                          "buffer",
+                                                                          "sampler"};
+
+constexpr VkDescriptorType BINDING_TYPES[BindlessDescriptors::BindingCount] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+}  // namespace
+
+BindlessDescriptors::BindlessDescriptors(const LogicalDevice& device,
+                                         DescriptorSetLayoutCache& layoutCache,
+                                         uint32_t maxTextures,
+                                         uint32_t maxBuffers,
+                                         uint32_t maxSamplers)
+    : device_(device),
+      writer_(device) {
+  if (!isSupported(device_)) {
+    LOG_F("Bindless descriptors need the Vulkan 1.2 descriptor indexing features");
+  }
+
+  // The whole table lives in one set, and every stage may index it, so both the per-set and the
+  // per-stage limits apply
+  VkPhysicalDeviceVulkan12Properties limits{};
+  limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &limits;
+  vkGetPhysicalDeviceProperties2(device_.getPhysicalDevice(), &properties);
+
+  slots_[TexturesBinding].capacity =
+      std::min({maxTextures,
+                limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+  slots_[BuffersBinding].capacity =
+      std::min({maxBuffers,
+                limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+  slots_[SamplersBinding].capacity =
+      std::min({maxSamplers,
+                limits.maxDescriptorSetUpdateAfterBindSamplers,
+                limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings(BindingCount);
+  std::vector<DescriptorAllocator::PoolRatio> poolSizes(BindingCount);
+  for (uint32_t i = 0; i < BindingCount; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = BINDING_TYPES[i];
+    bindings[i].descriptorCount = slots_[i].capacity;
+    bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+    poolSizes[i] = {BINDING_TYPES[i], float(slots_[i].capacity)};
+  }
+
+  // Slots may be empty, and may be written while the set is bound by frames in flight as long as
+  // those frames don't use them
+  std::vector<VkDescriptorBindingFlags> bindingFlags(
+      BindingCount,
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+
+  layout_ = layoutCache.get(
+      bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, bindingFlags);
+
+  descriptors_ = std::make_unique<DescriptorAllocator>(
+      device_, 1, poolSizes, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
+  set_ = descriptors_->allocate(layout_);
+
+  LOG_I("Bindless descriptors: {} textures, {} buffers, {} samplers",
+        slots_[TexturesBinding].capacity,
+        slots_[BuffersBinding].capacity,
+        slots_[SamplersBinding].capacity);
+}
+
+void BindlessDescriptors::requestFeatures(DeviceFeatures& features) {
+  VkPhysicalDeviceVulkan12Features& vulkan12 = features.vulkan12;
+  vulkan12.descriptorIndexing = VK_TRUE;
+  vulkan12.runtimeDescriptorArray = VK_TRUE;
+  vulkan12.descriptorBindingPartiallyBound = VK_TRUE;
+  vulkan12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  vulkan12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  vulkan12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  vulkan12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  vulkan12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+bool BindlessDescriptors::isSupported(const LogicalDevice& device) {
+  const VkPhysicalDeviceVulkan12Features& vulkan12 = device.getEnabledFeatures().vulkan12;
+  return vulkan12.descriptorIndexing && vulkan12.runtimeDescriptorArray &&
+         vulkan12.descriptorBindingPartiallyBound &&
+         vulkan12.descriptorBindingUpdateUnusedWhilePending &&
+         vulkan12.descriptorBindingSampledImageUpdateAfterBind &&
+         vulkan12.descriptorBindingStorageBufferUpdateAfterBind &&
+         vulkan12.shaderSampledImageArrayNonUniformIndexing &&
+         vulkan12.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+uint32_t BindlessDescriptors::addTexture(VkImageView imageView, VkImageLayout layout) {
+  uint32_t index = slots_[TexturesBinding].allocate(BINDING_NAMES[TexturesBinding]);
+  setTexture(index, imageView, layout);
+  return index;
+}
+
+uint32_t BindlessDescriptors::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+  uint32_t index = slots_[BuffersBinding].allocate(BINDING_NAMES[BuffersBinding]);
+  writer_.writeBuffer(
+      set_, BuffersBinding, BINDING_TYPES[BuffersBinding], buffer, offset, range, index);
+  return index;
+}
+
+uint32_t BindlessDescriptors::addSampler(VkSampler sampler) {
+  uint32_t index = slots_[SamplersBinding].allocate(BINDING_NAMES[SamplersBinding]);
+  writer_.writeImage(set_,
+                     SamplersBinding,
+                     BINDING_TYPES[SamplersBinding],
+                     VK_NULL_HANDLE,
+                     sampler,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     index);
+  return index;
+}
+
+void BindlessDescriptors::setTexture(uint32_t index, VkImageView imageView, VkImageLayout layout) {
+  if (index >= slots_[TexturesBinding].next) {
+    LOG_F("Texture slot {} was never allocated", index);
+  }
+
+  writer_.writeImage(set_,
+                     TexturesBinding,
+                     BINDING_TYPES[TexturesBinding],
+                     imageView,
+                     VK_NULL_HANDLE,
+                     layout,
+                     index);
+}
+
+void BindlessDescriptors::removeTexture(uint32_t index) {
+  slots_[TexturesBinding].free(index, BINDING_NAMES[TexturesBinding]);
+}
+
+void BindlessDescriptors::removeBuffer(uint32_t index) {
+  slots_[BuffersBinding].free(index, BINDING_NAMES[BuffersBinding]);
+}
+
+void BindlessDescriptors::removeSampler(uint32_t index) {
+  slots_[SamplersBinding].free(index, BINDING_NAMES[SamplersBinding]);
+}
+
+void BindlessDescriptors::update() { writer_.update(); }
+
+uint32_t BindlessDescriptors::getCount(Binding binding) const {
+  return slots_[binding].next - static_cast<uint32_t>(slots_[binding].freed.size());
+}
+
+uint32_t BindlessDescriptors::Slots::allocate(const char* name) {
+  if (!freed.empty()) {
+    uint32_t index = freed.back();
+    freed.pop_back();
+    return index;
+  }
+
+  if (next == capacity) {
+    LOG_F("Out of bindless {} slots ({} in use)", name, capacity);
+  }
+
+  return next++;
+}
+
+void BindlessDescriptors::Slots::free(uint32_t index, const char* name) {
+  if (index >= next) {
+    LOG_F("Freeing {} slot {}, which was never allocated", name, index);
+  }
+
+  // Nothing is written: partially bound slots may keep a stale descriptor as long as no shader
+  // reads it
+  freed.push_back(index);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Descriptors.hpp>
+#include <engine/core/Device.hpp>
+#include <engine/core/PushConstants.hpp>
+#include <memory>
+#include <vector>
+
+// Resource indices of one material, pushed as push constants before its draws (std430)
+struct BindlessMaterial {
+  uint32_t baseColorTexture;
+  uint32_t sampler;
+  uint32_t materialBuffer;  // Storage buffer holding the material's parameters
+  uint32_t materialIndex;   // Element of materialBuffer
+};
+
+static_assert(sizeof(BindlessMaterial) == 16, "BindlessMaterial must match the shaders");
+
+using BindlessMaterialConstants = PushConstants<BindlessMaterial, VK_SHADER_STAGE_FRAGMENT_BIT>;
+
+/**
+ * @brief One descriptor set holding every texture, storage buffer and sampler in use, as three
+ * large arrays that shaders index with plain integers. Bound once per frame; materials then only
+ * push their indices (BindlessMaterial), so drawing a different material costs no descriptor
+ * binds, and objects sharing a pipeline can be drawn back to back.
+ *
+ *   uint32_t albedo = bindless.addTexture(albedoView);
+ *   uint32_t linear = bindless.addSampler(linearSampler);
+ *   bindless.update();   // Before the frame that first uses them is submitted
+ *   ...
+ *   commandBuffer.bindDescriptorSets(pipeline, {bindless.getSet()}, BINDLESS_SET);
+ *   commandBuffer.pushConstants<BindlessMaterialConstants>(pipeline, {albedo, linear, ...});
+ *
+ * On the shader side (with GL_EXT_nonuniform_qualifier):
+ *
+ *   layout(set = BINDLESS_SET, binding = 0) uniform texture2D textures[];
+ *   layout(set = BINDLESS_SET, binding = 1) buffer Buffers { uint data[]; } buffers[];
+ *   layout(set = BINDLESS_SET, binding = 2) uniform sampler samplers[];
+ *
+ *   texture(sampler2D(textures[nonuniformEXT(index)], samplers[sampler]), uv)
+ *
+ * The arrays are partially bound and update-after-bind: slots nobody uses may hold nothing, and
+ * new resources can be added while earlier frames using the set are still in flight. Removing a
+ * resource frees its slot for reuse, so only remove once no frame in flight uses it.
+ *
+ * Needs the descriptor indexing features of Vulkan 1.2; request them with requestFeatures() and
+ * check isSupported() on the device.
+ */
+class BindlessDescriptors {
+ public:
+  enum Binding : uint32_t { TexturesBinding = 0, BuffersBinding, SamplersBinding, BindingCount };
+
+  static constexpr uint32_t NO_RESOURCE = UINT32_MAX;
+
+  BindlessDescriptors() = delete;
+  BindlessDescriptors(BindlessDescriptors& other) = delete;
+
+  /**
+   * Array sizes are clamped to the device's update-after-bind limits. Calls LOG_F unless
+   * isSupported(device).
+   */
+  BindlessDescriptors(const LogicalDevice& device,
+                      DescriptorSetLayoutCache& layoutCache,
+                      uint32_t maxTextures = 16384,
+                      uint32_t maxBuffers = 4096,
+                      uint32_t maxSamplers = 64);
+
+  // Add the descriptor indexing features the table needs to `features`
+  static void requestFeatures(DeviceFeatures& features);
+
+  static bool isSupported(const LogicalDevice& device);
+
+  // Sampled image, in `layout` whenever a shader reads it
+  uint32_t addTexture(VkImageView imageView,
+                      VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+  uint32_t addSampler(VkSampler sampler);
+
+  // Point an existing slot at another resource, e.g. a streamed-in texture replacing a placeholder
+  void setTexture(uint32_t index,
+                  VkImageView imageView,
+                  VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  void removeTexture(uint32_t index);
+  void removeBuffer(uint32_t index);
+  void removeSampler(uint32_t index);
+
+  // Write every resource added or changed since the last update, in one batch
+  void update();
+
+  VkDescriptorSetLayout getLayout() const { return layout_; }
+
+  VkDescriptorSet getSet() const { return set_; }
+
+  uint32_t getCapacity(Binding binding) const { return slots_[binding].capacity; }
+
+  // Slots currently holding a resource
+  uint32_t getCount(Binding binding) const;
+
+ private:
+  // Free list of the slots of one array
+  struct Slots {
+    uint32_t capacity = 0;
+    uint32_t next = 0;  // Slots past this one have never been used
+    std::vector<uint32_t> freed;
+
+    uint32_t allocate(const char* name);
+    void free(uint32_t index, const char* name);
+  };
+
+  const LogicalDevice& device_;
+
+  VkDescriptorSetLayout layout_;
+  std::unique_ptr<DescriptorAllocator> descriptors_;
+  VkDescriptorSet set_;
+
+  Slots slots_[BindingCount];
+  DescriptorWriter writer_;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <engine/core/PackedVertex.hpp>
 #include <engine/core/Vertex.hpp>
 #include <engine/core/Device.hpp>
 #include <fmtlog/Log.hpp>
@@ -15,9 +16,16 @@ class Buffer {
          VkBufferUsageFlags usageFlags,
          VkMemoryPropertyFlags propertyFlags,
          const QueueFamilyRequests sharingQueues = {})
+      : Buffer(device, bufferContents.size(), usageFlags, propertyFlags, sharingQueues) {}
+
+  Buffer(const LogicalDevice& device,
+         size_t numElements,
+         VkBufferUsageFlags usageFlags,
+         VkMemoryPropertyFlags propertyFlags,
+         const QueueFamilyRequests sharingQueues = {})
       : device_(device),
-        numElements_(bufferContents.size()),
-        bufferSize_(sizeof(InputType) * bufferContents.size()) {
+        numElements_(numElements),
+        bufferSize_(sizeof(InputType) * numElements) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = bufferSize_;
@@ -66,17 +74,7 @@ class Buffer {
   }
 
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(device_.getPhysicalDevice(), &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-      if ((typeFilter & (1 << i)) &&
-          (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-        return i;
-      }
-    }
-
-    LOG_F("failed to find suitable memory type!");
+    return device_.getPhysicalDevice().findMemoryType(typeFilter, properties);
   }
 
   operator VkBuffer() const { return buffer_; }
@@ -93,6 +91,91 @@ class Buffer {
   size_t bufferSize_;
 };
 
+// Extra usage flags a device-local buffer needs, based on what it stores. Specialize this to let
+// OnDeviceBuffer<T> be bound as something other than a plain transfer destination.
+template <class InputType>
+struct DeviceBufferUsage {
+  static constexpr VkBufferUsageFlags flags = 0;
+};
+
+// Vertex buffers
+template <>
+struct DeviceBufferUsage<Vertex> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+};
+
+template <>
+struct DeviceBufferUsage<PackedVertex> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+};
+
+template <>
+struct DeviceBufferUsage<PackedPositionColorVertex> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+};
+
+// Indirect draw commands, also written by compute shaders (e.g. GPU culling)
+template <>
+struct DeviceBufferUsage<VkDrawIndexedIndirectCommand> {
+  static constexpr VkBufferUsageFlags flags =
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+};
+
+// Indirect dispatch arguments, usually produced by a compute pass for the next one
+template <>
+struct DeviceBufferUsage<VkDispatchIndirectCommand> {
+  static constexpr VkBufferUsageFlags flags =
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+};
+
+// Index buffers
+template <>
+struct DeviceBufferUsage<uint8_t> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+};
+
+template <>
+struct DeviceBufferUsage<uint16_t> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+};
+
+template <>
+struct DeviceBufferUsage<uint32_t> {
+  static constexpr VkBufferUsageFlags flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+};
+
+// Maps an index element type to its VkIndexType. uint8_t needs VK_EXT_index_type_uint8.
+template <class IndexType>
+struct IndexTypeOf;
+
+template <>
+struct IndexTypeOf<uint8_t> {
+  static constexpr VkIndexType value = VK_INDEX_TYPE_UINT8_EXT;
+};
+
+template <>
+struct IndexTypeOf<uint16_t> {
+  static constexpr VkIndexType value = VK_INDEX_TYPE_UINT16;
+};
+
+template <>
+struct IndexTypeOf<uint32_t> {
+  static constexpr VkIndexType value = VK_INDEX_TYPE_UINT32;
+};
+
+constexpr size_t getIndexTypeSize(VkIndexType indexType) {
+  switch (indexType) {
+    case VK_INDEX_TYPE_UINT8_EXT:
+      return 1;
+    case VK_INDEX_TYPE_UINT16:
+      return 2;
+    case VK_INDEX_TYPE_UINT32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
 // Buffer used to store data in device memory, optimal format
 template <class InputType>
 class OnDeviceBuffer : public Buffer<InputType> {
@@ -100,56 +183,158 @@ class OnDeviceBuffer : public Buffer<InputType> {
   OnDeviceBuffer(const LogicalDevice& device,
                  const std::vector<InputType>& bufferContents,
                  const QueueFamilyRequests sharingQueues = {})
+      : OnDeviceBuffer(device, bufferContents.size(), sharingQueues) {}
+
+  OnDeviceBuffer(const LogicalDevice& device,
+                 size_t numElements,
+                 const QueueFamilyRequests sharingQueues = {})
       : Buffer<InputType>(device,
-                          bufferContents,
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          numElements,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT | DeviceBufferUsage<InputType>::flags,
                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                           sharingQueues) {}
 };
 
-template <>
-class OnDeviceBuffer<Vertex> : public Buffer<Vertex> {
+// Buffer used to transfer data from host to device memory
+template <class InputType>
+class TransferBuffer : public Buffer<InputType> {
  public:
-  OnDeviceBuffer(const LogicalDevice& device,
-                 const std::vector<Vertex>& bufferContents,
+  TransferBuffer(const LogicalDevice& device,
+                 const std::vector<InputType>& bufferContents,
                  const QueueFamilyRequests sharingQueues = {})
-      : Buffer<Vertex>(device,
-                        bufferContents,
-                        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                        sharingQueues) {}
+      : TransferBuffer(device, bufferContents.data(), bufferContents.size(), sharingQueues) {}
+
+  // Copy straight from memory we don't own, e.g. a memory-mapped asset file
+  TransferBuffer(const LogicalDevice& device,
+                 const InputType* bufferContents,
+                 size_t numElements,
+                 const QueueFamilyRequests sharingQueues = {})
+      : Buffer<InputType>(
+            device,
+            numElements,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sharingQueues) {
+    // Copy the buffer contents into the transfer buffer
+    void* data;
+    vkMapMemory(device_, bufferMemory_, 0 /*offset*/, bufferSize_, 0 /*flags*/, &data);
+    memcpy(data, bufferContents, bufferSize_);
+    vkUnmapMemory(device_, bufferMemory_);
+  }
 };
 
-template <>
-class OnDeviceBuffer<uint16_t> : public Buffer<uint16_t> {
+/**
+ * @brief Device-local index buffer whose index width is picked at runtime, e.g. per mesh at import.
+ * The contents are raw bytes (so it can be filled from a TransferBuffer<uint8_t>); the index type
+ * travels with the buffer.
+ */
+class IndexBuffer : public Buffer<uint8_t> {
  public:
-  OnDeviceBuffer(const LogicalDevice& device,
-                 const std::vector<uint16_t>& bufferContents,
-                 const QueueFamilyRequests sharingQueues = {})
-      : Buffer<uint16_t>(device,
-                        bufferContents,
+  IndexBuffer(const LogicalDevice& device,
+              VkIndexType indexType,
+              size_t indexCount,
+              const QueueFamilyRequests sharingQueues = {})
+      : Buffer<uint8_t>(device,
+                        indexCount * getIndexTypeSize(indexType),
                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                        sharingQueues) {}
+                        sharingQueues),
+        indexType_(indexType),
+        indexCount_(indexCount) {}
+
+  VkIndexType getIndexType() const { return indexType_; }
+
+  size_t getIndexCount() const { return indexCount_; }
+
+ private:
+  VkIndexType indexType_;
+  size_t indexCount_;
 };
 
-// Buffer used to transfer data from host to device memory
+/**
+ * @brief Host-visible buffer kept persistently mapped, so it can be rewritten every frame without a
+ * staging copy. Holds up to `capacity` elements.
+ *
+ * The GPU reads it in place: only write to a buffer that no in-flight command buffer is using,
+ * e.g. by keeping one per frame in flight.
+ */
 template <class InputType>
-class TransferBuffer : public Buffer<InputType> {
+class MappedBuffer : public Buffer<InputType> {
  public:
-  TransferBuffer(const LogicalDevice& device,
-                 const std::vector<InputType>& bufferContents,
-                 const QueueFamilyRequests sharingQueues = {})
+  MappedBuffer(const LogicalDevice& device,
+               size_t capacity,
+               VkBufferUsageFlags usageFlags,
+               const QueueFamilyRequests sharingQueues = {})
       : Buffer<InputType>(
             device,
-            bufferContents,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            capacity,
+            usageFlags,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
             sharingQueues) {
-    // Copy the buffer contents into the transfer buffer
     void* data;
     vkMapMemory(device_, bufferMemory_, 0 /*offset*/, bufferSize_, 0 /*flags*/, &data);
-    memcpy(data, bufferContents.data(), bufferSize_);
-    vkUnmapMemory(device_, bufferMemory_);
+    mapped_ = static_cast<InputType*>(data);
+  }
+
+  ~MappedBuffer() { vkUnmapMemory(device_, bufferMemory_); }
+
+  size_t getCapacity() const { return numElements_; }
+
+  // The mapping itself, for writing in place. Stays valid for the lifetime of the buffer
+  InputType* getMapped() const { return mapped_; }
+
+  // Overwrite `count` elements starting at element `first`. Calls LOG_F if they don't fit.
+  void write(const InputType* elements, size_t count, size_t first = 0) {
+    if (first + count > numElements_) {
+      LOG_F("Writing {} elements at {} overflows a mapped buffer of {}",
+            count,
+            first,
+            numElements_);
+    }
+
+    memcpy(mapped_ + first, elements, count * sizeof(InputType));
   }
-};
\ No newline at end of file
+
+  void write(const std::vector<InputType>& elements, size_t first = 0) {
+    write(elements.data(), elements.size(), first);
+  }
+
+ private:
+  InputType* mapped_;
+};
+
+// Vertex buffer read once per instance, see InstanceData.hpp. Compute shaders can read it too,
+// e.g. to cull instances
+template <class InstanceType>
+class InstanceBuffer : public MappedBuffer<InstanceType> {
+ public:
+  InstanceBuffer(const LogicalDevice& device,
+                 size_t capacity,
+                 const QueueFamilyRequests sharingQueues = {})
+      : MappedBuffer<InstanceType>(
+            device,
+            capacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            sharingQueues) {}
+};
+
+// Draw commands for CommandBuffer::drawIndexedIndirect, written by the CPU
+class IndirectCommandBuffer : public MappedBuffer<VkDrawIndexedIndirectCommand> {
+ public:
+  IndirectCommandBuffer(const LogicalDevice& device,
+                        size_t capacity,
+                        const QueueFamilyRequests sharingQueues = {})
+      : MappedBuffer<VkDrawIndexedIndirectCommand>(device,
+                                                   capacity,
+                                                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                   sharingQueues) {}
+};
+
+// Draw count for CommandBuffer::drawIndexedIndirectCount, written by the CPU
+class IndirectCountBuffer : public MappedBuffer<uint32_t> {
+ public:
+  IndirectCountBuffer(const LogicalDevice& device, const QueueFamilyRequests sharingQueues = {})
+      : MappedBuffer<uint32_t>(device, 1, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sharingQueues) {}
+
+  void write(uint32_t count) { MappedBuffer<uint32_t>::write(&count, 1); }
+};
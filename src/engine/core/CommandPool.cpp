@@ -1,7 +1,32 @@
 #include "CommandPool.hpp"
 
+#include <algorithm>
+#include <engine/core/Sync.hpp>
 #include <fmtlog/Log.hpp>
 
+namespace {
+
+// End of mip levels [baseMipLevel, baseMipLevel + mipLevelCount) of `image`, where the count may
+// be VK_REMAINING_MIP_LEVELS. Calls LOG_F unless they are one or more of the image's levels
+uint32_t getEndMipLevel(const Image& image, uint32_t baseMipLevel, uint32_t mipLevelCount) {
+  uint32_t levels = image.getMipLevels();
+  if (mipLevelCount == VK_REMAINING_MIP_LEVELS && baseMipLevel < levels) {
+    return levels;
+  }
+
+  // Compared without adding, which could wrap around
+  if (baseMipLevel >= levels || mipLevelCount == 0 || mipLevelCount > levels - baseMipLevel) {
+    LOG_F("Barrier on {} mip levels from level {} of an image with {}",
+          mipLevelCount,
+          baseMipLevel,
+          levels);
+  }
+
+  return baseMipLevel + mipLevelCount;
+}
+
+}  // namespace
+
 CommandPool::CommandPool(const LogicalDevice& device, const QueueFamilyRequest& queue)
     : device_(device),
       queue_(queue) {
@@ -94,11 +119,9 @@ void CommandBuffer::end() {
 }
 
 void CommandBuffer::beginRenderPass(const RenderPass& renderPass, const Framebuffer& framebuffer) {
-  // We need a VkClearValue for every attachment that uses
-  // VK_ATTACHMENT_LOAD_OP_CLEAR. For now, that's all our attachments, and we
-  // will just make them all clear to black.
-  std::vector<VkClearValue> clearColors;
-  clearColors.resize(renderPass.getAttachmentCount(), {{{0.0f, 0.0f, 0.0f, 1.0f}}});
+  // We need a VkClearValue for every attachment that uses VK_ATTACHMENT_LOAD_OP_CLEAR, indexed by
+  // attachment. The render pass builds them once when it is finalized
+  const std::vector<VkClearValue>& clearValues = renderPass.getClearValues();
 
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -106,8 +129,8 @@ void CommandBuffer::beginRenderPass(const RenderPass& renderPass, const Framebuf
   renderPassInfo.framebuffer = framebuffer;
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = renderPass.getExtent();
-  renderPassInfo.clearValueCount = clearColors.size();
-  renderPassInfo.pClearValues = clearColors.data();
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues = clearValues.data();
 
   // Record this command to the command buffer
   vkCmdBeginRenderPass(commandBuffer_, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -115,6 +138,8 @@ void CommandBuffer::beginRenderPass(const RenderPass& renderPass, const Framebuf
 
 void CommandBuffer::endRenderPass() { vkCmdEndRenderPass(commandBuffer_); }
 
+void CommandBuffer::nextSubpass() { vkCmdNextSubpass(commandBuffer_, VK_SUBPASS_CONTENTS_INLINE); }
+
 void CommandBuffer::draw(uint32_t vertexCount,
                          uint32_t instanceCount,
                          uint32_t firstVertexIndex,
@@ -138,4 +163,352 @@ void CommandBuffer::drawIndexed(uint32_t vertexCount,
                    firstIndexOffset,
                    indexValueOffset,
                    instanceOffset);
-}
\ No newline at end of file
+}
+
+void CommandBuffer::drawIndexedIndirect(const Buffer<VkDrawIndexedIndirectCommand>& commands,
+                                        uint32_t drawCount,
+                                        uint32_t firstDraw) {
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  if (size_t(firstDraw) + drawCount > commands.getNumElements()) {
+    LOG_F("Drawing commands {} to {} of an indirect buffer holding {}",
+          firstDraw,
+          size_t(firstDraw) + drawCount,
+          commands.getNumElements());
+  }
+
+  if (device_.getEnabledFeatures().core.features.multiDrawIndirect) {
+    vkCmdDrawIndexedIndirect(commandBuffer_, commands, firstDraw * stride, drawCount, stride);
+  } else {
+    // Without multiDrawIndirect, drawCount can only be 0 or 1
+    for (uint32_t i = 0; i < drawCount; i++) {
+      vkCmdDrawIndexedIndirect(commandBuffer_, commands, (firstDraw + i) * stride, 1, stride);
+    }
+  }
+}
+
+void CommandBuffer::drawIndexedIndirectCount(const Buffer<VkDrawIndexedIndirectCommand>& commands,
+                                             const Buffer<uint32_t>& count,
+                                             uint32_t maxDrawCount) {
+  if (!device_.getEnabledFeatures().vulkan12.drawIndirectCount) {
+    LOG_F("drawIndexedIndirectCount needs the drawIndirectCount feature");
+  }
+
+  if (maxDrawCount > commands.getNumElements()) {
+    LOG_F("maxDrawCount {} is larger than the indirect buffer ({} commands)",
+          maxDrawCount,
+          commands.getNumElements());
+  }
+
+  vkCmdDrawIndexedIndirectCount(commandBuffer_,
+                                commands,
+                                0,  // offset
+                                count,
+                                0,  // countBufferOffset
+                                maxDrawCount,
+                                sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void CommandBuffer::bindDescriptorSets(const ComputePipeline& pipeline,
+                                       const std::vector<VkDescriptorSet>& descriptorSets,
+                                       uint32_t firstSet,
+                                       const std::vector<uint32_t>& dynamicOffsets) {
+  vkCmdBindDescriptorSets(commandBuffer_,
+                          VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline.getLayout(),
+                          firstSet,
+                          static_cast<uint32_t>(descriptorSets.size()),
+                          descriptorSets.data(),
+                          static_cast<uint32_t>(dynamicOffsets.size()),
+                          dynamicOffsets.data());
+}
+
+void CommandBuffer::pushConstantBytes(VkPipelineLayout layout,
+                                      const std::vector<VkPushConstantRange>& ranges,
+                                      VkShaderStageFlags stages,
+                                      uint32_t offset,
+                                      uint32_t size,
+                                      const void* data) {
+  if (!hasPushConstantRange(ranges, stages, offset, size)) {
+    LOG_F("Pushing {} bytes at offset {} for stages {:#x}, which the pipeline didn't declare",
+          size,
+          offset,
+          stages);
+  }
+
+  vkCmdPushConstants(commandBuffer_, layout, stages, offset, size, data);
+}
+
+void CommandBuffer::dispatchIndirect(const Buffer<VkDispatchIndirectCommand>& commands,
+                                     uint32_t index) {
+  if (index >= commands.getNumElements()) {
+    LOG_F("Dispatching command {} of an indirect buffer holding {}",
+          index,
+          commands.getNumElements());
+  }
+
+  vkCmdDispatchIndirect(commandBuffer_, commands, index * sizeof(VkDispatchIndirectCommand));
+}
+
+void CommandBuffer::memoryBarrier(VkPipelineStageFlags srcStages,
+                                  VkAccessFlags srcAccess,
+                                  VkPipelineStageFlags dstStages,
+                                  VkAccessFlags dstAccess) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+
+  vkCmdPipelineBarrier(commandBuffer_,
+                       srcStages,
+                       dstStages,
+                       0,  // dependencyFlags
+                       1,
+                       &barrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+}
+
+void CommandBuffer::bufferBarrier(VkBuffer buffer,
+                                  VkPipelineStageFlags srcStages,
+                                  VkAccessFlags srcAccess,
+                                  VkPipelineStageFlags dstStages,
+                                  VkAccessFlags dstAccess) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(commandBuffer_,
+                       srcStages,
+                       dstStages,
+                       0,  // dependencyFlags
+                       0,
+                       nullptr,
+                       1,
+                       &barrier,
+                       0,
+                       nullptr);
+}
+
+void CommandBuffer::pipelineBarrier(VkPipelineStageFlags srcStages,
+                                    VkPipelineStageFlags dstStages,
+                                    VkAccessFlags srcAccess,
+                                    VkAccessFlags dstAccess,
+                                    const std::vector<VkImageMemoryBarrier>& imageBarriers) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  bool hasMemoryBarrier = srcAccess != 0 || dstAccess != 0;
+
+  vkCmdPipelineBarrier(commandBuffer_,
+                       srcStages,
+                       dstStages,
+                       0,  // dependencyFlags
+                       hasMemoryBarrier ? 1 : 0,
+                       hasMemoryBarrier ? &barrier : nullptr,
+                       0,
+                       nullptr,
+                       static_cast<uint32_t>(imageBarriers.size()),
+                       imageBarriers.data());
+}
+
+void CommandBuffer::imageBarrier(Image& image,
+                                 VkImageLayout newLayout,
+                                 VkPipelineStageFlags srcStages,
+                                 VkAccessFlags srcAccess,
+                                 VkPipelineStageFlags dstStages,
+                                 VkAccessFlags dstAccess,
+                                 uint32_t baseMipLevel,
+                                 uint32_t mipLevelCount) {
+  uint32_t endMipLevel = getEndMipLevel(image, baseMipLevel, mipLevelCount);
+
+  // One barrier per run of levels that are in the same layout
+  std::vector<VkImageMemoryBarrier> barriers;
+  for (uint32_t level = baseMipLevel; level < endMipLevel;) {
+    uint32_t runEnd = level + 1;
+    while (runEnd < endMipLevel && image.layouts_[runEnd] == image.layouts_[level]) {
+      runEnd++;
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = image.layouts_[level];
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = image.getAspect();
+    barrier.subresourceRange.baseMipLevel = level;
+    barrier.subresourceRange.levelCount = runEnd - level;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = image.getArrayLayers();
+    barriers.push_back(barrier);
+
+    level = runEnd;
+  }
+
+  vkCmdPipelineBarrier(commandBuffer_,
+                       srcStages,
+                       dstStages,
+                       0,  // dependencyFlags
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+
+  std::fill(image.layouts_.begin() + baseMipLevel, image.layouts_.begin() + endMipLevel, newLayout);
+}
+
+void CommandBuffer::transitionImageLayout(Image& image,
+                                          VkImageLayout newLayout,
+                                          uint32_t baseMipLevel,
+                                          uint32_t mipLevelCount) {
+  if (newLayout == VK_IMAGE_LAYOUT_UNDEFINED || newLayout == VK_IMAGE_LAYOUT_PREINITIALIZED) {
+    LOG_F("Images can't be transitioned to layout {}", static_cast<int>(newLayout));
+  }
+
+  // Rejects the same ranges imageBarrier() does, before they are used below
+  uint32_t endMipLevel = getEndMipLevel(image, baseMipLevel, mipLevelCount);
+
+  // Wait for whatever any of the levels may be used for
+  ImageLayoutUsage src{0, 0};
+  for (uint32_t level = baseMipLevel; level < endMipLevel; level++) {
+    ImageLayoutUsage usage = getImageLayoutUsage(image.getLayout(level));
+    src.stages |= usage.stages;
+    src.access |= usage.access;
+  }
+
+  ImageLayoutUsage dst = getImageLayoutUsage(newLayout);
+  imageBarrier(image,
+               newLayout,
+               src.stages,
+               src.access,
+               dst.stages,
+               dst.access,
+               baseMipLevel,
+               mipLevelCount);
+}
+
+void CommandBuffer::copyBufferToImage(VkBuffer src,
+                                      const Image& dst,
+                                      uint32_t mipLevel,
+                                      VkDeviceSize srcOffset) {
+  if (mipLevel >= dst.getMipLevels()) {
+    LOG_F("Copying to mip level {} of an image with {}", mipLevel, dst.getMipLevels());
+  }
+
+  VkImageLayout layout = dst.getLayout(mipLevel);
+  if (layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && layout != VK_IMAGE_LAYOUT_GENERAL) {
+    LOG_F("Copying to an image in layout {}", static_cast<int>(layout));
+  }
+
+  VkExtent2D extent = dst.getMipExtent(mipLevel);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = srcOffset;
+  region.bufferRowLength = 0;    // Tightly packed
+  region.bufferImageHeight = 0;  // Tightly packed
+  region.imageSubresource.aspectMask = (dst.getAspect() & VK_IMAGE_ASPECT_DEPTH_BIT)
+                                           ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                           : dst.getAspect();
+  region.imageSubresource.mipLevel = mipLevel;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = dst.getArrayLayers();
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {extent.width, extent.height, 1};
+
+  vkCmdCopyBufferToImage(commandBuffer_, src, dst, layout, 1 /* num regions */, &region);
+}
+
+void CommandBuffer::blitImage(const Image& src,
+                              uint32_t srcMipLevel,
+                              const Image& dst,
+                              uint32_t dstMipLevel,
+                              VkFilter filter) {
+  if (srcMipLevel >= src.getMipLevels() || dstMipLevel >= dst.getMipLevels()) {
+    LOG_F("Blitting from mip level {} of {} to level {} of {}",
+          srcMipLevel,
+          src.getMipLevels(),
+          dstMipLevel,
+          dst.getMipLevels());
+  }
+
+  VkExtent2D srcExtent = src.getMipExtent(srcMipLevel);
+  VkExtent2D dstExtent = dst.getMipExtent(dstMipLevel);
+
+  VkImageBlit blit{};
+  blit.srcSubresource.aspectMask = src.getAspect();
+  blit.srcSubresource.mipLevel = srcMipLevel;
+  blit.srcSubresource.baseArrayLayer = 0;
+  blit.srcSubresource.layerCount = src.getArrayLayers();
+  blit.srcOffsets[1] = {int32_t(srcExtent.width), int32_t(srcExtent.height), 1};
+  blit.dstSubresource.aspectMask = dst.getAspect();
+  blit.dstSubresource.mipLevel = dstMipLevel;
+  blit.dstSubresource.baseArrayLayer = 0;
+  blit.dstSubresource.layerCount = dst.getArrayLayers();
+  blit.dstOffsets[1] = {int32_t(dstExtent.width), int32_t(dstExtent.height), 1};
+
+  vkCmdBlitImage(commandBuffer_,
+                 src,
+                 src.getLayout(srcMipLevel),
+                 dst,
+                 dst.getLayout(dstMipLevel),
+                 1 /* num regions */,
+                 &blit,
+                 filter);
+}
+
+void CommandBuffer::clearColorImage(const Image& image, const VkClearColorValue& color) {
+  VkImageLayout layout = image.getLayout(0);
+  for (uint32_t level = 0; level < image.getMipLevels(); level++) {
+    if (image.getLayout(level) != layout ||
+        (layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && layout != VK_IMAGE_LAYOUT_GENERAL)) {
+      LOG_F("Clearing an image in layout {}", static_cast<int>(image.getLayout(level)));
+    }
+  }
+
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = VK_REMAINING_MIP_LEVELS;
+  range.baseArrayLayer = 0;
+  range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+  vkCmdClearColorImage(commandBuffer_, image, layout, &color, 1 /* num ranges */, &range);
+}
+
+void CommandBuffer::submitAndWait(std::mutex* queueMutex) {
+  Fence fence(device_, false /* initially signalled */);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer_;
+
+  {
+    // vkQueueSubmit requires external synchronization on the queue
+    std::unique_lock<std::mutex> lock;
+    if (queueMutex) {
+      lock = std::unique_lock<std::mutex>(*queueMutex);
+    }
+
+    if (vkQueueSubmit(parent_.getQueue().getQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
+      LOG_F("failed to submit command buffer!");
+    }
+  }
+
+  fence.wait();
+}
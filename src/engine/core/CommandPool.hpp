@@ -3,9 +3,12 @@
 #include <vulkan/vulkan.h>
 
 #include <engine/core/Buffer.hpp>
+#include <engine/core/ComputePipeline.hpp>
 #include <engine/core/Device.hpp>
 #include <engine/core/GraphicsPipeline.hpp>
+#include <engine/core/Image.hpp>
 #include <engine/core/RenderPass.hpp>
+#include <mutex>
 #include <typeinfo>
 
 class CommandBuffer;
@@ -45,6 +48,8 @@ class CommandBuffer {
   CommandBuffer(CommandBuffer&& other);
   ~CommandBuffer();
 
+  const LogicalDevice& getDevice() const { return device_; }
+
   // TODO: maybe express the lifetime of the recording using a special "recording" object that
   // ends the recording when the object goes out of scope?
   void begin(VkCommandBufferUsageFlags flags = 0);
@@ -53,11 +58,166 @@ class CommandBuffer {
   void beginRenderPass(const RenderPass& renderPass, const Framebuffer& framebuffer);
   void endRenderPass();
 
+  // Move on to the next subpass of the render pass, e.g. from a depth pre-pass to shading
+  void nextSubpass();
+
   template <class InputType>
   void bindPipeline(const GraphicsPipeline<InputType>& pipeline) {
     vkCmdBindPipeline(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
   }
 
+  /**
+   * @brief Bind `descriptorSets` to consecutive set numbers of a pipeline, starting at `firstSet`.
+   * `dynamicOffsets` holds one offset per dynamic buffer binding of the sets, in set then binding
+   * order (e.g. UniformRing allocations).
+   */
+  template <class InputType>
+  void bindDescriptorSets(const GraphicsPipeline<InputType>& pipeline,
+                          const std::vector<VkDescriptorSet>& descriptorSets,
+                          uint32_t firstSet = 0,
+                          const std::vector<uint32_t>& dynamicOffsets = {}) {
+    vkCmdBindDescriptorSets(commandBuffer_,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline.getLayout(),
+                            firstSet,
+                            static_cast<uint32_t>(descriptorSets.size()),
+                            descriptorSets.data(),
+                            static_cast<uint32_t>(dynamicOffsets.size()),
+                            dynamicOffsets.data());
+  }
+
+  /**
+   * @brief Push `value` into the range described by `Range` (a PushConstants<T, Stages, Offset>),
+   * which the pipeline must have been created with. The stages are checked against the kind of
+   * pipeline at compile time, and against its declared ranges when recording.
+   */
+  template <class Range, class InputType>
+  void pushConstants(const GraphicsPipeline<InputType>& pipeline,
+                     const typename Range::Type& value) {
+    static_assert(!Range::isCompute, "Compute push constants pushed to a graphics pipeline");
+    pushConstantBytes(pipeline.getLayout(),
+                      pipeline.getPushConstantRanges(),
+                      Range::stages,
+                      Range::offset,
+                      Range::size,
+                      &value);
+  }
+
+  void bindPipeline(const ComputePipeline& pipeline) {
+    vkCmdBindPipeline(commandBuffer_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  }
+
+  void bindDescriptorSets(const ComputePipeline& pipeline,
+                          const std::vector<VkDescriptorSet>& descriptorSets,
+                          uint32_t firstSet = 0,
+                          const std::vector<uint32_t>& dynamicOffsets = {});
+
+  template <class Range>
+  void pushConstants(const ComputePipeline& pipeline, const typename Range::Type& value) {
+    static_assert(Range::isCompute, "Graphics push constants pushed to a compute pipeline");
+    pushConstantBytes(pipeline.getLayout(),
+                      pipeline.getPushConstantRanges(),
+                      Range::stages,
+                      Range::offset,
+                      Range::size,
+                      &value);
+  }
+
+  void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) {
+    vkCmdDispatch(commandBuffer_, groupCountX, groupCountY, groupCountZ);
+  }
+
+  /**
+   * @brief Dispatch with the group counts read on the GPU from element `index` of `commands`,
+   * e.g. as many groups as a previous pass produced work items. The buffer needs
+   * VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, and a barrier to VK_ACCESS_INDIRECT_COMMAND_READ_BIT if a
+   * shader wrote it.
+   */
+  void dispatchIndirect(const Buffer<VkDispatchIndirectCommand>& commands, uint32_t index = 0);
+
+  /**
+   * @brief Make writes done by `srcStages` through `srcAccess` visible to `dstAccess` in
+   * `dstStages`, for every resource. E.g. a compute shader writing indirect draws:
+   *
+   *   memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+   *                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+   */
+  void memoryBarrier(VkPipelineStageFlags srcStages,
+                     VkAccessFlags srcAccess,
+                     VkPipelineStageFlags dstStages,
+                     VkAccessFlags dstAccess);
+
+  // memoryBarrier() limited to the whole of one buffer
+  void bufferBarrier(VkBuffer buffer,
+                     VkPipelineStageFlags srcStages,
+                     VkAccessFlags srcAccess,
+                     VkPipelineStageFlags dstStages,
+                     VkAccessFlags dstAccess);
+
+  /**
+   * @brief One vkCmdPipelineBarrier holding a memory barrier (left out when both access masks are
+   * 0) and `imageBarriers`, e.g. everything a RenderGraph pass waits for. The layouts the images
+   * are tracked in aren't updated.
+   */
+  void pipelineBarrier(VkPipelineStageFlags srcStages,
+                       VkPipelineStageFlags dstStages,
+                       VkAccessFlags srcAccess,
+                       VkAccessFlags dstAccess,
+                       const std::vector<VkImageMemoryBarrier>& imageBarriers = {});
+
+  /**
+   * @brief Move mip levels [baseMipLevel, baseMipLevel + mipLevelCount) of `image`, every layer,
+   * from the layouts they are tracked in to `newLayout`, once the work done through `srcAccess` in
+   * `srcStages` is finished, and before `dstStages` access them through `dstAccess`.
+   */
+  void imageBarrier(Image& image,
+                    VkImageLayout newLayout,
+                    VkPipelineStageFlags srcStages,
+                    VkAccessFlags srcAccess,
+                    VkPipelineStageFlags dstStages,
+                    VkAccessFlags dstAccess,
+                    uint32_t baseMipLevel = 0,
+                    uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS);
+
+  // imageBarrier() with the stages and accesses implied by the old and new layouts, see
+  // getImageLayoutUsage()
+  void transitionImageLayout(Image& image,
+                             VkImageLayout newLayout,
+                             uint32_t baseMipLevel = 0,
+                             uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS);
+
+  /**
+   * @brief Copy tightly packed texels from `src`, starting at byte `srcOffset`, into mip level
+   * `mipLevel` of every layer of `dst`. That level must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+   * (or GENERAL). Only the depth of depth/stencil images is copied.
+   */
+  void copyBufferToImage(VkBuffer src,
+                         const Image& dst,
+                         uint32_t mipLevel = 0,
+                         VkDeviceSize srcOffset = 0);
+
+  /**
+   * @brief Scale the whole of mip level `srcMipLevel` of `src` onto the whole of `dstMipLevel` of
+   * `dst`, every layer, filtering with `filter`. The levels must be in TRANSFER_SRC_OPTIMAL and
+   * TRANSFER_DST_OPTIMAL, and the queue must support graphics.
+   */
+  void blitImage(const Image& src,
+                 uint32_t srcMipLevel,
+                 const Image& dst,
+                 uint32_t dstMipLevel,
+                 VkFilter filter = VK_FILTER_LINEAR);
+
+  // Set every texel of every mip level and layer of color image `image` to `color`. Every level
+  // must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL or GENERAL
+  void clearColorImage(const Image& image, const VkClearColorValue& color);
+
+  // Set every 32-bit word of the buffer to `value`. Needs VK_BUFFER_USAGE_TRANSFER_DST_BIT, and
+  // runs in the transfer stage
+  template <class InputType>
+  void fillBuffer(const Buffer<InputType>& buffer, uint32_t value = 0) {
+    vkCmdFillBuffer(commandBuffer_, buffer, 0 /* offset */, VK_WHOLE_SIZE, value);
+  }
+
   template <class InputType>
   void bindVertexBuffers(const Buffer<InputType>& buffer) {
     // TODO: figure out how to validate that the currently bound pipeline is compatible with this
@@ -71,13 +231,22 @@ class CommandBuffer {
                            offsets);
   }
 
+  // Bind a vertex buffer to a specific binding, e.g. an InstanceBuffer to binding 1
+  template <class InputType>
+  void bindVertexBuffer(uint32_t binding, const Buffer<InputType>& buffer) {
+    VkBuffer vertexBuffers[] = {buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer_, binding, 1 /* num buffers */, vertexBuffers, offsets);
+  }
+
+  // Index type is deduced from the element type: uint8_t, uint16_t or uint32_t
   template <class InputType>
-  void bindIndexBuffer(const Buffer<InputType>& buffer);
+  void bindIndexBuffer(const Buffer<InputType>& buffer) {
+    vkCmdBindIndexBuffer(commandBuffer_, buffer, 0 /* offset */, IndexTypeOf<InputType>::value);
+  }
 
-  // Template specialization for UINT16 index buffers
-  template <>
-  void bindIndexBuffer<uint16_t>(const Buffer<uint16_t>& buffer) {
-    vkCmdBindIndexBuffer(commandBuffer_, buffer, 0 /* offset */, VK_INDEX_TYPE_UINT16);
+  void bindIndexBuffer(const IndexBuffer& buffer) {
+    vkCmdBindIndexBuffer(commandBuffer_, buffer, 0 /* offset */, buffer.getIndexType());
   }
 
   void draw(uint32_t vertexCount,
@@ -91,6 +260,26 @@ class CommandBuffer {
                    uint32_t indexValueOffset,
                    uint32_t instanceOffset);
 
+  /**
+   * @brief Draw `drawCount` commands from `commands`, starting at command `firstDraw`, with the
+   * vertex and index buffers currently bound.
+   *
+   * Issued as a single call when multiDrawIndirect is enabled, otherwise as one call per command.
+   * Commands with a non-zero firstInstance need drawIndirectFirstInstance.
+   */
+  void drawIndexedIndirect(const Buffer<VkDrawIndexedIndirectCommand>& commands,
+                           uint32_t drawCount,
+                           uint32_t firstDraw = 0);
+
+  /**
+   * @brief Like drawIndexedIndirect(), but the draw count is read on the GPU from the first
+   * element of `count`, clamped to `maxDrawCount`. Lets the CPU or a compute shader change the
+   * number of draws without re-recording. Calls LOG_F unless drawIndirectCount is enabled.
+   */
+  void drawIndexedIndirectCount(const Buffer<VkDrawIndexedIndirectCommand>& commands,
+                                const Buffer<uint32_t>& count,
+                                uint32_t maxDrawCount);
+
   template <class InputType>
   void copyBuffer(const Buffer<InputType>& src, const Buffer<InputType>& dst) {
     if (src.getBufferSize() != dst.getBufferSize()) {
@@ -105,6 +294,16 @@ class CommandBuffer {
     vkCmdCopyBuffer(commandBuffer_, src, dst, 1 /* num copy regions */, &copyRegion);
   }
 
+  /**
+   * @brief Submit this command buffer to the queue of the pool it was allocated from, and block
+   * until the GPU has finished executing it. Only this submission is waited on (via a fence), not
+   * the whole queue.
+   *
+   * @param queueMutex optional mutex serializing access to the queue, for when several threads
+   * submit to the same VkQueue
+   */
+  void submitAndWait(std::mutex* queueMutex = nullptr);
+
   operator VkCommandBuffer() const { return commandBuffer_; }
 
  protected:
@@ -113,6 +312,13 @@ class CommandBuffer {
                 VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
  private:
+  void pushConstantBytes(VkPipelineLayout layout,
+                         const std::vector<VkPushConstantRange>& ranges,
+                         VkShaderStageFlags stages,
+                         uint32_t offset,
+                         uint32_t size,
+                         const void* data);
+
   VkCommandBuffer commandBuffer_;
   const CommandPool& parent_;
   const LogicalDevice& device_;
@@ -0,0 +1,53 @@
+#include "ComputePipeline.hpp"
+
+#include <fmtlog/Log.hpp>
+
+ComputePipeline::ComputePipeline(const LogicalDevice& device,
+                                 ShaderModule& computeShader,
+                                 const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                 const std::vector<VkPushConstantRange>& pushConstantRanges,
+                                 const PipelineCache* pipelineCache)
+    : device_(device),
+      pushConstantRanges_(pushConstantRanges),
+      key_(computeShader.getKey()) {
+  validatePushConstantRanges(device_, pushConstantRanges_);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges_.size());
+  pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges_.data();
+
+  if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipelineLayout_) !=
+      VK_SUCCESS) {
+    LOG_F("failed to create compute pipeline layout!");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = computeShader;
+  pipelineInfo.stage.pName = computeShader.entryPointName();
+  pipelineInfo.stage.pSpecializationInfo = computeShader.getSpecializationInfo();
+  pipelineInfo.layout = pipelineLayout_;
+
+  // Allows for deriving a new pipeline from an old pipeline
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;  // Optional
+  pipelineInfo.basePipelineIndex = -1;               // Optional
+
+  if (vkCreateComputePipelines(device_,
+                               pipelineCache ? VkPipelineCache(*pipelineCache) : VK_NULL_HANDLE,
+                               1,
+                               &pipelineInfo,
+                               nullptr,
+                               &computePipeline_) != VK_SUCCESS) {
+    LOG_F("failed to create compute pipeline!");
+  }
+}
+
+ComputePipeline::~ComputePipeline() {
+  vkDestroyPipeline(device_, computePipeline_, nullptr);
+  vkDestroyPipelineLayout(device_, pipelineLayout_, nullptr);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Device.hpp>
+#include <engine/core/PipelineCache.hpp>
+#include <engine/core/PushConstants.hpp>
+#include <engine/core/ShaderModule.hpp>
+#include <vector>
+
+/**
+ * @brief A compute shader and the layout of the resources it uses. The counterpart of
+ * GraphicsPipeline for work dispatched with CommandBuffer::dispatch().
+ *
+ * The shader's specialization constants (see ShaderModule::specialize()) are applied at creation.
+ * Pass a PipelineCache to skip compiling shaders the driver has seen before.
+ *
+ *   ComputePipeline pipeline(device, shader, {setLayout}, {}, &pipelineCache);
+ *   commandBuffer.bindPipeline(pipeline);
+ *   commandBuffer.bindDescriptorSets(pipeline, {descriptorSet});
+ *   commandBuffer.dispatch(ComputePipeline::getGroupCount(itemCount, GROUP_SIZE));
+ *   commandBuffer.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+ *                               VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+ */
+class ComputePipeline {
+ public:
+  ComputePipeline() = delete;
+  ComputePipeline(ComputePipeline& other) = delete;
+
+  ComputePipeline(const LogicalDevice& device,
+                  ShaderModule& computeShader,
+                  const std::vector<VkDescriptorSetLayout>& setLayouts = {},
+                  const std::vector<VkPushConstantRange>& pushConstantRanges = {},
+                  const PipelineCache* pipelineCache = nullptr);
+
+  ~ComputePipeline();
+
+  operator VkPipeline() const { return computePipeline_; }
+
+  VkPipelineLayout getLayout() const { return pipelineLayout_; }
+
+  const std::vector<VkPushConstantRange>& getPushConstantRanges() const {
+    return pushConstantRanges_;
+  }
+
+  // Identifies the shader permutation this pipeline was built from
+  size_t getKey() const { return key_; }
+
+  // Work groups needed to cover `invocationCount` invocations, `groupSize` per group
+  static uint32_t getGroupCount(size_t invocationCount, uint32_t groupSize) {
+    return static_cast<uint32_t>((invocationCount + groupSize - 1) / groupSize);
+  }
+
+ private:
+  const LogicalDevice& device_;
+  std::vector<VkPushConstantRange> pushConstantRanges_;
+
+  VkPipelineLayout pipelineLayout_;
+  VkPipeline computePipeline_;
+  size_t key_;
+};
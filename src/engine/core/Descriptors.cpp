@@ -0,0 +1,296 @@
+#include "Descriptors.hpp"
+
+#include <algorithm>
+#include <engine/utils/hash.hpp>
+#include <fmtlog/Log.hpp>
+#include <numeric>
+
+DescriptorSetLayoutCache::DescriptorSetLayoutCache(const LogicalDevice& device) : device_(device) {}
+
+DescriptorSetLayoutCache::~DescriptorSetLayoutCache() {
+  for (const auto& [info, layout] : layouts_) {
+    vkDestroyDescriptorSetLayout(device_, layout, nullptr);
+  }
+}
+
+VkDescriptorSetLayout DescriptorSetLayoutCache::get(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    VkDescriptorSetLayoutCreateFlags flags,
+    const std::vector<VkDescriptorBindingFlags>& bindingFlags) {
+  if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+    LOG_F("Got {} binding flags for {} bindings", bindingFlags.size(), bindings.size());
+  }
+
+  // Sort the bindings (and their flags along with them) so that the order they're listed in
+  // doesn't create duplicate layouts
+  std::vector<size_t> order(bindings.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&bindings](size_t a, size_t b) {
+    return bindings[a].binding < bindings[b].binding;
+  });
+
+  LayoutInfo info;
+  info.flags = flags;
+  for (size_t i : order) {
+    if (bindings[i].pImmutableSamplers) {
+      LOG_F("Binding {} uses immutable samplers, which the layout cache doesn't support",
+            bindings[i].binding);
+    }
+
+    info.bindings.push_back(bindings[i]);
+    if (!bindingFlags.empty()) {
+      info.bindingFlags.push_back(bindingFlags[i]);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto found = layouts_.find(info);
+  if (found != layouts_.end()) {
+    return found->second;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+  flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.bindingCount = static_cast<uint32_t>(info.bindingFlags.size());
+  flagsInfo.pBindingFlags = info.bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = info.bindingFlags.empty() ? nullptr : &flagsInfo;
+  layoutInfo.flags = flags;
+  layoutInfo.bindingCount = static_cast<uint32_t>(info.bindings.size());
+  layoutInfo.pBindings = info.bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+    LOG_F("failed to create descriptor set layout!");
+  }
+
+  layouts_.emplace(std::move(info), layout);
+  return layout;
+}
+
+size_t DescriptorSetLayoutCache::getLayoutCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return layouts_.size();
+}
+
+bool DescriptorSetLayoutCache::LayoutInfo::operator==(const LayoutInfo& other) const {
+  if (flags != other.flags || bindings.size() != other.bindings.size() ||
+      bindingFlags != other.bindingFlags) {
+    return false;
+  }
+
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const VkDescriptorSetLayoutBinding& a = bindings[i];
+    const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+    if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+        a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t DescriptorSetLayoutCache::LayoutInfoHash::operator()(const LayoutInfo& info) const {
+  size_t hash = std::hash<uint32_t>{}(info.flags);
+  for (const auto& binding : info.bindings) {
+    hashCombine(hash, binding.binding);
+    hashCombine(hash, static_cast<uint32_t>(binding.descriptorType));
+    hashCombine(hash, binding.descriptorCount);
+    hashCombine(hash, binding.stageFlags);
+  }
+  for (VkDescriptorBindingFlags flags : info.bindingFlags) {
+    hashCombine(hash, flags);
+  }
+  return hash;
+}
+
+DescriptorAllocator::DescriptorAllocator(const LogicalDevice& device,
+                                         uint32_t setsPerPool,
+                                         const std::vector<PoolRatio>& poolRatios,
+                                         VkDescriptorPoolCreateFlags poolFlags)
+    : device_(device),
+      setsPerPool_(setsPerPool),
+      poolRatios_(poolRatios),
+      poolFlags_(poolFlags) {}
+
+DescriptorAllocator::~DescriptorAllocator() {
+  if (currentPool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device_, currentPool_, nullptr);
+  }
+  for (VkDescriptorPool pool : usedPools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+  for (VkDescriptorPool pool : freePools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  if (currentPool_ == VK_NULL_HANDLE) {
+    currentPool_ = grabPool();
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = currentPool_;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet set;
+  VkResult result = vkAllocateDescriptorSets(device_, &allocInfo, &set);
+  if (result == VK_SUCCESS) {
+    return set;
+  }
+
+  if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+    LOG_F("failed to allocate descriptor set!");
+  }
+
+  // The current pool is full: retire it and try once more with an empty one
+  usedPools_.push_back(currentPool_);
+  currentPool_ = grabPool();
+  allocInfo.descriptorPool = currentPool_;
+
+  if (vkAllocateDescriptorSets(device_, &allocInfo, &set) != VK_SUCCESS) {
+    LOG_F("Descriptor set layout doesn't fit in an empty pool of {} sets; raise the pool ratios",
+          setsPerPool_);
+  }
+
+  return set;
+}
+
+void DescriptorAllocator::reset() {
+  if (currentPool_ != VK_NULL_HANDLE) {
+    usedPools_.push_back(currentPool_);
+    currentPool_ = VK_NULL_HANDLE;
+  }
+
+  for (VkDescriptorPool pool : usedPools_) {
+    vkResetDescriptorPool(device_, pool, 0);
+    freePools_.push_back(pool);
+  }
+  usedPools_.clear();
+}
+
+const std::vector<DescriptorAllocator::PoolRatio>& DescriptorAllocator::getDefaultPoolRatios() {
+  static const std::vector<PoolRatio> ratios = {
+      {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+      {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f},
+  };
+  return ratios;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool() {
+  std::vector<VkDescriptorPoolSize> sizes;
+  for (const auto& ratio : poolRatios_) {
+    sizes.push_back(
+        {ratio.type, std::max(1u, static_cast<uint32_t>(ratio.descriptorsPerSet * setsPerPool_))});
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = poolFlags_;
+  poolInfo.maxSets = setsPerPool_;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+  poolInfo.pPoolSizes = sizes.data();
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+    LOG_F("failed to create descriptor pool!");
+  }
+
+  return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool() {
+  if (freePools_.empty()) {
+    return createPool();
+  }
+
+  VkDescriptorPool pool = freePools_.back();
+  freePools_.pop_back();
+  return pool;
+}
+
+DescriptorWriter& DescriptorWriter::writeBuffer(VkDescriptorSet set,
+                                                uint32_t binding,
+                                                VkDescriptorType type,
+                                                VkBuffer buffer,
+                                                VkDeviceSize offset,
+                                                VkDeviceSize range,
+                                                uint32_t arrayElement) {
+  bufferInfos_.push_back({buffer, offset, range});
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = binding;
+  write.dstArrayElement = arrayElement;
+  write.descriptorCount = 1;
+  write.descriptorType = type;
+
+  writes_.push_back({write, false, bufferInfos_.size() - 1});
+  return *this;
+}
+
+DescriptorWriter& DescriptorWriter::writeImage(VkDescriptorSet set,
+                                               uint32_t binding,
+                                               VkDescriptorType type,
+                                               VkImageView imageView,
+                                               VkSampler sampler,
+                                               VkImageLayout layout,
+                                               uint32_t arrayElement) {
+  imageInfos_.push_back({sampler, imageView, layout});
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = binding;
+  write.dstArrayElement = arrayElement;
+  write.descriptorCount = 1;
+  write.descriptorType = type;
+
+  writes_.push_back({write, true, imageInfos_.size() - 1});
+  return *this;
+}
+
+void DescriptorWriter::update() {
+  if (writes_.empty()) {
+    return;
+  }
+
+  vkWrites_.clear();
+  for (PendingWrite& pending : writes_) {
+    if (pending.isImage) {
+      pending.write.pImageInfo = &imageInfos_[pending.infoIndex];
+    } else {
+      pending.write.pBufferInfo = &bufferInfos_[pending.infoIndex];
+    }
+    vkWrites_.push_back(pending.write);
+  }
+
+  vkUpdateDescriptorSets(device_,
+                         static_cast<uint32_t>(vkWrites_.size()),
+                         vkWrites_.data(),
+                         0,  // descriptorCopyCount
+                         nullptr);
+
+  clear();
+}
+
+void DescriptorWriter::clear() {
+  writes_.clear();
+  bufferInfos_.clear();
+  imageInfos_.clear();
+}
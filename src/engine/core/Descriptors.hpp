@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Device.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Creates each distinct descriptor set layout once. Layouts are looked up by their binding
+ * description, so every pipeline asking for "a uniform buffer at 0 and a sampled image at 1" gets
+ * the same VkDescriptorSetLayout, and sets allocated for one are compatible with all of them.
+ *
+ * Layouts live as long as the cache; thread safe.
+ */
+class DescriptorSetLayoutCache {
+ public:
+  DescriptorSetLayoutCache() = delete;
+  DescriptorSetLayoutCache(DescriptorSetLayoutCache& other) = delete;
+
+  DescriptorSetLayoutCache(const LogicalDevice& device);
+
+  ~DescriptorSetLayoutCache();
+
+  /**
+   * @brief The layout for `bindings`, created on first use. Binding order doesn't matter.
+   * Immutable samplers aren't supported.
+   *
+   * @param bindingFlags optional VkDescriptorBindingFlags per binding, in the same order
+   */
+  VkDescriptorSetLayout get(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                            VkDescriptorSetLayoutCreateFlags flags = 0,
+                            const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
+
+  size_t getLayoutCount() const;
+
+ private:
+  struct LayoutInfo {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;  // Sorted by binding
+    std::vector<VkDescriptorBindingFlags> bindingFlags;  // Empty, or one per binding
+    VkDescriptorSetLayoutCreateFlags flags;
+
+    bool operator==(const LayoutInfo& other) const;
+  };
+
+  struct LayoutInfoHash {
+    size_t operator()(const LayoutInfo& info) const;
+  };
+
+  const LogicalDevice& device_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutInfoHash> layouts_;
+};
+
+/**
+ * @brief Allocates descriptor sets from a growing list of pools, so callers never size pools by
+ * hand. When a pool runs out, the next one is taken, reusing an exhausted pool that has since been
+ * reset before creating a new one.
+ *
+ * Meant to be used once per frame in flight: allocate the frame's sets while recording, and
+ * reset() once the GPU is done with the frame. Resetting whole pools is much cheaper than freeing
+ * sets one by one, and keeps allocation to a few pointer bumps in the driver. Allocators that are
+ * never reset suit long-lived sets.
+ *
+ *   VkDescriptorSet set = frameDescriptors.allocate(layout);
+ *   writer.writeBuffer(set, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms);
+ *   writer.update();
+ *   ...
+ *   frameDescriptors.reset();  // Once the frame's fence has signalled
+ *
+ * Not thread safe: use one allocator per thread.
+ */
+class DescriptorAllocator {
+ public:
+  // Descriptors of one type per pool, relative to the number of sets in the pool
+  struct PoolRatio {
+    VkDescriptorType type;
+    float descriptorsPerSet;
+  };
+
+  DescriptorAllocator() = delete;
+  DescriptorAllocator(DescriptorAllocator& other) = delete;
+
+  /**
+   * @param setsPerPool the sets each pool holds
+   * @param poolRatios descriptors of each type per pool; defaults to a mix of buffers and images
+   * @param poolFlags e.g. VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+   */
+  DescriptorAllocator(const LogicalDevice& device,
+                      uint32_t setsPerPool = 256,
+                      const std::vector<PoolRatio>& poolRatios = getDefaultPoolRatios(),
+                      VkDescriptorPoolCreateFlags poolFlags = 0);
+
+  ~DescriptorAllocator();
+
+  // Calls LOG_F if even an empty pool can't hold a set with this layout
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+  // Free every set allocated so far. Only call once the GPU no longer uses any of them
+  void reset();
+
+  // Pools created so far, in use or not
+  size_t getPoolCount() const {
+    return usedPools_.size() + freePools_.size() + (currentPool_ != VK_NULL_HANDLE ? 1 : 0);
+  }
+
+  static const std::vector<PoolRatio>& getDefaultPoolRatios();
+
+ private:
+  VkDescriptorPool createPool();
+  VkDescriptorPool grabPool();
+
+  const LogicalDevice& device_;
+  uint32_t setsPerPool_;
+  std::vector<PoolRatio> poolRatios_;
+  VkDescriptorPoolCreateFlags poolFlags_;
+
+  // Created on the first allocate()
+  VkDescriptorPool currentPool_ = VK_NULL_HANDLE;
+
+  std::vector<VkDescriptorPool> usedPools_;  // Full, or at least not current
+  std::vector<VkDescriptorPool> freePools_;  // Reset and ready for reuse
+};
+
+/**
+ * @brief Collects descriptor writes and applies them all with a single vkUpdateDescriptorSets().
+ * The buffers and images written only need to exist until update().
+ *
+ *   DescriptorWriter writer(device);
+ *   writer.writeBuffer(set, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instances);
+ *   writer.writeImage(set, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler);
+ *   writer.update();
+ */
+class DescriptorWriter {
+ public:
+  DescriptorWriter() = delete;
+  DescriptorWriter(DescriptorWriter& other) = delete;
+
+  DescriptorWriter(const LogicalDevice& device) : device_(device) {}
+
+  DescriptorWriter& writeBuffer(VkDescriptorSet set,
+                                uint32_t binding,
+                                VkDescriptorType type,
+                                VkBuffer buffer,
+                                VkDeviceSize offset = 0,
+                                VkDeviceSize range = VK_WHOLE_SIZE,
+                                uint32_t arrayElement = 0);
+
+  DescriptorWriter& writeImage(VkDescriptorSet set,
+                               uint32_t binding,
+                               VkDescriptorType type,
+                               VkImageView imageView,
+                               VkSampler sampler = VK_NULL_HANDLE,
+                               VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               uint32_t arrayElement = 0);
+
+  size_t getPendingCount() const { return writes_.size(); }
+
+  // Apply every pending write, and start over
+  void update();
+
+  // Drop every pending write
+  void clear();
+
+ private:
+  const LogicalDevice& device_;
+
+  // The info pointers of the writes are filled in by update(), since the info vectors may still
+  // grow until then
+  struct PendingWrite {
+    VkWriteDescriptorSet write;
+    bool isImage;
+    size_t infoIndex;
+  };
+
+  std::vector<PendingWrite> writes_;
+  std::vector<VkDescriptorBufferInfo> bufferInfos_;
+  std::vector<VkDescriptorImageInfo> imageInfos_;
+  std::vector<VkWriteDescriptorSet> vkWrites_;
+};
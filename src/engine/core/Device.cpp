@@ -2,6 +2,8 @@
 
 #include <engine/utils/to_string.hpp>
 #include <fmtlog/Log.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <map>
 #include <set>
 
@@ -26,6 +28,51 @@ std::string getDeviceTypeString(VkPhysicalDeviceType type) {
   return "UNKNOWN";
 }
 
+// Every Vulkan feature structure is a (sType, pNext) header followed only by VkBool32 members
+template <class FeatureStruct>
+static void intersectFeatureStruct(FeatureStruct& requested, const FeatureStruct& supported) {
+  constexpr size_t firstFeature = offsetof(FeatureStruct, pNext) + sizeof(void*);
+  constexpr size_t featureCount = (sizeof(FeatureStruct) - firstFeature) / sizeof(VkBool32);
+
+  auto* dst = reinterpret_cast<VkBool32*>(reinterpret_cast<uint8_t*>(&requested) + firstFeature);
+  auto* src = reinterpret_cast<const VkBool32*>(reinterpret_cast<const uint8_t*>(&supported) +
+                                                firstFeature);
+
+  for (size_t i = 0; i < featureCount; i++) {
+    dst[i] = dst[i] && src[i];
+  }
+}
+
+VkPhysicalDeviceFeatures2& DeviceFeatures::link(uint32_t apiVersion,
+                                                const DeviceExtensions& extensions) {
+  void** next = &core.pNext;
+
+  auto append = [&next](auto& features) {
+    *next = &features;
+    next = &features.pNext;
+  };
+
+  if (apiVersion >= VK_API_VERSION_1_2) {
+    append(vulkan11);
+    append(vulkan12);
+  }
+
+  if (std::count(extensions.begin(), extensions.end(), VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME)) {
+    append(indexTypeUint8);
+  }
+
+  *next = nullptr;
+
+  return core;
+}
+
+void DeviceFeatures::intersect(const DeviceFeatures& supported) {
+  intersectFeatureStruct(core, supported.core);
+  intersectFeatureStruct(vulkan11, supported.vulkan11);
+  intersectFeatureStruct(vulkan12, supported.vulkan12);
+  intersectFeatureStruct(indexTypeUint8, supported.indexTypeUint8);
+}
+
 std::vector<PhysicalDevice> PhysicalDevice::getPhysicalDevices(
     Instance& instance,
     std::optional<VkSurfaceKHR> surface) {
@@ -185,6 +232,49 @@ VkPhysicalDeviceFeatures PhysicalDevice::getFeatures() const {
   return deviceFeatures;
 }
 
+DeviceFeatures PhysicalDevice::getSupportedFeatures() const {
+  // Structures that aren't linked into the query stay zeroed, i.e. unsupported
+  DeviceFeatures features;
+  uint32_t apiVersion = getProperties().apiVersion;
+
+  if (apiVersion >= VK_API_VERSION_1_1) {
+    vkGetPhysicalDeviceFeatures2(device_, &features.link(apiVersion, getDeviceExtensions()));
+  } else {
+    // vkGetPhysicalDeviceFeatures2 is core 1.1 and can't be used on older devices
+    vkGetPhysicalDeviceFeatures(device_, &features.core.features);
+  }
+
+  return features;
+}
+
+uint32_t PhysicalDevice::findMemoryType(uint32_t typeFilter,
+                                        VkMemoryPropertyFlags properties) const {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(device_, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  LOG_F("failed to find suitable memory type!");
+}
+
+bool PhysicalDevice::hasMemoryType(VkMemoryPropertyFlags properties) const {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(device_, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 std::vector<QueueFamily> PhysicalDevice::getQueueFamilies() const { return queueFamilies_; }
 
 bool PhysicalDevice::hasAllExtensions(const DeviceExtensions& extensions) const {
@@ -308,7 +398,9 @@ struct QueueRequestsForSingleFamily {
 LogicalDevice::LogicalDevice(Instance& instance,
                              PhysicalDevice&& physicalDevice,
                              const DeviceExtensions& requiredExtensions,
-                             QueueFamilyRequests& requests)
+                             QueueFamilyRequests& requests,
+                             const DeviceExtensions& optionalExtensions,
+                             const DeviceFeatures& requestedFeatures)
     : instance_(instance),
       physicalDevice_(std::move(physicalDevice)) {
   // Step 1: figure out how many different queue families were requested
@@ -370,17 +462,39 @@ LogicalDevice::LogicalDevice(Instance& instance,
   createInfo.queueCreateInfoCount = queueCreateInfos.size();
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-  // TODO: enable device features
-  VkPhysicalDeviceFeatures deviceFeatures{};
-  createInfo.pEnabledFeatures = &deviceFeatures;
-
   if (!physicalDevice_.hasAllExtensions(requiredExtensions)) {
     LOG_F("Physical device does not have all required extensions");
   }
 
-  std::vector<const char*> vkDeviceExtensions(requiredExtensions.size());
-  for (size_t i = 0; i < requiredExtensions.size(); i++) {
-    vkDeviceExtensions[i] = requiredExtensions[i].c_str();
+  // Optional extensions are enabled if the device has them
+  enabledExtensions_ = requiredExtensions;
+  DeviceExtensions availableExtensions = physicalDevice_.getDeviceExtensions();
+
+  for (const auto& extension : optionalExtensions) {
+    if (std::count(availableExtensions.begin(), availableExtensions.end(), extension)) {
+      enabledExtensions_.push_back(extension);
+    } else {
+      LOG_I("Optional device extension '{}' is not available", extension);
+    }
+  }
+
+  // Same for features: only the supported subset of the request is enabled
+  enabledFeatures_ = requestedFeatures;
+  enabledFeatures_.intersect(physicalDevice_.getSupportedFeatures());
+
+  uint32_t apiVersion = physicalDevice_.getProperties().apiVersion;
+
+  if (apiVersion >= VK_API_VERSION_1_1) {
+    // The features travel in the pNext chain, so pEnabledFeatures must stay null
+    createInfo.pNext = &enabledFeatures_.link(apiVersion, enabledExtensions_);
+    createInfo.pEnabledFeatures = nullptr;
+  } else {
+    createInfo.pEnabledFeatures = &enabledFeatures_.core.features;
+  }
+
+  std::vector<const char*> vkDeviceExtensions(enabledExtensions_.size());
+  for (size_t i = 0; i < enabledExtensions_.size(); i++) {
+    vkDeviceExtensions[i] = enabledExtensions_[i].c_str();
   }
 
   createInfo.enabledExtensionCount = vkDeviceExtensions.size();
@@ -441,9 +555,15 @@ LogicalDevice::LogicalDevice(Instance& instance,
   }
 }
 
+bool LogicalDevice::isExtensionEnabled(const std::string& extension) const {
+  return std::count(enabledExtensions_.begin(), enabledExtensions_.end(), extension) != 0;
+}
+
 LogicalDevice::LogicalDevice(LogicalDevice&& other)
     : instance_(other.instance_),
-      physicalDevice_(std::move(other.physicalDevice_)) {
+      physicalDevice_(std::move(other.physicalDevice_)),
+      enabledExtensions_(std::move(other.enabledExtensions_)),
+      enabledFeatures_(other.enabledFeatures_) {
   if (device_) {
     vkDestroyDevice(device_, nullptr);
   }
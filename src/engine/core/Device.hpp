@@ -42,6 +42,32 @@ using QueueFamilyRequests = std::vector<std::reference_wrapper<QueueFamilyReques
 
 using DeviceExtensions = std::vector<std::string>;
 
+/**
+ * @brief Device features beyond Vulkan 1.0, kept as one chain of feature structures. Used both to
+ * query what a PhysicalDevice supports and to request features when creating a LogicalDevice.
+ *
+ * Structures are only linked into the chain when the device's API version or enabled extensions
+ * allow them, so link() rebuilds the chain every time it is handed to Vulkan.
+ */
+struct DeviceFeatures {
+  VkPhysicalDeviceFeatures2 core{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  VkPhysicalDeviceVulkan11Features vulkan11{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+  VkPhysicalDeviceVulkan12Features vulkan12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+
+  // VK_EXT_index_type_uint8
+  VkPhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT};
+
+  /**
+   * @brief Link the structures usable with a device of `apiVersion` with `extensions` enabled
+   * into a pNext chain, and return its head.
+   */
+  VkPhysicalDeviceFeatures2& link(uint32_t apiVersion, const DeviceExtensions& extensions);
+
+  // Turn off every feature that isn't also set in `supported`
+  void intersect(const DeviceFeatures& supported);
+};
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -101,6 +127,15 @@ class PhysicalDevice {
 
   VkPhysicalDeviceFeatures getFeatures() const;
 
+  // Everything the device supports, including extension features
+  DeviceFeatures getSupportedFeatures() const;
+
+  // A memory type allowed by `typeFilter` that has all of `properties`. Calls LOG_F if none does
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+  // True if some memory type has all of `properties`, e.g. LAZILY_ALLOCATED on tile-based GPUs
+  bool hasMemoryType(VkMemoryPropertyFlags properties) const;
+
   // TODO: REMOVE THIS, ONLY FOR INTEGRGATION WITH ORIGINAL ENGINE
   VkPhysicalDevice getVkPhysicalDevice() const { return device_; }
 
@@ -139,17 +174,28 @@ class LogicalDevice {
   // Allow move constructor
   LogicalDevice(LogicalDevice&& other);
 
-  // Normal construction
+  /**
+   * @brief Create the device. Calls LOG_F if any of `requiredExtensions` is missing.
+   *
+   * `optionalExtensions` and `requestedFeatures` are enabled where the physical device supports
+   * them; check isExtensionEnabled() / getEnabledFeatures() for what was actually enabled.
+   */
   LogicalDevice(Instance& instance,
                 PhysicalDevice&& physicalDevice,
-                const DeviceExtensions& requredExtensions,
-                QueueFamilyRequests& requests);
+                const DeviceExtensions& requiredExtensions,
+                QueueFamilyRequests& requests,
+                const DeviceExtensions& optionalExtensions = {},
+                const DeviceFeatures& requestedFeatures = {});
 
   // TODO: REMOVE THIS, ONLY FOR INTEGRGATION WITH ORIGINAL ENGINE
   VkDevice getVkDevice() const { return device_; }
 
   const PhysicalDevice& getPhysicalDevice() const { return physicalDevice_; }
 
+  const DeviceFeatures& getEnabledFeatures() const { return enabledFeatures_; }
+
+  bool isExtensionEnabled(const std::string& extension) const;
+
   operator VkDevice() const { return device_; }
 
   operator VkPhysicalDevice() const { return physicalDevice_; }
@@ -158,5 +204,7 @@ class LogicalDevice {
   PhysicalDevice physicalDevice_;
   Instance& instance_;
   std::vector<VkQueue> queues_;
+  DeviceExtensions enabledExtensions_;
+  DeviceFeatures enabledFeatures_;
   VkDevice device_ = nullptr;
 };
@@ -3,12 +3,37 @@
 #include <vulkan/vulkan.h>
 
 #include <engine/core/Device.hpp>
+#include <engine/core/PushConstants.hpp>
 #include <engine/core/RenderPass.hpp>
 #include <engine/core/ShaderModule.hpp>
 #include <engine/core/Swapchain.hpp>
+#include <engine/utils/hash.hpp>
 #include <fmtlog/Log.hpp>
 #include <optional>
 
+/**
+ * @brief Depth test and write state of a GraphicsPipeline, used when its subpass has a depth
+ * attachment. Depth is cleared to 1.0 (see Attachment::getClearValue()), so nearer is less; equal
+ * depths pass, so that coplanar geometry is drawn in submission order as it is without depth.
+ *
+ * With a depth pre-pass, the opaque geometry is first drawn by a depth-only pipeline (no fragment
+ * shader, default state) into a subpass with only the depth attachment, then drawn again by the
+ * shading pipeline with afterPrePass() into a subpass that depends on it (Subpass::dependOn()).
+ * Early fragment tests then reject every fragment but the visible one, so each pixel is shaded
+ * once however much the geometry overlaps. Both vertex shaders must compute exactly the same
+ * positions, e.g. by being the same shader with `invariant gl_Position`.
+ */
+struct DepthState {
+  bool test = true;
+  bool write = true;
+  VkCompareOp compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  static constexpr DepthState disabled() { return {false, false, VK_COMPARE_OP_ALWAYS}; }
+
+  // Shading after a depth pre-pass: only the fragments the pre-pass kept pass, depth is left as is
+  static constexpr DepthState afterPrePass() { return {true, false, VK_COMPARE_OP_EQUAL}; }
+};
+
 template <class InputType>
 class GraphicsPipeline {
  public:
@@ -19,26 +44,99 @@ class GraphicsPipeline {
                    const Swapchain& swapchain,
                    const Subpass& subpass,
                    VertexShaderModule<InputType>& vertexShader,
-                   ShaderModule& fragmentShader)
+                   ShaderModule& fragmentShader,
+                   const std::vector<VkDescriptorSetLayout>& setLayouts = {},
+                   const std::vector<VkPushConstantRange>& pushConstantRanges = {},
+                   const DepthState& depthState = {})
+      : device_(device),
+        swapchain_(swapchain),
+        subpass_(subpass),
+        pushConstantRanges_(pushConstantRanges),
+        depthState_(depthState) {
+    create(vertexShader, &fragmentShader, setLayouts);
+  }
+
+  /**
+   * @brief A depth-only pipeline, without a fragment shader: e.g. for a depth pre-pass (see
+   * DepthState) or a shadow map. Its subpass must have a depth attachment.
+   */
+  GraphicsPipeline(const LogicalDevice& device,
+                   const Swapchain& swapchain,
+                   const Subpass& subpass,
+                   VertexShaderModule<InputType>& vertexShader,
+                   const std::vector<VkDescriptorSetLayout>& setLayouts = {},
+                   const std::vector<VkPushConstantRange>& pushConstantRanges = {},
+                   const DepthState& depthState = {})
       : device_(device),
         swapchain_(swapchain),
-        subpass_(subpass) {
+        subpass_(subpass),
+        pushConstantRanges_(pushConstantRanges),
+        depthState_(depthState) {
+    create(vertexShader, nullptr, setLayouts);
+  }
+
+  ~GraphicsPipeline() {
+    vkDestroyPipeline(device_, graphicsPipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, pipelineLayout_, nullptr);
+  }
+
+  operator VkPipeline() const { return graphicsPipeline_; }
+
+  VkPipelineLayout getLayout() const { return pipelineLayout_; }
+
+  const std::vector<VkPushConstantRange>& getPushConstantRanges() const {
+    return pushConstantRanges_;
+  }
+
+  const DepthState& getDepthState() const { return depthState_; }
+
+  // Identifies the shader permutation this pipeline was built from
+  size_t getKey() const { return key_; }
+
+ private:
+  void create(VertexShaderModule<InputType>& vertexShader,
+              ShaderModule* fragmentShader,
+              const std::vector<VkDescriptorSetLayout>& setLayouts) {
+    if (!fragmentShader && !subpass_.hasDepthStencil()) {
+      LOG_F("A pipeline without a fragment shader needs a subpass with a depth attachment");
+    }
+
+    if (subpass_.isDepthReadOnly() && depthState_.write) {
+      LOG_F("Subpass {} only reads its depth attachment, but the pipeline writes depth",
+            subpass_.getIndex());
+    }
+
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = vertexShader;
     vertShaderStageInfo.pName = vertexShader.entryPointName();
-
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragmentShader;
-    fragShaderStageInfo.pName = fragmentShader.entryPointName();
+    vertShaderStageInfo.pSpecializationInfo = vertexShader.getSpecializationInfo();
 
     // TODO: allow more pipeline stages
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
     shaderStages.push_back(vertShaderStageInfo);
-    shaderStages.push_back(fragShaderStageInfo);
+
+    if (fragmentShader) {
+      VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+      fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+      fragShaderStageInfo.module = *fragmentShader;
+      fragShaderStageInfo.pName = fragmentShader->entryPointName();
+      fragShaderStageInfo.pSpecializationInfo = fragmentShader->getSpecializationInfo();
+      shaderStages.push_back(fragShaderStageInfo);
+    }
+
+    // Every shader permutation (including its specialization constants) produces a distinct key,
+    // and so does every depth state, so that draws sorted by key are grouped by pipeline
+    key_ = vertexShader.getKey();
+    if (fragmentShader) {
+      hashCombine(key_, fragmentShader->getKey());
+    }
+    hashCombine(key_, subpass_.getIndex());
+    hashCombine(key_, depthState_.test);
+    hashCombine(key_, depthState_.write);
+    hashCombine(key_, static_cast<uint32_t>(depthState_.compareOp));
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -96,10 +194,13 @@ class GraphicsPipeline {
     multisampling.alphaToCoverageEnable = VK_FALSE;  // Optional
     multisampling.alphaToOneEnable = VK_FALSE;       // Optional
 
-    // Disable color blending
+    // Disable color blending. A pipeline without a fragment shader leaves color undefined, so it
+    // must not write any
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.colorWriteMask =
+        fragmentShader ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                             VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+                       : 0;
     colorBlendAttachment.blendEnable = VK_FALSE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;   // Optional
     colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
@@ -108,24 +209,40 @@ class GraphicsPipeline {
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;              // Optional
 
+    // One per color attachment of the subpass; none for a depth-only subpass
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(
+        subpass_.getColorAttachmentReferences().size(), colorBlendAttachment);
+
     // Setup global color blending parameters
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;  // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
     colorBlending.blendConstants[0] = 0.0f;  // Optional
     colorBlending.blendConstants[1] = 0.0f;  // Optional
     colorBlending.blendConstants[2] = 0.0f;  // Optional
     colorBlending.blendConstants[3] = 0.0f;  // Optional
 
+    // Fragments failing the test are discarded before the fragment shader runs, unless the shader
+    // discards or writes depth itself. Stencil isn't used yet
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = depthState_.test ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = depthState_.write ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = depthState_.compareOp;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;             // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr;          // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0;     // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;  // Optional
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges_.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges_.data();
+
+    validatePushConstantRanges(device_, pushConstantRanges_);
 
     if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipelineLayout_) !=
         VK_SUCCESS) {
@@ -141,7 +258,7 @@ class GraphicsPipeline {
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;  // Optional
+    pipelineInfo.pDepthStencilState = subpass_.hasDepthStencil() ? &depthStencil : nullptr;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = nullptr;  // Optional
 
@@ -164,18 +281,14 @@ class GraphicsPipeline {
     }
   }
 
-  ~GraphicsPipeline() {
-    vkDestroyPipeline(device_, graphicsPipeline_, nullptr);
-    vkDestroyPipelineLayout(device_, pipelineLayout_, nullptr);
-  }
-
-  operator VkPipeline() const { return graphicsPipeline_; }
-
  private:
   const LogicalDevice& device_;
   const Swapchain& swapchain_;
   const Subpass& subpass_;
+  std::vector<VkPushConstantRange> pushConstantRanges_;
+  DepthState depthState_;
 
   VkPipelineLayout pipelineLayout_;
   VkPipeline graphicsPipeline_;
+  size_t key_;
 };
\ No newline at end of file
@@ -1,20 +1,270 @@
 #include "Image.hpp"
 
+#include <algorithm>
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/MipGenerator.hpp>
 #include <fmtlog/Log.hpp>
 
+ImageLayoutUsage getImageLayoutUsage(VkImageLayout layout) {
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+    case VK_IMAGE_LAYOUT_PREINITIALIZED:
+      // Nothing to wait for: the contents are discarded (or were written by the host)
+      return {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0};
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT};
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+      // Presentation waits on a semaphore, which already covers every write
+      return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0};
+    default:
+      // GENERAL and anything more specialized: assume any stage may read and write it
+      return {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+              VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT};
+  }
+}
+
+VkImageAspectFlags getFormatAspect(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+FormatBlock getFormatBlock(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+      return {4, 4, 8};
+
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+      return {4, 4, 16};
+
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SRGB:
+      return {1, 1, 1};
+
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R16_SFLOAT:
+      return {1, 1, 2};
+
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+    case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_SFLOAT:
+      return {1, 1, 4};
+
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+      return {1, 1, 8};
+
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return {1, 1, 16};
+
+    default:
+      break;
+  }
+
+  if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+    // Every ASTC block is 16 bytes. The formats come in UNORM / SRGB pairs, by block size
+    static const uint32_t blockSizes[][2] = {{4, 4},
+                                             {5, 4},
+                                             {5, 5},
+                                             {6, 5},
+                                             {6, 6},
+                                             {8, 5},
+                                             {8, 6},
+                                             {8, 8},
+                                             {10, 5},
+                                             {10, 6},
+                                             {10, 8},
+                                             {10, 10},
+                                             {12, 10},
+                                             {12, 12}};
+    const uint32_t* size = blockSizes[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+    return {size[0], size[1], 16};
+  }
+
+  return {1, 1, 0};
+}
+
+VkFormat findDepthFormat(const LogicalDevice& device, bool needStencil) {
+  // Every implementation supports at least one of D24_UNORM_S8_UINT and D32_SFLOAT_S8_UINT, and
+  // one of X8_D24_UNORM_PACK32 and D32_SFLOAT
+  const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT,
+                                 VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                 VK_FORMAT_D24_UNORM_S8_UINT,
+                                 VK_FORMAT_X8_D24_UNORM_PACK32,
+                                 VK_FORMAT_D16_UNORM};
+
+  for (VkFormat format : candidates) {
+    if (needStencil && !(getFormatAspect(format) & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+      continue;
+    }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &properties);
+    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+
+  LOG_F("No supported depth{} format", needStencil ? " / stencil" : "");
+}
+
 Image::Image(Image&& other) : device_(other.device_) {
   presentable_ = other.presentable_;
   image_ = other.image_;
+  memory_ = other.memory_;
+  memorySize_ = other.memorySize_;
   mipLevels_ = other.mipLevels_;
+  arrayLayers_ = other.arrayLayers_;
   format_ = other.format_;
   extent_ = other.extent_;
+  usage_ = other.usage_;
+  aspect_ = other.aspect_;
+  layouts_ = std::move(other.layouts_);
 
   // Invalidate other
   other.image_ = nullptr;
+  other.memory_ = VK_NULL_HANDLE;
+  other.memorySize_ = 0;
   other.extent_ = {0, 0};
   other.format_ = VK_FORMAT_UNDEFINED;
 }
 
+Image::Image(const LogicalDevice& device,
+             VkExtent2D extent,
+             VkFormat format,
+             VkImageUsageFlags usage,
+             uint32_t mipLevels,
+             uint32_t arrayLayers,
+             VkSampleCountFlagBits samples,
+             VkMemoryPropertyFlags memoryProperties,
+             const QueueFamilyRequests sharingQueues)
+    : device_(device),
+      mipLevels_(mipLevels),
+      arrayLayers_(arrayLayers),
+      format_(format),
+      extent_(extent),
+      usage_(usage),
+      aspect_(getFormatAspect(format)),
+      layouts_(mipLevels, VK_IMAGE_LAYOUT_UNDEFINED) {
+  if (extent_.width == 0 || extent_.height == 0 || mipLevels_ == 0 || arrayLayers_ == 0) {
+    LOG_F("Image of {}x{} with {} mip levels and {} layers",
+          extent_.width,
+          extent_.height,
+          mipLevels_,
+          arrayLayers_);
+  }
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format_;
+  imageInfo.extent = {extent_.width, extent_.height, 1};
+  imageInfo.mipLevels = mipLevels_;
+  imageInfo.arrayLayers = arrayLayers_;
+  imageInfo.samples = samples;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = usage_;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  // Handle potential sharing cases
+  std::vector<uint32_t> sharedFamilyIndices;
+  if (sharingQueues.size() != 0) {
+    sharedFamilyIndices = getUniqueQueueFamilyIndices(sharingQueues);
+
+    if (sharedFamilyIndices.size() > 1) {
+      imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilyIndices.size());
+      imageInfo.pQueueFamilyIndices = sharedFamilyIndices.data();
+    }
+  }
+
+  if (vkCreateImage(device_, &imageInfo, nullptr, &image_) != VK_SUCCESS) {
+    LOG_F("failed to create image!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device_, image_, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      device_.getPhysicalDevice().findMemoryType(memRequirements.memoryTypeBits, memoryProperties);
+
+  // One allocation per image, as for Buffer. maxMemoryAllocationCount can be as low as 4096, and
+  // TextureStreamer alone holds up to three images per texture (tail, streamed, retired): past a
+  // thousand or so streamed textures, images will need sub-allocating from larger blocks
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory_) != VK_SUCCESS) {
+    LOG_F("failed to allocate image memory!");
+  }
+
+  memorySize_ = memRequirements.size;
+  vkBindImageMemory(device_, image_, memory_, 0 /*offset*/);
+}
+
 Image::Image(const LogicalDevice& device,
              VkImage image,
              uint32_t mipLevels,
@@ -26,20 +276,150 @@ Image::Image(const LogicalDevice& device,
       mipLevels_(mipLevels),
       extent_(extent),
       format_(format),
-      presentable_(presentable) {}
+      presentable_(presentable),
+      layouts_(mipLevels, VK_IMAGE_LAYOUT_UNDEFINED) {}
+
+Image::~Image() {
+  // Swapchain images belong to the swapchain
+  if (memory_ != VK_NULL_HANDLE) {
+    vkDestroyImage(device_, image_, nullptr);
+    vkFreeMemory(device_, memory_, nullptr);
+  }
+}
+
+void Image::upload(const CommandPool& commandPool,
+                   const void* data,
+                   size_t size,
+                   VkImageLayout finalLayout,
+                   MipGenerator* mipGenerator) {
+  bool blitMips = mipLevels_ > 1 && MipGenerator::canBlit(device_, *this);
+  if (mipLevels_ > 1 && !blitMips && !mipGenerator) {
+    LOG_F("Image of format {} can't be blitted: generating its mip levels needs a MipGenerator",
+          static_cast<int>(format_));
+  }
+
+  // Transfer-only queues can copy level 0 but generate none of the others
+  const QueueFamily& family = commandPool.getQueue().family;
+  if (blitMips && !family.graphics) {
+    LOG_F("Mip levels are blitted, which needs a pool on a graphics queue, not queue family {}",
+          family.index);
+  }
+  if (mipLevels_ > 1 && !blitMips && !family.compute) {
+    LOG_F("Mip levels are downsampled, which needs a pool on a compute queue, not queue family {}",
+          family.index);
+  }
+
+  // The copy reads a whole level 0 for every layer, so less data would be read past its end
+  VkDeviceSize levelSize = getLevelSize(0);
+  if (levelSize == 0) {
+    LOG_F("Uploading to an image of format {}, whose texel size isn't known",
+          static_cast<int>(format_));
+  }
+  if (size < levelSize) {
+    LOG_F("Uploading {} bytes to an image whose mip level 0 takes {} ({} layers of {}x{})",
+          size,
+          levelSize,
+          arrayLayers_,
+          extent_.width,
+          extent_.height);
+  }
+
+  TransferBuffer<uint8_t> staging(device_, static_cast<const uint8_t*>(data), size);
+
+  CommandBuffer commandBuffer = commandPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  commandBuffer.transitionImageLayout(*this, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  commandBuffer.copyBufferToImage(staging, *this);
+
+  // Mip levels are generated in the same submission, so the texture is complete once it finishes
+  if (blitMips) {
+    MipGenerator::recordBlits(commandBuffer, *this);
+  } else if (mipLevels_ > 1) {
+    mipGenerator->record(commandBuffer, *this);
+  }
 
-Image::~Image() {}
+  // The pool's queue may be transfer-only, so nothing after the upload is waited on here: waiting
+  // for the submission is what orders the upload before the image's first use
+  commandBuffer.imageBarrier(*this,
+                             finalLayout,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_ACCESS_MEMORY_WRITE_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0);
+  commandBuffer.end();
 
-ImageView::ImageView(ImageView&& other) : image_(other.image_), imageView_(other.imageView_) {
+  commandBuffer.submitAndWait();
+
+  if (mipGenerator) {
+    mipGenerator->reset();
+  }
+}
+
+uint32_t Image::getFullMipLevels(VkExtent2D extent) {
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(extent.width, extent.height); size > 1; size >>= 1) {
+    levels++;
+  }
+  return levels;
+}
+
+VkExtent2D Image::getMipExtent(uint32_t mipLevel) const {
+  return {std::max(extent_.width >> mipLevel, 1u), std::max(extent_.height >> mipLevel, 1u)};
+}
+
+VkDeviceSize Image::getLevelSize(uint32_t mipLevel) const {
+  FormatBlock block = getFormatBlock(format_);
+  VkExtent2D extent = getMipExtent(mipLevel);
+
+  // Partial blocks at the edges are stored whole
+  VkDeviceSize blocksX = (extent.width + block.width - 1) / block.width;
+  VkDeviceSize blocksY = (extent.height + block.height - 1) / block.height;
+  return blocksX * blocksY * block.bytes * arrayLayers_;
+}
+
+ImageView::ImageView(ImageView&& other)
+    : image_(other.image_),
+      imageView_(other.imageView_),
+      baseMipLevel_(other.baseMipLevel_),
+      mipLevelCount_(other.mipLevelCount_),
+      aspect_(other.aspect_) {
   other.imageView_ = nullptr;
 }
 
-ImageView::ImageView(const Image& image) : image_(image) {
+ImageView::ImageView(const Image& image,
+                     uint32_t baseMipLevel,
+                     uint32_t mipLevelCount,
+                     std::optional<VkImageViewType> viewType,
+                     std::optional<VkImageAspectFlags> aspect)
+    : image_(image),
+      baseMipLevel_(baseMipLevel),
+      mipLevelCount_(mipLevelCount),
+      aspect_(aspect.value_or(image.getAspect())) {
+  if (aspect_ == 0 || (aspect_ & ~image_.getAspect()) != 0) {
+    LOG_F("View of aspects {:#x} of an image with aspects {:#x}", aspect_, image_.getAspect());
+  }
+
+  // Checked before the count is worked out, which would wrap around past the last level
+  if (baseMipLevel_ >= image_.getMipLevels()) {
+    LOG_F("View from mip level {} of an image with {}", baseMipLevel_, image_.getMipLevels());
+  }
+
+  if (mipLevelCount_ == VK_REMAINING_MIP_LEVELS) {
+    mipLevelCount_ = image_.getMipLevels() - baseMipLevel_;
+  }
+  if (mipLevelCount_ == 0 || mipLevelCount_ > image_.getMipLevels() - baseMipLevel_) {
+    LOG_F("View of {} mip levels from level {} of an image with {}",
+          mipLevelCount_,
+          baseMipLevel_,
+          image_.getMipLevels());
+  }
+
   VkImageViewCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   createInfo.image = image_;
-  createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;  // Treat the image as a 2D array of pixels
-  createInfo.format = image_.getFormat();       // Match the format of the underlying image
+  createInfo.viewType = viewType.value_or(image_.getArrayLayers() > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+                                                                     : VK_IMAGE_VIEW_TYPE_2D);
+  createInfo.format = image_.getFormat();  // Match the format of the underlying image
 
   // Allows us to swizzle one color channel into another, but for now
   // we just stick with the default
@@ -48,23 +428,19 @@ ImageView::ImageView(const Image& image) : image_(image) {
   createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
   createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
-  // ??? not sure what this does ???
-  createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  // Which of the color, depth and stencil data the view sees
+  createInfo.subresourceRange.aspectMask = aspect_;
 
-  // Tell Vulkan there is only a single MIP level, MIP0, because
-  // the final rendered image that we are going to display to the user
+  // A whole mip chain for sampling, or single levels, e.g. to render or write into them. Swapchain
+  // images only have MIP0, since the final rendered image that we are going to display to the user
   // only has a single image
-  createInfo.subresourceRange.baseMipLevel = 0;
-  createInfo.subresourceRange.levelCount = image_.getMipLevels();
-
-  // Since this is currently a 2D application, we only need one layer per
-  // VkImage but for a VR application, we might request a VkImage with
-  // multiple layers, and then bind each layer of a single VkImage into
-  // multiple VkImageViews
-  //
-  // TODO: VR support?
+  createInfo.subresourceRange.baseMipLevel = baseMipLevel_;
+  createInfo.subresourceRange.levelCount = mipLevelCount_;
+
+  // Swapchain images have a single layer. Owned images can have several, e.g. one per eye for VR
+  // or one per texture of an array
   createInfo.subresourceRange.baseArrayLayer = 0;
-  createInfo.subresourceRange.layerCount = 1;
+  createInfo.subresourceRange.layerCount = image_.getArrayLayers();
 
   if (vkCreateImageView(image_.getAssociatedDevice(), &createInfo, nullptr, &imageView_) !=
       VK_SUCCESS) {
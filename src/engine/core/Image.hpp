@@ -3,28 +3,125 @@
 #include <vulkan/vulkan.h>
 
 #include <engine/core/Device.hpp>
+#include <optional>
+#include <vector>
+
+class CommandPool;
+class MipGenerator;
+
+// The pipeline stages and accesses that use an image while it is in a given layout, i.e. what a
+// layout transition has to wait for (leaving the layout) or block (entering it)
+struct ImageLayoutUsage {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+ImageLayoutUsage getImageLayoutUsage(VkImageLayout layout);
+
+// Color, depth and/or stencil, depending on what `format` stores
+VkImageAspectFlags getFormatAspect(VkFormat format);
+
+// Texel block dimensions and size; 1x1 for uncompressed formats
+struct FormatBlock {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes;  // 0 for formats the engine doesn't know the size of
+};
+
+FormatBlock getFormatBlock(VkFormat format);
+
+// The most precise depth format `device` can render depth attachments in, with a stencil aspect
+// too if `needStencil`. Calls LOG_F if there is none.
+VkFormat findDepthFormat(const LogicalDevice& device, bool needStencil = false);
 
 /**
  * @brief Simple wrapper enabling RAII around a VkImage
  *
+ * Either one of the images of a Swapchain, or an image the engine creates and owns, along with its
+ * memory: textures, offscreen render targets, depth buffers.
+ *
+ * The image remembers the layout the last recorded transition left each mip level in (see
+ * CommandBuffer::transitionImageLayout()), so only the new layout has to be given. This assumes
+ * command buffers using the image run in the order they were recorded in.
+ *
+ *   Image texture(device, extent, VK_FORMAT_R8G8B8A8_SRGB,
+ *                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+ *   texture.upload(graphicsCommandPool, pixels.data(), pixels.size());
+ *   ImageView textureView(texture);
  */
 class Image {
   friend class Swapchain;
   friend class ImageView;
+  friend class CommandBuffer;
 
  public:
   Image(Image& other) = delete;
 
   Image(Image&& other);
 
+  /**
+   * @brief Create a 2D image (or 2D array, with `arrayLayers` > 1) with optimal tiling, in
+   * VK_IMAGE_LAYOUT_UNDEFINED, and bind it to memory of its own.
+   *
+   * @param sharingQueues queues other than the creating one that use the image, e.g. a transfer
+   * queue uploading to it. More than one family makes the image concurrently shared.
+   */
+  Image(const LogicalDevice& device,
+        VkExtent2D extent,
+        VkFormat format,
+        VkImageUsageFlags usage,
+        uint32_t mipLevels = 1,
+        uint32_t arrayLayers = 1,
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+        VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        const QueueFamilyRequests sharingQueues = {});
+
   ~Image();
 
+  /**
+   * @brief Copy tightly packed texels into mip level 0 of every layer (one layer after the other),
+   * through a staging buffer, generate the other mip levels from it on the GPU, and leave the image
+   * in `finalLayout`. Blocks until all of it is done. Needs VK_IMAGE_USAGE_TRANSFER_DST_BIT, and a
+   * format getFormatBlock() knows. Calls LOG_F if `size` is less than getLevelSize(0).
+   *
+   * Mip levels are blitted when the image allows it (see MipGenerator::canBlit()), which needs a
+   * pool on a graphics queue; other images need `mipGenerator` and a compute-capable queue. Calls
+   * LOG_F if the pool's queue can't generate them.
+   */
+  void upload(const CommandPool& commandPool,
+              const void* data,
+              size_t size,
+              VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              MipGenerator* mipGenerator = nullptr);
+
+  // Mip levels in a full chain for `extent`, down to 1x1
+  static uint32_t getFullMipLevels(VkExtent2D extent);
+
   uint32_t getMipLevels() const { return mipLevels_; }
 
+  uint32_t getArrayLayers() const { return arrayLayers_; }
+
   VkFormat getFormat() const { return format_; }
 
   VkExtent2D getExtent() const { return extent_; }
 
+  // Size of mip level `mipLevel`
+  VkExtent2D getMipExtent(uint32_t mipLevel) const;
+
+  // Bytes of mip level `mipLevel` across every layer, tightly packed. 0 if getFormatBlock() doesn't
+  // know the format
+  VkDeviceSize getLevelSize(uint32_t mipLevel) const;
+
+  VkImageUsageFlags getUsage() const { return usage_; }
+
+  VkImageAspectFlags getAspect() const { return aspect_; }
+
+  // Bytes of device memory the image owns; 0 for swapchain images
+  VkDeviceSize getMemorySize() const { return memorySize_; }
+
+  // The layout mip level `mipLevel` is left in by the transitions recorded so far
+  VkImageLayout getLayout(uint32_t mipLevel = 0) const { return layouts_[mipLevel]; }
+
   bool isPresentable() const { return presentable_; }
 
   operator VkImage() const { return image_; }
@@ -44,9 +141,15 @@ class Image {
   const LogicalDevice& device_;  // The device that this image is bound to
   bool presentable_ = false;     // Only true for VkImages that are derived from a Swapchain
   VkImage image_;
+  VkDeviceMemory memory_ = VK_NULL_HANDLE;  // Only set for images the engine created
+  VkDeviceSize memorySize_ = 0;
   uint32_t mipLevels_;
+  uint32_t arrayLayers_ = 1;
   VkFormat format_;
   VkExtent2D extent_;
+  VkImageUsageFlags usage_ = 0;
+  VkImageAspectFlags aspect_ = VK_IMAGE_ASPECT_COLOR_BIT;
+  std::vector<VkImageLayout> layouts_;  // Per mip level, shared by every layer
 };
 
 /**
@@ -61,15 +164,38 @@ class ImageView {
 
   ImageView(ImageView&& other);
 
-  ImageView(const Image& image);
+  /**
+   * @brief View of `mipLevelCount` mip levels of `image` from `baseMipLevel` (by default the whole
+   * chain), and every layer. Unless `viewType` says otherwise, the view is 2D, or a 2D array if
+   * the image has more than one layer.
+   *
+   * The view sees every aspect of the image unless `aspect` says otherwise. Views of combined
+   * depth/stencil images that shaders sample or store to must pick one, e.g.
+   * VK_IMAGE_ASPECT_DEPTH_BIT; attachment views keep both. Calls LOG_F if `aspect` isn't part of
+   * the image's.
+   */
+  ImageView(const Image& image,
+            uint32_t baseMipLevel = 0,
+            uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS,
+            std::optional<VkImageViewType> viewType = std::nullopt,
+            std::optional<VkImageAspectFlags> aspect = std::nullopt);
 
   ~ImageView();
 
   const Image& getImage() const { return image_; }
 
+  uint32_t getBaseMipLevel() const { return baseMipLevel_; }
+
+  uint32_t getMipLevelCount() const { return mipLevelCount_; }
+
+  VkImageAspectFlags getAspect() const { return aspect_; }
+
   operator VkImageView() const { return imageView_; }
 
  private:
   const Image& image_;
   VkImageView imageView_;
-};
\ No newline at end of file
+  uint32_t baseMipLevel_;
+  uint32_t mipLevelCount_;
+  VkImageAspectFlags aspect_;
+};
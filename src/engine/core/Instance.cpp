@@ -67,7 +67,30 @@ Instance::Instance(const std::string& applicationName,
   appInfo.pEngineName = "VK_ENGINE";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);  // TODO: use project version from CMake
 
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.2 for vkGetPhysicalDeviceFeatures2 and the core Vulkan 1.1 / 1.2 feature structures. Devices
+  // that expose an older version still work, without those features, but the loader must be 1.2.
+  // 1.0 loaders don't have vkEnumerateInstanceVersion
+  uint32_t loaderVersion = VK_API_VERSION_1_0;
+  auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+      vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+  if (enumerateInstanceVersion != nullptr &&
+      enumerateInstanceVersion(&loaderVersion) != VK_SUCCESS) {
+    loaderVersion = VK_API_VERSION_1_0;
+  }
+
+  LOG_D("Vulkan loader version {}.{}.{}",
+        VK_VERSION_MAJOR(loaderVersion),
+        VK_VERSION_MINOR(loaderVersion),
+        VK_VERSION_PATCH(loaderVersion));
+  if (loaderVersion < VK_API_VERSION_1_2) {
+    LOG_F("The Vulkan loader only supports version {}.{}.{}, 1.2 is needed: update the drivers or "
+          "the Vulkan runtime",
+          VK_VERSION_MAJOR(loaderVersion),
+          VK_VERSION_MINOR(loaderVersion),
+          VK_VERSION_PATCH(loaderVersion));
+  }
+
+  appInfo.apiVersion = VK_API_VERSION_1_2;
 
   VkInstanceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -126,8 +149,13 @@ Instance::Instance(const std::string& applicationName,
   createInfo.enabledLayerCount = vkRequiredlayers.size();
   createInfo.ppEnabledLayerNames = vkRequiredlayers.data();
 
-  if (vkCreateInstance(&createInfo, nullptr, &instance_) != VK_SUCCESS) {
-    LOG_F("Failed to create Vulkan instance");
+  VkResult result = vkCreateInstance(&createInfo, nullptr, &instance_);
+  if (result != VK_SUCCESS) {
+    LOG_F("Failed to create a Vulkan 1.2 instance (error {}) with loader version {}.{}.{}",
+          static_cast<int>(result),
+          VK_VERSION_MAJOR(loaderVersion),
+          VK_VERSION_MINOR(loaderVersion),
+          VK_VERSION_PATCH(loaderVersion));
   }
 
   if (enableDebugMessages) {
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <engine/core/Vertex.hpp>
+#include <engine/core/VertexLayout.hpp>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Per-instance attributes for instanced draws, read from vertex binding 1 once per instance.
+ *
+ * The transform is passed as four vec4 columns (a mat4 input in the shader occupies locations 2-5),
+ * and the color multiplies the vertex color.
+ */
+struct InstanceData {
+  glm::mat4 transform{1.0f};
+  glm::vec4 color{1.0f};
+
+  struct Binding;
+};
+
+struct InstanceData::Binding
+    : VertexBinding<1,
+                    InstanceData,
+                    VK_VERTEX_INPUT_RATE_INSTANCE,
+                    VertexAttribute<2,  // inTransform, column 0
+                                    VK_FORMAT_R32G32B32A32_SFLOAT,
+                                    offsetof(InstanceData, transform) + 0 * sizeof(glm::vec4)>,
+                    VertexAttribute<3,  // inTransform, column 1
+                                    VK_FORMAT_R32G32B32A32_SFLOAT,
+                                    offsetof(InstanceData, transform) + 1 * sizeof(glm::vec4)>,
+                    VertexAttribute<4,  // inTransform, column 2
+                                    VK_FORMAT_R32G32B32A32_SFLOAT,
+                                    offsetof(InstanceData, transform) + 2 * sizeof(glm::vec4)>,
+                    VertexAttribute<5,  // inTransform, column 3
+                                    VK_FORMAT_R32G32B32A32_SFLOAT,
+                                    offsetof(InstanceData, transform) + 3 * sizeof(glm::vec4)>,
+                    VertexAttribute<6,  // inInstanceColor
+                                    VK_FORMAT_R32G32B32A32_SFLOAT,
+                                    offsetof(InstanceData, color)>> {};
+
+static_assert(sizeof(InstanceData) == 80, "InstanceData must stay tightly packed");
+
+/**
+ * @brief Vertex input of instanced pipelines: Vertex at binding 0, InstanceData at binding 1.
+ */
+struct InstancedVertexLayout : VertexLayout<Vertex::Binding, InstanceData::Binding> {};
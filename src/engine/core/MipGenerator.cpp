@@ -0,0 +1,335 @@
+#include "MipGenerator.hpp"
+
+#include <algorithm>
+#include <engine/core/PushConstants.hpp>
+#include <fmtlog/Log.hpp>
+
+// Must match local_size_x and local_size_y in downsample.comp
+constexpr uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+// Bindings of the downsampler's descriptor set
+enum DownsampleBinding : uint32_t { SourceBinding = 0, LevelsBinding, DownsampleBindingCount };
+
+struct DownsampleParams {
+  uint32_t levelCount;  // Levels this dispatch writes, up to LEVELS_PER_DISPATCH
+  MipReduction reduction;
+};
+
+using DownsamplePushConstants = PushConstants<DownsampleParams, VK_SHADER_STAGE_COMPUTE_BIT>;
+
+// Formats read and written as integers, which downsample.comp's float images can't access
+static bool isIntegerFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UINT:
+    case VK_FORMAT_R8_SINT:
+    case VK_FORMAT_R8G8_UINT:
+    case VK_FORMAT_R8G8_SINT:
+    case VK_FORMAT_R8G8B8_UINT:
+    case VK_FORMAT_R8G8B8_SINT:
+    case VK_FORMAT_B8G8R8_UINT:
+    case VK_FORMAT_B8G8R8_SINT:
+    case VK_FORMAT_R8G8B8A8_UINT:
+    case VK_FORMAT_R8G8B8A8_SINT:
+    case VK_FORMAT_B8G8R8A8_UINT:
+    case VK_FORMAT_B8G8R8A8_SINT:
+    case VK_FORMAT_A8B8G8R8_UINT_PACK32:
+    case VK_FORMAT_A8B8G8R8_SINT_PACK32:
+    case VK_FORMAT_A2R10G10B10_UINT_PACK32:
+    case VK_FORMAT_A2R10G10B10_SINT_PACK32:
+    case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+    case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_R16_SINT:
+    case VK_FORMAT_R16G16_UINT:
+    case VK_FORMAT_R16G16_SINT:
+    case VK_FORMAT_R16G16B16_UINT:
+    case VK_FORMAT_R16G16B16_SINT:
+    case VK_FORMAT_R16G16B16A16_UINT:
+    case VK_FORMAT_R16G16B16A16_SINT:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32B32_UINT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32A32_UINT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R64_UINT:
+    case VK_FORMAT_R64_SINT:
+    case VK_FORMAT_R64G64_UINT:
+    case VK_FORMAT_R64G64_SINT:
+    case VK_FORMAT_R64G64B64_UINT:
+    case VK_FORMAT_R64G64B64_SINT:
+    case VK_FORMAT_R64G64B64A64_UINT:
+    case VK_FORMAT_R64G64B64A64_SINT:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+MipGenerator::MipGenerator(const LogicalDevice& device,
+                           ShaderModule& downsampleShader,
+                           DescriptorSetLayoutCache& layoutCache,
+                           const PipelineCache* pipelineCache)
+    : device_(device),
+      descriptors_(device,
+                   16,  // setsPerPool
+                   {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, float(LEVELS_PER_DISPATCH)}}) {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS) {
+    LOG_F("failed to create downsample sampler!");
+  }
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings(DownsampleBindingCount);
+  bindings[SourceBinding].binding = SourceBinding;
+  bindings[SourceBinding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[SourceBinding].descriptorCount = 1;
+  bindings[SourceBinding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[LevelsBinding].binding = LevelsBinding;
+  bindings[LevelsBinding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[LevelsBinding].descriptorCount = LEVELS_PER_DISPATCH;
+  bindings[LevelsBinding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  descriptorSetLayout_ = layoutCache.get(bindings);
+
+  std::vector<VkDescriptorSetLayout> setLayouts = {descriptorSetLayout_};
+  std::vector<VkPushConstantRange> pushConstantRanges = {DownsamplePushConstants::getRange()};
+  pipeline_ = std::make_unique<ComputePipeline>(
+      device_, downsampleShader, setLayouts, pushConstantRanges, pipelineCache);
+}
+
+MipGenerator::~MipGenerator() { vkDestroySampler(device_, sampler_, nullptr); }
+
+void MipGenerator::requestFeatures(DeviceFeatures& features) {
+  features.core.features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+}
+
+bool MipGenerator::canBlit(const LogicalDevice& device, const Image& image) {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), image.getFormat(), &properties);
+
+  constexpr VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                          VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (properties.optimalTilingFeatures & needed) == needed &&
+         (image.getUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) &&
+         (image.getUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+}
+
+bool MipGenerator::canDownsample(const Image& image) const {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device_.getPhysicalDevice(), image.getFormat(), &properties);
+
+  constexpr VkFormatFeatureFlags needed =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+  constexpr VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+  return (properties.optimalTilingFeatures & needed) == needed &&
+         (image.getUsage() & usage) == usage && image.getAspect() == VK_IMAGE_ASPECT_COLOR_BIT &&
+         !isIntegerFormat(image.getFormat()) &&
+         device_.getEnabledFeatures().core.features.shaderStorageImageWriteWithoutFormat;
+}
+
+void MipGenerator::recordBlits(CommandBuffer& commandBuffer, Image& image) {
+  if (!canBlit(commandBuffer.getDevice(), image)) {
+    LOG_F("Mip levels of format {} can't be blitted", static_cast<int>(image.getFormat()));
+  }
+
+  commandBuffer.transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  for (uint32_t level = 1; level < image.getMipLevels(); level++) {
+    // The previous level is complete: read it to write this one
+    commandBuffer.imageBarrier(image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_READ_BIT,
+                               level - 1,
+                               1);
+    commandBuffer.blitImage(image, level - 1, image, level);
+  }
+
+  commandBuffer.imageBarrier(image,
+                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_ACCESS_TRANSFER_READ_BIT,
+                             image.getMipLevels() - 1,
+                             1);
+}
+
+void MipGenerator::record(CommandBuffer& commandBuffer, Image& image) {
+  if (canBlit(device_, image)) {
+    recordBlits(commandBuffer, image);
+    return;
+  }
+
+  if (!canDownsample(image)) {
+    LOG_F("Mip levels of format {} can neither be blitted nor downsampled in compute",
+          static_cast<int>(image.getFormat()));
+  }
+
+  // Sampled reads and storage writes are both allowed in GENERAL, so no level changes layout
+  // between dispatches
+  commandBuffer.transitionImageLayout(image, VK_IMAGE_LAYOUT_GENERAL);
+  commandBuffer.bindPipeline(*pipeline_);
+
+  for (uint32_t source = 0; source + 1 < image.getMipLevels(); source += LEVELS_PER_DISPATCH) {
+    uint32_t levelCount = std::min(LEVELS_PER_DISPATCH, image.getMipLevels() - 1 - source);
+
+    // Array views even for single-layer images, to match the shader's types
+    views_.push_back(
+        std::make_unique<ImageView>(image, source, 1, VK_IMAGE_VIEW_TYPE_2D_ARRAY));
+    VkDescriptorSet set =
+        writeDescriptors(*views_.back(), VK_IMAGE_LAYOUT_GENERAL, image, source + 1, levelCount);
+
+    if (source > 0) {
+      // The previous dispatch wrote this one's source level
+      commandBuffer.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    VkExtent2D extent = image.getMipExtent(source + 1);
+    commandBuffer.bindDescriptorSets(*pipeline_, {set});
+    commandBuffer.pushConstants<DownsamplePushConstants>(*pipeline_,
+                                                         {levelCount, MipReduction::Average});
+    commandBuffer.dispatch(ComputePipeline::getGroupCount(extent.width, DOWNSAMPLE_GROUP_SIZE),
+                           ComputePipeline::getGroupCount(extent.height, DOWNSAMPLE_GROUP_SIZE),
+                           image.getArrayLayers());
+  }
+}
+
+void MipGenerator::recordReduction(CommandBuffer& commandBuffer,
+                                   const Image& source,
+                                   VkImageLayout sourceLayout,
+                                   Image& target,
+                                   MipReduction reduction) {
+  VkExtent2D expected = source.getMipExtent(1);
+  VkExtent2D extent = target.getExtent();
+  if (extent.width != expected.width || extent.height != expected.height ||
+      target.getArrayLayers() != source.getArrayLayers()) {
+    LOG_F("Reducing a {}x{} image into a {}x{} one, expected {}x{}",
+          source.getExtent().width,
+          source.getExtent().height,
+          extent.width,
+          extent.height,
+          expected.width,
+          expected.height);
+  }
+
+  // Sampled views see a single aspect: the depth of depth/stencil images
+  VkImageAspectFlags aspect = source.getAspect();
+  if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+    aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  }
+  if ((aspect & (aspect - 1)) != 0 || !(source.getUsage() & VK_IMAGE_USAGE_SAMPLED_BIT)) {
+    LOG_F("Only sampled images with a single aspect, or depth, can be reduced");
+  }
+
+  if (!canDownsample(target)) {
+    LOG_F("Format {} can't be written by the compute downsampler",
+          static_cast<int>(target.getFormat()));
+  }
+
+  // Only transition levels that aren't in GENERAL yet: e.g. a depth pyramid rebuilt every frame
+  // stays in it, and needs no barrier but the ones its user records
+  for (uint32_t level = 0; level < target.getMipLevels(); level++) {
+    if (target.getLayout(level) != VK_IMAGE_LAYOUT_GENERAL) {
+      commandBuffer.transitionImageLayout(target, VK_IMAGE_LAYOUT_GENERAL);
+      break;
+    }
+  }
+
+  commandBuffer.bindPipeline(*pipeline_);
+
+  // Min and max write a single level per dispatch (see downsample.comp)
+  uint32_t levelsPerDispatch = reduction == MipReduction::Average ? LEVELS_PER_DISPATCH : 1;
+
+  for (uint32_t first = 0; first < target.getMipLevels(); first += levelsPerDispatch) {
+    uint32_t levelCount = std::min(levelsPerDispatch, target.getMipLevels() - first);
+
+    if (first == 0) {
+      views_.push_back(
+          std::make_unique<ImageView>(source, 0, 1, VK_IMAGE_VIEW_TYPE_2D_ARRAY, aspect));
+    } else {
+      views_.push_back(
+          std::make_unique<ImageView>(target, first - 1, 1, VK_IMAGE_VIEW_TYPE_2D_ARRAY));
+    }
+    VkDescriptorSet set = writeDescriptors(*views_.back(),
+                                           first == 0 ? sourceLayout : VK_IMAGE_LAYOUT_GENERAL,
+                                           target,
+                                           first,
+                                           levelCount);
+
+    if (first > 0) {
+      // The previous dispatch wrote this one's source level
+      commandBuffer.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    VkExtent2D levelExtent = target.getMipExtent(first);
+    commandBuffer.bindDescriptorSets(*pipeline_, {set});
+    commandBuffer.pushConstants<DownsamplePushConstants>(*pipeline_, {levelCount, reduction});
+    commandBuffer.dispatch(
+        ComputePipeline::getGroupCount(levelExtent.width, DOWNSAMPLE_GROUP_SIZE),
+        ComputePipeline::getGroupCount(levelExtent.height, DOWNSAMPLE_GROUP_SIZE),
+        target.getArrayLayers());
+  }
+}
+
+VkDescriptorSet MipGenerator::writeDescriptors(const ImageView& sourceView,
+                                               VkImageLayout sourceLayout,
+                                               Image& target,
+                                               uint32_t firstLevel,
+                                               uint32_t levelCount) {
+  VkDescriptorSet set = descriptors_.allocate(descriptorSetLayout_);
+
+  DescriptorWriter writer(device_);
+  writer.writeImage(set,
+                    SourceBinding,
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    sourceView,
+                    sampler_,
+                    sourceLayout);
+
+  // Every element must be valid: the ones past levelCount repeat the last level, which the shader
+  // doesn't write to
+  for (uint32_t i = 0; i < LEVELS_PER_DISPATCH; i++) {
+    if (i < levelCount) {
+      views_.push_back(
+          std::make_unique<ImageView>(target, firstLevel + i, 1, VK_IMAGE_VIEW_TYPE_2D_ARRAY));
+    }
+    writer.writeImage(set,
+                      LevelsBinding,
+                      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                      *views_.back(),
+                      VK_NULL_HANDLE,
+                      VK_IMAGE_LAYOUT_GENERAL,
+                      i);
+  }
+  writer.update();
+
+  return set;
+}
+
+void MipGenerator::reset() {
+  descriptors_.reset();
+  views_.clear();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/ComputePipeline.hpp>
+#include <engine/core/Descriptors.hpp>
+#include <engine/core/Image.hpp>
+#include <memory>
+#include <vector>
+
+// How the compute downsampler combines the 2x2 texels under each texel of the next level
+enum class MipReduction : uint32_t {
+  Average,  // Box filter, for textures
+  Min,      // E.g. a depth pyramid of the nearest depths
+  Max,      // E.g. a depth pyramid of the farthest depths, for occlusion culling
+};
+
+/**
+ * @brief Fills the mip chain of an image from its level 0 on the GPU.
+ *
+ * Images whose format can be blitted with linear filtering (see canBlit()) get one
+ * vkCmdBlitImage per level, which needs no shader, only a graphics queue. Other formats, e.g.
+ * 32-bit float ones on many devices, go through a compute downsampler (shaders/downsample.comp): a
+ * 2x2 box filter in which every work group keeps reducing its tile in shared memory, so one
+ * dispatch writes up to four levels. The compute path needs a float or normalized format that
+ * supports storage, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, and the
+ * shaderStorageImageWriteWithoutFormat feature (see requestFeatures()).
+ *
+ *   generator.record(commandBuffer, texture);   // After level 0 is written
+ *   ...                                         // Submit, and wait for it to finish
+ *   generator.reset();
+ *
+ * Image::upload() does all of this for textures. recordReduction() builds every level of an image
+ * from another one instead, keeping the min or max of each 2x2 block, e.g. a depth pyramid from a
+ * depth buffer.
+ */
+class MipGenerator {
+ public:
+  // Mip levels written by one compute dispatch
+  static constexpr uint32_t LEVELS_PER_DISPATCH = 4;
+
+  MipGenerator() = delete;
+  MipGenerator(MipGenerator& other) = delete;
+
+  /**
+   * @param downsampleShader the compiled downsample.comp
+   * @param layoutCache provides the descriptor set layout, and must outlive the generator
+   */
+  MipGenerator(const LogicalDevice& device,
+               ShaderModule& downsampleShader,
+               DescriptorSetLayoutCache& layoutCache,
+               const PipelineCache* pipelineCache = nullptr);
+
+  ~MipGenerator();
+
+  // Add the features the compute path needs to `features`
+  static void requestFeatures(DeviceFeatures& features);
+
+  // True if `image` can be blitted into its own mip levels with linear filtering
+  static bool canBlit(const LogicalDevice& device, const Image& image);
+
+  // True if the compute downsampler can write `image`'s mip levels: never for UINT/SINT formats
+  bool canDownsample(const Image& image) const;
+
+  /**
+   * @brief Fill mip levels 1 and up of every layer from level 0 by blitting, one level from the
+   * previous one. Level 0 must have been written (and left in any layout); every level ends up in
+   * TRANSFER_SRC_OPTIMAL. Calls LOG_F unless canBlit().
+   */
+  static void recordBlits(CommandBuffer& commandBuffer, Image& image);
+
+  /**
+   * @brief Fill mip levels 1 and up of every layer from level 0, blitting if possible and
+   * downsampling in compute otherwise; the compute path leaves every level in GENERAL. The
+   * descriptors and views used stay allocated until reset().
+   */
+  void record(CommandBuffer& commandBuffer, Image& image);
+
+  /**
+   * @brief Fill every mip level of `target` from `source` in compute, level 0 from mip level 0 of
+   * `source` and each other level from the one before, combining texels with `reduction`. Min and
+   * max reductions take in the odd rows and columns, so every texel of `source` counts.
+   *
+   * `source` must have a single aspect, or a depth one (only the depth of depth/stencil formats is
+   * read), VK_IMAGE_USAGE_SAMPLED_BIT, and be in `sourceLayout` by the time the commands run;
+   * `target` must be half the size of `source` (rounded down), and is left in GENERAL. Nothing orders the reduction after the writes to
+   * `source`, or the uses of `target` after it: that is up to the caller.
+   */
+  void recordReduction(CommandBuffer& commandBuffer,
+                       const Image& source,
+                       VkImageLayout sourceLayout,
+                       Image& target,
+                       MipReduction reduction);
+
+  // Free what record() used. Only once the command buffers it recorded into have finished
+  void reset();
+
+ private:
+  const LogicalDevice& device_;
+
+  VkSampler sampler_;  // Nearest, to read the source level with texelFetch
+  VkDescriptorSetLayout descriptorSetLayout_;
+  DescriptorAllocator descriptors_;
+  std::unique_ptr<ComputePipeline> pipeline_;
+
+  // Allocate the descriptor set of a dispatch reading `sourceView` and writing mip levels
+  // [firstLevel, firstLevel + levelCount) of `target`
+  VkDescriptorSet writeDescriptors(const ImageView& sourceView,
+                                   VkImageLayout sourceLayout,
+                                   Image& target,
+                                   uint32_t firstLevel,
+                                   uint32_t levelCount);
+
+  // Per-level views referenced by the descriptor sets recorded since the last reset()
+  std::vector<std::unique_ptr<ImageView>> views_;
+};
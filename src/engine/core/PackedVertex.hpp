@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <engine/core/VertexLayout.hpp>
+
+/**
+ * @brief Bandwidth-friendly vertex: 20 bytes, against 48 bytes for the same attributes stored as
+ * floats. Filled with the kernels in VertexEncoding.hpp.
+ *
+ * The input assembler expands every attribute back to floats, so shaders declare plain
+ * vec4 / vec2 inputs. Positions come out in [-1, 1] and have to be rescaled with the mesh's
+ * QuantizationRange (`position * scale + offset`), and normals have to be decoded from the
+ * octahedral mapping.
+ */
+struct PackedVertex {
+  int16_t position[4];   // SNORM16 in the mesh's quantization range, w unused
+  uint8_t color[4];      // UNORM8 RGBA
+  int16_t normal[2];     // SNORM16 octahedral
+  uint16_t texcoord[2];  // Half float
+
+  // Defined below, once PackedVertex is complete. Locations 0 and 1 match Vertex, so shaders
+  // written for it only need to rescale the position.
+  struct Layout;
+};
+
+struct PackedVertex::Layout
+    : VertexLayout<VertexBinding<0,
+                                 PackedVertex,
+                                 VK_VERTEX_INPUT_RATE_VERTEX,
+                                 VertexAttribute<0,  // inPosition
+                                                 VK_FORMAT_R16G16B16A16_SNORM,
+                                                 offsetof(PackedVertex, position)>,
+                                 VertexAttribute<1,  // inColor
+                                                 VK_FORMAT_R8G8B8A8_UNORM,
+                                                 offsetof(PackedVertex, color)>,
+                                 VertexAttribute<2,  // inNormal
+                                                 VK_FORMAT_R16G16_SNORM,
+                                                 offsetof(PackedVertex, normal)>,
+                                 VertexAttribute<3,  // inTexcoord
+                                                 VK_FORMAT_R16G16_SFLOAT,
+                                                 offsetof(PackedVertex, texcoord)>>> {};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+
+/**
+ * @brief Position and color only, the packed counterpart of Vertex: 12 bytes instead of 20.
+ */
+struct PackedPositionColorVertex {
+  int16_t position[4];  // SNORM16 in the mesh's quantization range, w unused
+  uint8_t color[4];     // UNORM8 RGBA
+
+  struct Layout;
+};
+
+struct PackedPositionColorVertex::Layout
+    : VertexLayout<VertexBinding<0,
+                                 PackedPositionColorVertex,
+                                 VK_VERTEX_INPUT_RATE_VERTEX,
+                                 VertexAttribute<0,  // inPosition
+                                                 VK_FORMAT_R16G16B16A16_SNORM,
+                                                 offsetof(PackedPositionColorVertex, position)>,
+                                 VertexAttribute<1,  // inColor
+                                                 VK_FORMAT_R8G8B8A8_UNORM,
+                                                 offsetof(PackedPositionColorVertex, color)>>> {};
+
+static_assert(sizeof(PackedPositionColorVertex) == 12,
+              "PackedPositionColorVertex must stay tightly packed");
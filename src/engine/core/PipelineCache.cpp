@@ -0,0 +1,62 @@
+#include "PipelineCache.hpp"
+
+#include <fmtlog/Log.hpp>
+#include <fstream>
+#include <vector>
+
+PipelineCache::PipelineCache(const LogicalDevice& device, const std::filesystem::path& cacheFile)
+    : device_(device),
+      cacheFile_(cacheFile) {
+  std::vector<char> initialData;
+  if (!cacheFile_.empty()) {
+    std::ifstream file(cacheFile_, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+      initialData.resize(static_cast<size_t>(file.tellg()));
+      file.seekg(0);
+      file.read(initialData.data(), initialData.size());
+
+      LOG_D("Loaded {} bytes of pipeline cache from '{}'",
+            initialData.size(),
+            cacheFile_.generic_string());
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = initialData.size();
+  cacheInfo.pInitialData = initialData.data();
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    LOG_F("failed to create pipeline cache!");
+  }
+}
+
+PipelineCache::~PipelineCache() { vkDestroyPipelineCache(device_, pipelineCache_, nullptr); }
+
+bool PipelineCache::save() const {
+  if (cacheFile_.empty()) {
+    return false;
+  }
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS) {
+    LOG_W("Failed to query the size of the pipeline cache");
+    return false;
+  }
+
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, data.data()) != VK_SUCCESS) {
+    LOG_W("Failed to read the pipeline cache");
+    return false;
+  }
+
+  std::ofstream file(cacheFile_, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), dataSize);
+  if (!file) {
+    LOG_W("Failed to write the pipeline cache to '{}'", cacheFile_.generic_string());
+    return false;
+  }
+
+  LOG_D("Saved {} bytes of pipeline cache to '{}'", dataSize, cacheFile_.generic_string());
+  return true;
+}
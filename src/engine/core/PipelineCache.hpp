@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Device.hpp>
+#include <filesystem>
+
+/**
+ * @brief Driver-side cache of compiled pipelines, shared by every pipeline created with it.
+ * Recreating a pipeline the driver has already compiled (e.g. the GPU culler after a swapchain
+ * resize) then skips the shader compilation.
+ *
+ * Optionally backed by a file: loaded at creation and written by save(), so pipelines are only
+ * ever compiled once per driver. The driver validates the data and ignores it when it was written
+ * by another device or driver version.
+ */
+class PipelineCache {
+ public:
+  PipelineCache() = delete;
+  PipelineCache(PipelineCache& other) = delete;
+
+  // Start from the contents of `cacheFile` when it exists and is non-empty
+  PipelineCache(const LogicalDevice& device, const std::filesystem::path& cacheFile = {});
+
+  ~PipelineCache();
+
+  operator VkPipelineCache() const { return pipelineCache_; }
+
+  // Write the current contents to the file given at creation. Returns false when there is none or
+  // writing failed
+  bool save() const;
+
+ private:
+  const LogicalDevice& device_;
+  std::filesystem::path cacheFile_;
+  VkPipelineCache pipelineCache_;
+};
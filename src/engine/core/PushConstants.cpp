@@ -0,0 +1,46 @@
+#include "PushConstants.hpp"
+
+#include <fmtlog/Log.hpp>
+
+void validatePushConstantRanges(const LogicalDevice& device,
+                                const std::vector<VkPushConstantRange>& ranges) {
+  const uint32_t maxSize = device.getPhysicalDevice().getProperties().limits.maxPushConstantsSize;
+
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const VkPushConstantRange& range = ranges[i];
+    if (range.stageFlags == 0 || range.size == 0) {
+      LOG_F("Push constant range {} is empty", i);
+    }
+
+    if (range.offset + range.size > maxSize) {
+      LOG_F("Push constant range {} ends at byte {}, the device supports {}",
+            i,
+            range.offset + range.size,
+            maxSize);
+    }
+
+    // Vulkan allows a stage in only one range of a layout
+    for (size_t j = 0; j < i; j++) {
+      if (ranges[j].stageFlags & range.stageFlags) {
+        LOG_F("Push constant ranges {} and {} share stages {:#x}",
+              j,
+              i,
+              ranges[j].stageFlags & range.stageFlags);
+      }
+    }
+  }
+}
+
+bool hasPushConstantRange(const std::vector<VkPushConstantRange>& ranges,
+                          VkShaderStageFlags stages,
+                          uint32_t offset,
+                          uint32_t size) {
+  for (const VkPushConstantRange& range : ranges) {
+    if (range.stageFlags == stages && range.offset <= offset &&
+        offset + size <= range.offset + range.size) {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Device.hpp>
+#include <type_traits>
+#include <vector>
+
+// Every device can push at least this many bytes; maxPushConstantsSize may allow more
+constexpr uint32_t MIN_PUSH_CONSTANTS_SIZE = 128;
+
+/**
+ * @brief Compile-time description of one push constant range: the struct T pushed into it, the
+ * shader stages that read it, and its byte offset in the pipeline's push constant block.
+ *
+ * A pipeline declares the range with getRange(), and CommandBuffer::pushConstants() takes the
+ * same type, so the stages and the size of what is pushed always match the declaration.
+ *
+ * Example:
+ *   struct DrawConstants { glm::mat4 transform; uint32_t materialIndex; uint32_t pad[3]; };
+ *   using DrawPushConstants = PushConstants<DrawConstants, VK_SHADER_STAGE_VERTEX_BIT>;
+ *
+ *   GraphicsPipeline<Vertex> pipeline(device, swapchain, subpass, vertexShader, fragmentShader,
+ *                                     setLayouts, {DrawPushConstants::getRange()});
+ *   commandBuffer.pushConstants<DrawPushConstants>(pipeline, {transform, 3});
+ *
+ * T is copied as raw bytes, so it must follow the shader's std430 layout. The range has to end
+ * within MIN_PUSH_CONSTANTS_SIZE, so it fits on any device; validatePushConstantRanges() still
+ * checks each pipeline's ranges against the device's actual limit.
+ */
+template <class T, VkShaderStageFlags Stages, uint32_t Offset = 0>
+struct PushConstants {
+  static_assert(std::is_trivially_copyable_v<T>, "Push constants are copied as raw bytes");
+  static_assert(sizeof(T) % 4 == 0, "Push constant ranges must be a multiple of 4 bytes");
+  static_assert(Offset % 4 == 0, "Push constant offsets must be a multiple of 4 bytes");
+  static_assert(Offset + sizeof(T) <= MIN_PUSH_CONSTANTS_SIZE,
+                "Push constant ranges must fit in the 128 bytes every device supports");
+  static_assert(Stages != 0, "Push constants must be visible to at least one stage");
+  static_assert((Stages & ~(VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)) == 0,
+                "Push constants are only supported for graphics and compute stages");
+  static_assert(!(Stages & VK_SHADER_STAGE_COMPUTE_BIT) || Stages == VK_SHADER_STAGE_COMPUTE_BIT,
+                "A range can't be shared between compute and graphics stages");
+
+  using Type = T;
+
+  static constexpr VkShaderStageFlags stages = Stages;
+  static constexpr uint32_t offset = Offset;
+  static constexpr uint32_t size = sizeof(T);
+
+  static constexpr bool isCompute = Stages == VK_SHADER_STAGE_COMPUTE_BIT;
+
+  static constexpr VkPushConstantRange getRange() { return {stages, offset, size}; }
+};
+
+/**
+ * @brief Calls LOG_F if `ranges` don't fit in the device's maxPushConstantsSize, overlap with
+ * shared stages, or have no stages. Pipelines run this when their layout is created.
+ */
+void validatePushConstantRanges(const LogicalDevice& device,
+                                const std::vector<VkPushConstantRange>& ranges);
+
+// True if a single range of `ranges` was declared with exactly `stages` and covers the bytes
+bool hasPushConstantRange(const std::vector<VkPushConstantRange>& ranges,
+                          VkShaderStageFlags stages,
+                          uint32_t offset,
+                          uint32_t size);
@@ -3,6 +3,25 @@
 #include <engine/utils/vk.hpp>
 #include <fmtlog/Log.hpp>
 
+namespace {
+
+// How the subpasses use an attachment, in subpass order
+struct AttachmentUse {
+  bool used = false;
+  bool firstUseWrites = false;
+  VkImageLayout lastLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  void add(VkImageLayout layout, bool writes) {
+    if (!used) {
+      used = true;
+      firstUseWrites = writes;
+    }
+    lastLayout = layout;
+  }
+};
+
+}  // namespace
+
 RenderPass::RenderPass(const LogicalDevice& device, uint32_t width, uint32_t height)
     : device_(device),
       width_(width),
@@ -16,24 +35,39 @@ RenderPass::~RenderPass() {
   vkDestroyRenderPass(device_, renderPass_, nullptr);
 }
 
-const Attachment& RenderPass::createAttachment(VkFormat format) {
+const Attachment& RenderPass::createAttachment(VkFormat format, const AttachmentOps& ops) {
   if (finalized_) {
     LOG_F("cannot modify a render pass after it is finalized");
   }
 
-  attachments_.push_back(Attachment(*this, {width_, height_}, format, attachments_.size()));
+  attachments_.push_back(Attachment(*this, {width_, height_}, format, attachments_.size(), ops));
   return attachments_.back();
 }
 
 Subpass& RenderPass::createSubpass(
-    std::vector<std::reference_wrapper<const Attachment>> colorAttachments) {
+    std::vector<std::reference_wrapper<const Attachment>> colorAttachments,
+    const Attachment* depthStencilAttachment,
+    bool depthReadOnly) {
   if (finalized_) {
     LOG_F("cannot modify a render pass after it is finalized");
   }
 
   // TODO: validate that all attachments are owned by this render pass
 
-  subpasses_.push_back(Subpass(*this, subpasses_.size(), colorAttachments));
+  for (const Attachment& attachment : colorAttachments) {
+    if (attachment.isDepthStencil()) {
+      LOG_F("Attachment {} has a depth / stencil format but is used as a color attachment",
+            attachment.getIndex());
+    }
+  }
+
+  if (depthStencilAttachment && !depthStencilAttachment->isDepthStencil()) {
+    LOG_F("Attachment {} has a color format but is used as a depth / stencil attachment",
+          depthStencilAttachment->getIndex());
+  }
+
+  subpasses_.push_back(
+      Subpass(*this, subpasses_.size(), colorAttachments, depthStencilAttachment, depthReadOnly));
   return subpasses_.back();
 }
 
@@ -42,8 +76,20 @@ void RenderPass::finalize() {
     LOG_F("cannot finalize a render pass a second time");
   }
 
-  std::vector<VkAttachmentDescription> vkAttachmentDescriptions;
-  vkAttachmentDescriptions.resize(attachments_.size());
+  // Where each attachment is first and last used decides the ops and layouts left unset
+  std::vector<AttachmentUse> uses(attachments_.size());
+  for (const auto& subpass : subpasses_) {
+    for (const VkAttachmentReference& reference : subpass.getColorAttachmentReferences()) {
+      uses[reference.attachment].add(reference.layout, true);
+    }
+
+    if (const VkAttachmentReference* reference = subpass.getDepthStencilAttachmentReference()) {
+      uses[reference->attachment].add(reference->layout, !subpass.isDepthReadOnly());
+    }
+  }
+
+  attachmentDescriptions_.resize(attachments_.size());
+  clearValues_.resize(attachments_.size());
 
   size_t i = 0;
   for (const auto& attachment : attachments_) {
@@ -52,23 +98,45 @@ void RenderPass::finalize() {
       LOG_F("Assert failed: i != attachment index");
     }
 
-    vkAttachmentDescriptions[i].format = attachment.getFormat();
-
-    // TODO: make these non-generic
-    vkAttachmentDescriptions[i].samples = VK_SAMPLE_COUNT_1_BIT;
-    vkAttachmentDescriptions[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    vkAttachmentDescriptions[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    vkAttachmentDescriptions[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    vkAttachmentDescriptions[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    vkAttachmentDescriptions[i].initialLayout =
-        VK_IMAGE_LAYOUT_UNDEFINED;  // Initial layout of our VkImage is going to
-                                    // be undefined, since this is the default
-                                    // state of all VkImages that come from the
-                                    // Swapchain.
-    vkAttachmentDescriptions[i].finalLayout =
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;  // Final layout of the color
-                                          // attachment is one that can be
-                                          // presented to the screen
+    const AttachmentOps& ops = attachment.getOps();
+    const AttachmentUse& use = uses[i];
+    if (!use.used) {
+      LOG_F("Attachment {} is not used by any subpass", i);
+    }
+
+    // Previous contents are only worth loading if the initial layout kept them, and clearing is
+    // a write, which a read-only first use isn't allowed
+    VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    if (ops.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+      loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    } else if (use.firstUseWrites) {
+      loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    }
+
+    // Nobody reads what isn't given a final layout, so it never has to leave tile memory
+    VkAttachmentStoreOp storeOp =
+        ops.finalLayout ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkAttachmentDescription& description = attachmentDescriptions_[i];
+    description.format = attachment.getFormat();
+
+    // TODO: support multisampling
+    description.samples = VK_SAMPLE_COUNT_1_BIT;
+    description.loadOp = ops.loadOp.value_or(loadOp);
+    description.storeOp = ops.storeOp.value_or(storeOp);
+
+    if (attachment.getAspect() & VK_IMAGE_ASPECT_STENCIL_BIT) {
+      description.stencilLoadOp = ops.stencilLoadOp.value_or(loadOp);
+      description.stencilStoreOp = ops.stencilStoreOp.value_or(storeOp);
+    } else {
+      description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+
+    description.initialLayout = ops.initialLayout;
+    description.finalLayout = ops.finalLayout.value_or(use.lastLayout);
+
+    clearValues_[i] = attachment.getClearValue();
     i++;
   }
 
@@ -88,11 +156,11 @@ void RenderPass::finalize() {
     vkSubpasses[i].colorAttachmentCount = subpass.getColorAttachmentReferences().size();
     vkSubpasses[i].pColorAttachments = subpass.getColorAttachmentReferences().data();
 
-    // TODO: support other types of attachments
+    // Depth / stencil attachments are tested and written by the fixed function stages around the
+    // fragment shader (VK_PIPELINE_STAGE_EARLY / LATE_FRAGMENT_TESTS_BIT)
+    vkSubpasses[i].pDepthStencilAttachment = subpass.getDepthStencilAttachmentReference();
 
-    // Depth / stencil attachments are always write-only, output attachments,
-    // from the ????? shader pipeline stage (probably between the vertex and
-    // fragment shaders) subpass.pDepthStencilAttachment = ???;
+    // TODO: support other types of attachments
 
     // Input attachments are what they say on the box, input attachments, and
     // can be either depth or color subpass.inputAttachmentCount = ????;
@@ -110,8 +178,8 @@ void RenderPass::finalize() {
   VkRenderPassCreateInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 
-  renderPassInfo.attachmentCount = vkAttachmentDescriptions.size();
-  renderPassInfo.pAttachments = vkAttachmentDescriptions.data();
+  renderPassInfo.attachmentCount = attachmentDescriptions_.size();
+  renderPassInfo.pAttachments = attachmentDescriptions_.data();
 
   renderPassInfo.subpassCount = vkSubpasses.size();
   renderPassInfo.pSubpasses = vkSubpasses.data();
@@ -146,16 +214,55 @@ const Framebuffer& RenderPass::createFramebuffer(
 
 Subpass::Subpass(const RenderPass& parent,
                  uint32_t index,
-                 std::vector<std::reference_wrapper<const Attachment>> colorAttachments)
+                 std::vector<std::reference_wrapper<const Attachment>> colorAttachments,
+                 const Attachment* depthStencilAttachment,
+                 bool depthReadOnly)
     : colorAttachments_(colorAttachments),
       subpassIndex_(index),
-      parent_(parent) {
+      parent_(parent),
+      depthStencilAttachment_(depthStencilAttachment),
+      depthReadOnly_(depthStencilAttachment && depthReadOnly) {
   // TODO: support other kinds of attachments
   colorAttachmentReferences_.resize(colorAttachments_.size());
   for (size_t i = 0; i < colorAttachments_.size(); i++) {
     colorAttachmentReferences_[i].attachment = colorAttachments_[i].get().getIndex();
     colorAttachmentReferences_[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
   }
+
+  if (depthStencilAttachment_) {
+    depthStencilAttachmentReference_.attachment = depthStencilAttachment_->getIndex();
+    depthStencilAttachmentReference_.layout =
+        depthReadOnly_ ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                       : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  }
+}
+
+VkPipelineStageFlags Subpass::getAttachmentStages() const {
+  VkPipelineStageFlags stages = 0;
+  if (!colorAttachments_.empty()) {
+    stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  }
+
+  // Depth is tested before the fragment shader when it can be (early-Z), after it otherwise
+  if (depthStencilAttachment_) {
+    stages |=
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  }
+
+  return stages;
+}
+
+VkAccessFlags Subpass::getAttachmentWriteAccess() const {
+  VkAccessFlags access = 0;
+  if (!colorAttachments_.empty()) {
+    access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  }
+
+  if (depthStencilAttachment_ && !depthReadOnly_) {
+    access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  }
+
+  return access;
 }
 
 void Subpass::addStartExternalDependency() {
@@ -185,14 +292,84 @@ void Subpass::addStartExternalDependency() {
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+  // Depth buffers aren't swapchain images, so a single one is shared by every frame in flight:
+  // the previous frame's depth tests must be done before this frame clears it
+  if (depthStencilAttachment_) {
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask |=
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  }
+
   dependencies_.push_back(dependency);
 }
 
-Attachment::Attachment(const RenderPass& parent, VkExtent2D extent, VkFormat format, uint32_t index)
+void Subpass::dependOn(const Subpass& other) {
+  if (&other.parent_ != &parent_) {
+    LOG_F("Subpasses of different render passes cannot depend on each other");
+  }
+
+  if (other.subpassIndex_ >= subpassIndex_) {
+    LOG_F("Subpass {} can only depend on an earlier subpass, not {}",
+          subpassIndex_,
+          other.subpassIndex_);
+  }
+
+  VkSubpassDependency dependency{};
+  dependency.srcSubpass = other.subpassIndex_;
+  dependency.dstSubpass = subpassIndex_;
+
+  dependency.srcStageMask = other.getAttachmentStages();
+  dependency.srcAccessMask = other.getAttachmentWriteAccess();
+
+  // Reads as well as writes: a depth test reads the attachment
+  dependency.dstStageMask = getAttachmentStages();
+  dependency.dstAccessMask = getAttachmentWriteAccess();
+  if (!colorAttachments_.empty()) {
+    dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+  }
+  if (depthStencilAttachment_) {
+    dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  }
+
+  if (dependency.srcStageMask == 0 || dependency.dstStageMask == 0) {
+    LOG_F("Subpass {} and {} must both have attachments to depend on each other",
+          subpassIndex_,
+          other.subpassIndex_);
+  }
+
+  dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  dependencies_.push_back(dependency);
+}
+
+Attachment::Attachment(const RenderPass& parent,
+                       VkExtent2D extent,
+                       VkFormat format,
+                       uint32_t index,
+                       const AttachmentOps& ops)
     : parent_(parent),
       extent_(extent),
       format_(format),
-      attachmentIndex_(index) {}
+      attachmentIndex_(index),
+      ops_(ops) {}
+
+VkClearValue Attachment::getClearValue() const {
+  if (ops_.clearValue) {
+    return *ops_.clearValue;
+  }
+
+  VkClearValue clearValue{};
+  if (isDepthStencil()) {
+    clearValue.depthStencil = {1.0f, 0};
+  } else {
+    clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  }
+
+  return clearValue;
+}
 
 Framebuffer::Framebuffer(const RenderPass& parent,
                          std::vector<FramebufferBinding> attachmentBindings)
@@ -5,6 +5,7 @@
 #include <engine/core/Device.hpp>
 #include <engine/core/Image.hpp>
 #include <list>
+#include <optional>
 
 class Subpass;
 class Attachment;
@@ -14,6 +15,46 @@ class Framebuffer;
 // which attachment an ImageView should be bound for
 using FramebufferBinding = std::pair<const Attachment&, const ImageView&>;
 
+/**
+ * @brief How the contents of an Attachment enter and leave its RenderPass. Whatever is left unset
+ * is inferred by RenderPass::finalize() from how the subpasses use the attachment:
+ *
+ * - finalLayout: the layout of the attachment's last use, so that no transition ends the pass.
+ *   An attachment without a finalLayout is taken as not read after the pass
+ * - storeOp: STORE if finalLayout is set, DONT_CARE otherwise, so that tile-based GPUs don't write
+ *   depth buffers and intermediate targets back to memory only to discard them
+ * - loadOp: LOAD if initialLayout says the previous contents are kept, otherwise CLEAR if the
+ *   first subpass using the attachment writes it, DONT_CARE if it only reads it
+ * - stencil ops: the same as the depth ops for formats with stencil, DONT_CARE otherwise
+ */
+struct AttachmentOps {
+  std::optional<VkAttachmentLoadOp> loadOp;
+  std::optional<VkAttachmentStoreOp> storeOp;
+  std::optional<VkAttachmentLoadOp> stencilLoadOp;
+  std::optional<VkAttachmentStoreOp> stencilStoreOp;
+
+  // UNDEFINED discards the previous contents, which costs nothing
+  VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  std::optional<VkImageLayout> finalLayout;
+
+  // For VK_ATTACHMENT_LOAD_OP_CLEAR. Black for color and the far plane (1.0) for depth by default
+  std::optional<VkClearValue> clearValue;
+
+  // A swapchain image, presented once the render pass ends
+  static AttachmentOps presented() {
+    AttachmentOps ops;
+    ops.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    return ops;
+  }
+
+  // Sampled by later passes, e.g. a shadow map or an offscreen color target
+  static AttachmentOps sampled() {
+    AttachmentOps ops;
+    ops.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return ops;
+  }
+};
+
 /**
  * @brief The RenderPass class. This is where a lot of the magic happens.
  * A RenderPass describes a sequence of SubPasses, the attachments that those SubPasses will use,
@@ -53,19 +94,27 @@ class RenderPass {
   /**
    * @brief Create a Attachment that is compatible / bound to the specified ImageView
    *
-   * @param imageView
+   * @param format format of the ImageViews bound to the attachment
+   * @param ops how its contents are loaded and stored; by default it is cleared and not kept
    * @return const Attachment&
    */
-  const Attachment& createAttachment(VkFormat format);
+  const Attachment& createAttachment(VkFormat format, const AttachmentOps& ops = {});
 
   /**
    * @brief Create a Subpass within this Render pass. Ordering happens later
    *
    * @param colorAttachments the number of color attachments this subpass will produce
+   * @param depthStencilAttachment optional depth and/or stencil attachment the subpass tests
+   * against
+   * @param depthReadOnly true if the subpass only tests against `depthStencilAttachment` without
+   * writing it, e.g. the shading pass after a depth pre-pass, which lets it stay in a read-only
+   * layout
    * @return const SubPass&
    */
   // TODO: bind a graphics pipeline to the subpass at this step?
-  Subpass& createSubpass(std::vector<std::reference_wrapper<const Attachment>> colorAttachments);
+  Subpass& createSubpass(std::vector<std::reference_wrapper<const Attachment>> colorAttachments,
+                         const Attachment* depthStencilAttachment = nullptr,
+                         bool depthReadOnly = false);
 
   const Framebuffer& createFramebuffer(std::vector<FramebufferBinding> attachmentBindings);
 
@@ -83,6 +132,17 @@ class RenderPass {
 
   size_t getAttachmentCount() const;
 
+  // In attachment index order
+  const std::list<Attachment>& getAttachments() const { return attachments_; }
+
+  // Load / store ops and layouts of each attachment, inferred where unset. Once finalized
+  const std::vector<VkAttachmentDescription>& getAttachmentDescriptions() const {
+    return attachmentDescriptions_;
+  }
+
+  // Clear value of each attachment, for vkCmdBeginRenderPass. Once finalized
+  const std::vector<VkClearValue>& getClearValues() const { return clearValues_; }
+
   VkExtent2D getExtent() const { return {width_, height_}; }
 
  private:
@@ -96,6 +156,10 @@ class RenderPass {
   std::list<Attachment> attachments_;
   std::list<Framebuffer> framebuffers_;
 
+  // Built by finalize()
+  std::vector<VkAttachmentDescription> attachmentDescriptions_;
+  std::vector<VkClearValue> clearValues_;
+
   uint32_t width_;
   uint32_t height_;
   bool finalized_ = false;
@@ -120,12 +184,23 @@ class Subpass {
    */
   Subpass(const RenderPass& parent,
           uint32_t index,
-          std::vector<std::reference_wrapper<const Attachment>> colorAttachments);
+          std::vector<std::reference_wrapper<const Attachment>> colorAttachments,
+          const Attachment* depthStencilAttachment = nullptr,
+          bool depthReadOnly = false);
 
   const std::vector<VkAttachmentReference>& getColorAttachmentReferences() const {
     return colorAttachmentReferences_;
   }
 
+  // Null if the subpass has no depth / stencil attachment
+  const VkAttachmentReference* getDepthStencilAttachmentReference() const {
+    return depthStencilAttachment_ ? &depthStencilAttachmentReference_ : nullptr;
+  }
+
+  bool hasDepthStencil() const { return depthStencilAttachment_ != nullptr; }
+
+  bool isDepthReadOnly() const { return depthReadOnly_; }
+
   uint32_t getIndex() const { return subpassIndex_; }
 
   const std::vector<VkSubpassDependency>& getDependencies() const { return dependencies_; }
@@ -134,6 +209,11 @@ class Subpass {
 
   void addEndExternalDependency();
 
+  /**
+   * @brief Wait for the attachment writes of `other`, an earlier subpass, before this subpass
+   * touches its own attachments, e.g. for a shading pass to test against the depth a pre-pass
+   * wrote. Only orders the same pixels of both subpasses (VK_DEPENDENCY_BY_REGION_BIT).
+   */
   void dependOn(const Subpass& other);
 
   bool isParent(const RenderPass& other) const { return other == parent_; }
@@ -145,7 +225,14 @@ class Subpass {
   uint32_t subpassIndex_;
   std::vector<std::reference_wrapper<const Attachment>> colorAttachments_;
   std::vector<VkAttachmentReference> colorAttachmentReferences_;
+  const Attachment* depthStencilAttachment_;
+  VkAttachmentReference depthStencilAttachmentReference_{};
+  bool depthReadOnly_;
   std::vector<VkSubpassDependency> dependencies_;
+
+  // The pipeline stages and accesses this subpass uses its attachments in
+  VkPipelineStageFlags getAttachmentStages() const;
+  VkAccessFlags getAttachmentWriteAccess() const;
 };
 
 /**
@@ -177,7 +264,11 @@ class Subpass {
  */
 class Attachment {
  public:
-  Attachment(const RenderPass& parent, VkExtent2D extent, VkFormat format, uint32_t index);
+  Attachment(const RenderPass& parent,
+             VkExtent2D extent,
+             VkFormat format,
+             uint32_t index,
+             const AttachmentOps& ops = {});
 
   VkExtent2D getExtent() const { return extent_; }
 
@@ -185,6 +276,18 @@ class Attachment {
 
   uint32_t getIndex() const { return attachmentIndex_; }
 
+  // Color, depth and/or stencil, depending on the format
+  VkImageAspectFlags getAspect() const { return getFormatAspect(format_); }
+
+  bool isDepthStencil() const { return !(getAspect() & VK_IMAGE_ASPECT_COLOR_BIT); }
+
+  // As requested, before inference (see RenderPass::getAttachmentDescriptions())
+  const AttachmentOps& getOps() const { return ops_; }
+
+  // What the attachment is cleared to when the render pass begins: AttachmentOps::clearValue, or
+  // black for color and the far plane (1.0) and 0 for depth / stencil
+  VkClearValue getClearValue() const;
+
   bool isParent(const RenderPass& other) const { return other == parent_; }
 
  private:
@@ -192,6 +295,7 @@ class Attachment {
   uint32_t attachmentIndex_;  // The index of the attachment in the RenderPass attachment list
   VkExtent2D extent_;
   VkFormat format_;
+  AttachmentOps ops_;
 };
 
 class Framebuffer {
@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 
 #include <ShaderModule.hpp>
+#include <engine/utils/hash.hpp>
 #include <fmtlog/Log.hpp>
 #include <fstream>
 
@@ -11,17 +12,25 @@ using namespace std::filesystem;
 ShaderModule::ShaderModule(const LogicalDevice& device, const path& shaderFile) : device_(device) {
   // TODO: async?
   shaderBinary_ = readBinaryFile(shaderFile);
+  binaryHash_ = hashBytes(shaderBinary_.data(), shaderBinary_.size());
   shaderModule_ = createVkShaderModule(device_, shaderBinary_);
 }
 
 ShaderModule::ShaderModule(const LogicalDevice& device, const ShaderBinary& shaderContents)
     : device_(device) {
   shaderBinary_ = shaderContents;
+  binaryHash_ = hashBytes(shaderBinary_.data(), shaderBinary_.size());
   shaderModule_ = createVkShaderModule(device_, shaderBinary_);
 }
 
 ShaderModule::~ShaderModule() { vkDestroyShaderModule(device_, shaderModule_, nullptr); }
 
+size_t ShaderModule::getKey() const {
+  size_t key = binaryHash_;
+  hashCombine(key, specialization_.getHash());
+  return key;
+}
+
 ShaderBinary ShaderModule::readBinaryFile(const path& shaderFile) {
   path absoluteShaderFile = absolute(shaderFile);
 
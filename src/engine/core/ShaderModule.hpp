@@ -1,7 +1,9 @@
 #pragma once
 
 #include <engine/core/Device.hpp>
+#include <engine/core/SpecializationConstants.hpp>
 #include <engine/core/Vertex.hpp>
+#include <engine/core/VertexLayout.hpp>
 #include <filesystem>
 #include <vector>
 
@@ -28,25 +30,33 @@ class ShaderModule {
   // is the correct symbol name
   const char* entryPointName() { return "main"; }
 
+  /**
+   * @brief Specialize this shader with a typed set of specialization constants. The values are
+   * copied, and applied to every pipeline created from this module afterwards.
+   */
+  template <class... Constants>
+  void specialize(const SpecializationConstants<Constants...>& constants) {
+    specialization_ = constants;
+  }
+
+  // nullptr if this module has not been specialized
+  const VkSpecializationInfo* getSpecializationInfo() { return specialization_.get(); }
+
+  /**
+   * @brief Hash identifying this module for pipeline caching purposes: covers the SPIR-V binary and
+   * any specialization constants, so two permutations of the same shader get different keys.
+   */
+  size_t getKey() const;
+
  private:
   ShaderBinary readBinaryFile(const std::filesystem::path& shaderFile);
 
  private:
   const LogicalDevice& device_;
   ShaderBinary shaderBinary_;
+  size_t binaryHash_;
   VkShaderModule shaderModule_;
-};
-
-template <class InputType>
-class VertexShaderInput {
- public:
-  static VkVertexInputBindingDescription getBindingDescription() {
-    return InputType::getBindingDescription();
-  }
-
-  static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
-    return InputType::getAttributeDescriptions();
-  }
+  SpecializationInfo specialization_;
 };
 
 template <class InputType>
@@ -59,18 +69,17 @@ class VertexShaderModule : public ShaderModule {
 
   const VkPipelineVertexInputStateCreateInfo&
   VertexShaderModule::getVertexShaderBindingDescription() {
-    vertexInputBindingDescription_ = VertexShaderInput<InputType>::getBindingDescription();
-    vertexInputAttributeDescription_ = VertexShaderInput<InputType>::getAttributeDescriptions();
+    // The descriptions live in static arrays built at compile time, so they are referenced rather
+    // than copied
+    using Layout = VertexLayoutOf<InputType>;
 
-    // Dummy vertex shader input descriptor that indicates we aren't going to
-    // upload anything (since the vertices are compiled in already)
     vertexShaderInputDescription_.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexShaderInputDescription_.vertexBindingDescriptionCount = 1;
-    vertexShaderInputDescription_.pVertexBindingDescriptions = &vertexInputBindingDescription_;
+    vertexShaderInputDescription_.vertexBindingDescriptionCount =
+        static_cast<uint32_t>(Layout::bindings.size());
+    vertexShaderInputDescription_.pVertexBindingDescriptions = Layout::bindings.data();
     vertexShaderInputDescription_.vertexAttributeDescriptionCount =
-        vertexInputAttributeDescription_.size();
-    vertexShaderInputDescription_.pVertexAttributeDescriptions =
-        vertexInputAttributeDescription_.data();
+        static_cast<uint32_t>(Layout::attributes.size());
+    vertexShaderInputDescription_.pVertexAttributeDescriptions = Layout::attributes.data();
     vertexShaderInputDescription_.flags = 0;
     vertexShaderInputDescription_.pNext = NULL;
 
@@ -91,6 +100,4 @@ class VertexShaderModule : public ShaderModule {
  private:
   VkPipelineVertexInputStateCreateInfo vertexShaderInputDescription_;
   VkPipelineInputAssemblyStateCreateInfo vertexShaderInputAssembly_;
-  VkVertexInputBindingDescription vertexInputBindingDescription_;
-  std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescription_;
 };
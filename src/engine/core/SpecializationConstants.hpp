@@ -0,0 +1,206 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstring>
+#include <engine/utils/hash.hpp>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Compile-time description of a single specialization constant.
+ *
+ * ConstantId must match the `layout(constant_id = N)` declaration in the shader, and T is the C++
+ * type used to supply the value. Only the scalar types that SPIR-V allows for specialization are
+ * accepted. Booleans are stored as a VkBool32, since that is how the driver reads them.
+ *
+ * Example:
+ *   using LightCount = SpecializationConstant<0, uint32_t>;
+ *   using UseFog = SpecializationConstant<1, bool>;
+ */
+template <uint32_t ConstantId, class T>
+struct SpecializationConstant {
+  static_assert(std::is_same_v<T, bool> || std::is_same_v<T, int32_t> ||
+                    std::is_same_v<T, uint32_t> || std::is_same_v<T, float> ||
+                    std::is_same_v<T, double>,
+                "Specialization constants must be bool, int32_t, uint32_t, float or double");
+
+  static constexpr uint32_t id = ConstantId;
+
+  using Type = T;
+  using StorageType = std::conditional_t<std::is_same_v<T, bool>, VkBool32, T>;
+};
+
+/**
+ * @brief Type-erased, self-contained copy of a set of specialization constants.
+ *
+ * This is what a ShaderModule holds on to once it has been specialized: it owns the map entries
+ * and the packed data, so the VkSpecializationInfo it hands out stays valid for as long as the
+ * SpecializationInfo itself is alive.
+ */
+class SpecializationInfo {
+ public:
+  SpecializationInfo() = default;
+
+  SpecializationInfo(const VkSpecializationMapEntry* entries,
+                     size_t entryCount,
+                     const void* data,
+                     size_t dataSize)
+      : entries_(entries, entries + entryCount),
+        data_(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + dataSize) {
+    hash_ = hashBytes(entries_.data(), entries_.size() * sizeof(VkSpecializationMapEntry));
+    hash_ = hashBytes(data_.data(), data_.size(), hash_);
+  }
+
+  bool empty() const { return entries_.empty(); }
+
+  // Hash over both the layout and the values, suitable for folding into a pipeline key
+  size_t getHash() const { return hash_; }
+
+  // Returns nullptr when there is nothing to specialize, which is what
+  // VkPipelineShaderStageCreateInfo::pSpecializationInfo expects in that case
+  const VkSpecializationInfo* get() {
+    if (empty()) {
+      return nullptr;
+    }
+
+    // Refresh the pointers every time: this object may have been copied or moved since the last
+    // call, which would leave stale pointers behind
+    info_.mapEntryCount = static_cast<uint32_t>(entries_.size());
+    info_.pMapEntries = entries_.data();
+    info_.dataSize = data_.size();
+    info_.pData = data_.data();
+
+    return &info_;
+  }
+
+ private:
+  std::vector<VkSpecializationMapEntry> entries_;
+  std::vector<uint8_t> data_;
+  size_t hash_ = 0;
+  VkSpecializationInfo info_{};
+};
+
+namespace detail {
+
+// Layout computations for SpecializationConstants. These live outside the class so they can be
+// used in constant expressions while the class itself is still incomplete.
+template <class... Constants>
+struct SpecializationLayout {
+  static constexpr size_t count = sizeof...(Constants);
+
+  static constexpr std::array<uint32_t, count> ids = {Constants::id...};
+  static constexpr std::array<uint32_t, count> sizes = {
+      static_cast<uint32_t>(sizeof(typename Constants::StorageType))...};
+
+  static constexpr size_t indexOf(uint32_t constantId) {
+    for (size_t i = 0; i < count; i++) {
+      if (ids[i] == constantId) {
+        return i;
+      }
+    }
+    return count;
+  }
+
+  static constexpr bool idsAreUnique() {
+    for (size_t i = 0; i < count; i++) {
+      for (size_t j = i + 1; j < count; j++) {
+        if (ids[i] == ids[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  static constexpr uint32_t totalSize() {
+    uint32_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+      size += sizes[i];
+    }
+    return size;
+  }
+
+  static constexpr std::array<VkSpecializationMapEntry, count> makeEntries() {
+    std::array<VkSpecializationMapEntry, count> entries{};
+    uint32_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+      entries[i].constantID = ids[i];
+      entries[i].offset = offset;
+      entries[i].size = sizes[i];
+      offset += sizes[i];
+    }
+    return entries;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief A typed set of specialization constants.
+ *
+ * The layout (constant IDs, offsets and sizes) is computed at compile time from the list of
+ * SpecializationConstant types. Values are set by constant ID, and both the ID and the value type
+ * are checked by the compiler:
+ *
+ *   using ForwardShaderConstants =
+ *       SpecializationConstants<SpecializationConstant<0, uint32_t>,  // light count
+ *                               SpecializationConstant<1, bool>>;     // fog enabled
+ *
+ *   ForwardShaderConstants constants;
+ *   constants.set<0>(8);
+ *   constants.set<1>(true);
+ *   fragmentShader.specialize(constants);
+ *
+ * Setting an ID that was not declared fails to compile.
+ */
+template <class... Constants>
+class SpecializationConstants {
+ public:
+  static constexpr size_t count = sizeof...(Constants);
+
+  static_assert(count > 0, "A specialization constant set needs at least one constant");
+
+ private:
+  using Layout = detail::SpecializationLayout<Constants...>;
+
+  static_assert(Layout::idsAreUnique(), "Specialization constant IDs must be unique within a set");
+
+  static constexpr std::array<VkSpecializationMapEntry, count> entries_ = Layout::makeEntries();
+
+  template <uint32_t ConstantId>
+  struct Lookup {
+    static constexpr size_t index = Layout::indexOf(ConstantId);
+    static_assert(index < count, "constant_id is not part of this specialization constant set");
+    using Constant = std::tuple_element_t<index, std::tuple<Constants...>>;
+  };
+
+ public:
+  // The C++ type of the constant declared with the given ID
+  template <uint32_t ConstantId>
+  using TypeOf = typename Lookup<ConstantId>::Constant::Type;
+
+  template <uint32_t ConstantId>
+  void set(TypeOf<ConstantId> value) {
+    using Constant = typename Lookup<ConstantId>::Constant;
+    typename Constant::StorageType stored = static_cast<typename Constant::StorageType>(value);
+    std::memcpy(&data_[entries_[Lookup<ConstantId>::index].offset], &stored, sizeof(stored));
+  }
+
+  template <uint32_t ConstantId>
+  TypeOf<ConstantId> get() const {
+    using Constant = typename Lookup<ConstantId>::Constant;
+    typename Constant::StorageType stored;
+    std::memcpy(&stored, &data_[entries_[Lookup<ConstantId>::index].offset], sizeof(stored));
+    return static_cast<TypeOf<ConstantId>>(stored);
+  }
+
+  operator SpecializationInfo() const {
+    return SpecializationInfo(entries_.data(), entries_.size(), data_.data(), data_.size());
+  }
+
+ private:
+  std::array<uint8_t, Layout::totalSize()> data_{};
+};
@@ -0,0 +1,94 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <fmtlog/Log.hpp>
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+UniformRing::UniformRing(const LogicalDevice& device,
+                         DescriptorSetLayoutCache& layoutCache,
+                         size_t frameCount,
+                         size_t bytesPerFrame,
+                         uint32_t maxAllocationSize,
+                         VkDescriptorType type,
+                         VkShaderStageFlags stages)
+    : device_(device),
+      maxAllocationSize_(maxAllocationSize),
+      frameCount_(std::max<size_t>(frameCount, 1)) {
+  const VkPhysicalDeviceLimits limits = device_.getPhysicalDevice().getProperties().limits;
+
+  VkBufferUsageFlags usage = 0;
+  uint32_t maxRange = 0;
+  if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+    usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    alignment_ = static_cast<uint32_t>(limits.minUniformBufferOffsetAlignment);
+    maxRange = limits.maxUniformBufferRange;
+  } else if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+    usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    alignment_ = static_cast<uint32_t>(limits.minStorageBufferOffsetAlignment);
+    maxRange = limits.maxStorageBufferRange;
+  } else {
+    LOG_F("A uniform ring is bound as a dynamic uniform or storage buffer, not descriptor type {}",
+          static_cast<int>(type));
+  }
+
+  if (maxAllocationSize_ == 0 || maxAllocationSize_ > maxRange) {
+    LOG_F("Uniform ring allocations of up to {} bytes; the device allows up to {}",
+          maxAllocationSize_,
+          maxRange);
+  }
+
+  // Every region starts aligned, and the last one is followed by enough padding for the range
+  // bound at its last allocation to stay inside the buffer
+  frameSize_ = alignUp(std::max<size_t>(bytesPerFrame, maxAllocationSize_), alignment_);
+  buffer_ = std::make_unique<MappedBuffer<uint8_t>>(
+      device_, frameSize_ * frameCount_ + maxAllocationSize_, usage);
+
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorType = type;
+  binding.descriptorCount = 1;
+  binding.stageFlags = stages;
+  layout_ = layoutCache.get({binding});
+
+  descriptors_ = std::make_unique<DescriptorAllocator>(
+      device_, 1, std::vector<DescriptorAllocator::PoolRatio>{{type, 1.0f}});
+  set_ = descriptors_->allocate(layout_);
+
+  DescriptorWriter writer(device_);
+  writer.writeBuffer(set_, 0, type, *buffer_, 0, maxAllocationSize_);
+  writer.update();
+
+  beginFrame(0);
+}
+
+void UniformRing::beginFrame(size_t frame) {
+  if (frame >= frameCount_) {
+    LOG_F("Frame {} of a uniform ring with {} frames", frame, frameCount_);
+  }
+
+  frameBegin_ = frame * frameSize_;
+  head_ = frameBegin_;
+}
+
+UniformRing::Allocation UniformRing::allocate(size_t size) {
+  if (size > maxAllocationSize_) {
+    LOG_F("Allocating {} bytes from a uniform ring limited to {}", size, maxAllocationSize_);
+  }
+
+  size_t offset = head_;
+  if (offset + size > frameBegin_ + frameSize_) {
+    LOG_F("Uniform ring frame out of space: {} of {} bytes used",
+          head_ - frameBegin_,
+          frameSize_);
+  }
+
+  head_ = alignUp(offset + size, alignment_);
+  return {static_cast<uint32_t>(offset), buffer_->getMapped() + offset};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <engine/core/Buffer.hpp>
+#include <engine/core/Descriptors.hpp>
+#include <engine/core/Device.hpp>
+#include <memory>
+#include <type_traits>
+
+/**
+ * @brief Per-frame constants without creating buffers or writing descriptors: one persistently
+ * mapped buffer split into a region per frame in flight, handing out aligned slices of the current
+ * frame's region with a bump pointer. Every slice is bound through the same descriptor set, by
+ * passing its offset as a dynamic offset.
+ *
+ *   ring.beginFrame(frame);   // Once the GPU is done with the frame's previous use
+ *   uint32_t offset = ring.push(ObjectConstants{transform, color});
+ *   commandBuffer.bindDescriptorSets(pipeline, {ring.getSet()}, OBJECT_SET, {offset});
+ *
+ * The set has a single dynamic buffer at binding 0, a uniform buffer by default, whose shader view
+ * is `maxAllocationSize` bytes from the offset:
+ *
+ *   layout(set = OBJECT_SET, binding = 0) uniform ObjectConstants { mat4 transform; vec4 color; };
+ */
+class UniformRing {
+ public:
+  struct Allocation {
+    uint32_t offset;  // Dynamic offset to bind the allocation with
+    void* data;       // Where to write it
+  };
+
+  UniformRing() = delete;
+  UniformRing(UniformRing& other) = delete;
+
+  /**
+   * @param frameCount frames that can be in flight at once, each with its own region
+   * @param bytesPerFrame size of each region
+   * @param maxAllocationSize largest allocation; also the range shaders see
+   * @param type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, or the STORAGE_BUFFER_DYNAMIC equivalent
+   */
+  UniformRing(const LogicalDevice& device,
+              DescriptorSetLayoutCache& layoutCache,
+              size_t frameCount,
+              size_t bytesPerFrame,
+              uint32_t maxAllocationSize = 256,
+              VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+              VkShaderStageFlags stages = VK_SHADER_STAGE_ALL);
+
+  // Start handing out `frame`'s region again, from the beginning
+  void beginFrame(size_t frame);
+
+  // `size` bytes (at most getMaxAllocationSize()) of the current frame. Calls LOG_F when the frame
+  // is out of space
+  Allocation allocate(size_t size);
+
+  // Copy `value` into a new allocation, and return its dynamic offset
+  template <class T>
+  uint32_t push(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be pushed");
+
+    Allocation allocation = allocate(sizeof(T));
+    std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation.offset;
+  }
+
+  VkDescriptorSetLayout getLayout() const { return layout_; }
+
+  VkDescriptorSet getSet() const { return set_; }
+
+  // Every allocation starts at a multiple of this
+  uint32_t getAlignment() const { return alignment_; }
+
+  uint32_t getMaxAllocationSize() const { return maxAllocationSize_; }
+
+  // Bytes handed out in the current frame, including alignment padding
+  size_t getUsedSize() const { return head_ - frameBegin_; }
+
+  size_t getFrameSize() const { return frameSize_; }
+
+ private:
+  const LogicalDevice& device_;
+  uint32_t alignment_ = 1;
+  uint32_t maxAllocationSize_;
+  size_t frameCount_;
+  size_t frameSize_;
+
+  std::unique_ptr<MappedBuffer<uint8_t>> buffer_;
+
+  VkDescriptorSetLayout layout_;
+  std::unique_ptr<DescriptorAllocator> descriptors_;
+  VkDescriptorSet set_;
+
+  // Offsets into the whole buffer
+  size_t frameBegin_ = 0;
+  size_t head_ = 0;
+};
@@ -0,0 +1,360 @@
+#include "VertexEncoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_ENCODING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr float SNORM16_MAX = 32767.0f;
+constexpr float UNORM8_MAX = 255.0f;
+
+// Rounds to nearest even, like _mm_cvtps_epi32 does in the default rounding mode
+int32_t roundToInt(float value) { return static_cast<int32_t>(std::nearbyint(value)); }
+
+int16_t quantizeSnorm16(float value) {
+  return static_cast<int16_t>(roundToInt(std::min(std::max(value, -1.0f), 1.0f) * SNORM16_MAX));
+}
+
+uint8_t quantizeUnorm8(float value) {
+  return static_cast<uint8_t>(roundToInt(std::min(std::max(value, 0.0f), 1.0f) * UNORM8_MAX));
+}
+
+uint8_t* elementAt(void* dst, size_t index, size_t stride) {
+  return static_cast<uint8_t*>(dst) + index * stride;
+}
+
+#ifdef VERTEX_ENCODING_SSE2
+
+// Load four tightly packed vec3s and transpose them into x, y and z registers
+inline void loadVec3x4(const float* src, __m128& x, __m128& y, __m128& z) {
+  __m128 a = _mm_loadu_ps(src);      // x0 y0 z0 x1
+  __m128 b = _mm_loadu_ps(src + 4);  // y1 z1 x2 y2
+  __m128 c = _mm_loadu_ps(src + 8);  // z2 x3 y3 z3
+
+  __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));  // x2 x2 x3 x3
+  x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));
+
+  __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));  // y0 y0 y1 y1
+  bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));         // y2 y2 y3 y3
+  y = _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(2, 0, 2, 0));
+
+  ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));  // z0 z0 z1 z1
+  bc = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));  // z2 z2 z3 z3
+  z = _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// Clamp to [-1, 1] and convert to SNORM16, one value per 32-bit lane
+inline __m128i quantizeSnorm16x4(__m128 value) {
+  value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+  return _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(SNORM16_MAX)));
+}
+
+// Write the four 32-bit lanes of `value` to four consecutive elements
+inline void store32x4(__m128i value, void* dst, size_t index, size_t stride) {
+  for (size_t lane = 0; lane < 4; lane++) {
+    uint32_t bits = static_cast<uint32_t>(_mm_cvtsi128_si32(value));
+    std::memcpy(elementAt(dst, index + lane, stride), &bits, sizeof(bits));
+    value = _mm_srli_si128(value, 4);
+  }
+}
+
+// Branch-free float -> half with round-to-nearest-even, one value per 32-bit lane. Handles
+// subnormals, infinities and NaNs the same way floatToHalf() does.
+inline __m128i floatToHalfx4(__m128 value) {
+  const __m128i signMask = _mm_set1_epi32(static_cast<int32_t>(0x80000000u));
+  const __m128i halfMaxPlusOne = _mm_set1_epi32((127 + 16) << 23);
+  const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+  const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+  const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+  const __m128i infinity = _mm_set1_epi32(0x7c00);
+  const __m128i nanBit = _mm_set1_epi32(0x200);
+
+  __m128i bits = _mm_castps_si128(value);
+  __m128i sign = _mm_and_si128(bits, signMask);
+  __m128i absBits = _mm_xor_si128(bits, sign);
+  __m128 absValue = _mm_castsi128_ps(absBits);
+
+  __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absValue, absValue));
+  __m128i isFinite = _mm_cmpgt_epi32(halfMaxPlusOne, absBits);
+  __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absBits);
+
+  // Subnormal results: let the FPU do the rounding by adding a magic number
+  __m128i subnormal = _mm_sub_epi32(
+      _mm_castps_si128(_mm_add_ps(absValue, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+  // Normal results: rebias the exponent and round the mantissa to nearest even
+  __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+  __m128i normal =
+      _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+  __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal),
+                                _mm_andnot_si128(isSubnormal, normal));
+  __m128i special = _mm_or_si128(infinity, _mm_and_si128(isNan, nanBit));
+  __m128i half =
+      _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, special));
+
+  return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+#endif  // VERTEX_ENCODING_SSE2
+
+}  // namespace
+
+QuantizationRange QuantizationRange::fromBounds(const glm::vec3& boundsMin,
+                                                const glm::vec3& boundsMax) {
+  QuantizationRange range;
+
+  glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+  float scale = std::max(std::max(halfExtent.x, halfExtent.y), halfExtent.z);
+
+  range.offset = (boundsMin + boundsMax) * 0.5f;
+  range.scale = glm::vec3(scale > 0.0f ? scale : 1.0f);
+
+  return range;
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign = bits & 0x80000000u;
+  uint32_t absBits = bits ^ sign;
+  uint32_t half;
+
+  if (absBits >= (127 + 16) << 23) {
+    // Overflows to infinity, or is already infinity / NaN
+    half = absBits > 0x7f800000u ? 0x7e00 : 0x7c00;
+  } else if (absBits < (127 - 14) << 23) {
+    // Subnormal (or zero) half
+    const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+    float magic;
+    std::memcpy(&magic, &magicBits, sizeof(magic));
+
+    float absValue;
+    std::memcpy(&absValue, &absBits, sizeof(absValue));
+    absValue += magic;
+
+    std::memcpy(&half, &absValue, sizeof(half));
+    half -= magicBits;
+  } else {
+    uint32_t mantissaOdd = (absBits >> 13) & 1;
+    half = (absBits + 0xfff - ((127 - 15) << 23) + mantissaOdd) >> 13;
+  }
+
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float halfToFloat(uint16_t value) {
+  uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits;
+
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent == 0) {
+    // Zero or subnormal: exact in single precision
+    float result = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -result : result;
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& normal) {
+  float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  float inverse = 1.0f / std::max(sum, std::numeric_limits<float>::min());
+
+  glm::vec2 encoded(normal.x * inverse, normal.y * inverse);
+
+  // Fold the lower hemisphere over the diagonals
+  if (normal.z < 0.0f) {
+    glm::vec2 folded((1.0f - std::abs(encoded.y)) * std::copysign(1.0f, encoded.x),
+                     (1.0f - std::abs(encoded.x)) * std::copysign(1.0f, encoded.y));
+    encoded = folded;
+  }
+
+  return encoded;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& encoded) {
+  glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+
+  if (normal.z < 0.0f) {
+    float x = normal.x;
+    normal.x = (1.0f - std::abs(normal.y)) * std::copysign(1.0f, x);
+    normal.y = (1.0f - std::abs(x)) * std::copysign(1.0f, normal.y);
+  }
+
+  return glm::normalize(normal);
+}
+
+void encodePositionsSnorm16(const glm::vec3* positions,
+                            size_t count,
+                            const QuantizationRange& range,
+                            void* dst,
+                            size_t dstStride) {
+  glm::vec3 inverseScale = 1.0f / range.scale;
+  size_t i = 0;
+
+#ifdef VERTEX_ENCODING_SSE2
+  const float* src = &positions[0].x;
+
+  __m128 offsetX = _mm_set1_ps(range.offset.x);
+  __m128 offsetY = _mm_set1_ps(range.offset.y);
+  __m128 offsetZ = _mm_set1_ps(range.offset.z);
+  __m128 inverseX = _mm_set1_ps(inverseScale.x);
+  __m128 inverseY = _mm_set1_ps(inverseScale.y);
+  __m128 inverseZ = _mm_set1_ps(inverseScale.z);
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 x, y, z;
+    loadVec3x4(src + i * 3, x, y, z);
+
+    __m128i qx = quantizeSnorm16x4(_mm_mul_ps(_mm_sub_ps(x, offsetX), inverseX));
+    __m128i qy = quantizeSnorm16x4(_mm_mul_ps(_mm_sub_ps(y, offsetY), inverseY));
+    __m128i qz = quantizeSnorm16x4(_mm_mul_ps(_mm_sub_ps(z, offsetZ), inverseZ));
+
+    // Interleave into x y z 0 per vertex, two vertices per register
+    __m128i xy = _mm_unpacklo_epi16(_mm_packs_epi32(qx, qx), _mm_packs_epi32(qy, qy));
+    __m128i zw = _mm_unpacklo_epi16(_mm_packs_epi32(qz, qz), _mm_setzero_si128());
+    __m128i v01 = _mm_unpacklo_epi32(xy, zw);
+    __m128i v23 = _mm_unpackhi_epi32(xy, zw);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(elementAt(dst, i, dstStride)), v01);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(elementAt(dst, i + 1, dstStride)),
+                     _mm_srli_si128(v01, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(elementAt(dst, i + 2, dstStride)), v23);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(elementAt(dst, i + 3, dstStride)),
+                     _mm_srli_si128(v23, 8));
+  }
+#endif
+
+  for (; i < count; i++) {
+    int16_t encoded[4] = {
+        quantizeSnorm16((positions[i].x - range.offset.x) * inverseScale.x),
+        quantizeSnorm16((positions[i].y - range.offset.y) * inverseScale.y),
+        quantizeSnorm16((positions[i].z - range.offset.z) * inverseScale.z),
+        0,
+    };
+    std::memcpy(elementAt(dst, i, dstStride), encoded, sizeof(encoded));
+  }
+}
+
+void encodeNormalsOctahedral16(const glm::vec3* normals,
+                               size_t count,
+                               void* dst,
+                               size_t dstStride) {
+  size_t i = 0;
+
+#ifdef VERTEX_ENCODING_SSE2
+  const float* src = &normals[0].x;
+
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 minSum = _mm_set1_ps(std::numeric_limits<float>::min());
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 x, y, z;
+    loadVec3x4(src + i * 3, x, y, z);
+
+    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)),
+                            _mm_andnot_ps(signMask, z));
+    __m128 inverse = _mm_div_ps(one, _mm_max_ps(sum, minSum));
+
+    __m128 ex = _mm_mul_ps(x, inverse);
+    __m128 ey = _mm_mul_ps(y, inverse);
+
+    // Folded values for the lower hemisphere
+    __m128 signX = _mm_or_ps(_mm_and_ps(ex, signMask), one);
+    __m128 signY = _mm_or_ps(_mm_and_ps(ey, signMask), one);
+    __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ey)), signX);
+    __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ex)), signY);
+
+    __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+    ex = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, ex));
+    ey = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, ey));
+
+    __m128i qx = quantizeSnorm16x4(ex);
+    __m128i qy = quantizeSnorm16x4(ey);
+
+    store32x4(_mm_unpacklo_epi16(_mm_packs_epi32(qx, qx), _mm_packs_epi32(qy, qy)),
+              dst,
+              i,
+              dstStride);
+  }
+#endif
+
+  for (; i < count; i++) {
+    glm::vec2 octahedral = encodeOctahedral(normals[i]);
+    int16_t encoded[2] = {quantizeSnorm16(octahedral.x), quantizeSnorm16(octahedral.y)};
+    std::memcpy(elementAt(dst, i, dstStride), encoded, sizeof(encoded));
+  }
+}
+
+void encodeTexcoordsHalf(const glm::vec2* texcoords, size_t count, void* dst, size_t dstStride) {
+  size_t i = 0;
+
+#ifdef VERTEX_ENCODING_SSE2
+  const float* src = &texcoords[0].x;
+
+  for (; i + 4 <= count; i += 4) {
+    // Sign-extend the 16-bit results so the saturating pack keeps their bit patterns
+    __m128i h01 = floatToHalfx4(_mm_loadu_ps(src + i * 2));
+    __m128i h23 = floatToHalfx4(_mm_loadu_ps(src + i * 2 + 4));
+    h01 = _mm_srai_epi32(_mm_slli_epi32(h01, 16), 16);
+    h23 = _mm_srai_epi32(_mm_slli_epi32(h23, 16), 16);
+
+    store32x4(_mm_packs_epi32(h01, h23), dst, i, dstStride);
+  }
+#endif
+
+  for (; i < count; i++) {
+    uint16_t encoded[2] = {floatToHalf(texcoords[i].x), floatToHalf(texcoords[i].y)};
+    std::memcpy(elementAt(dst, i, dstStride), encoded, sizeof(encoded));
+  }
+}
+
+void encodeColorsUnorm8(const glm::vec4* colors, size_t count, void* dst, size_t dstStride) {
+  size_t i = 0;
+
+#ifdef VERTEX_ENCODING_SSE2
+  const float* src = &colors[0].x;
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 unormMax = _mm_set1_ps(UNORM8_MAX);
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i c[4];
+    for (size_t k = 0; k < 4; k++) {
+      __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + (i + k) * 4), zero), one);
+      c[k] = _mm_cvtps_epi32(_mm_mul_ps(value, unormMax));
+    }
+
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
+    store32x4(packed, dst, i, dstStride);
+  }
+#endif
+
+  for (; i < count; i++) {
+    uint8_t encoded[4] = {
+        quantizeUnorm8(colors[i].x),
+        quantizeUnorm8(colors[i].y),
+        quantizeUnorm8(colors[i].z),
+        quantizeUnorm8(colors[i].w),
+    };
+    std::memcpy(elementAt(dst, i, dstStride), encoded, sizeof(encoded));
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/**
+ * Kernels that convert float vertex attributes into the packed encodings used by PackedVertex.
+ *
+ * Every kernel reads a tightly packed source stream (as stored in MeshData) and writes one element
+ * per vertex into an interleaved destination, `dstStride` bytes apart, so a single attribute of an
+ * array of packed vertices can be filled in one call. The SSE2 paths process four vertices at a
+ * time; the scalar paths handle the remainder and produce bit-identical results.
+ */
+
+/**
+ * @brief Maps positions into [-1, 1] for SNORM16 storage. The shader recovers the original
+ * position as `decoded * scale + offset`.
+ */
+struct QuantizationRange {
+  glm::vec3 offset = glm::vec3(0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+
+  // Centered on the bounding box, with a uniform scale so the mesh's proportions survive the
+  // quantization error
+  static QuantizationRange fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+// IEEE 754 binary16 conversions, round-to-nearest-even
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2, and back
+glm::vec2 encodeOctahedral(const glm::vec3& normal);
+glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+// vec3 -> int16_t[4] (SNORM16 in `range`, w = 0)
+void encodePositionsSnorm16(const glm::vec3* positions,
+                            size_t count,
+                            const QuantizationRange& range,
+                            void* dst,
+                            size_t dstStride);
+
+// vec3 -> int16_t[2] (SNORM16 octahedral). Input normals should be normalized.
+void encodeNormalsOctahedral16(const glm::vec3* normals,
+                               size_t count,
+                               void* dst,
+                               size_t dstStride);
+
+// vec2 -> uint16_t[2] (half float)
+void encodeTexcoordsHalf(const glm::vec2* texcoords, size_t count, void* dst, size_t dstStride);
+
+// vec4 -> uint8_t[4] (UNORM8, clamped to [0, 1])
+void encodeColorsUnorm8(const glm::vec4* colors, size_t count, void* dst, size_t dstStride);
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Compile-time vertex input layouts.
+ *
+ * A layout lists one or more vertex buffer bindings, each with the attributes it feeds:
+ *
+ *   struct Vertex::Layout
+ *       : VertexLayout<
+ *             VertexBinding<0,
+ *                           Vertex,
+ *                           VK_VERTEX_INPUT_RATE_VERTEX,
+ *                           VertexAttribute<0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, pos)>,
+ *                           ...>> {};
+ *
+ * The binding and attribute descriptions are built at compile time into static std::arrays that
+ * pipelines point at directly. Attributes that overflow their struct or overlap each other, and
+ * duplicate binding indices or locations, fail to compile.
+ *
+ * Layouts are declared outside the vertex struct (as above, via a forward-declared nested `Layout`)
+ * because offsetof() needs the struct to be complete.
+ */
+
+/**
+ * @brief Size in bytes of one attribute of the given format, or 0 if the format is not supported
+ * as a vertex attribute by this header.
+ */
+constexpr uint32_t getVertexFormatSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SNORM:
+    case VK_FORMAT_R8_UINT:
+    case VK_FORMAT_R8_SINT:
+      return 1;
+
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SNORM:
+    case VK_FORMAT_R8G8_UINT:
+    case VK_FORMAT_R8G8_SINT:
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R16_SNORM:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_R16_SINT:
+    case VK_FORMAT_R16_SFLOAT:
+      return 2;
+
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+    case VK_FORMAT_R8G8B8A8_UINT:
+    case VK_FORMAT_R8G8B8A8_SINT:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_UINT:
+    case VK_FORMAT_R16G16_SINT:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32_SFLOAT:
+      return 4;
+
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SNORM:
+    case VK_FORMAT_R16G16B16A16_UINT:
+    case VK_FORMAT_R16G16B16A16_SINT:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32_SFLOAT:
+      return 8;
+
+    case VK_FORMAT_R32G32B32_UINT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32_SFLOAT:
+      return 12;
+
+    case VK_FORMAT_R32G32B32A32_UINT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief One shader input, read from `Offset` bytes into each element of its binding.
+ */
+template <uint32_t Location, VkFormat Format, size_t Offset>
+struct VertexAttribute {
+  static constexpr uint32_t location = Location;
+  static constexpr VkFormat format = Format;
+  static constexpr uint32_t offset = static_cast<uint32_t>(Offset);
+  static constexpr uint32_t size = getVertexFormatSize(Format);
+
+  static_assert(size != 0, "Format is not supported as a vertex attribute");
+};
+
+namespace detail {
+
+template <class... Attributes>
+constexpr bool attributesAreDisjoint() {
+  constexpr size_t count = sizeof...(Attributes);
+  constexpr uint32_t offsets[count + 1] = {Attributes::offset..., 0};
+  constexpr uint32_t sizes[count + 1] = {Attributes::size..., 0};
+
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = i + 1; j < count; j++) {
+      if (offsets[i] < offsets[j] + sizes[j] && offsets[j] < offsets[i] + sizes[i]) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+template <class T, size_t N>
+constexpr bool valuesAreUnique(const std::array<T, N>& values) {
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = i + 1; j < N; j++) {
+      if (values[i] == values[j]) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+template <size_t N>
+constexpr bool locationsAreUnique(const std::array<VkVertexInputAttributeDescription, N>& list) {
+  std::array<uint32_t, N> locations{};
+  for (size_t i = 0; i < N; i++) {
+    locations[i] = list[i].location;
+  }
+
+  return valuesAreUnique(locations);
+}
+
+template <size_t... Counts>
+constexpr std::array<VkVertexInputAttributeDescription, (Counts + ... + 0)> concatenateAttributes(
+    const std::array<VkVertexInputAttributeDescription, Counts>&... lists) {
+  std::array<VkVertexInputAttributeDescription, (Counts + ... + 0)> result{};
+  size_t next = 0;
+
+  auto append = [&result, &next](const auto& list) {
+    for (size_t i = 0; i < list.size(); i++) {
+      result[next++] = list[i];
+    }
+  };
+  (append(lists), ...);
+
+  return result;
+}
+
+}  // namespace detail
+
+/**
+ * @brief A vertex buffer binding: elements of type `VertexType`, advanced per vertex or per
+ * instance, feeding the listed attributes.
+ */
+template <uint32_t Binding, class VertexType, VkVertexInputRate InputRate, class... Attributes>
+struct VertexBinding {
+  using Type = VertexType;
+
+  static constexpr uint32_t binding = Binding;
+  static constexpr uint32_t stride = sizeof(VertexType);
+  static constexpr VkVertexInputRate inputRate = InputRate;
+
+  static_assert(sizeof...(Attributes) > 0, "A vertex binding needs at least one attribute");
+  static_assert(((Attributes::offset + Attributes::size <= stride) && ...),
+                "Vertex attribute extends past the end of the vertex struct");
+  static_assert(detail::attributesAreDisjoint<Attributes...>(), "Vertex attributes overlap");
+
+  static constexpr VkVertexInputBindingDescription getDescription() {
+    return {Binding, stride, InputRate};
+  }
+
+  static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)>
+  getAttributeDescriptions() {
+    return {{{Attributes::location, Binding, Attributes::format, Attributes::offset}...}};
+  }
+};
+
+/**
+ * @brief The complete vertex input of a pipeline: every binding, and every attribute of every
+ * binding, as static arrays.
+ */
+template <class... Bindings>
+struct VertexLayout {
+  static constexpr std::array<VkVertexInputBindingDescription, sizeof...(Bindings)> bindings = {
+      {Bindings::getDescription()...}};
+
+  static constexpr auto attributes =
+      detail::concatenateAttributes(Bindings::getAttributeDescriptions()...);
+
+  static_assert(detail::valuesAreUnique(std::array<uint32_t, sizeof...(Bindings)>{
+                    {Bindings::binding...}}),
+                "Vertex binding indices must be unique");
+
+  static_assert(detail::locationsAreUnique(attributes),
+                "Vertex attribute locations must be unique");
+};
+
+namespace detail {
+
+template <class InputType, class = void>
+struct VertexLayoutSelector {
+  using type = InputType;
+};
+
+template <class InputType>
+struct VertexLayoutSelector<InputType, std::void_t<typename InputType::Layout>> {
+  using type = typename InputType::Layout;
+};
+
+}  // namespace detail
+
+/**
+ * @brief The layout a pipeline uses for `InputType`: its nested `Layout` if it has one (a vertex
+ * struct), otherwise `InputType` itself (a VertexLayout spanning several bindings).
+ */
+template <class InputType>
+using VertexLayoutOf = typename detail::VertexLayoutSelector<InputType>::type;
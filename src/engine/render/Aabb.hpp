@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Axis-aligned bounding box. Default-constructed boxes are empty: expanding an empty box by
+ * anything yields that thing.
+ */
+struct Aabb {
+  glm::vec3 min{FLT_MAX};
+  glm::vec3 max{-FLT_MAX};
+
+  Aabb() = default;
+
+  Aabb(const glm::vec3& boundsMin, const glm::vec3& boundsMax) : min(boundsMin), max(boundsMax) {}
+
+  // Box around a sphere: center in xyz, radius in w
+  static Aabb fromSphere(const glm::vec4& sphere) {
+    glm::vec3 center(sphere.x, sphere.y, sphere.z);
+    return Aabb(center - glm::vec3(sphere.w), center + glm::vec3(sphere.w));
+  }
+
+  bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+  glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+
+  // Half the size along each axis
+  glm::vec3 getExtent() const { return (max - min) * 0.5f; }
+
+  // 0 for empty boxes, so they never dominate a surface area heuristic
+  float getSurfaceArea() const {
+    if (isEmpty()) {
+      return 0.0f;
+    }
+
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  void expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void expand(const Aabb& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  bool contains(const Aabb& other) const {
+    return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+           max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+  }
+
+  bool overlaps(const Aabb& other) const {
+    return min.x <= other.max.x && min.y <= other.max.y && min.z <= other.max.z &&
+           max.x >= other.min.x && max.y >= other.min.y && max.z >= other.min.z;
+  }
+};
+
+inline Aabb merge(const Aabb& a, const Aabb& b) {
+  return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
@@ -0,0 +1,765 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <fmtlog/Log.hpp>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+// Bins per axis when evaluating split candidates. 16 is within a percent or two of testing every
+// object boundary, at a fraction of the cost
+constexpr uint32_t BIN_COUNT = 16;
+
+// Past this depth the build falls back to median splits, which bounds the recursion even when the
+// heuristic keeps peeling single objects off degenerate input
+constexpr uint32_t MAX_SAH_DEPTH = 64;
+
+// Subtrees per worker when splitting refits and queries over a thread pool, to even out the load
+constexpr size_t SUBTREES_PER_THREAD = 4;
+
+uint32_t getLargestAxis(const glm::vec3& size) {
+  if (size.x >= size.y && size.x >= size.z) {
+    return 0;
+  }
+  return size.y >= size.z ? 1 : 2;
+}
+
+}  // namespace
+
+struct Bvh::BuildContext {
+  const std::vector<Aabb>& bounds;
+  std::vector<glm::vec3> centroids;
+  std::vector<uint32_t> order;
+  ThreadPool* threadPool;
+
+  // Where to split order[begin, end): the returned index starts the right half
+  size_t split(size_t begin, size_t end, uint32_t depth) {
+    Aabb centroidBounds;
+    for (size_t i = begin; i < end; i++) {
+      centroidBounds.expand(centroids[order[i]]);
+    }
+
+    glm::vec3 size = centroidBounds.max - centroidBounds.min;
+    uint32_t largestAxis = getLargestAxis(size);
+    size_t middle = begin + (end - begin) / 2;
+
+    // Every centroid in the same place: any split is as good as another
+    if (size[largestAxis] <= 0.0f) {
+      return middle;
+    }
+
+    if (depth < MAX_SAH_DEPTH) {
+      float bestCost = FLT_MAX;
+      uint32_t bestAxis = 0;
+      uint32_t bestBin = 0;
+
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        if (size[axis] <= 0.0f) {
+          continue;
+        }
+
+        Aabb bins[BIN_COUNT];
+        size_t counts[BIN_COUNT] = {};
+        float scale = BIN_COUNT / size[axis];
+
+        for (size_t i = begin; i < end; i++) {
+          uint32_t bin = getBin(order[i], axis, centroidBounds.min[axis], scale);
+          counts[bin]++;
+          bins[bin].expand(bounds[order[i]]);
+        }
+
+        // Sweep from the right, then from the left, so every candidate costs O(1)
+        float rightArea[BIN_COUNT];
+        size_t rightCount[BIN_COUNT];
+        Aabb accumulated;
+        size_t count = 0;
+        for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--) {
+          accumulated.expand(bins[bin]);
+          count += counts[bin];
+          rightArea[bin] = accumulated.getSurfaceArea();
+          rightCount[bin] = count;
+        }
+
+        accumulated = Aabb();
+        count = 0;
+        for (uint32_t bin = 1; bin < BIN_COUNT; bin++) {
+          accumulated.expand(bins[bin - 1]);
+          count += counts[bin - 1];
+
+          if (count == 0 || rightCount[bin] == 0) {
+            continue;
+          }
+
+          float cost = count * accumulated.getSurfaceArea() + rightCount[bin] * rightArea[bin];
+          if (cost < bestCost) {
+            bestCost = cost;
+            bestAxis = axis;
+            bestBin = bin;
+          }
+        }
+      }
+
+      if (bestCost < FLT_MAX) {
+        float scale = BIN_COUNT / size[bestAxis];
+        float offset = centroidBounds.min[bestAxis];
+        auto split = std::partition(
+            order.begin() + begin, order.begin() + end, [&](uint32_t object) {
+              return getBin(object, bestAxis, offset, scale) < bestBin;
+            });
+
+        size_t index = static_cast<size_t>(split - order.begin());
+        if (index != begin && index != end) {
+          return index;
+        }
+      }
+    }
+
+    std::nth_element(order.begin() + begin,
+                     order.begin() + middle,
+                     order.begin() + end,
+                     [&](uint32_t a, uint32_t b) {
+                       return centroids[a][largestAxis] < centroids[b][largestAxis];
+                     });
+    return middle;
+  }
+
+  uint32_t getBin(uint32_t object, uint32_t axis, float offset, float scale) const {
+    float bin = (centroids[object][axis] - offset) * scale;
+    return std::min(static_cast<uint32_t>(std::max(bin, 0.0f)), BIN_COUNT - 1);
+  }
+};
+
+void Bvh::build(const std::vector<Aabb>& bounds, ThreadPool* threadPool) {
+  clear();
+
+  if (bounds.empty()) {
+    return;
+  }
+
+  // A tree with one object per leaf has exactly 2n - 1 nodes
+  size_t nodeCount = bounds.size() * 2 - 1;
+  nodes_.resize(nodeCount);
+  parents_.resize(nodeCount);
+  heights_.resize(nodeCount);
+  objectNodes_.resize(bounds.size());
+
+  BuildContext context{bounds, {}, {}, threadPool};
+  context.centroids.resize(bounds.size());
+  context.order.resize(bounds.size());
+  for (size_t i = 0; i < bounds.size(); i++) {
+    context.centroids[i] = bounds[i].getCenter();
+  }
+  std::iota(context.order.begin(), context.order.end(), 0u);
+
+  root_ = 0;
+  buildRange(context, root_, NULL_NODE, 0, bounds.size(), 0);
+}
+
+uint32_t Bvh::buildRange(BuildContext& context,
+                         int32_t node,
+                         int32_t parent,
+                         size_t begin,
+                         size_t end,
+                         uint32_t depth) {
+  parents_[node] = parent;
+
+  if (end - begin == 1) {
+    uint32_t object = context.order[begin];
+    nodes_[node] = {context.bounds[object], NULL_NODE, static_cast<int32_t>(object)};
+    heights_[node] = 0;
+    objectNodes_[object] = node;
+    return 0;
+  }
+
+  size_t middle = context.split(begin, end, depth);
+
+  // Depth-first layout: the left subtree (2 * leftCount - 1 nodes) follows its parent, the right
+  // one follows the left. Knowing every subtree's place up front lets them be built in parallel
+  int32_t left = node + 1;
+  int32_t right = node + static_cast<int32_t>(2 * (middle - begin));
+
+  uint32_t childHeights[2];
+  auto buildChild = [&](size_t child) {
+    childHeights[child] = child == 0 ? buildRange(context, left, node, begin, middle, depth + 1)
+                                     : buildRange(context, right, node, middle, end, depth + 1);
+  };
+
+  if (context.threadPool && end - begin >= PARALLEL_SIZE) {
+    context.threadPool->parallelFor(2, 1, [&](size_t first, size_t last) {
+      for (size_t child = first; child < last; child++) {
+        buildChild(child);
+      }
+    });
+  } else {
+    buildChild(0);
+    buildChild(1);
+  }
+
+  nodes_[node] = {merge(nodes_[left].bounds, nodes_[right].bounds), left, right};
+  heights_[node] = 1 + static_cast<int32_t>(std::max(childHeights[0], childHeights[1]));
+  return static_cast<uint32_t>(heights_[node]);
+}
+
+void Bvh::clear() {
+  nodes_.clear();
+  parents_.clear();
+  heights_.clear();
+  freeNodes_.clear();
+  root_ = NULL_NODE;
+  objectNodes_.clear();
+  freeObjects_.clear();
+}
+
+uint32_t Bvh::insert(const Aabb& bounds) {
+  uint32_t object;
+  if (!freeObjects_.empty()) {
+    object = freeObjects_.back();
+    freeObjects_.pop_back();
+  } else {
+    object = static_cast<uint32_t>(objectNodes_.size());
+    objectNodes_.push_back(NULL_NODE);
+  }
+
+  int32_t leaf = allocateNode();
+  nodes_[leaf] = {bounds, NULL_NODE, static_cast<int32_t>(object)};
+  objectNodes_[object] = leaf;
+
+  insertLeaf(leaf);
+  return object;
+}
+
+void Bvh::remove(uint32_t object) {
+  if (object >= objectNodes_.size() || objectNodes_[object] == NULL_NODE) {
+    LOG_F("Removing object {}, which is not in the BVH", object);
+  }
+
+  int32_t leaf = objectNodes_[object];
+  removeLeaf(leaf);
+  freeNode(leaf);
+
+  objectNodes_[object] = NULL_NODE;
+  freeObjects_.push_back(object);
+}
+
+void Bvh::update(uint32_t object, const Aabb& bounds) {
+  if (object >= objectNodes_.size() || objectNodes_[object] == NULL_NODE) {
+    LOG_F("Updating object {}, which is not in the BVH", object);
+  }
+
+  int32_t leaf = objectNodes_[object];
+
+  // Refitting stretches every ancestor up to the common one of both positions, so objects that
+  // jumped are cheaper to find a new place for
+  bool jumped = !bounds.overlaps(nodes_[leaf].bounds);
+  nodes_[leaf].bounds = bounds;
+
+  if (jumped) {
+    removeLeaf(leaf);
+    insertLeaf(leaf);
+  } else {
+    refitAncestors(parents_[leaf]);
+  }
+}
+
+void Bvh::setBounds(uint32_t object, const Aabb& bounds) {
+  if (object >= objectNodes_.size() || objectNodes_[object] == NULL_NODE) {
+    LOG_F("Moving object {}, which is not in the BVH", object);
+  }
+
+  nodes_[objectNodes_[object]].bounds = bounds;
+}
+
+const Aabb& Bvh::getBounds(uint32_t object) const {
+  if (object >= objectNodes_.size() || objectNodes_[object] == NULL_NODE) {
+    LOG_F("Object {} is not in the BVH", object);
+  }
+
+  return nodes_[objectNodes_[object]].bounds;
+}
+
+void Bvh::refit(ThreadPool* threadPool) {
+  if (root_ == NULL_NODE) {
+    return;
+  }
+
+  if (!threadPool || getObjectCount() < PARALLEL_SIZE) {
+    refitSubtree(root_);
+    return;
+  }
+
+  std::vector<int32_t> above;
+  std::vector<int32_t> subtrees =
+      splitSubtrees((threadPool->getThreadCount() + 1) * SUBTREES_PER_THREAD, &above);
+
+  // Rotations never reach outside the subtree of the node being rotated, so the subtrees are
+  // independent
+  threadPool->parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      refitSubtree(subtrees[i]);
+    }
+  });
+
+  for (auto it = above.rbegin(); it != above.rend(); ++it) {
+    refitNode(*it);
+    rotate(*it);
+  }
+}
+
+uint32_t Bvh::getHeight() const {
+  return root_ == NULL_NODE ? 0 : static_cast<uint32_t>(heights_[root_]);
+}
+
+float Bvh::getSahCost() const {
+  if (root_ == NULL_NODE || nodes_[root_].isLeaf()) {
+    return 0.0f;
+  }
+
+  float area = 0.0f;
+  std::vector<int32_t> stack = {root_};
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    if (!node.isLeaf()) {
+      area += node.bounds.getSurfaceArea();
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+
+  return area / nodes_[root_].bounds.getSurfaceArea();
+}
+
+void Bvh::queryFrustum(const Frustum& frustum,
+                       std::vector<uint32_t>& objects,
+                       ThreadPool* threadPool) const {
+  if (root_ == NULL_NODE) {
+    return;
+  }
+
+  if (!threadPool || getObjectCount() < PARALLEL_SIZE) {
+    queryFrustumSubtree(root_, frustum, objects);
+    return;
+  }
+
+  // The few nodes above the subtrees go untested, which only costs pruning: every leaf still is
+  std::vector<int32_t> subtrees =
+      splitSubtrees((threadPool->getThreadCount() + 1) * SUBTREES_PER_THREAD, nullptr);
+  std::vector<std::vector<uint32_t>> results(subtrees.size());
+
+  threadPool->parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      queryFrustumSubtree(subtrees[i], frustum, results[i]);
+    }
+  });
+
+  for (const auto& result : results) {
+    objects.insert(objects.end(), result.begin(), result.end());
+  }
+}
+
+void Bvh::queryAabb(const Aabb& bounds, std::vector<uint32_t>& objects) const {
+  if (root_ == NULL_NODE) {
+    return;
+  }
+
+  std::vector<int32_t> stack = {root_};
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    if (!node.bounds.overlaps(bounds)) {
+      continue;
+    }
+
+    if (node.isLeaf()) {
+      objects.push_back(static_cast<uint32_t>(node.right));
+    } else {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+BvhRayHit Bvh::raycast(const BvhRay& ray) const {
+  BvhRayHit hit{NO_OBJECT, ray.maxDistance};
+
+  if (root_ == NULL_NODE) {
+    return hit;
+  }
+
+  glm::vec3 inverseDirection = 1.0f / ray.direction;
+  bool parallel = ray.direction.x == 0.0f || ray.direction.y == 0.0f || ray.direction.z == 0.0f;
+
+  // Distance at which the ray enters `bounds`, or FLT_MAX if it misses it or only gets there past
+  // the closest hit so far
+  auto enter = [&](const Aabb& bounds) {
+    glm::vec3 t0 = (bounds.min - ray.origin) * inverseDirection;
+    glm::vec3 t1 = (bounds.max - ray.origin) * inverseDirection;
+
+    if (parallel) {
+      // 0 * inf: the ray runs along one of the slab's planes, and never leaves the slab. The other
+      // bound is infinite, so its opposite in place of the NaN leaves the slab unbounded. A NaN
+      // left in would make the comparisons below drop the hit
+      t0 = glm::mix(t0, -t1, glm::isnan(t0));
+      t1 = glm::mix(t1, -t0, glm::isnan(t1));
+    }
+
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    // NaNs only remain for flat boxes the ray lies in; second operands, so std::max/min skip them
+    float entry = std::max(std::max(std::max(0.0f, tNear.x), tNear.y), tNear.z);
+    float exit = std::min(std::min(std::min(FLT_MAX, tFar.x), tFar.y), tFar.z);
+    return entry <= exit && entry <= hit.distance ? entry : FLT_MAX;
+  };
+
+  std::vector<std::pair<int32_t, float>> stack;
+  float rootEntry = enter(nodes_[root_].bounds);
+  if (rootEntry < FLT_MAX) {
+    stack.emplace_back(root_, rootEntry);
+  }
+
+  while (!stack.empty()) {
+    auto [index, entry] = stack.back();
+    stack.pop_back();
+
+    // Found something closer since this node was pushed
+    if (entry > hit.distance) {
+      continue;
+    }
+
+    const Node& node = nodes_[index];
+    if (node.isLeaf()) {
+      if (hit.object == NO_OBJECT || entry < hit.distance) {
+        hit = {static_cast<uint32_t>(node.right), entry};
+      }
+      continue;
+    }
+
+    // Nearest child on top of the stack, so it's visited first and prunes the other
+    float leftEntry = enter(nodes_[node.left].bounds);
+    float rightEntry = enter(nodes_[node.right].bounds);
+    std::pair<int32_t, float> nearChild(node.left, leftEntry);
+    std::pair<int32_t, float> farChild(node.right, rightEntry);
+    if (rightEntry < leftEntry) {
+      std::swap(nearChild, farChild);
+    }
+
+    if (farChild.second < FLT_MAX) {
+      stack.push_back(farChild);
+    }
+    if (nearChild.second < FLT_MAX) {
+      stack.push_back(nearChild);
+    }
+  }
+
+  return hit;
+}
+
+void Bvh::raycast(const std::vector<BvhRay>& rays,
+                  std::vector<BvhRayHit>& hits,
+                  ThreadPool* threadPool) const {
+  hits.resize(rays.size());
+
+  auto castRange = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      hits[i] = raycast(rays[i]);
+    }
+  };
+
+  if (threadPool) {
+    threadPool->parallelFor(rays.size(), 256, castRange);
+  } else {
+    castRange(0, rays.size());
+  }
+}
+
+int32_t Bvh::allocateNode() {
+  if (!freeNodes_.empty()) {
+    int32_t node = freeNodes_.back();
+    freeNodes_.pop_back();
+    heights_[node] = 0;
+    return node;
+  }
+
+  nodes_.push_back({Aabb(), NULL_NODE, NULL_NODE});
+  parents_.push_back(NULL_NODE);
+  heights_.push_back(0);
+  return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+void Bvh::freeNode(int32_t node) {
+  heights_[node] = -1;
+  freeNodes_.push_back(node);
+}
+
+void Bvh::insertLeaf(int32_t leaf) {
+  if (root_ == NULL_NODE) {
+    root_ = leaf;
+    parents_[leaf] = NULL_NODE;
+    return;
+  }
+
+  // Walk down towards the sibling that minimizes the surface area added to the tree (the
+  // branch-and-bound-free descent of Box2D's dynamic tree)
+  const Aabb leafBounds = nodes_[leaf].bounds;
+  int32_t index = root_;
+
+  while (!nodes_[index].isLeaf()) {
+    const Node& node = nodes_[index];
+
+    float area = node.bounds.getSurfaceArea();
+    float combinedArea = merge(node.bounds, leafBounds).getSurfaceArea();
+
+    // Cost of making the leaf a sibling of this node, and the growth every level below pays on top
+    float cost = 2.0f * combinedArea;
+    float inheritedCost = 2.0f * (combinedArea - area);
+
+    auto descendCost = [&](int32_t child) {
+      const Node& childNode = nodes_[child];
+      float grownArea = merge(childNode.bounds, leafBounds).getSurfaceArea();
+      float childArea = childNode.isLeaf() ? 0.0f : childNode.bounds.getSurfaceArea();
+      return grownArea - childArea + inheritedCost;
+    };
+
+    float leftCost = descendCost(node.left);
+    float rightCost = descendCost(node.right);
+
+    if (cost < leftCost && cost < rightCost) {
+      break;
+    }
+
+    index = leftCost < rightCost ? node.left : node.right;
+  }
+
+  int32_t sibling = index;
+  int32_t oldParent = parents_[sibling];
+  int32_t newParent = allocateNode();
+
+  nodes_[newParent] = {merge(nodes_[sibling].bounds, leafBounds), sibling, leaf};
+  parents_[newParent] = oldParent;
+  heights_[newParent] = heights_[sibling] + 1;
+
+  replaceChild(oldParent, sibling, newParent);
+  parents_[sibling] = newParent;
+  parents_[leaf] = newParent;
+
+  refitAncestors(newParent);
+}
+
+void Bvh::removeLeaf(int32_t leaf) {
+  if (leaf == root_) {
+    root_ = NULL_NODE;
+    return;
+  }
+
+  // The leaf's sibling takes the place of their parent
+  int32_t parent = parents_[leaf];
+  int32_t grandparent = parents_[parent];
+  int32_t sibling = nodes_[parent].left == leaf ? nodes_[parent].right : nodes_[parent].left;
+
+  replaceChild(grandparent, parent, sibling);
+  parents_[sibling] = grandparent;
+  freeNode(parent);
+
+  refitAncestors(grandparent);
+}
+
+void Bvh::replaceChild(int32_t parent, int32_t oldChild, int32_t newChild) {
+  if (parent == NULL_NODE) {
+    root_ = newChild;
+  } else if (nodes_[parent].left == oldChild) {
+    nodes_[parent].left = newChild;
+  } else {
+    nodes_[parent].right = newChild;
+  }
+}
+
+void Bvh::refitNode(int32_t node) {
+  Node& n = nodes_[node];
+  n.bounds = merge(nodes_[n.left].bounds, nodes_[n.right].bounds);
+  heights_[node] = 1 + std::max(heights_[n.left], heights_[n.right]);
+}
+
+void Bvh::refitAncestors(int32_t node) {
+  while (node != NULL_NODE) {
+    refitNode(node);
+    rotate(node);
+    node = parents_[node];
+  }
+}
+
+void Bvh::refitSubtree(int32_t root) {
+  // Iterative post-order, so both children are refitted (and rotated) before their parent
+  std::vector<std::pair<int32_t, bool>> stack = {{root, false}};
+
+  while (!stack.empty()) {
+    auto [node, childrenDone] = stack.back();
+    stack.pop_back();
+
+    if (nodes_[node].isLeaf()) {
+      continue;
+    }
+
+    if (childrenDone) {
+      refitNode(node);
+      rotate(node);
+    } else {
+      stack.emplace_back(node, true);
+      stack.emplace_back(nodes_[node].left, false);
+      stack.emplace_back(nodes_[node].right, false);
+    }
+  }
+}
+
+void Bvh::rotate(int32_t node) {
+  const int32_t left = nodes_[node].left;
+  const int32_t right = nodes_[node].right;
+
+  // Swapping a child with one of its sibling's children leaves this node's box unchanged, and
+  // changes the sibling's box. Pick the swap that shrinks it the most, if any does
+  float bestDelta = 0.0f;
+  int32_t bestChild = NULL_NODE;
+  int32_t bestGrandchild = NULL_NODE;
+
+  auto consider = [&](int32_t child, int32_t sibling) {
+    const Node& siblingNode = nodes_[sibling];
+    if (siblingNode.isLeaf()) {
+      return;
+    }
+
+    float area = siblingNode.bounds.getSurfaceArea();
+    const Aabb& childBounds = nodes_[child].bounds;
+
+    // child <-> sibling.left: the sibling ends up with sibling.right and child
+    float delta = merge(childBounds, nodes_[siblingNode.right].bounds).getSurfaceArea() - area;
+    if (delta < bestDelta) {
+      bestDelta = delta;
+      bestChild = child;
+      bestGrandchild = siblingNode.left;
+    }
+
+    delta = merge(childBounds, nodes_[siblingNode.left].bounds).getSurfaceArea() - area;
+    if (delta < bestDelta) {
+      bestDelta = delta;
+      bestChild = child;
+      bestGrandchild = siblingNode.right;
+    }
+  };
+
+  consider(left, right);
+  consider(right, left);
+
+  if (bestChild == NULL_NODE) {
+    return;
+  }
+
+  int32_t sibling = parents_[bestGrandchild];
+  replaceChild(node, bestChild, bestGrandchild);
+  replaceChild(sibling, bestGrandchild, bestChild);
+  parents_[bestGrandchild] = node;
+  parents_[bestChild] = sibling;
+
+  refitNode(sibling);
+  heights_[node] = 1 + std::max(heights_[nodes_[node].left], heights_[nodes_[node].right]);
+}
+
+std::vector<int32_t> Bvh::splitSubtrees(size_t count, std::vector<int32_t>* above) const {
+  std::vector<int32_t> subtrees;
+  if (root_ == NULL_NODE) {
+    return subtrees;
+  }
+
+  // Breadth-first, one level at a time, until there are enough subtrees or only leaves are left
+  subtrees.push_back(root_);
+  while (subtrees.size() < count) {
+    std::vector<int32_t> next;
+    bool expanded = false;
+
+    for (int32_t node : subtrees) {
+      if (nodes_[node].isLeaf()) {
+        next.push_back(node);
+        continue;
+      }
+
+      if (above) {
+        above->push_back(node);
+      }
+      next.push_back(nodes_[node].left);
+      next.push_back(nodes_[node].right);
+      expanded = true;
+    }
+
+    subtrees.swap(next);
+    if (!expanded) {
+      break;
+    }
+  }
+
+  return subtrees;
+}
+
+void Bvh::queryFrustumSubtree(int32_t root,
+                              const Frustum& frustum,
+                              std::vector<uint32_t>& objects) const {
+  constexpr uint32_t ALL_PLANES = (1u << Frustum::PlaneCount) - 1;
+
+  // Each entry carries the planes its node still has to be tested against: once a box is fully
+  // inside a plane, so is everything below it
+  std::vector<std::pair<int32_t, uint32_t>> stack = {{root, ALL_PLANES}};
+
+  while (!stack.empty()) {
+    auto [index, planes] = stack.back();
+    stack.pop_back();
+
+    const Node& node = nodes_[index];
+    glm::vec3 center = node.bounds.getCenter();
+    glm::vec3 extent = node.bounds.getExtent();
+
+    bool outside = false;
+    for (uint32_t p = 0; p < Frustum::PlaneCount && !outside; p++) {
+      if (!(planes & (1u << p))) {
+        continue;
+      }
+
+      glm::vec3 normal(frustum.planes[p]);
+      float distance = glm::dot(normal, center) + frustum.planes[p].w;
+      float radius = glm::dot(glm::abs(normal), extent);
+
+      outside = distance + radius < 0.0f;
+      if (distance - radius >= 0.0f) {
+        planes &= ~(1u << p);
+      }
+    }
+
+    if (outside) {
+      continue;
+    }
+
+    if (node.isLeaf()) {
+      objects.push_back(static_cast<uint32_t>(node.right));
+    } else if (planes == 0) {
+      collectObjects(index, objects);
+    } else {
+      stack.emplace_back(node.left, planes);
+      stack.emplace_back(node.right, planes);
+    }
+  }
+}
+
+void Bvh::collectObjects(int32_t root, std::vector<uint32_t>& objects) const {
+  std::vector<int32_t> stack = {root};
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    if (node.isLeaf()) {
+      objects.push_back(static_cast<uint32_t>(node.right));
+    } else {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
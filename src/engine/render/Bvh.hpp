@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <engine/render/Aabb.hpp>
+#include <engine/render/Frustum.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct BvhRay {
+  glm::vec3 origin;
+  glm::vec3 direction;  // Doesn't need to be normalized; distances are in units of its length
+  float maxDistance = FLT_MAX;
+};
+
+struct BvhRayHit {
+  uint32_t object;  // Bvh::NO_OBJECT when nothing was hit
+  float distance;
+};
+
+/**
+ * @brief Dynamic bounding volume hierarchy over the bounding boxes of scene objects, for culling,
+ * picking and proximity queries that would otherwise be linear scans.
+ *
+ *   bvh.build(objectBounds, &threadPool);       // SAH build, object i gets objectBounds[i]
+ *   bvh.update(object, movedBounds);            // one object moved
+ *   bvh.setBounds(object, movedBounds);         // many objects moved...
+ *   bvh.refit(&threadPool);                     // ...then refit them all at once
+ *   bvh.queryFrustum(frustum, visibleObjects);
+ *
+ * Every leaf holds one object. Objects are identified by the index they were built with, or the
+ * id insert() returned; ids of removed objects are reused.
+ *
+ * build() lays the nodes out depth-first, with each node's left child right after it, and keeps
+ * the data traversals touch (bounds and children) in 32-byte nodes, two per cache line; parent
+ * links and heights live in separate arrays. Incremental changes allocate nodes wherever there is
+ * room, so a full build() restores the layout after heavy editing.
+ *
+ * Moving objects are handled by refitting the boxes of their ancestors, combined with tree
+ * rotations (Kensler 2008) that swap a child with a grandchild whenever that shrinks the surface
+ * area of the subtree, which keeps the tree's SAH cost close to a rebuild as objects drift.
+ *
+ * The const queries can run concurrently from any number of threads. Given a thread pool, frustum
+ * queries are also split over independent subtrees, and ray batches over rays.
+ */
+class Bvh {
+ public:
+  static constexpr uint32_t NO_OBJECT = UINT32_MAX;
+
+  Bvh() = default;
+  Bvh(Bvh& other) = delete;
+
+  /**
+   * @brief Replace the contents of the tree with one object per box, top-down with a binned
+   * surface area heuristic. Subtrees above PARALLEL_SIZE objects are built in parallel.
+   */
+  void build(const std::vector<Aabb>& bounds, ThreadPool* threadPool = nullptr);
+
+  void clear();
+
+  // Add an object and return its id
+  uint32_t insert(const Aabb& bounds);
+
+  void remove(uint32_t object);
+
+  /**
+   * @brief Move an object and refit its ancestors, rotating along the way. An object that no
+   * longer overlaps its old bounds is re-inserted from the root instead.
+   */
+  void update(uint32_t object, const Aabb& bounds);
+
+  // Move an object without touching the rest of the tree. Call refit() before the next query
+  void setBounds(uint32_t object, const Aabb& bounds);
+
+  // Recompute every internal box and apply rotations, bottom-up, splitting the work over subtrees
+  void refit(ThreadPool* threadPool = nullptr);
+
+  const Aabb& getBounds(uint32_t object) const;
+
+  size_t getObjectCount() const { return objectNodes_.size() - freeObjects_.size(); }
+
+  // Longest path from the root to a leaf, 0 for a single object
+  uint32_t getHeight() const;
+
+  // Sum of the surface areas of the internal nodes relative to the root's: the expected number of
+  // nodes a random ray visits, and a measure of tree quality
+  float getSahCost() const;
+
+  // Append every object whose box is at least partly inside `frustum` to `objects`
+  void queryFrustum(const Frustum& frustum,
+                    std::vector<uint32_t>& objects,
+                    ThreadPool* threadPool = nullptr) const;
+
+  // Append every object whose box overlaps `bounds` to `objects`
+  void queryAabb(const Aabb& bounds, std::vector<uint32_t>& objects) const;
+
+  // Nearest object whose box the ray enters, at a distance in [0, maxDistance]
+  BvhRayHit raycast(const BvhRay& ray) const;
+
+  void raycast(const std::vector<BvhRay>& rays,
+               std::vector<BvhRayHit>& hits,
+               ThreadPool* threadPool = nullptr) const;
+
+  // Object count above which work is split across a thread pool
+  static constexpr size_t PARALLEL_SIZE = 16384;
+
+ private:
+  static constexpr int32_t NULL_NODE = -1;
+
+  struct Node {
+    Aabb bounds;
+    int32_t left;   // NULL_NODE for leaves
+    int32_t right;  // The object, for leaves
+
+    bool isLeaf() const { return left == NULL_NODE; }
+  };
+
+  static_assert(sizeof(Node) == 32, "Bvh nodes should stay at half a cache line");
+
+  struct BuildContext;
+
+  int32_t allocateNode();
+  void freeNode(int32_t node);
+
+  uint32_t buildRange(BuildContext& context,
+                      int32_t node,
+                      int32_t parent,
+                      size_t begin,
+                      size_t end,
+                      uint32_t depth);
+
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  void replaceChild(int32_t parent, int32_t oldChild, int32_t newChild);
+
+  // Recompute a node's box and height from its children
+  void refitNode(int32_t node);
+  void refitAncestors(int32_t node);
+  void refitSubtree(int32_t root);
+  void rotate(int32_t node);
+
+  // Split the top of the tree into at least `count` disjoint subtrees where possible. The internal
+  // nodes above them go to `above`, parents before children
+  std::vector<int32_t> splitSubtrees(size_t count, std::vector<int32_t>* above) const;
+
+  void queryFrustumSubtree(int32_t root,
+                           const Frustum& frustum,
+                           std::vector<uint32_t>& objects) const;
+  void collectObjects(int32_t root, std::vector<uint32_t>& objects) const;
+
+ private:
+  std::vector<Node> nodes_;
+  std::vector<int32_t> parents_;
+  std::vector<int32_t> heights_;  // -1 for free nodes
+  std::vector<int32_t> freeNodes_;
+  int32_t root_ = NULL_NODE;
+
+  // Leaf of every object id, NULL_NODE for ids that are free
+  std::vector<int32_t> objectNodes_;
+  std::vector<uint32_t> freeObjects_;
+};
@@ -0,0 +1,80 @@
+#include "DepthPyramid.hpp"
+
+#include <fmtlog/Log.hpp>
+
+DepthPyramid::DepthPyramid(const LogicalDevice& device,
+                           const CommandPool& commandPool,
+                           const Image& depth,
+                           ShaderModule& downsampleShader,
+                           DescriptorSetLayoutCache& layoutCache,
+                           const PipelineCache* pipelineCache)
+    : device_(device),
+      depth_(depth),
+      pyramid_(device,
+               depth.getMipExtent(1),
+               FORMAT,
+               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+                   VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+               Image::getFullMipLevels(depth.getMipExtent(1))),
+      generator_(device, downsampleShader, layoutCache, pipelineCache) {
+  if (!(depth_.getAspect() & VK_IMAGE_ASPECT_DEPTH_BIT) || !(depth_.getUsage() & DEPTH_USAGE)) {
+    LOG_F("Depth pyramids need a depth format with VK_IMAGE_USAGE_SAMPLED_BIT");
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device_.getPhysicalDevice(), depth_.getFormat(), &properties);
+  if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    LOG_F("Depth format {} can't be sampled", static_cast<int>(depth_.getFormat()));
+  }
+
+  if (!generator_.canDownsample(pyramid_)) {
+    LOG_F("The depth pyramid can't be written in compute (see DepthPyramid::requestFeatures())");
+  }
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS) {
+    LOG_F("failed to create depth pyramid sampler!");
+  }
+
+  view_ = std::make_unique<ImageView>(pyramid_);
+
+  // The pyramid stays in GENERAL from now on: both the builds and the reads use it
+  CommandBuffer commandBuffer = commandPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  commandBuffer.transitionImageLayout(pyramid_, VK_IMAGE_LAYOUT_GENERAL);
+
+  VkClearColorValue farPlane{};
+  farPlane.float32[0] = 1.0f;
+  commandBuffer.clearColorImage(pyramid_, farPlane);
+
+  commandBuffer.end();
+  commandBuffer.submitAndWait();
+}
+
+DepthPyramid::~DepthPyramid() { vkDestroySampler(device_, sampler_, nullptr); }
+
+void DepthPyramid::requestFeatures(DeviceFeatures& features) {
+  MipGenerator::requestFeatures(features);
+}
+
+bool DepthPyramid::isSupported(const LogicalDevice& device) {
+  // Storage and sampled R32_SFLOAT images are required by the spec
+  return device.getEnabledFeatures().core.features.shaderStorageImageWriteWithoutFormat;
+}
+
+void DepthPyramid::record(CommandBuffer& commandBuffer) {
+  generator_.recordReduction(commandBuffer,
+                             depth_,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             pyramid_,
+                             MipReduction::Max);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/Descriptors.hpp>
+#include <engine/core/Image.hpp>
+#include <engine/core/MipGenerator.hpp>
+#include <memory>
+
+/**
+ * @brief A hierarchical depth buffer (Hi-Z): a mip chain in which every texel holds the farthest
+ * depth of the depth buffer texels under it, for occlusion culling.
+ *
+ * Level 0 is half the size of the depth buffer, and every level keeps the max of the 2x2 texels
+ * above it, plus the odd row or column at the edges, so a texel never claims anything nearer
+ * than what was drawn under it. Whatever lies behind the depth a texel holds is hidden.
+ *
+ * The pyramid is built with a MipGenerator of its own (shaders/downsample.comp), once the depth
+ * buffer is complete, and read by GpuCuller in the next frame. It is always in GENERAL, so only
+ * memory barriers order its builds and reads:
+ *
+ *   pyramid.record(commandBuffer);   // Depth buffer in SHADER_READ_ONLY_OPTIMAL
+ *
+ * The depth buffer needs DEPTH_USAGE on top of being a depth attachment, so it can't be a
+ * transient attachment. Only its depth is read, so it may have a stencil aspect too.
+ */
+class DepthPyramid {
+ public:
+  // The pyramid's format: depths are reduced in full precision whatever the depth format
+  static constexpr VkFormat FORMAT = VK_FORMAT_R32_SFLOAT;
+
+  // Usage the depth buffer needs for the pyramid to read it
+  static constexpr VkImageUsageFlags DEPTH_USAGE = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  DepthPyramid() = delete;
+  DepthPyramid(DepthPyramid& other) = delete;
+
+  /**
+   * @brief Create the pyramid of `depth`, cleared to the far plane (1) until the first build, so
+   * nothing is occluded before then. Blocks until the clear is done.
+   *
+   * @param commandPool runs the clear: needs a graphics or compute queue
+   * @param downsampleShader the compiled downsample.comp
+   * @param layoutCache provides the descriptor set layout, and must outlive the pyramid
+   */
+  DepthPyramid(const LogicalDevice& device,
+               const CommandPool& commandPool,
+               const Image& depth,
+               ShaderModule& downsampleShader,
+               DescriptorSetLayoutCache& layoutCache,
+               const PipelineCache* pipelineCache = nullptr);
+
+  ~DepthPyramid();
+
+  // Add the features building the pyramid needs to `features`
+  static void requestFeatures(DeviceFeatures& features);
+
+  // Whether `device` was created with what building a pyramid needs
+  static bool isSupported(const LogicalDevice& device);
+
+  /**
+   * @brief Rebuild every level from the depth buffer, which must be in
+   * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, after the depth writes and before the pyramid's
+   * reads. Waiting for the pyramid's previous reads, and making the new one visible to the next,
+   * is up to the caller. The descriptors used stay allocated as long as the pyramid.
+   */
+  void record(CommandBuffer& commandBuffer);
+
+  // Every level, for sampling in GENERAL
+  const ImageView& getView() const { return *view_; }
+
+  // Nearest filtering; the pyramid is meant to be read with texelFetch
+  VkSampler getSampler() const { return sampler_; }
+
+  uint32_t getMipLevels() const { return pyramid_.getMipLevels(); }
+
+  // Size of the depth buffer the pyramid reduces
+  VkExtent2D getDepthExtent() const { return depth_.getExtent(); }
+
+ private:
+  const LogicalDevice& device_;
+  const Image& depth_;
+
+  Image pyramid_;
+  std::unique_ptr<ImageView> view_;
+  VkSampler sampler_;
+  MipGenerator generator_;
+};
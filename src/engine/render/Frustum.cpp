@@ -0,0 +1,34 @@
+#include "Frustum.hpp"
+
+// glm matrices are column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+static glm::vec4 row(const glm::mat4& m, int i) {
+  return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+  // Gribb & Hartmann: every clip space inequality (-w <= x <= w, -w <= y <= w, 0 <= z <= w) is a
+  // plane made of two rows of the matrix
+  Frustum frustum;
+  frustum.planes[Left] = row(viewProjection, 3) + row(viewProjection, 0);
+  frustum.planes[Right] = row(viewProjection, 3) - row(viewProjection, 0);
+  frustum.planes[Bottom] = row(viewProjection, 3) + row(viewProjection, 1);
+  frustum.planes[Top] = row(viewProjection, 3) - row(viewProjection, 1);
+  frustum.planes[Near] = row(viewProjection, 2);
+  frustum.planes[Far] = row(viewProjection, 3) - row(viewProjection, 2);
+
+  for (auto& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+
+  return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec4& sphere) const {
+  for (const auto& plane : planes) {
+    if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/**
+ * @brief The six clip planes of a view-projection matrix, for culling bounding volumes.
+ *
+ * Planes are stored as (normal, distance) with unit-length normals pointing into the frustum, so
+ * `dot(normal, point) + distance` is the signed distance of a point from the plane.
+ */
+struct Frustum {
+  enum Plane { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+
+  glm::vec4 planes[PlaneCount];
+
+  /**
+   * @brief Extract the planes of `viewProjection`, using Vulkan's clip space conventions (depth in
+   * [0, 1]). Points in world space pass the planes of viewProjection, points in object space those
+   * of viewProjection * model.
+   */
+  static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+  // Whether a sphere (center in xyz, radius in w) is at least partly inside the frustum
+  bool intersectsSphere(const glm::vec4& sphere) const;
+};
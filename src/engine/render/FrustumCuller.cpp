@@ -0,0 +1,551 @@
+#include "FrustumCuller.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <engine/utils/cpu.hpp>
+#include <fmtlog/Log.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRUSTUM_CULLER_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define FRUSTUM_CULLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts AVX intrinsics anywhere. GCC and Clang need the functions using them marked, so the
+// rest of the library keeps building for the baseline instruction set
+#if defined(FRUSTUM_CULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUM_CULLER_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define FRUSTUM_CULLER_AVX2_TARGET
+#endif
+
+static_assert(FrustumCuller::CHUNK_SIZE % CULL_BLOCK_SIZE == 0,
+              "Chunks must hold whole blocks");
+
+namespace {
+
+// Padding volumes: a sphere with a huge negative radius, or a box with huge negative extents, is
+// behind every plane. FLT_MAX rather than infinity keeps the plane tests free of NaNs
+constexpr float EMPTY_EXTENT = -FLT_MAX;
+
+size_t roundUpToBlock(size_t count) {
+  return (count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE * CULL_BLOCK_SIZE;
+}
+
+// Append the indices of the lanes set in `mask` without branching on it: every lane is written,
+// but the output only advances past the visible ones
+inline size_t appendVisible(uint32_t mask, size_t lanes, size_t base, uint32_t* visible) {
+  size_t count = 0;
+  for (size_t lane = 0; lane < lanes; lane++) {
+    visible[count] = static_cast<uint32_t>(base + lane);
+    count += (mask >> lane) & 1;
+  }
+  return count;
+}
+
+size_t cullSpheresScalar(const Frustum& frustum,
+                         const SphereBounds& bounds,
+                         size_t beginBlock,
+                         size_t endBlock,
+                         uint32_t* visible) {
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i++) {
+    bool inside = true;
+    for (const auto& plane : frustum.planes) {
+      float distance = plane.x * bounds.getX()[i] + plane.y * bounds.getY()[i] +
+                       plane.z * bounds.getZ()[i] + plane.w;
+      inside = inside && distance >= -bounds.getRadius()[i];
+    }
+
+    visible[count] = static_cast<uint32_t>(i);
+    count += inside;
+  }
+
+  return count;
+}
+
+size_t cullBoxesScalar(const Frustum& frustum,
+                       const BoxBounds& bounds,
+                       size_t beginBlock,
+                       size_t endBlock,
+                       uint32_t* visible) {
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i++) {
+    bool inside = true;
+    for (const auto& plane : frustum.planes) {
+      // Distance of the corner furthest along the plane normal
+      float distance = plane.x * bounds.getCenterX()[i] + plane.y * bounds.getCenterY()[i] +
+                       plane.z * bounds.getCenterZ()[i] + plane.w +
+                       std::fabs(plane.x) * bounds.getExtentX()[i] +
+                       std::fabs(plane.y) * bounds.getExtentY()[i] +
+                       std::fabs(plane.z) * bounds.getExtentZ()[i];
+      inside = inside && distance >= 0.0f;
+    }
+
+    visible[count] = static_cast<uint32_t>(i);
+    count += inside;
+  }
+
+  return count;
+}
+
+#ifdef FRUSTUM_CULLER_X86
+
+size_t cullSpheresSse(const Frustum& frustum,
+                      const SphereBounds& bounds,
+                      size_t beginBlock,
+                      size_t endBlock,
+                      uint32_t* visible) {
+  __m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount];
+  __m128 planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+  for (int p = 0; p < Frustum::PlaneCount; p++) {
+    planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+  }
+
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 4) {
+    __m128 x = _mm_load_ps(bounds.getX() + i);
+    __m128 y = _mm_load_ps(bounds.getY() + i);
+    __m128 z = _mm_load_ps(bounds.getZ() + i);
+    __m128 negRadius = _mm_xor_ps(_mm_load_ps(bounds.getRadius() + i), signBit);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < Frustum::PlaneCount; p++) {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                   _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+    }
+
+    count += appendVisible(_mm_movemask_ps(inside), 4, i, visible + count);
+  }
+
+  return count;
+}
+
+size_t cullBoxesSse(const Frustum& frustum,
+                    const BoxBounds& bounds,
+                    size_t beginBlock,
+                    size_t endBlock,
+                    uint32_t* visible) {
+  __m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount];
+  __m128 planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+  __m128 absX[Frustum::PlaneCount], absY[Frustum::PlaneCount], absZ[Frustum::PlaneCount];
+  for (int p = 0; p < Frustum::PlaneCount; p++) {
+    planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    absX[p] = _mm_set1_ps(std::fabs(frustum.planes[p].x));
+    absY[p] = _mm_set1_ps(std::fabs(frustum.planes[p].y));
+    absZ[p] = _mm_set1_ps(std::fabs(frustum.planes[p].z));
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 4) {
+    __m128 x = _mm_load_ps(bounds.getCenterX() + i);
+    __m128 y = _mm_load_ps(bounds.getCenterY() + i);
+    __m128 z = _mm_load_ps(bounds.getCenterZ() + i);
+    __m128 ex = _mm_load_ps(bounds.getExtentX() + i);
+    __m128 ey = _mm_load_ps(bounds.getExtentY() + i);
+    __m128 ez = _mm_load_ps(bounds.getExtentZ() + i);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < Frustum::PlaneCount; p++) {
+      __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                 _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+      __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                 _mm_mul_ps(absZ[p], ez));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(center, radius), zero));
+    }
+
+    count += appendVisible(_mm_movemask_ps(inside), 4, i, visible + count);
+  }
+
+  return count;
+}
+
+FRUSTUM_CULLER_AVX2_TARGET size_t cullSpheresAvx2(const Frustum& frustum,
+                                                  const SphereBounds& bounds,
+                                                  size_t beginBlock,
+                                                  size_t endBlock,
+                                                  uint32_t* visible) {
+  __m256 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount];
+  __m256 planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+  for (int p = 0; p < Frustum::PlaneCount; p++) {
+    planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+  }
+
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 8) {
+    __m256 x = _mm256_load_ps(bounds.getX() + i);
+    __m256 y = _mm256_load_ps(bounds.getY() + i);
+    __m256 z = _mm256_load_ps(bounds.getZ() + i);
+    __m256 negRadius = _mm256_xor_ps(_mm256_load_ps(bounds.getRadius() + i), signBit);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < Frustum::PlaneCount; p++) {
+      __m256 distance = _mm256_fmadd_ps(
+          planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+    }
+
+    count += appendVisible(_mm256_movemask_ps(inside), 8, i, visible + count);
+  }
+
+  return count;
+}
+
+FRUSTUM_CULLER_AVX2_TARGET size_t cullBoxesAvx2(const Frustum& frustum,
+                                                const BoxBounds& bounds,
+                                                size_t beginBlock,
+                                                size_t endBlock,
+                                                uint32_t* visible) {
+  __m256 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount];
+  __m256 planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+  __m256 absX[Frustum::PlaneCount], absY[Frustum::PlaneCount], absZ[Frustum::PlaneCount];
+  for (int p = 0; p < Frustum::PlaneCount; p++) {
+    planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    absX[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].x));
+    absY[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].y));
+    absZ[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].z));
+  }
+
+  const __m256 zero = _mm256_setzero_ps();
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 8) {
+    __m256 x = _mm256_load_ps(bounds.getCenterX() + i);
+    __m256 y = _mm256_load_ps(bounds.getCenterY() + i);
+    __m256 z = _mm256_load_ps(bounds.getCenterZ() + i);
+    __m256 ex = _mm256_load_ps(bounds.getExtentX() + i);
+    __m256 ey = _mm256_load_ps(bounds.getExtentY() + i);
+    __m256 ez = _mm256_load_ps(bounds.getExtentZ() + i);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < Frustum::PlaneCount; p++) {
+      __m256 distance = _mm256_fmadd_ps(
+          planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+      distance = _mm256_fmadd_ps(
+          absX[p], ex, _mm256_fmadd_ps(absY[p], ey, _mm256_fmadd_ps(absZ[p], ez, distance)));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+
+    count += appendVisible(_mm256_movemask_ps(inside), 8, i, visible + count);
+  }
+
+  return count;
+}
+
+#endif  // FRUSTUM_CULLER_X86
+
+#ifdef FRUSTUM_CULLER_NEON
+
+inline uint32_t movemask(uint32x4_t mask) {
+  const uint32_t laneBits[4] = {1, 2, 4, 8};
+  uint32x4_t bits = vandq_u32(mask, vld1q_u32(laneBits));
+  uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+  return vget_lane_u32(vpadd_u32(sum, sum), 0);
+}
+
+size_t cullSpheresNeon(const Frustum& frustum,
+                       const SphereBounds& bounds,
+                       size_t beginBlock,
+                       size_t endBlock,
+                       uint32_t* visible) {
+  size_t count = 0;
+
+  // Two 4-wide halves per block, so both halves share every plane load
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 8) {
+    float32x4_t x0 = vld1q_f32(bounds.getX() + i), x1 = vld1q_f32(bounds.getX() + i + 4);
+    float32x4_t y0 = vld1q_f32(bounds.getY() + i), y1 = vld1q_f32(bounds.getY() + i + 4);
+    float32x4_t z0 = vld1q_f32(bounds.getZ() + i), z1 = vld1q_f32(bounds.getZ() + i + 4);
+    float32x4_t negRadius0 = vnegq_f32(vld1q_f32(bounds.getRadius() + i));
+    float32x4_t negRadius1 = vnegq_f32(vld1q_f32(bounds.getRadius() + i + 4));
+
+    uint32x4_t inside0 = vdupq_n_u32(~0u), inside1 = vdupq_n_u32(~0u);
+    for (const auto& plane : frustum.planes) {
+      float32x4_t distance0 = vdupq_n_f32(plane.w), distance1 = vdupq_n_f32(plane.w);
+      distance0 = vmlaq_n_f32(distance0, x0, plane.x);
+      distance1 = vmlaq_n_f32(distance1, x1, plane.x);
+      distance0 = vmlaq_n_f32(distance0, y0, plane.y);
+      distance1 = vmlaq_n_f32(distance1, y1, plane.y);
+      distance0 = vmlaq_n_f32(distance0, z0, plane.z);
+      distance1 = vmlaq_n_f32(distance1, z1, plane.z);
+      inside0 = vandq_u32(inside0, vcgeq_f32(distance0, negRadius0));
+      inside1 = vandq_u32(inside1, vcgeq_f32(distance1, negRadius1));
+    }
+
+    uint32_t mask = movemask(inside0) | (movemask(inside1) << 4);
+    count += appendVisible(mask, 8, i, visible + count);
+  }
+
+  return count;
+}
+
+size_t cullBoxesNeon(const Frustum& frustum,
+                     const BoxBounds& bounds,
+                     size_t beginBlock,
+                     size_t endBlock,
+                     uint32_t* visible) {
+  size_t count = 0;
+
+  for (size_t i = beginBlock * CULL_BLOCK_SIZE; i < endBlock * CULL_BLOCK_SIZE; i += 4) {
+    float32x4_t x = vld1q_f32(bounds.getCenterX() + i);
+    float32x4_t y = vld1q_f32(bounds.getCenterY() + i);
+    float32x4_t z = vld1q_f32(bounds.getCenterZ() + i);
+    float32x4_t ex = vld1q_f32(bounds.getExtentX() + i);
+    float32x4_t ey = vld1q_f32(bounds.getExtentY() + i);
+    float32x4_t ez = vld1q_f32(bounds.getExtentZ() + i);
+
+    uint32x4_t inside = vdupq_n_u32(~0u);
+    for (const auto& plane : frustum.planes) {
+      float32x4_t distance = vdupq_n_f32(plane.w);
+      distance = vmlaq_n_f32(distance, x, plane.x);
+      distance = vmlaq_n_f32(distance, y, plane.y);
+      distance = vmlaq_n_f32(distance, z, plane.z);
+      distance = vmlaq_n_f32(distance, ex, std::fabs(plane.x));
+      distance = vmlaq_n_f32(distance, ey, std::fabs(plane.y));
+      distance = vmlaq_n_f32(distance, ez, std::fabs(plane.z));
+      inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+    }
+
+    count += appendVisible(movemask(inside), 4, i, visible + count);
+  }
+
+  return count;
+}
+
+#endif  // FRUSTUM_CULLER_NEON
+
+}  // namespace
+
+void SphereBounds::resize(size_t count) {
+  size_t padded = roundUpToBlock(count);
+
+  // Spheres past the old size become real ones up to `count`, and padding after that
+  x_.resize(padded, 0.0f);
+  y_.resize(padded, 0.0f);
+  z_.resize(padded, 0.0f);
+  radius_.resize(padded);
+
+  for (size_t i = std::min(count_, count); i < padded; i++) {
+    radius_[i] = i < count ? 0.0f : EMPTY_EXTENT;
+  }
+
+  count_ = count;
+}
+
+void SphereBounds::set(size_t index, const glm::vec4& sphere) {
+  x_[index] = sphere.x;
+  y_[index] = sphere.y;
+  z_[index] = sphere.z;
+  radius_[index] = sphere.w;
+}
+
+glm::vec4 SphereBounds::get(size_t index) const {
+  return glm::vec4(x_[index], y_[index], z_[index], radius_[index]);
+}
+
+void BoxBounds::resize(size_t count) {
+  size_t padded = roundUpToBlock(count);
+
+  centerX_.resize(padded, 0.0f);
+  centerY_.resize(padded, 0.0f);
+  centerZ_.resize(padded, 0.0f);
+  extentX_.resize(padded);
+  extentY_.resize(padded);
+  extentZ_.resize(padded);
+
+  for (size_t i = std::min(count_, count); i < padded; i++) {
+    float extent = i < count ? 0.0f : EMPTY_EXTENT;
+    extentX_[i] = extent;
+    extentY_[i] = extent;
+    extentZ_[i] = extent;
+  }
+
+  count_ = count;
+}
+
+void BoxBounds::set(size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+  centerX_[index] = (boundsMin.x + boundsMax.x) * 0.5f;
+  centerY_[index] = (boundsMin.y + boundsMax.y) * 0.5f;
+  centerZ_[index] = (boundsMin.z + boundsMax.z) * 0.5f;
+  extentX_[index] = (boundsMax.x - boundsMin.x) * 0.5f;
+  extentY_[index] = (boundsMax.y - boundsMin.y) * 0.5f;
+  extentZ_[index] = (boundsMax.z - boundsMin.z) * 0.5f;
+}
+
+const char* getCullKernelName(CullKernel kernel) {
+  switch (kernel) {
+    case CullKernel::Scalar:
+      return "scalar";
+    case CullKernel::SSE:
+      return "SSE";
+    case CullKernel::AVX2:
+      return "AVX2";
+    case CullKernel::NEON:
+      return "NEON";
+  }
+
+  return "unknown";
+}
+
+bool isCullKernelSupported(CullKernel kernel) {
+  switch (kernel) {
+    case CullKernel::Scalar:
+      return true;
+#ifdef FRUSTUM_CULLER_X86
+    case CullKernel::SSE:
+      return true;
+    case CullKernel::AVX2: {
+      static const bool supported = cpuSupportsAvx2();
+      return supported;
+    }
+#endif
+#ifdef FRUSTUM_CULLER_NEON
+    case CullKernel::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+CullKernel getBestCullKernel() {
+  for (CullKernel kernel : {CullKernel::AVX2, CullKernel::NEON, CullKernel::SSE}) {
+    if (isCullKernelSupported(kernel)) {
+      return kernel;
+    }
+  }
+
+  return CullKernel::Scalar;
+}
+
+size_t cullSpheres(CullKernel kernel,
+                   const Frustum& frustum,
+                   const SphereBounds& bounds,
+                   size_t beginBlock,
+                   size_t endBlock,
+                   uint32_t* visible) {
+  switch (kernel) {
+#ifdef FRUSTUM_CULLER_X86
+    case CullKernel::SSE:
+      return cullSpheresSse(frustum, bounds, beginBlock, endBlock, visible);
+    case CullKernel::AVX2:
+      return cullSpheresAvx2(frustum, bounds, beginBlock, endBlock, visible);
+#endif
+#ifdef FRUSTUM_CULLER_NEON
+    case CullKernel::NEON:
+      return cullSpheresNeon(frustum, bounds, beginBlock, endBlock, visible);
+#endif
+    default:
+      return cullSpheresScalar(frustum, bounds, beginBlock, endBlock, visible);
+  }
+}
+
+size_t cullBoxes(CullKernel kernel,
+                 const Frustum& frustum,
+                 const BoxBounds& bounds,
+                 size_t beginBlock,
+                 size_t endBlock,
+                 uint32_t* visible) {
+  switch (kernel) {
+#ifdef FRUSTUM_CULLER_X86
+    case CullKernel::SSE:
+      return cullBoxesSse(frustum, bounds, beginBlock, endBlock, visible);
+    case CullKernel::AVX2:
+      return cullBoxesAvx2(frustum, bounds, beginBlock, endBlock, visible);
+#endif
+#ifdef FRUSTUM_CULLER_NEON
+    case CullKernel::NEON:
+      return cullBoxesNeon(frustum, bounds, beginBlock, endBlock, visible);
+#endif
+    default:
+      return cullBoxesScalar(frustum, bounds, beginBlock, endBlock, visible);
+  }
+}
+
+FrustumCuller::FrustumCuller(ThreadPool* threadPool, CullKernel kernel)
+    : threadPool_(threadPool), kernel_(kernel) {
+  if (!isCullKernelSupported(kernel)) {
+    LOG_F("The {} culling kernel is not supported on this CPU", getCullKernelName(kernel));
+  }
+}
+
+template <class CullFunction>
+void FrustumCuller::cullChunks(size_t paddedCount, const CullFunction& cullBlocks) {
+  // Every chunk writes into the slice of the output starting at its first object, which is always
+  // large enough to hold all of its objects
+  size_t chunkCount = (paddedCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  visible_.resize(paddedCount);
+  chunkCounts_.assign(chunkCount, 0);
+
+  auto cullChunk = [&](size_t chunk) {
+    size_t begin = chunk * CHUNK_SIZE;
+    size_t end = std::min(begin + CHUNK_SIZE, paddedCount);
+    chunkCounts_[chunk] =
+        cullBlocks(begin / CULL_BLOCK_SIZE, end / CULL_BLOCK_SIZE, visible_.data() + begin);
+  };
+
+  if (threadPool_ && chunkCount > 1) {
+    threadPool_->parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+      for (size_t chunk = begin; chunk < end; chunk++) {
+        cullChunk(chunk);
+      }
+    });
+  } else {
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+      cullChunk(chunk);
+    }
+  }
+
+  // Pack the slices. Each one moves towards the front, never past the start of its own slice
+  size_t count = 0;
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    std::memmove(visible_.data() + count,
+                 visible_.data() + chunk * CHUNK_SIZE,
+                 chunkCounts_[chunk] * sizeof(uint32_t));
+    count += chunkCounts_[chunk];
+  }
+
+  visible_.resize(count);
+}
+
+const std::vector<uint32_t>& FrustumCuller::cull(const Frustum& frustum,
+                                                 const SphereBounds& bounds) {
+  cullChunks(bounds.getPaddedSize(), [&](size_t beginBlock, size_t endBlock, uint32_t* visible) {
+    return cullSpheres(kernel_, frustum, bounds, beginBlock, endBlock, visible);
+  });
+  return visible_;
+}
+
+const std::vector<uint32_t>& FrustumCuller::cull(const Frustum& frustum,
+                                                 const BoxBounds& bounds) {
+  cullChunks(bounds.getPaddedSize(), [&](size_t beginBlock, size_t endBlock, uint32_t* visible) {
+    return cullBoxes(kernel_, frustum, bounds, beginBlock, endBlock, visible);
+  });
+  return visible_;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <engine/render/Frustum.hpp>
+#include <engine/utils/AlignedAllocator.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Every kernel handles bounding volumes in blocks of this many. Bounds stores are padded to a
+// whole number of blocks with empty volumes that fail every plane
+constexpr size_t CULL_BLOCK_SIZE = 8;
+
+/**
+ * @brief Bounding spheres stored as separate center x / y / z and radius arrays, each 32-byte
+ * aligned, so a SIMD kernel loads the same component of 4 or 8 spheres at once.
+ */
+class SphereBounds {
+ public:
+  SphereBounds() = default;
+  SphereBounds(SphereBounds& other) = delete;
+
+  size_t size() const { return count_; }
+
+  // size() rounded up to a whole number of blocks
+  size_t getPaddedSize() const { return x_.size(); }
+
+  // Resize to `count` spheres. New spheres are zero-sized, at the origin
+  void resize(size_t count);
+
+  // Center in xyz, radius in w
+  void set(size_t index, const glm::vec4& sphere);
+
+  glm::vec4 get(size_t index) const;
+
+  const float* getX() const { return x_.data(); }
+  const float* getY() const { return y_.data(); }
+  const float* getZ() const { return z_.data(); }
+  const float* getRadius() const { return radius_.data(); }
+
+ private:
+  size_t count_ = 0;
+  AlignedVector<float> x_;
+  AlignedVector<float> y_;
+  AlignedVector<float> z_;
+  AlignedVector<float> radius_;
+};
+
+/**
+ * @brief Axis-aligned bounding boxes stored as separate center and half-extent arrays, each 32-byte
+ * aligned. Center / extent is cheaper to test against a plane than min / max.
+ */
+class BoxBounds {
+ public:
+  BoxBounds() = default;
+  BoxBounds(BoxBounds& other) = delete;
+
+  size_t size() const { return count_; }
+
+  size_t getPaddedSize() const { return centerX_.size(); }
+
+  // Resize to `count` boxes. New boxes are empty, at the origin
+  void resize(size_t count);
+
+  void set(size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+  const float* getCenterX() const { return centerX_.data(); }
+  const float* getCenterY() const { return centerY_.data(); }
+  const float* getCenterZ() const { return centerZ_.data(); }
+  const float* getExtentX() const { return extentX_.data(); }
+  const float* getExtentY() const { return extentY_.data(); }
+  const float* getExtentZ() const { return extentZ_.data(); }
+
+ private:
+  size_t count_ = 0;
+  AlignedVector<float> centerX_;
+  AlignedVector<float> centerY_;
+  AlignedVector<float> centerZ_;
+  AlignedVector<float> extentX_;
+  AlignedVector<float> extentY_;
+  AlignedVector<float> extentZ_;
+};
+
+/**
+ * @brief Instruction sets the culling kernels are written for. SSE handles 4 volumes per
+ * iteration and AVX2 8. NEON handles 8 spheres (as two 4-wide halves) but 4 boxes.
+ */
+enum class CullKernel { Scalar, SSE, AVX2, NEON };
+
+const char* getCullKernelName(CullKernel kernel);
+
+// Whether `kernel` was compiled in and runs on this CPU. Scalar is always supported
+bool isCullKernelSupported(CullKernel kernel);
+
+// The widest kernel supported by this CPU, checked once at runtime
+CullKernel getBestCullKernel();
+
+/**
+ * @brief Test blocks [beginBlock, endBlock) of `bounds` against `frustum` on the calling thread,
+ * and append the index of every volume at least partly inside it to `visible`, in ascending order.
+ * `visible` needs room for (endBlock - beginBlock) * CULL_BLOCK_SIZE indices. Returns how many
+ * indices were written.
+ */
+size_t cullSpheres(CullKernel kernel,
+                   const Frustum& frustum,
+                   const SphereBounds& bounds,
+                   size_t beginBlock,
+                   size_t endBlock,
+                   uint32_t* visible);
+
+size_t cullBoxes(CullKernel kernel,
+                 const Frustum& frustum,
+                 const BoxBounds& bounds,
+                 size_t beginBlock,
+                 size_t endBlock,
+                 uint32_t* visible);
+
+/**
+ * @brief CPU frustum culling, for when culling can't run in a compute pass (see GpuCuller).
+ *
+ *   bounds.resize(objectCount);
+ *   bounds.set(i, worldSphere);   // for every object
+ *   const auto& visible = culler.cull(frustum, bounds);
+ *
+ * The bounds are split into chunks culled in parallel on the thread pool, each into its own slice
+ * of the output, and the slices are then packed into a single ascending list of visible indices.
+ * InstancedDrawList::getVisibleIndirectCommands() turns that list into draws.
+ */
+class FrustumCuller {
+ public:
+  FrustumCuller(FrustumCuller& other) = delete;
+
+  // Without a thread pool everything runs on the calling thread. Calls LOG_F if `kernel` is not
+  // supported on this CPU
+  explicit FrustumCuller(ThreadPool* threadPool = nullptr,
+                         CullKernel kernel = getBestCullKernel());
+
+  const std::vector<uint32_t>& cull(const Frustum& frustum, const SphereBounds& bounds);
+
+  const std::vector<uint32_t>& cull(const Frustum& frustum, const BoxBounds& bounds);
+
+  // Result of the last cull()
+  const std::vector<uint32_t>& getVisible() const { return visible_; }
+
+  CullKernel getKernel() const { return kernel_; }
+
+  // Objects per parallel chunk: large enough to amortize scheduling, a multiple of the block size
+  static constexpr size_t CHUNK_SIZE = 16384;
+
+ private:
+  template <class CullFunction>
+  void cullChunks(size_t paddedCount, const CullFunction& cullBlocks);
+
+ private:
+  ThreadPool* threadPool_;
+  CullKernel kernel_;
+  std::vector<uint32_t> visible_;
+  std::vector<size_t> chunkCounts_;
+};
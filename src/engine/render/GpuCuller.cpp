@@ -0,0 +1,200 @@
+#include "GpuCuller.hpp"
+
+#include <algorithm>
+#include <engine/core/SpecializationConstants.hpp>
+#include <fmtlog/Log.hpp>
+
+// Must match local_size_x in cull.comp
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+// Bindings of the culling shader's descriptor set, in order
+enum CullBinding : uint32_t {
+  ParamsBinding = 0,
+  InstancesBinding,
+  ObjectMeshesBinding,
+  MeshesBinding,
+  CommandsBinding,
+  CountBinding,
+  PyramidBinding,  // The only image: every binding before it is a storage buffer
+  CullBindingCount
+};
+
+using CullCompact = SpecializationConstant<0, bool>;
+
+GpuCuller::GpuCuller(const LogicalDevice& device,
+                     const MeshPool& meshPool,
+                     const DepthPyramid& depthPyramid,
+                     ShaderModule& cullShader,
+                     DescriptorSetLayoutCache& layoutCache,
+                     const std::vector<const InstanceBuffer<InstanceData>*>& instanceBuffers,
+                     size_t maxObjects,
+                     const PipelineCache* pipelineCache)
+    : device_(device),
+      meshPool_(meshPool),
+      depthPyramid_(depthPyramid),
+      maxObjects_(std::max<size_t>(maxObjects, 1)),
+      compact_(device.getEnabledFeatures().vulkan12.drawIndirectCount),
+      descriptors_(device,
+                   static_cast<uint32_t>(instanceBuffers.size()),
+                   {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, float(PyramidBinding)},
+                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f}}) {
+  // Mesh table: static, shared by every frame
+  std::vector<CullMeshInfo> meshInfo(meshPool_.getMeshCount());
+  for (uint32_t i = 0; i < meshInfo.size(); i++) {
+    const MeshRange& range = meshPool_.getRange(i);
+    meshInfo[i] = {range.indexCount, range.firstIndex, range.vertexOffset, 0, range.boundingSphere};
+  }
+
+  meshInfo_ = std::make_unique<MappedBuffer<CullMeshInfo>>(
+      device_, std::max<size_t>(meshInfo.size(), 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  meshInfo_->write(meshInfo);
+
+  // Descriptor set layout: storage buffers and the depth pyramid, used by the compute stage
+  std::vector<VkDescriptorSetLayoutBinding> bindings(CullBindingCount);
+  for (uint32_t i = 0; i < CullBindingCount; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = i == PyramidBinding ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  descriptorSetLayout_ = layoutCache.get(bindings);
+
+  // Per-frame buffers and descriptor sets, written all at once
+  constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  DescriptorWriter writer(device_);
+
+  for (const auto* instances : instanceBuffers) {
+    if (instances->getCapacity() < maxObjects) {
+      LOG_F("Instance buffer holds {} instances, the culler expects up to {}",
+            instances->getCapacity(),
+            maxObjects);
+    }
+
+    FrameResources frame;
+    frame.instances = instances;
+    frame.params = std::make_unique<MappedBuffer<CullParams>>(
+        device_, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    frame.objectMeshes = std::make_unique<MappedBuffer<uint32_t>>(
+        device_, maxObjects_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    frame.commands =
+        std::make_unique<OnDeviceBuffer<VkDrawIndexedIndirectCommand>>(device_, maxObjects_);
+    frame.drawCount = std::make_unique<Buffer<uint32_t>>(
+        device_,
+        1,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    frame.descriptorSet = descriptors_.allocate(descriptorSetLayout_);
+
+    writer.writeBuffer(frame.descriptorSet, ParamsBinding, type, *frame.params)
+        .writeBuffer(frame.descriptorSet, InstancesBinding, type, *frame.instances)
+        .writeBuffer(frame.descriptorSet, ObjectMeshesBinding, type, *frame.objectMeshes)
+        .writeBuffer(frame.descriptorSet, MeshesBinding, type, *meshInfo_)
+        .writeBuffer(frame.descriptorSet, CommandsBinding, type, *frame.commands)
+        .writeBuffer(frame.descriptorSet, CountBinding, type, *frame.drawCount)
+        .writeImage(frame.descriptorSet,
+                    PyramidBinding,
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    depthPyramid_.getView(),
+                    depthPyramid_.getSampler(),
+                    VK_IMAGE_LAYOUT_GENERAL);
+
+    frames_.push_back(std::move(frame));
+  }
+
+  writer.update();
+
+  SpecializationConstants<CullCompact> constants;
+  constants.set<CullCompact::id>(compact_);
+  cullShader.specialize(constants);
+
+  std::vector<VkDescriptorSetLayout> setLayouts = {descriptorSetLayout_};
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  pipeline_ = std::make_unique<ComputePipeline>(
+      device_, cullShader, setLayouts, pushConstantRanges, pipelineCache);
+}
+
+void GpuCuller::update(size_t frame,
+                       const InstancedDrawList& drawList,
+                       const glm::mat4& viewProjection) {
+  if (drawList.getInstanceCount() > maxObjects_) {
+    LOG_F("Draw list has {} instances, the culler was created for up to {}",
+          drawList.getInstanceCount(),
+          maxObjects_);
+  }
+
+  FrameResources& resources = frames_[frame];
+
+  Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+  CullParams params{};
+  for (int i = 0; i < Frustum::PlaneCount; i++) {
+    params.planes[i] = frustum.planes[i];
+  }
+
+  // The first frame's pyramid is still cleared to the far plane, and hides nothing whatever the
+  // matrix
+  params.occlusionViewProjection = previousViewProjection_.value_or(viewProjection);
+  previousViewProjection_ = viewProjection;
+
+  VkExtent2D depthExtent = depthPyramid_.getDepthExtent();
+  params.depthSize = glm::vec2(depthExtent.width, depthExtent.height);
+  params.objectCount = static_cast<uint32_t>(drawList.getInstanceCount());
+  resources.params->write(&params, 1);
+
+  // Instances are stored batch after batch, so each batch is a run of the same mesh index
+  objectMeshScratch_.resize(drawList.getInstanceCount());
+  for (const auto& batch : drawList.getBatches()) {
+    std::fill_n(objectMeshScratch_.begin() + batch.firstInstance,
+                batch.instanceCount,
+                batch.meshIndex);
+  }
+  resources.objectMeshes->write(objectMeshScratch_);
+}
+
+void GpuCuller::recordCull(CommandBuffer& commandBuffer, size_t frame, bool drawBarrier) const {
+  const FrameResources& resources = frames_[frame];
+
+  // Start from an empty list: zero draws, and zeroed commands when every object keeps its slot
+  commandBuffer.fillBuffer(*resources.drawCount);
+  if (!compact_) {
+    commandBuffer.fillBuffer(*resources.commands);
+  }
+
+  commandBuffer.memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  commandBuffer.bindPipeline(*pipeline_);
+  commandBuffer.bindDescriptorSets(*pipeline_, {resources.descriptorSet});
+
+  // Sized for the worst case, since the command buffer may be reused across frames: the shader
+  // skips invocations past the frame's object count
+  commandBuffer.dispatch(ComputePipeline::getGroupCount(maxObjects_, CULL_GROUP_SIZE));
+
+  if (drawBarrier) {
+    commandBuffer.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+  }
+}
+
+void GpuCuller::recordDraw(CommandBuffer& commandBuffer, size_t frame) const {
+  const FrameResources& resources = frames_[frame];
+
+  commandBuffer.bindVertexBuffer(InstanceData::Binding::binding, *resources.instances);
+  meshPool_.bind(commandBuffer);
+
+  if (compact_) {
+    commandBuffer.drawIndexedIndirectCount(*resources.commands,
+                                           *resources.drawCount,
+                                           static_cast<uint32_t>(maxObjects_));
+  } else {
+    commandBuffer.drawIndexedIndirect(*resources.commands, static_cast<uint32_t>(maxObjects_));
+  }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/Buffer.hpp>
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/ComputePipeline.hpp>
+#include <engine/core/Descriptors.hpp>
+#include <engine/core/InstanceData.hpp>
+#include <engine/render/DepthPyramid.hpp>
+#include <engine/render/Frustum.hpp>
+#include <engine/render/InstancedDrawList.hpp>
+#include <engine/render/MeshPool.hpp>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Storage buffer layouts shared with the culling shader (std430)
+struct CullParams {
+  glm::vec4 planes[Frustum::PlaneCount];
+  glm::mat4 occlusionViewProjection;  // The one the depth pyramid's depth buffer was drawn with
+  glm::vec2 depthSize;
+  uint32_t objectCount;
+  uint32_t reserved;
+};
+
+struct CullMeshInfo {
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t reserved;
+  glm::vec4 boundingSphere;
+};
+
+static_assert(sizeof(CullParams) == 176, "CullParams must match the culling shader");
+static_assert(sizeof(CullMeshInfo) == 32, "CullMeshInfo must match the culling shader");
+
+/**
+ * @brief GPU-driven frustum and occlusion culling of an InstancedDrawList whose meshes live in a
+ * MeshPool.
+ *
+ * A compute shader (shaders/cull.comp) tests the bounding sphere of every instance against the
+ * view frustum and writes an indirect draw command for each one that survives, so culling costs a
+ * single dispatch however many objects there are. The CPU only uploads the camera and which mesh
+ * each instance uses.
+ *
+ * Spheres inside the frustum are then tested against the DepthPyramid of the previous frame: the
+ * corners of the sphere's bounding box are projected with the previous frame's view-projection,
+ * and the sphere is culled if its nearest depth lies behind the farthest depth the pyramid holds
+ * over the rectangle they cover, read from the level where that rectangle spans at most 2x2
+ * texels. Bounds crossing the camera plane are kept. Objects coming out from behind others show
+ * up one frame late, once the pyramid has caught up with them.
+ *
+ * With drawIndirectCount, surviving draws are compacted to the front of the command buffer and
+ * counted on the GPU. Without it, every object keeps its own command, with zero instances when
+ * culled.
+ *
+ * Resources are kept per frame (one set per instance buffer), so a frame can be prepared while
+ * others are in flight. The pyramid is shared by every frame, which must be run in the order their
+ * update() was called:
+ *
+ *   culler.update(frame, drawList, viewProjection);   // Once nothing in flight uses `frame`
+ *   culler.recordCull(commandBuffer, frame);           // Outside the render pass
+ *   culler.recordDraw(commandBuffer, frame);           // Inside it
+ *   depthPyramid.record(commandBuffer);                // Once the depth buffer is complete
+ *
+ * The cull reads the pyramid in the compute stage, and its build must wait for that read: see
+ * DepthPyramid for the barriers.
+ */
+class GpuCuller {
+ public:
+  GpuCuller() = delete;
+  GpuCuller(GpuCuller& other) = delete;
+
+  /**
+   * @param depthPyramid rebuilt by the caller after every frame's depth, and read in GENERAL
+   * @param cullShader the compiled cull.comp; specialized by the culler
+   * @param layoutCache provides the descriptor set layout, and must outlive the culler
+   * @param instanceBuffers one per frame, holding the draw list's instances
+   * @param maxObjects the most instances a frame may hold
+   * @param pipelineCache optional, speeds up re-creating the culler (e.g. on swapchain resize)
+   */
+  GpuCuller(const LogicalDevice& device,
+            const MeshPool& meshPool,
+            const DepthPyramid& depthPyramid,
+            ShaderModule& cullShader,
+            DescriptorSetLayoutCache& layoutCache,
+            const std::vector<const InstanceBuffer<InstanceData>*>& instanceBuffers,
+            size_t maxObjects,
+            const PipelineCache* pipelineCache = nullptr);
+
+  // Whether surviving draws are compacted and counted on the GPU (needs drawIndirectCount)
+  bool isCompacting() const { return compact_; }
+
+  /**
+   * @brief Upload the camera and the draw list's per-instance mesh indices for `frame`. The
+   * frame's instance buffer must hold drawList.getInstances() by the time the frame executes.
+   * Occlusion is tested with the `viewProjection` of the previous call.
+   */
+  void update(size_t frame, const InstancedDrawList& drawList, const glm::mat4& viewProjection);
+
+  // Reset the frame's draw commands and dispatch the culling shader. Records the barrier that
+  // makes the commands visible to indirect draws, unless the caller orders them itself (e.g. with
+  // a RenderGraph) and passes `drawBarrier` = false
+  void recordCull(CommandBuffer& commandBuffer, size_t frame, bool drawBarrier = true) const;
+
+  // Draw whatever survived culling, with a single indirect call
+  void recordDraw(CommandBuffer& commandBuffer, size_t frame) const;
+
+ private:
+  struct FrameResources {
+    const InstanceBuffer<InstanceData>* instances;
+    std::unique_ptr<MappedBuffer<CullParams>> params;
+    std::unique_ptr<MappedBuffer<uint32_t>> objectMeshes;
+    std::unique_ptr<OnDeviceBuffer<VkDrawIndexedIndirectCommand>> commands;
+    std::unique_ptr<Buffer<uint32_t>> drawCount;
+    VkDescriptorSet descriptorSet;
+  };
+
+  const LogicalDevice& device_;
+  const MeshPool& meshPool_;
+  const DepthPyramid& depthPyramid_;
+  size_t maxObjects_;
+  bool compact_;
+
+  std::unique_ptr<MappedBuffer<CullMeshInfo>> meshInfo_;
+  std::vector<FrameResources> frames_;
+
+  VkDescriptorSetLayout descriptorSetLayout_;
+  DescriptorAllocator descriptors_;
+  std::unique_ptr<ComputePipeline> pipeline_;
+
+  // What the depth pyramid read by the next frame is drawn with; unset until the first update()
+  std::optional<glm::mat4> previousViewProjection_;
+
+  // Reused by update() to avoid reallocating every frame
+  std::vector<uint32_t> objectMeshScratch_;
+};
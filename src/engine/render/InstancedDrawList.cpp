@@ -0,0 +1,235 @@
+#include "InstancedDrawList.hpp"
+
+#include <algorithm>
+#include <fmtlog/Log.hpp>
+
+void InstancedDrawList::clear() {
+  pendingMeshes_.clear();
+  pendingInstances_.clear();
+  instances_.clear();
+  batches_.clear();
+}
+
+void InstancedDrawList::add(uint32_t meshIndex, const InstanceData& instance) {
+  pendingMeshes_.push_back(meshIndex);
+  pendingInstances_.push_back(instance);
+}
+
+void InstancedDrawList::build() {
+  batches_.clear();
+  instances_.resize(pendingInstances_.size());
+
+  if (pendingInstances_.empty()) {
+    return;
+  }
+
+  // Counting sort on the mesh index: stable, and a single pass over the instances
+  uint32_t meshCount = *std::max_element(pendingMeshes_.begin(), pendingMeshes_.end()) + 1;
+  std::vector<uint32_t> firstInstance(meshCount + 1, 0);
+
+  for (uint32_t mesh : pendingMeshes_) {
+    firstInstance[mesh + 1]++;
+  }
+
+  for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+    uint32_t count = firstInstance[mesh + 1];
+    firstInstance[mesh + 1] += firstInstance[mesh];
+
+    if (count > 0) {
+      batches_.push_back({mesh, firstInstance[mesh], count});
+    }
+  }
+
+  // firstInstance[mesh] becomes the next free slot of each batch
+  for (size_t i = 0; i < pendingInstances_.size(); i++) {
+    instances_[firstInstance[pendingMeshes_[i]]++] = pendingInstances_[i];
+  }
+}
+
+void InstancedDrawList::record(CommandBuffer& commandBuffer,
+                               const std::vector<GpuMesh>& meshes,
+                               const InstanceBuffer<InstanceData>& instanceBuffer) const {
+  if (instanceBuffer.getCapacity() < instances_.size()) {
+    LOG_F("Instance buffer holds {} instances, the draw list has {}",
+          instanceBuffer.getCapacity(),
+          instances_.size());
+  }
+
+  // Instance data stays bound for the whole list, only the mesh changes between batches
+  commandBuffer.bindVertexBuffer(InstanceData::Binding::binding, instanceBuffer);
+
+  for (const auto& batch : batches_) {
+    if (batch.meshIndex >= meshes.size()) {
+      LOG_F("Draw list references mesh {}, only {} meshes were given",
+            batch.meshIndex,
+            meshes.size());
+    }
+
+    const GpuMesh& mesh = meshes[batch.meshIndex];
+
+    // Meshes that failed to upload have no buffers
+    if (!mesh.vertexBuffer || !mesh.indexBuffer) {
+      continue;
+    }
+
+    commandBuffer.bindVertexBuffer(Vertex::Binding::binding, *mesh.vertexBuffer);
+    commandBuffer.bindIndexBuffer(*mesh.indexBuffer);
+    commandBuffer.drawIndexed(static_cast<uint32_t>(mesh.indexBuffer->getIndexCount()),
+                              batch.instanceCount,
+                              0,  // firstIndexOffset
+                              0,  // indexValueOffset
+                              batch.firstInstance);
+  }
+}
+
+std::vector<VkDrawIndexedIndirectCommand> InstancedDrawList::getIndirectCommands(
+    const MeshPool& meshPool) const {
+  std::vector<VkDrawIndexedIndirectCommand> commands;
+  commands.reserve(batches_.size());
+
+  for (const auto& batch : batches_) {
+    if (batch.meshIndex >= meshPool.getMeshCount()) {
+      LOG_F("Draw list references mesh {}, the mesh pool holds {}",
+            batch.meshIndex,
+            meshPool.getMeshCount());
+    }
+
+    commands.push_back(
+        meshPool.getDrawCommand(batch.meshIndex, batch.instanceCount, batch.firstInstance));
+  }
+
+  return commands;
+}
+
+void InstancedDrawList::getBoundingSpheres(const MeshPool& meshPool, SphereBounds& bounds) const {
+  bounds.resize(instances_.size());
+
+  for (const auto& batch : batches_) {
+    if (batch.meshIndex >= meshPool.getMeshCount()) {
+      LOG_F("Draw list references mesh {}, the mesh pool holds {}",
+            batch.meshIndex,
+            meshPool.getMeshCount());
+    }
+
+    const glm::vec4& sphere = meshPool.getRange(batch.meshIndex).boundingSphere;
+
+    for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; i++) {
+      const glm::mat4& transform = instances_[i].transform;
+
+      glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+      float scale = std::max(glm::length(glm::vec3(transform[0])),
+                             std::max(glm::length(glm::vec3(transform[1])),
+                                      glm::length(glm::vec3(transform[2]))));
+
+      bounds.set(i, glm::vec4(center, sphere.w * scale));
+    }
+  }
+}
+
+std::vector<VkDrawIndexedIndirectCommand> InstancedDrawList::getVisibleIndirectCommands(
+    const MeshPool& meshPool,
+    const std::vector<uint32_t>& visible,
+    std::vector<InstanceData>& visibleInstances) const {
+  std::vector<VkDrawIndexedIndirectCommand> commands;
+  commands.reserve(batches_.size());
+  visibleInstances.clear();
+  visibleInstances.reserve(visible.size());
+
+  // Both lists are in instance order, so a single pass over `visible` splits it into batches
+  size_t next = 0;
+  for (const auto& batch : batches_) {
+    if (batch.meshIndex >= meshPool.getMeshCount()) {
+      LOG_F("Draw list references mesh {}, the mesh pool holds {}",
+            batch.meshIndex,
+            meshPool.getMeshCount());
+    }
+
+    uint32_t firstInstance = static_cast<uint32_t>(visibleInstances.size());
+    uint32_t batchEnd = batch.firstInstance + batch.instanceCount;
+
+    for (; next < visible.size() && visible[next] < batchEnd; next++) {
+      visibleInstances.push_back(instances_[visible[next]]);
+    }
+
+    uint32_t instanceCount = static_cast<uint32_t>(visibleInstances.size()) - firstInstance;
+    commands.push_back(meshPool.getDrawCommand(batch.meshIndex, instanceCount, firstInstance));
+  }
+
+  if (next != visible.size()) {
+    LOG_F("Visible index {} is past the {} instances of the draw list",
+          visible[next],
+          instances_.size());
+  }
+
+  return commands;
+}
+
+void InstancedDrawList::recordIndirect(CommandBuffer& commandBuffer,
+                                       const MeshPool& meshPool,
+                                       const InstanceBuffer<InstanceData>& instanceBuffer,
+                                       const Buffer<VkDrawIndexedIndirectCommand>& commands) const {
+  bindBuffers(commandBuffer, meshPool, instanceBuffer);
+  commandBuffer.drawIndexedIndirect(commands, static_cast<uint32_t>(batches_.size()));
+}
+
+void InstancedDrawList::createIndirectBuffers(const LogicalDevice& device,
+                                              size_t frameCount,
+                                              size_t maxDraws) {
+  indirectBuffers_.clear();
+  countBuffers_.clear();
+
+  // Vulkan doesn't allow empty buffers
+  for (size_t i = 0; i < frameCount; i++) {
+    indirectBuffers_.push_back(
+        std::make_unique<IndirectCommandBuffer>(device, std::max<size_t>(maxDraws, 1)));
+    countBuffers_.push_back(std::make_unique<IndirectCountBuffer>(device));
+  }
+}
+
+void InstancedDrawList::writeIndirect(size_t frame,
+                                      const std::vector<VkDrawIndexedIndirectCommand>& commands) {
+  checkFrame(frame);
+  indirectBuffers_[frame]->write(commands);
+  countBuffers_[frame]->write(static_cast<uint32_t>(commands.size()));
+}
+
+void InstancedDrawList::destroyIndirectBuffers() {
+  indirectBuffers_.clear();
+  countBuffers_.clear();
+}
+
+const IndirectCommandBuffer& InstancedDrawList::getIndirectBuffer(size_t frame) const {
+  checkFrame(frame);
+  return *indirectBuffers_[frame];
+}
+
+void InstancedDrawList::recordIndirectCount(CommandBuffer& commandBuffer,
+                                            const MeshPool& meshPool,
+                                            const InstanceBuffer<InstanceData>& instanceBuffer,
+                                            size_t frame) const {
+  checkFrame(frame);
+  bindBuffers(commandBuffer, meshPool, instanceBuffer);
+  commandBuffer.drawIndexedIndirectCount(
+      *indirectBuffers_[frame],
+      *countBuffers_[frame],
+      static_cast<uint32_t>(indirectBuffers_[frame]->getCapacity()));
+}
+
+void InstancedDrawList::bindBuffers(CommandBuffer& commandBuffer,
+                                    const MeshPool& meshPool,
+                                    const InstanceBuffer<InstanceData>& instanceBuffer) const {
+  if (instanceBuffer.getCapacity() < instances_.size()) {
+    LOG_F("Instance buffer holds {} instances, the draw list has {}",
+          instanceBuffer.getCapacity(),
+          instances_.size());
+  }
+
+  commandBuffer.bindVertexBuffer(InstanceData::Binding::binding, instanceBuffer);
+  meshPool.bind(commandBuffer);
+}
+
+void InstancedDrawList::checkFrame(size_t frame) const {
+  if (frame >= indirectBuffers_.size()) {
+    LOG_F("Frame {} has no indirect buffers: {} were created", frame, indirectBuffers_.size());
+  }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <engine/assets/MeshData.hpp>
+#include <engine/core/Buffer.hpp>
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/InstanceData.hpp>
+#include <engine/render/FrustumCuller.hpp>
+#include <engine/render/MeshPool.hpp>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief A run of instances of the same mesh, drawn with a single vkCmdDrawIndexed.
+ */
+struct InstancedDrawBatch {
+  uint32_t meshIndex;
+  uint32_t firstInstance;  // Into the instance buffer
+  uint32_t instanceCount;
+};
+
+/**
+ * @brief Collects instances of meshes and collapses every instance of the same mesh into one
+ * instanced draw.
+ *
+ *   drawList.add(treeMesh, {treeTransform, treeColor});    // x 10000
+ *   drawList.build();
+ *   instanceBuffers[frame]->write(drawList.getInstances());
+ *   drawList.record(commandBuffer, meshes, *instanceBuffers[frame]);
+ *
+ * build() groups the instances by mesh, so getInstances() is laid out batch after batch and can be
+ * written to an InstanceBuffer as-is. Pipelines drawing the list use InstancedVertexLayout.
+ *
+ * With the meshes in a MeshPool, the whole list can instead be drawn with a single indirect call:
+ * write getIndirectCommands() to an indirect buffer and use recordIndirect(). Culled on the CPU,
+ * the list is drawn the same way from getVisibleIndirectCommands(), here into the list's own
+ * per-frame indirect buffers:
+ *
+ *   drawList.createIndirectBuffers(device, frameCount, drawList.getBatches().size());
+ *   drawList.getBoundingSpheres(meshPool, bounds);
+ *   auto commands = drawList.getVisibleIndirectCommands(meshPool, culler.cull(frustum, bounds),
+ *                                                       visibleInstances);
+ *   drawList.writeIndirect(frame, commands);
+ *   drawList.recordIndirectCount(commandBuffer, meshPool, *instanceBuffers[frame], frame);
+ */
+class InstancedDrawList {
+ public:
+  InstancedDrawList() = default;
+  InstancedDrawList(InstancedDrawList& other) = delete;
+
+  void clear();
+
+  void add(uint32_t meshIndex, const InstanceData& instance);
+
+  /**
+   * @brief Group the instances added so far by mesh, keeping the order they were added in within
+   * each mesh, and rebuild the batch list. Linear in the number of instances.
+   */
+  void build();
+
+  // Instances in batch order, valid after build()
+  const std::vector<InstanceData>& getInstances() const { return instances_; }
+
+  const std::vector<InstancedDrawBatch>& getBatches() const { return batches_; }
+
+  size_t getInstanceCount() const { return instances_.size(); }
+
+  /**
+   * @brief Record one draw per batch. `instanceBuffer` must hold getInstances() (at least as of the
+   * frame the command buffer executes), and `meshes` is indexed by the batches' meshIndex. Batches
+   * of meshes without buffers are skipped.
+   */
+  void record(CommandBuffer& commandBuffer,
+              const std::vector<GpuMesh>& meshes,
+              const InstanceBuffer<InstanceData>& instanceBuffer) const;
+
+  // One indirect draw command per batch, in batch order, for meshes stored in `meshPool`
+  std::vector<VkDrawIndexedIndirectCommand> getIndirectCommands(const MeshPool& meshPool) const;
+
+  /**
+   * @brief World-space bounding sphere of every instance, in getInstances() order: the mesh's
+   * sphere transformed by the instance, scaled by its largest axis scale. Same as GpuCuller.
+   */
+  void getBoundingSpheres(const MeshPool& meshPool, SphereBounds& bounds) const;
+
+  /**
+   * @brief Like getIndirectCommands(), but only drawing the instances listed in `visible`
+   * (ascending indices into getInstances(), as produced by FrustumCuller). The visible instances
+   * are packed batch after batch into `visibleInstances`, which takes the place of getInstances()
+   * in the instance buffer.
+   *
+   * There is still one command per batch, so the draw count matches recordIndirect(); batches
+   * with nothing visible get an instance count of 0.
+   */
+  std::vector<VkDrawIndexedIndirectCommand> getVisibleIndirectCommands(
+      const MeshPool& meshPool,
+      const std::vector<uint32_t>& visible,
+      std::vector<InstanceData>& visibleInstances) const;
+
+  /**
+   * @brief Record the whole list as one multi-draw indirect call. `commands` must hold
+   * getIndirectCommands() when the command buffer executes.
+   */
+  void recordIndirect(CommandBuffer& commandBuffer,
+                      const MeshPool& meshPool,
+                      const InstanceBuffer<InstanceData>& instanceBuffer,
+                      const Buffer<VkDrawIndexedIndirectCommand>& commands) const;
+
+  /**
+   * @brief Create an indirect command buffer of `maxDraws` commands and a draw count buffer for
+   * each of `frameCount` frames, replacing any created before. Only once no frame in flight uses
+   * the old ones.
+   */
+  void createIndirectBuffers(const LogicalDevice& device, size_t frameCount, size_t maxDraws);
+
+  // Write `commands` and their count into `frame`'s indirect buffers. Calls LOG_F if they don't fit
+  void writeIndirect(size_t frame, const std::vector<VkDrawIndexedIndirectCommand>& commands);
+
+  // Only once no frame in flight uses them
+  void destroyIndirectBuffers();
+
+  // Commands of `frame`, e.g. for recordIndirect()
+  const IndirectCommandBuffer& getIndirectBuffer(size_t frame) const;
+
+  /**
+   * @brief Like recordIndirect() with getIndirectBuffer(frame), but the number of draws is read
+   * on the GPU from what writeIndirect() last wrote for `frame`, so the list can grow (up to the
+   * buffers' maxDraws) or shrink without re-recording. Needs drawIndirectCount.
+   */
+  void recordIndirectCount(CommandBuffer& commandBuffer,
+                           const MeshPool& meshPool,
+                           const InstanceBuffer<InstanceData>& instanceBuffer,
+                           size_t frame) const;
+
+ private:
+  // Bind the instances and the pool's meshes, checking the instances fit
+  void bindBuffers(CommandBuffer& commandBuffer,
+                   const MeshPool& meshPool,
+                   const InstanceBuffer<InstanceData>& instanceBuffer) const;
+
+  void checkFrame(size_t frame) const;
+
+  // As added, before build()
+  std::vector<uint32_t> pendingMeshes_;
+  std::vector<InstanceData> pendingInstances_;
+
+  std::vector<InstanceData> instances_;
+  std::vector<InstancedDrawBatch> batches_;
+
+  // Per frame in flight, once createIndirectBuffers() was called
+  std::vector<std::unique_ptr<IndirectCommandBuffer>> indirectBuffers_;
+  std::vector<std::unique_ptr<IndirectCountBuffer>> countBuffers_;
+};
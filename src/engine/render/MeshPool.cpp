@@ -0,0 +1,135 @@
+#include "MeshPool.hpp"
+
+#include <algorithm>
+#include <fmtlog/Log.hpp>
+#include <limits>
+
+MeshPool::MeshPool(const LogicalDevice& device) : device_(device) {}
+
+uint32_t MeshPool::addMesh(const Vertex* vertices,
+                           size_t vertexCount,
+                           const uint32_t* indices,
+                           size_t indexCount) {
+  if (vertexBuffer_) {
+    LOG_F("Meshes can't be added to a MeshPool after upload()");
+  }
+
+  // Draw commands address the pool with 32-bit index ranges and a signed vertex offset
+  if (indexCount > std::numeric_limits<uint32_t>::max() - indices_.size()) {
+    LOG_F("Adding {} indices to a MeshPool of {} overflows 32-bit index offsets",
+          indexCount,
+          indices_.size());
+  }
+  if (vertexCount > std::numeric_limits<uint32_t>::max() ||
+      vertices_.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+    LOG_F("Adding {} vertices to a MeshPool of {} overflows its vertex offsets",
+          vertexCount,
+          vertices_.size());
+  }
+
+  MeshRange range{};
+  range.firstIndex = static_cast<uint32_t>(indices_.size());
+  range.indexCount = static_cast<uint32_t>(indexCount);
+  range.vertexOffset = static_cast<int32_t>(vertices_.size());
+  range.vertexCount = static_cast<uint32_t>(vertexCount);
+  range.boundingSphere = glm::vec4(0.0f);
+
+  if (vertexCount > 0) {
+    // Centered on the bounding box, which is close enough to the optimal sphere for culling.
+    // Vertex positions are 2D, on the z = 0 plane
+    glm::vec2 boundsMin = vertices[0].pos;
+    glm::vec2 boundsMax = vertices[0].pos;
+    for (size_t i = 1; i < vertexCount; i++) {
+      boundsMin = glm::min(boundsMin, vertices[i].pos);
+      boundsMax = glm::max(boundsMax, vertices[i].pos);
+    }
+
+    glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++) {
+      radius = std::max(radius, glm::length(vertices[i].pos - center));
+    }
+
+    range.boundingSphere = glm::vec4(center, 0.0f, radius);
+  }
+
+  vertices_.insert(vertices_.end(), vertices, vertices + vertexCount);
+  indices_.insert(indices_.end(), indices, indices + indexCount);
+  maxMeshVertices_ = std::max(maxMeshVertices_, vertexCount);
+
+  ranges_.push_back(range);
+
+  return static_cast<uint32_t>(ranges_.size() - 1);
+}
+
+uint32_t MeshPool::addMesh(const MeshData& mesh) {
+  std::vector<Vertex> vertices = mesh.toVertices();
+  return addMesh(vertices.data(), vertices.size(), mesh.indices.data(), mesh.indices.size());
+}
+
+void MeshPool::upload(const CommandPool& transferPool) {
+  if (vertexBuffer_) {
+    LOG_F("MeshPool was already uploaded");
+  }
+
+  if (vertices_.empty() || indices_.empty()) {
+    LOG_F("MeshPool is empty, nothing to upload");
+  }
+
+  // vertexOffset is signed, and the rebased indices must stay within what the device can fetch
+  size_t maxIndexValue =
+      device_.getPhysicalDevice().getProperties().limits.maxDrawIndexedIndexValue;
+  if (vertices_.size() - 1 > std::min<size_t>(maxIndexValue, std::numeric_limits<int32_t>::max())) {
+    LOG_F("MeshPool holds {} vertices, more than the device can address", vertices_.size());
+  }
+
+  bool allowUint8 = device_.getEnabledFeatures().indexTypeUint8.indexTypeUint8;
+  VkIndexType indexType = selectIndexType(maxMeshVertices_, allowUint8);
+  std::vector<uint8_t> indexBytes = encodeIndices(indices_, indexType);
+
+  TransferBuffer<Vertex> vertexStaging(device_, vertices_);
+  TransferBuffer<uint8_t> indexStaging(device_, indexBytes);
+
+  vertexBuffer_ = std::make_unique<OnDeviceBuffer<Vertex>>(device_, vertices_.size());
+  indexBuffer_ = std::make_unique<IndexBuffer>(device_, indexType, indices_.size());
+
+  CommandBuffer commandBuffer = transferPool.allocateCommandBuffer();
+  commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  commandBuffer.copyBuffer(vertexStaging, *vertexBuffer_);
+  commandBuffer.copyBuffer(indexStaging, *indexBuffer_);
+  commandBuffer.end();
+  commandBuffer.submitAndWait();
+
+  LOG_I("Uploaded {} meshes into a MeshPool: {} vertices, {} indices of {} bytes",
+        ranges_.size(),
+        vertices_.size(),
+        indices_.size(),
+        getIndexTypeSize(indexType));
+
+  vertices_ = {};
+  indices_ = {};
+}
+
+VkDrawIndexedIndirectCommand MeshPool::getDrawCommand(uint32_t mesh,
+                                                      uint32_t instanceCount,
+                                                      uint32_t firstInstance) const {
+  const MeshRange& range = ranges_[mesh];
+
+  VkDrawIndexedIndirectCommand command{};
+  command.indexCount = range.indexCount;
+  command.instanceCount = instanceCount;
+  command.firstIndex = range.firstIndex;
+  command.vertexOffset = range.vertexOffset;
+  command.firstInstance = firstInstance;
+
+  return command;
+}
+
+void MeshPool::bind(CommandBuffer& commandBuffer) const {
+  if (!vertexBuffer_) {
+    LOG_F("MeshPool must be uploaded before it is bound");
+  }
+
+  commandBuffer.bindVertexBuffer(Vertex::Binding::binding, *vertexBuffer_);
+  commandBuffer.bindIndexBuffer(*indexBuffer_);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <engine/assets/MeshData.hpp>
+#include <engine/core/Buffer.hpp>
+#include <engine/core/CommandPool.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Where a mesh lives inside a MeshPool, in the terms of VkDrawIndexedIndirectCommand.
+ */
+struct MeshRange {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  int32_t vertexOffset;
+  uint32_t vertexCount;
+
+  // Object-space bounding sphere: center in xyz, radius in w
+  glm::vec4 boundingSphere;
+};
+
+/**
+ * @brief Every mesh of a scene packed into one vertex buffer and one index buffer, so they can all
+ * be drawn from a single indirect buffer without rebinding anything between draws.
+ *
+ * Indices stay local to their mesh and are rebased with vertexOffset at draw time, so the pool's
+ * index type only has to cover its largest mesh: scenes made of meshes under 65536 vertices keep
+ * 16-bit indices however large the pool gets.
+ *
+ * Meshes are added on the CPU, then upload() creates the device-local buffers in one submission.
+ */
+class MeshPool {
+ public:
+  MeshPool() = delete;
+  MeshPool(MeshPool& other) = delete;
+
+  explicit MeshPool(const LogicalDevice& device);
+
+  /**
+   * @brief Append a mesh and return its index in the pool. Empty meshes are kept (with an empty
+   * range) so mesh indices line up with the caller's. Calls LOG_F once the pool's indices or
+   * vertices no longer fit the 32-bit offsets of draw commands.
+   */
+  uint32_t addMesh(const Vertex* vertices,
+                   size_t vertexCount,
+                   const uint32_t* indices,
+                   size_t indexCount);
+
+  uint32_t addMesh(const MeshData& mesh);
+
+  /**
+   * @brief Create the device-local buffers and copy every mesh into them, blocking until the copy
+   * has finished. The CPU-side copies are released afterwards. Calls LOG_F if the pool is empty,
+   * was already uploaded, or has more vertices than the device can address.
+   */
+  void upload(const CommandPool& transferPool);
+
+  size_t getMeshCount() const { return ranges_.size(); }
+
+  const MeshRange& getRange(uint32_t mesh) const { return ranges_[mesh]; }
+
+  // A single-draw command for `instanceCount` instances of `mesh`, starting at `firstInstance`
+  VkDrawIndexedIndirectCommand getDrawCommand(uint32_t mesh,
+                                              uint32_t instanceCount,
+                                              uint32_t firstInstance) const;
+
+  // Only valid after upload()
+  VkIndexType getIndexType() const { return indexBuffer_->getIndexType(); }
+
+  // Bind the pool's vertex buffer (binding 0) and index buffer. Only valid after upload()
+  void bind(CommandBuffer& commandBuffer) const;
+
+ private:
+  const LogicalDevice& device_;
+
+  // CPU-side, until upload()
+  std::vector<Vertex> vertices_;
+  std::vector<uint32_t> indices_;
+  size_t maxMeshVertices_ = 0;
+
+  std::vector<MeshRange> ranges_;
+
+  std::unique_ptr<OnDeviceBuffer<Vertex>> vertexBuffer_;
+  std::unique_ptr<IndexBuffer> indexBuffer_;
+};
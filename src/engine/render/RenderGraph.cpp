@@ -0,0 +1,424 @@
+#include "RenderGraph.hpp"
+
+#include <fmtlog/Log.hpp>
+
+namespace {
+
+// The stages a usage happens in, its accesses and the image layouts it needs
+struct UsageInfo {
+  VkPipelineStageFlags stages;
+  VkAccessFlags readAccess;
+  VkAccessFlags writeAccess;  // 0 for usages that can't write
+  VkImageLayout readLayout;
+  VkImageLayout writeLayout;  // Also when the pass reads the image too
+};
+
+UsageInfo getUsageInfo(ResourceUsage usage) {
+  switch (usage) {
+    case ResourceUsage::ColorAttachment:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    case ResourceUsage::DepthAttachment:
+      return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              // Depth tests read what the pass itself writes
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    case ResourceUsage::FragmentShader:
+      return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_LAYOUT_GENERAL};
+    case ResourceUsage::ComputeShader:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_LAYOUT_GENERAL};
+    case ResourceUsage::VertexInput:
+      return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+              VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+              0,
+              VK_IMAGE_LAYOUT_UNDEFINED,
+              VK_IMAGE_LAYOUT_UNDEFINED};
+    case ResourceUsage::IndirectCommand:
+      return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+              VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+              0,
+              VK_IMAGE_LAYOUT_UNDEFINED,
+              VK_IMAGE_LAYOUT_UNDEFINED};
+    case ResourceUsage::Transfer:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_READ_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+  }
+
+  LOG_F("Unknown resource usage {}", static_cast<int>(usage));
+}
+
+}  // namespace
+
+RenderGraph::Pass::Pass(RenderGraph& graph,
+                        uint32_t index,
+                        std::string name,
+                        std::function<void(CommandBuffer&)> record)
+    : graph_(graph),
+      index_(index),
+      name_(std::move(name)),
+      record_(std::move(record)) {}
+
+RenderGraph::Pass::Access& RenderGraph::Pass::getAccess(Resource resource, ResourceUsage usage) {
+  if (resource >= graph_.resources_.size()) {
+    LOG_F("Pass {} uses unknown resource {}", name_, resource);
+  }
+
+  for (Access& access : accesses_) {
+    if (access.resource == resource) {
+      if (access.usage != usage) {
+        LOG_F("Pass {} uses {} in two different ways", name_, graph_.resources_[resource].name);
+      }
+      return access;
+    }
+  }
+
+  accesses_.push_back({resource, usage});
+  return accesses_.back();
+}
+
+void RenderGraph::Pass::read(Resource resource, ResourceUsage usage) {
+  getAccess(resource, usage).reads = true;
+  graph_.invalidate();
+}
+
+void RenderGraph::Pass::write(Resource resource, ResourceUsage usage) {
+  if (getUsageInfo(usage).writeAccess == 0) {
+    LOG_F("Pass {} writes {} through a read-only usage ({})",
+          name_,
+          graph_.resources_[resource].name,
+          static_cast<int>(usage));
+  }
+
+  getAccess(resource, usage).writes = true;
+  graph_.invalidate();
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string& name,
+                                               const ResourceState& initial) {
+  resources_.push_back({name, true, initial});
+  invalidate();
+  return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string& name,
+                                                const ResourceState& initial) {
+  resources_.push_back({name, false, initial});
+  invalidate();
+  return static_cast<Resource>(resources_.size() - 1);
+}
+
+void RenderGraph::setImage(Resource resource, const Image& image) {
+  if (resource >= resources_.size() || !resources_[resource].isImage) {
+    LOG_F("Render graph resource {} is not an image", resource);
+  }
+
+  // Barriers only depend on how the image is used, so binding another one keeps them valid
+  resources_[resource].image = &image;
+}
+
+void RenderGraph::markOutput(Resource resource, const ResourceState& final) {
+  if (resource >= resources_.size()) {
+    LOG_F("Unknown render graph resource {}", resource);
+  }
+
+  resources_[resource].output = true;
+  resources_[resource].final = final;
+  invalidate();
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name,
+                                        std::function<void(CommandBuffer&)> record) {
+  passes_.push_back(std::unique_ptr<Pass>(
+      new Pass(*this, static_cast<uint32_t>(passes_.size()), name, std::move(record))));
+  invalidate();
+  return *passes_.back();
+}
+
+void RenderGraph::compile() {
+  cull();
+  computeBarriers();
+  compiled_ = true;
+
+  LOG_D("Render graph compiled: {} of {} passes, {} barriers",
+        schedule_.size(),
+        passes_.size(),
+        getBarrierCount());
+}
+
+void RenderGraph::cull() {
+  culled_.assign(passes_.size(), true);
+
+  // Walking back from the outputs: a resource is live while a pass further down reads what is
+  // in it
+  std::vector<bool> live(resources_.size());
+  for (size_t i = 0; i < resources_.size(); i++) {
+    live[i] = resources_[i].output;
+  }
+
+  for (size_t i = passes_.size(); i-- > 0;) {
+    Pass& pass = *passes_[i];
+
+    bool needed = pass.sideEffects_;
+    for (Pass::Access& access : pass.accesses_) {
+      access.contentsUsedLater = live[access.resource];
+      needed |= access.writes && access.contentsUsedLater;
+    }
+
+    if (!needed) {
+      continue;
+    }
+    culled_[i] = false;
+
+    // What the pass overwrites isn't needed from the passes before it, what it reads is
+    for (const Pass::Access& access : pass.accesses_) {
+      if (access.writes && !access.reads) {
+        live[access.resource] = false;
+      }
+    }
+    for (const Pass::Access& access : pass.accesses_) {
+      if (access.reads) {
+        live[access.resource] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::computeBarriers() {
+  std::vector<TrackedState> states(resources_.size());
+  for (size_t i = 0; i < resources_.size(); i++) {
+    const ResourceState& initial = resources_[i].initial;
+    states[i] = {initial.layout, initial.stages, initial.access, 0, 0, 0};
+  }
+
+  schedule_.clear();
+  barriers_.clear();
+  for (size_t i = 0; i < passes_.size(); i++) {
+    if (culled_[i]) {
+      continue;
+    }
+
+    Barrier barrier;
+    for (const Pass::Access& access : passes_[i]->accesses_) {
+      addAccess(barrier, states[access.resource], access);
+    }
+
+    schedule_.push_back(passes_[i].get());
+    barriers_.push_back(std::move(barrier));
+  }
+
+  // Hand the outputs over to whatever uses them after the graph
+  finalBarrier_ = {};
+  for (size_t i = 0; i < resources_.size(); i++) {
+    const ResourceInfo& resource = resources_[i];
+    const TrackedState& state = states[i];
+    if (!resource.output) {
+      continue;
+    }
+
+    const ResourceState& final = resource.final;
+    if (resource.isImage && final.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+        final.layout != state.layout) {
+      finalBarrier_.images.push_back({static_cast<Resource>(i),
+                                      state.layout,
+                                      final.layout,
+                                      state.writeAccess,
+                                      final.access});
+      finalBarrier_.srcStages |= state.writeStages | state.readStages;
+      finalBarrier_.dstStages |= final.stages;
+    } else if (state.writeAccess != 0 && final.stages != 0) {
+      finalBarrier_.srcStages |= state.writeStages;
+      finalBarrier_.srcAccess |= state.writeAccess;
+      finalBarrier_.dstStages |= final.stages;
+      finalBarrier_.dstAccess |= final.access;
+    }
+  }
+}
+
+void RenderGraph::addAccess(Barrier& barrier, TrackedState& state, const Pass::Access& access) {
+  UsageInfo info = getUsageInfo(access.usage);
+  VkAccessFlags accessMask =
+      (access.reads ? info.readAccess : 0) | (access.writes ? info.writeAccess : 0);
+  VkImageLayout layout = access.writes ? info.writeLayout : info.readLayout;
+
+  if (resources_[access.resource].isImage && layout != state.layout) {
+    // A transition waits for every use before it, and is visible to the pass once done. Images
+    // written without being read don't need their previous contents
+    bool discard = access.writes && !access.reads;
+    barrier.images.push_back({access.resource,
+                              discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+                              layout,
+                              state.writeAccess,
+                              accessMask});
+    barrier.srcStages |= state.writeStages | state.readStages;
+    barrier.dstStages |= info.stages;
+
+    // The transition is the write the following uses are ordered after
+    state.layout = layout;
+    state.writeStages = info.stages;
+    state.writeAccess = 0;
+    state.readStages = 0;
+    state.visibleStages = info.stages;
+    state.visibleAccess = accessMask;
+  } else if (access.writes) {
+    // Write after write, and write after read. Reads only need to be done: nothing to make
+    // visible
+    if ((state.writeStages | state.readStages) != 0) {
+      barrier.srcStages |= state.writeStages | state.readStages;
+      barrier.srcAccess |= state.writeAccess;
+      barrier.dstStages |= info.stages;
+      barrier.dstAccess |= accessMask;
+    }
+  } else if (state.writeStages != 0 && ((info.stages & ~state.visibleStages) != 0 ||
+                                        (accessMask & ~state.visibleAccess) != 0)) {
+    // Read after write, unless an earlier barrier already made the write visible to this read
+    barrier.srcStages |= state.writeStages;
+    barrier.srcAccess |= state.writeAccess;
+    barrier.dstStages |= info.stages;
+    barrier.dstAccess |= accessMask;
+    state.visibleStages |= info.stages;
+    state.visibleAccess |= accessMask;
+  }
+
+  if (access.writes) {
+    state.writeStages = info.stages;
+    state.writeAccess = info.writeAccess;
+    state.readStages = 0;
+    state.visibleStages = 0;
+    state.visibleAccess = 0;
+  } else {
+    state.readStages |= info.stages;
+  }
+}
+
+void RenderGraph::record(CommandBuffer& commandBuffer) {
+  if (!compiled_) {
+    compile();
+  }
+
+  for (size_t i = 0; i < schedule_.size(); i++) {
+    recordBarrier(commandBuffer, barriers_[i]);
+    schedule_[i]->record_(commandBuffer);
+  }
+
+  recordBarrier(commandBuffer, finalBarrier_);
+}
+
+void RenderGraph::recordBarrier(CommandBuffer& commandBuffer, const Barrier& barrier) {
+  if (barrier.isEmpty()) {
+    return;
+  }
+
+  imageBarrierScratch_.clear();
+  for (const ImageTransition& transition : barrier.images) {
+    const ResourceInfo& resource = resources_[transition.resource];
+    if (!resource.image) {
+      LOG_F("No image bound to render graph resource {}", resource.name);
+    }
+
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = transition.srcAccess;
+    imageBarrier.dstAccessMask = transition.dstAccess;
+    imageBarrier.oldLayout = transition.oldLayout;
+    imageBarrier.newLayout = transition.newLayout;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = *resource.image;
+    imageBarrier.subresourceRange.aspectMask = resource.image->getAspect();
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    imageBarrierScratch_.push_back(imageBarrier);
+  }
+
+  // Nothing before the graph (or after it) still leaves a valid stage to wait on (or block)
+  VkPipelineStageFlags srcStages =
+      barrier.srcStages != 0 ? barrier.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  VkPipelineStageFlags dstStages =
+      barrier.dstStages != 0 ? barrier.dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+  commandBuffer.pipelineBarrier(
+      srcStages, dstStages, barrier.srcAccess, barrier.dstAccess, imageBarrierScratch_);
+}
+
+bool RenderGraph::isCulled(const Pass& pass) {
+  if (&pass.graph_ != this) {
+    LOG_F("Pass {} is not from this render graph", pass.name_);
+  }
+
+  if (!compiled_) {
+    compile();
+  }
+
+  return culled_[pass.index_];
+}
+
+AttachmentOps RenderGraph::getAttachmentOps(const Pass& pass, Resource resource) {
+  if (&pass.graph_ != this) {
+    LOG_F("Pass {} is not from this render graph", pass.name_);
+  }
+
+  if (!compiled_) {
+    compile();
+  }
+
+  for (const Pass::Access& access : pass.accesses_) {
+    if (access.resource != resource) {
+      continue;
+    }
+
+    if (access.usage != ResourceUsage::ColorAttachment &&
+        access.usage != ResourceUsage::DepthAttachment) {
+      LOG_F("Pass {} doesn't use {} as an attachment", pass.name_, resources_[resource].name);
+    }
+
+    UsageInfo info = getUsageInfo(access.usage);
+    VkImageLayout layout = access.writes ? info.writeLayout : info.readLayout;
+
+    AttachmentOps ops;
+    ops.loadOp = access.reads ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    ops.storeOp =
+        access.contentsUsedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    ops.stencilLoadOp = ops.loadOp;
+    ops.stencilStoreOp = ops.storeOp;
+    ops.initialLayout = layout;
+    ops.finalLayout = layout;
+    return ops;
+  }
+
+  LOG_F("Pass {} doesn't use {}", pass.name_, resources_[resource].name);
+}
+
+size_t RenderGraph::getBarrierCount() {
+  if (!compiled_) {
+    compile();
+  }
+
+  size_t count = finalBarrier_.isEmpty() ? 0 : 1;
+  for (const Barrier& barrier : barriers_) {
+    if (!barrier.isEmpty()) {
+      count++;
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/Image.hpp>
+#include <engine/core/RenderPass.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a render graph pass uses a resource for. Each usage implies the pipeline stages and
+// accesses it happens in, and for images the layout it needs
+enum class ResourceUsage {
+  ColorAttachment,
+  DepthAttachment,  // DEPTH_STENCIL_READ_ONLY_OPTIMAL when only read
+  FragmentShader,   // Sampled when read, storage image (GENERAL) when written
+  ComputeShader,    // Sampled when read, storage image (GENERAL) when written
+  VertexInput,      // Vertex and index buffers
+  IndirectCommand,  // Indirect draw and dispatch parameters
+  Transfer,         // Copy source when read, destination when written
+};
+
+// The state a resource is in before a render graph runs, or must be left in after it: the stages
+// and accesses that use it outside of the graph, and the layout of an image
+struct ResourceState {
+  VkPipelineStageFlags stages = 0;
+  VkAccessFlags access = 0;
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  // A swapchain image just acquired, with the acquire semaphore waited on in `stages`
+  static ResourceState acquired(
+      VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) {
+    return {stages, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+  }
+
+  // A swapchain image about to be presented
+  static ResourceState present() {
+    return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+  }
+};
+
+/**
+ * @brief The passes of a frame, described by the resources they read and write, from which the
+ * graph works out the synchronization between them.
+ *
+ * Passes run in the order they were added; each read sees the last write added before it. When
+ * compiled, the graph:
+ * - culls the passes whose writes nobody reads: only passes leading to an output (see
+ *   markOutput()) or with side effects run
+ * - finds the barriers each pass needs, and records them as one vkCmdPipelineBarrier before it:
+ *   a memory barrier for every resource staying in its layout, and an image barrier for each
+ *   layout transition. Passes that only read what earlier barriers already made visible get none
+ * - transitions images written without being read from VK_IMAGE_LAYOUT_UNDEFINED, discarding
+ *   their previous contents, and leaves the outputs in their final state once the last pass ran
+ *
+ * Compiling happens on the first record() after the graph changed; recording it again, even
+ * with other images bound to its resources (setImage()), only replays the compiled barriers.
+ *
+ *   RenderGraph graph;
+ *   auto color = graph.importImage("swapchain", ResourceState::acquired());
+ *   auto commands = graph.importBuffer("draw commands");
+ *   graph.markOutput(color, ResourceState::present());
+ *
+ *   RenderGraph::Pass& cull = graph.addPass("cull", [&](CommandBuffer& cb) { ... });
+ *   cull.write(commands, ResourceUsage::ComputeShader);
+ *
+ *   RenderGraph::Pass& scene = graph.addPass("scene", [&](CommandBuffer& cb) { ... });
+ *   scene.read(commands, ResourceUsage::IndirectCommand);
+ *   scene.write(color, ResourceUsage::ColorAttachment);
+ *
+ *   graph.setImage(color, swapchainImage);
+ *   graph.record(commandBuffer);
+ *
+ * The graph owns the layouts of the images it transitions: RenderPasses drawing into them take
+ * their attachments' ops from getAttachmentOps(), so they neither transition them again nor
+ * store what nobody reads. Images are synchronized as a whole, every mip level and layer.
+ */
+class RenderGraph {
+ public:
+  using Resource = uint32_t;
+
+  class Pass {
+    friend class RenderGraph;
+
+   public:
+    Pass() = delete;
+    Pass(Pass& other) = delete;
+
+    // Use `resource` without changing it. Contents written by earlier passes are made visible
+    void read(Resource resource, ResourceUsage usage);
+
+    // Change `resource`. Unless the pass reads it too, its previous contents are discarded
+    void write(Resource resource, ResourceUsage usage);
+
+    // Run the pass even if nothing it writes is read, e.g. when it writes host visible memory
+    void setSideEffects() { sideEffects_ = true; }
+
+    const std::string& getName() const { return name_; }
+
+    uint32_t getIndex() const { return index_; }
+
+   private:
+    Pass(RenderGraph& graph,
+         uint32_t index,
+         std::string name,
+         std::function<void(CommandBuffer&)> record);
+
+    struct Access {
+      Resource resource;
+      ResourceUsage usage;
+      bool reads = false;
+      bool writes = false;
+      bool contentsUsedLater = false;  // Set by compile(): a later pass or the output reads them
+    };
+
+    Access& getAccess(Resource resource, ResourceUsage usage);
+
+    RenderGraph& graph_;
+    uint32_t index_;
+    std::string name_;
+    std::function<void(CommandBuffer&)> record_;
+    std::vector<Access> accesses_;
+    bool sideEffects_ = false;
+  };
+
+  RenderGraph() = default;
+  RenderGraph(RenderGraph& other) = delete;
+
+  /**
+   * @brief Add an image the graph uses, in `initial` state when the graph starts. Bind the actual
+   * image with setImage() before recording.
+   */
+  Resource importImage(const std::string& name, const ResourceState& initial = {});
+
+  // Add a buffer the graph uses. Buffers are synchronized with memory barriers, so they need no
+  // binding
+  Resource importBuffer(const std::string& name, const ResourceState& initial = {});
+
+  // Bind `image` to `resource`, e.g. the swapchain image of the command buffer being recorded
+  void setImage(Resource resource, const Image& image);
+
+  /**
+   * @brief Keep what the passes write into `resource`, left in `final` state once the graph ran:
+   * the passes writing it are never culled.
+   */
+  void markOutput(Resource resource, const ResourceState& final = {});
+
+  // Passes run in the order they are added, by calling `record` with the command buffer
+  Pass& addPass(const std::string& name, std::function<void(CommandBuffer&)> record);
+
+  // Cull passes and compute barriers. Done by record() when the graph changed
+  void compile();
+
+  // Record the passes that weren't culled, each preceded by its barriers
+  void record(CommandBuffer& commandBuffer);
+
+  bool isCulled(const Pass& pass);
+
+  /**
+   * @brief Ops for the Attachment of a RenderPass that `pass` draws `resource` into: the image is
+   * already in its attachment layout when the pass begins, and stays in it. It is cleared unless
+   * the pass reads it, and stored only if something after the pass reads it.
+   */
+  AttachmentOps getAttachmentOps(const Pass& pass, Resource resource);
+
+  // vkCmdPipelineBarrier calls per record(), for profiling
+  size_t getBarrierCount();
+
+ private:
+  // An image barrier of a Barrier, resolved to the bound image when recording
+  struct ImageTransition {
+    Resource resource;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+  };
+
+  // Everything recorded in one vkCmdPipelineBarrier
+  struct Barrier {
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkAccessFlags srcAccess = 0;  // Of the memory barrier
+    VkAccessFlags dstAccess = 0;
+    std::vector<ImageTransition> images;
+
+    bool isEmpty() const { return srcStages == 0 && dstStages == 0 && images.empty(); }
+  };
+
+  struct ResourceInfo {
+    std::string name;
+    bool isImage;
+    ResourceState initial;
+    bool output = false;
+    ResourceState final;
+    const Image* image = nullptr;
+  };
+
+  // Where the compiled passes have left a resource
+  struct TrackedState {
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages;    // Of the last write, which later uses wait for
+    VkAccessFlags writeAccess;           // Of the last write, to make available
+    VkPipelineStageFlags readStages;     // Reading since the last write
+    VkPipelineStageFlags visibleStages;  // Stages and accesses the last write is visible to
+    VkAccessFlags visibleAccess;
+  };
+
+  void cull();
+  void computeBarriers();
+
+  // Add the synchronization `access` needs against `state` to `barrier`, and update `state`
+  void addAccess(Barrier& barrier, TrackedState& state, const Pass::Access& access);
+
+  void recordBarrier(CommandBuffer& commandBuffer, const Barrier& barrier);
+
+  void invalidate() { compiled_ = false; }
+
+  std::vector<ResourceInfo> resources_;
+  std::vector<std::unique_ptr<Pass>> passes_;
+
+  bool compiled_ = false;
+  std::vector<bool> culled_;       // By pass index
+  std::vector<Pass*> schedule_;    // The passes that run, in order
+  std::vector<Barrier> barriers_;  // Before each scheduled pass
+  Barrier finalBarrier_;           // After the last one
+
+  std::vector<VkImageMemoryBarrier> imageBarrierScratch_;  // Reused by every record()
+};
@@ -0,0 +1,413 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fmtlog/Log.hpp>
+
+TextureStreamer::TextureStreamer(const LogicalDevice& device,
+                                 const QueueFamilyRequest& transferQueue,
+                                 ThreadPool& threadPool,
+                                 BindlessDescriptors& bindless,
+                                 VkDeviceSize budget,
+                                 size_t frameCount,
+                                 const QueueFamilyRequests sharingQueues,
+                                 uint32_t tailSize,
+                                 uint32_t maxUploads)
+    : device_(device),
+      transferQueue_(transferQueue),
+      threadPool_(threadPool),
+      bindless_(bindless),
+      budget_(budget),
+      frameCount_(frameCount),
+      sharingQueues_(sharingQueues),
+      tailSize_(tailSize),
+      maxUploads_(maxUploads),
+      commandPool_(device, transferQueue) {
+  // Textures are named by a bindless texture slot, so the tables are as large as that array
+  uint32_t slots = bindless_.getCapacity(BindlessDescriptors::TexturesBinding);
+
+  for (size_t i = 0; i < frameCount_; i++) {
+    FrameTables tables;
+    tables.feedback = createTable(slots);
+    tables.slotTable = createTable(slots);
+    frames_.push_back(std::move(tables));
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  // The workers use the textures' files and images; don't let them outlive this
+  for (auto& upload : uploads_) {
+    upload->done.wait();
+  }
+
+  for (auto& [slot, texture] : textures_) {
+    bindless_.removeTexture(slot);
+    if (texture.streamed) {
+      bindless_.removeTexture(texture.streamedSlot);
+    }
+  }
+
+  for (auto& retired : retired_) {
+    bindless_.removeTexture(retired.slot);
+  }
+
+  for (auto& tables : frames_) {
+    bindless_.removeBuffer(tables.feedback.slot);
+    bindless_.removeBuffer(tables.slotTable.slot);
+  }
+}
+
+uint32_t TextureStreamer::add(std::unique_ptr<Ktx2TextureFile> file) {
+  if (file->needsMipGeneration()) {
+    LOG_F("Streamed textures need their mip levels stored in the file");
+  }
+
+  // The first level that fits in tailSize_, or the last one
+  VkExtent2D extent = file->getExtent();
+  uint32_t tailLevel = 0;
+  while (tailLevel + 1 < file->getLevelCount() &&
+         (std::max(extent.width >> tailLevel, 1u) > tailSize_ ||
+          std::max(extent.height >> tailLevel, 1u) > tailSize_)) {
+    tailLevel++;
+  }
+
+  Texture texture;
+  texture.tailLevel = tailLevel;
+  texture.residentLevel = tailLevel;
+  texture.tail = file->uploadLevels(device_, commandPool_, tailLevel, sharingQueues_, &queueMutex_);
+  texture.tailView = std::make_unique<ImageView>(*texture.tail);
+  texture.windowStart = frame_;
+  texture.file = std::move(file);
+
+  usedMemory_ += texture.tail->getMemorySize();
+
+  uint32_t slot = bindless_.addTexture(*texture.tailView);
+  textures_.emplace(slot, std::move(texture));
+
+  // No frame in flight uses the new texture, so every frame's table can point it at its tail now
+  for (auto& tables : frames_) {
+    tables.slotTable.buffer->getMapped()[slot] = slot;
+  }
+
+  return slot;
+}
+
+void TextureStreamer::remove(uint32_t texture) {
+  auto it = textures_.find(texture);
+  if (it == textures_.end()) {
+    LOG_F("Texture {} isn't streamed", texture);
+  }
+
+  // Its upload reads from the file: let it finish, then drop the image
+  for (auto upload = uploads_.begin(); upload != uploads_.end();) {
+    if ((*upload)->texture == texture) {
+      (*upload)->done.wait();
+      usedMemory_ -= (*upload)->reservedMemory;
+      upload = uploads_.erase(upload);
+    } else {
+      ++upload;
+    }
+  }
+
+  usedMemory_ -= it->second.tail->getMemorySize();
+  if (it->second.streamed) {
+    usedMemory_ -= it->second.streamed->getMemorySize();
+    bindless_.removeTexture(it->second.streamedSlot);
+  }
+
+  bindless_.removeTexture(texture);
+  textures_.erase(it);
+}
+
+void TextureStreamer::beginFrame(size_t frame) {
+  checkFrame(frame);
+  frame_++;
+
+  finishUploads();
+  freeRetiredImages();
+  readFeedback(frame);
+  scheduleUploads();
+
+  // Only this frame samples through its table, so it can follow the uploads and evictions above
+  uint32_t* slots = frames_[frame].slotTable.buffer->getMapped();
+  for (const auto& [slot, texture] : textures_) {
+    slots[slot] = getBoundSlot(slot, texture);
+  }
+}
+
+void TextureStreamer::requestLevel(uint32_t texture, uint32_t level) {
+  auto it = textures_.find(texture);
+  if (it == textures_.end()) {
+    LOG_F("Texture {} isn't streamed", texture);
+  }
+
+  // Anything coarser than the tail is always resident
+  Texture& streamed = it->second;
+  streamed.requestedLevel = std::min(streamed.requestedLevel, std::min(level, streamed.tailLevel));
+}
+
+uint32_t TextureStreamer::getLevelForScreenSize(uint32_t texture, float screenPixels) const {
+  auto it = textures_.find(texture);
+  if (it == textures_.end()) {
+    LOG_F("Texture {} isn't streamed", texture);
+  }
+
+  const Ktx2TextureFile& file = *it->second.file;
+  uint32_t lastLevel = file.getLevelCount() - 1;
+  if (screenPixels <= 0.0f) {
+    return lastLevel;
+  }
+
+  // One texel per pixel: each level halves the texels across
+  VkExtent2D extent = file.getExtent();
+  float texels = static_cast<float>(std::max(extent.width, extent.height));
+  float level = std::floor(std::log2(texels / screenPixels));
+  return static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(lastLevel)));
+}
+
+void TextureStreamer::recordFeedbackBarrier(CommandBuffer& commandBuffer) {
+  commandBuffer.memoryBarrier(
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      VK_ACCESS_HOST_READ_BIT);
+}
+
+uint32_t TextureStreamer::getFeedbackBuffer(size_t frame) const {
+  checkFrame(frame);
+  return frames_[frame].feedback.slot;
+}
+
+uint32_t TextureStreamer::getSlotTable(size_t frame) const {
+  checkFrame(frame);
+  return frames_[frame].slotTable.slot;
+}
+
+uint32_t TextureStreamer::getResidentLevel(uint32_t texture) const {
+  auto it = textures_.find(texture);
+  if (it == textures_.end()) {
+    LOG_F("Texture {} isn't streamed", texture);
+  }
+
+  return it->second.residentLevel;
+}
+
+TextureStreamer::TextureTable TextureStreamer::createTable(uint32_t size) {
+  TextureTable table;
+  table.buffer =
+      std::make_unique<MappedBuffer<uint32_t>>(device_, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  std::memset(table.buffer->getMapped(), 0, size * sizeof(uint32_t));
+  table.slot = bindless_.addBuffer(*table.buffer);
+  return table;
+}
+
+void TextureStreamer::checkFrame(size_t frame) const {
+  if (frame >= frames_.size()) {
+    LOG_F("Frame {} is out of range: the streamer was created for {} frames in flight",
+          frame,
+          frames_.size());
+  }
+}
+
+void TextureStreamer::readFeedback(size_t frame) {
+  const TextureTable& feedback = frames_[frame].feedback;
+  uint32_t* sampled = feedback.buffer->getMapped();
+
+  for (auto& [slot, texture] : textures_) {
+    // Levels needed, counted from the file's smallest one; 0 if the frame didn't sample it
+    uint32_t levels = sampled[slot];
+    if (levels != 0) {
+      uint32_t levelCount = texture.file->getLevelCount();
+      requestLevel(slot, levels >= levelCount ? 0 : levelCount - levels);
+    }
+  }
+
+  std::memset(sampled, 0, feedback.buffer->getCapacity() * sizeof(uint32_t));
+}
+
+void TextureStreamer::finishUploads() {
+  for (auto it = uploads_.begin(); it != uploads_.end();) {
+    Upload& upload = **it;
+    if (upload.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    // Re-throws whatever stopped the upload
+    upload.done.get();
+
+    usedMemory_ = usedMemory_ - upload.reservedMemory + upload.image->getMemorySize();
+
+    // A new slot rather than the old one's: frames in flight may still be sampling that
+    Texture& texture = textures_.at(upload.texture);
+    retireStreamed(texture);
+
+    texture.streamed = std::move(upload.image);
+    texture.streamedView = std::make_unique<ImageView>(*texture.streamed);
+    texture.streamedSlot = bindless_.addTexture(*texture.streamedView);
+    texture.residentLevel = upload.level;
+    texture.uploading = false;
+
+    it = uploads_.erase(it);
+  }
+}
+
+void TextureStreamer::freeRetiredImages() {
+  // Frames recorded before the image was replaced have all finished once frameCount_ more have
+  // begun
+  while (!retired_.empty() && retired_.front().frame + frameCount_ <= frame_) {
+    VkDeviceSize memory = retired_.front().image->getMemorySize();
+    usedMemory_ -= memory;
+    retiredMemory_ -= memory;
+    bindless_.removeTexture(retired_.front().slot);
+    retired_.pop_front();
+  }
+}
+
+void TextureStreamer::scheduleUploads() {
+  struct Raise {
+    uint32_t texture;
+    uint32_t level;
+    uint32_t missingLevels;
+    uint64_t lastUsedFrame;
+  };
+  std::vector<Raise> raises;
+
+  for (auto& [slot, texture] : textures_) {
+    uint32_t requested = texture.requestedLevel;
+    texture.requestedLevel = NOT_REQUESTED;
+
+    if (requested != NOT_REQUESTED) {
+      texture.lastUsedFrame = frame_;
+      texture.windowLevel = std::min(texture.windowLevel, requested);
+    }
+
+    if (texture.uploading) {
+      continue;
+    }
+
+    if (requested < texture.residentLevel) {
+      raises.push_back({slot, requested, texture.residentLevel - requested, texture.lastUsedFrame});
+      continue;
+    }
+
+    if (frame_ - texture.windowStart < LOWER_DELAY) {
+      continue;
+    }
+
+    // Lower what hasn't been needed at its resident level for a while. Lowering to a level that
+    // still needs streaming takes an upload, so it only happens when one is free and fits
+    uint32_t level = std::min(texture.windowLevel, texture.tailLevel);
+    if (level > texture.residentLevel) {
+      if (level < texture.tailLevel && uploads_.size() < maxUploads_ &&
+          usedMemory_ + estimateMemory(*texture.file, level) <= budget_) {
+        startUpload(slot, level);
+      } else {
+        evict(slot);
+      }
+    }
+
+    texture.windowLevel = NOT_REQUESTED;
+    texture.windowStart = frame_;
+  }
+
+  // Most missing levels first, then the most recently used
+  std::sort(raises.begin(), raises.end(), [](const Raise& a, const Raise& b) {
+    if (a.missingLevels != b.missingLevels) {
+      return a.missingLevels > b.missingLevels;
+    }
+    return a.lastUsedFrame > b.lastUsedFrame;
+  });
+
+  for (const auto& raise : raises) {
+    if (uploads_.size() >= maxUploads_) {
+      break;
+    }
+
+    if (makeRoom(estimateMemory(*textures_.at(raise.texture).file, raise.level), raise.texture)) {
+      startUpload(raise.texture, raise.level);
+    }
+  }
+}
+
+void TextureStreamer::startUpload(uint32_t texture, uint32_t level) {
+  Texture& streamed = textures_.at(texture);
+  streamed.uploading = true;
+
+  auto upload = std::make_unique<Upload>();
+  upload->texture = texture;
+  upload->level = level;
+  upload->reservedMemory = estimateMemory(*streamed.file, level);
+  usedMemory_ += upload->reservedMemory;
+
+  Upload* target = upload.get();
+  const Ktx2TextureFile* file = streamed.file.get();
+  upload->done = threadPool_.submit([this, target, file, level]() {
+    // A command pool can only be used by one thread at a time, so each upload gets its own
+    CommandPool commandPool(device_, transferQueue_);
+    target->image = file->uploadLevels(device_, commandPool, level, sharingQueues_, &queueMutex_);
+  });
+
+  uploads_.push_back(std::move(upload));
+}
+
+bool TextureStreamer::makeRoom(VkDeviceSize memory, uint32_t keep) {
+  // Retired images are freed within frameCount_ frames, so they don't need evicting for
+  auto fits = [&]() { return usedMemory_ - retiredMemory_ + memory <= budget_; };
+  if (fits()) {
+    return usedMemory_ + memory <= budget_;
+  }
+
+  // Textures asked for this frame are never evicted, so a busy frame can't thrash
+  std::vector<std::pair<uint64_t, uint32_t>> candidates;
+  VkDeviceSize evictable = 0;
+  for (const auto& [slot, texture] : textures_) {
+    if (slot != keep && texture.streamed && !texture.uploading &&
+        texture.lastUsedFrame < frame_) {
+      candidates.push_back({texture.lastUsedFrame, slot});
+      evictable += texture.streamed->getMemorySize();
+    }
+  }
+
+  if (usedMemory_ - retiredMemory_ - evictable + memory > budget_) {
+    return false;
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  for (size_t i = 0; i < candidates.size() && !fits(); i++) {
+    evict(candidates[i].second);
+  }
+
+  // The evicted images are only freed frames from now; the upload waits for them
+  return usedMemory_ + memory <= budget_;
+}
+
+void TextureStreamer::evict(uint32_t texture) {
+  Texture& streamed = textures_.at(texture);
+  retireStreamed(streamed);
+  streamed.residentLevel = streamed.tailLevel;
+}
+
+void TextureStreamer::retireStreamed(Texture& texture) {
+  if (!texture.streamed) {
+    return;
+  }
+
+  retiredMemory_ += texture.streamed->getMemorySize();
+  retired_.push_back({std::move(texture.streamedView),
+                      std::move(texture.streamed),
+                      texture.streamedSlot,
+                      frame_});
+  texture.streamedSlot = BindlessDescriptors::NO_RESOURCE;
+}
+
+VkDeviceSize TextureStreamer::estimateMemory(const Ktx2TextureFile& file, uint32_t level) {
+  VkDeviceSize memory = 0;
+  for (uint32_t i = level; i < file.getLevelCount(); i++) {
+    memory += file.getLevelSize(i);
+  }
+
+  return memory;
+}
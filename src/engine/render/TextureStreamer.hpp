@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <engine/assets/Ktx2Texture.hpp>
+#include <engine/core/BindlessDescriptors.hpp>
+#include <engine/core/Buffer.hpp>
+#include <engine/core/CommandPool.hpp>
+#include <engine/core/Image.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Keeps only the mip levels each texture needs on screen resident, within a fixed budget
+ * of device memory, so texture memory stays bounded however large the world gets.
+ *
+ * Every texture comes from a KTX2 file with a stored mip chain. Its tail (the levels no larger
+ * than `tailSize`) is uploaded when the texture is added and stays resident; larger levels are
+ * streamed in on the ThreadPool through the transfer queue when a frame asks for them, as one
+ * image holding every level from the finest wanted one down.
+ *
+ * A texture is named by the bindless slot of its tail. Every image streamed in gets a slot of its
+ * own, as descriptors frames in flight may sample can't be rewritten, and shaders find the slot to
+ * sample in a per-frame table indexed by texture. Replaced images and their slots are freed once
+ * no frame in flight can use them.
+ *
+ * Each frame says which level it needs of each texture, either from the CPU with requestLevel()
+ * (see getLevelForScreenSize()) or from the shaders, which write the levels they sampled into a
+ * feedback buffer indexed by texture too. The value written is how many levels of the file,
+ * counted from the smallest, the sample needed, which doesn't depend on the levels the bound image
+ * holds:
+ *
+ *   layout(set = BINDLESS_SET, binding = 1) buffer Buffers { uint data[]; } buffers[];
+ *
+ *   uint slot = buffers[slotTable].data[texture];
+ *   float lod = textureQueryLod(sampler2D(textures[nonuniformEXT(slot)], samplers[s]), uv).y;
+ *   uint levels = textureQueryLevels(sampler2D(textures[nonuniformEXT(slot)], samplers[s]));
+ *   atomicMax(buffers[feedbackBuffer].data[texture], uint(clamp(ceil(levels - lod), 1.0, 32.0)));
+ *
+ * with slotTable = getSlotTable(frame) and feedbackBuffer = getFeedbackBuffer(frame), passed e.g.
+ * as push constants, and the frame's last command buffer ending with recordFeedbackBarrier().
+ *
+ * When a level doesn't fit the budget, the least recently used textures drop back to their tail.
+ * Every LOWER_DELAY frames, textures also drop to the finest level asked for during that time, or
+ * to their tail if nobody asked for them.
+ *
+ *   streamer.beginFrame(frame);   // Once the GPU is done with the frame's previous use
+ *   streamer.requestLevel(texture, streamer.getLevelForScreenSize(texture, pixels));
+ *   bindless.update();
+ *
+ * Every image takes a VkDeviceMemory allocation of its own, so the tails, streamed images and
+ * retired images together must stay well under maxMemoryAllocationCount.
+ *
+ * The streamer submits to the transfer queue from worker threads, serialized with
+ * getQueueMutex(), which other users of that queue must lock too. Images are shared with
+ * `sharingQueues`, which must include the families of both the transfer queue and the queues
+ * sampling the textures.
+ */
+class TextureStreamer {
+ public:
+  // Frames a texture must go unrequested, or requested at coarser levels, before it is lowered
+  static constexpr uint64_t LOWER_DELAY = 120;
+
+  TextureStreamer() = delete;
+  TextureStreamer(TextureStreamer& other) = delete;
+
+  /**
+   * @param budget bytes of device memory all the textures' images may take, including images
+   * being uploaded and images replaced by newer ones but still used by frames in flight
+   * @param frameCount frames that can be in flight at once
+   * @param tailSize textures' levels no larger than this in both dimensions are always resident
+   * @param maxUploads uploads in flight at once
+   */
+  TextureStreamer(const LogicalDevice& device,
+                  const QueueFamilyRequest& transferQueue,
+                  ThreadPool& threadPool,
+                  BindlessDescriptors& bindless,
+                  VkDeviceSize budget,
+                  size_t frameCount,
+                  const QueueFamilyRequests sharingQueues = {},
+                  uint32_t tailSize = 64,
+                  uint32_t maxUploads = 4);
+
+  // Waits for the uploads in flight. Only once no frame in flight uses the textures
+  ~TextureStreamer();
+
+  /**
+   * @brief Start streaming `file`: upload its tail (blocking), and return the texture, the bindless
+   * slot of the tail. Calls LOG_F if the file has no stored mip chain or its format can't be
+   * sampled.
+   */
+  uint32_t add(std::unique_ptr<Ktx2TextureFile> file);
+
+  // Stop streaming a texture and free its slots. Only once no frame in flight uses it
+  void remove(uint32_t texture);
+
+  /**
+   * @brief Collect finished uploads, free images no frame in flight uses anymore, read the
+   * feedback `frame` wrote when it last ran, start the uploads and evictions the requests since
+   * the last call ask for, and fill `frame`'s slot table. Call once per frame, once the GPU is done
+   * with the frame's previous use and before recording it, then update the bindless descriptors.
+   * Calls LOG_F if `frame` isn't below the frame count.
+   */
+  void beginFrame(size_t frame);
+
+  // Ask for level `level` of `texture` (0 being the full resolution) to be resident
+  void requestLevel(uint32_t texture, uint32_t level);
+
+  // The finest level needed to draw `texture` over `screenPixels` pixels across
+  uint32_t getLevelForScreenSize(uint32_t texture, float screenPixels) const;
+
+  // Make the feedback shaders wrote visible to the host; at the end of the frame's last commands
+  static void recordFeedbackBarrier(CommandBuffer& commandBuffer);
+
+  // Bindless buffer slot of the feedback buffer shaders write into during `frame`
+  uint32_t getFeedbackBuffer(size_t frame) const;
+
+  // Bindless buffer slot of the table giving, by texture, the bindless texture slot `frame` samples
+  uint32_t getSlotTable(size_t frame) const;
+
+  // Finest level of `texture` the bound image holds
+  uint32_t getResidentLevel(uint32_t texture) const;
+
+  // Device memory taken by the textures' images, including uploads in flight
+  VkDeviceSize getUsedMemory() const { return usedMemory_; }
+
+  VkDeviceSize getBudget() const { return budget_; }
+
+  void setBudget(VkDeviceSize budget) { budget_ = budget; }
+
+  size_t getUploadsInFlight() const { return uploads_.size(); }
+
+  std::mutex& getQueueMutex() { return queueMutex_; }
+
+ private:
+  // No request since the last beginFrame()
+  static constexpr uint32_t NOT_REQUESTED = UINT32_MAX;
+
+  struct Texture {
+    std::unique_ptr<Ktx2TextureFile> file;
+
+    // The always resident levels, from tailLevel down
+    uint32_t tailLevel;
+    std::unique_ptr<Image> tail;
+    std::unique_ptr<ImageView> tailView;
+
+    // Levels from residentLevel down, when finer than the tail
+    uint32_t residentLevel;
+    std::unique_ptr<Image> streamed;
+    std::unique_ptr<ImageView> streamedView;
+    uint32_t streamedSlot = BindlessDescriptors::NO_RESOURCE;
+
+    uint32_t requestedLevel = NOT_REQUESTED;  // Finest level asked for since the last beginFrame()
+    uint64_t lastUsedFrame = 0;               // Last frame asking for any level, for LRU eviction
+
+    // Finest level asked for since windowStart; what the texture is lowered to after LOWER_DELAY
+    uint32_t windowLevel = NOT_REQUESTED;
+    uint64_t windowStart = 0;
+
+    bool uploading = false;
+  };
+
+  // Written by the worker thread, read once `done` is ready
+  struct Upload {
+    uint32_t texture;
+    uint32_t level;
+    VkDeviceSize reservedMemory;  // Estimated size, until the image exists
+    std::unique_ptr<Image> image;
+    std::future<void> done;
+  };
+
+  // An image replaced or evicted, freed with its slot once no frame in flight can still sample it
+  struct RetiredImage {
+    std::unique_ptr<ImageView> view;
+    std::unique_ptr<Image> image;
+    uint32_t slot;
+    uint64_t frame;
+  };
+
+  // Host-visible buffer indexed by texture, in a bindless buffer slot
+  struct TextureTable {
+    std::unique_ptr<MappedBuffer<uint32_t>> buffer;
+    uint32_t slot;
+  };
+
+  struct FrameTables {
+    TextureTable feedback;   // Levels sampled, written by the shaders
+    TextureTable slotTable;  // Bindless texture slot to sample, written by beginFrame()
+  };
+
+  TextureTable createTable(uint32_t size);
+  void checkFrame(size_t frame) const;
+
+  void readFeedback(size_t frame);
+  void finishUploads();
+  void freeRetiredImages();
+  void scheduleUploads();
+
+  // Start uploading `texture` from `level` down, on the ThreadPool
+  void startUpload(uint32_t texture, uint32_t level);
+
+  /**
+   * @brief Evict least recently used textures, other than `keep`, until `memory` more bytes fit
+   * in the budget once the retired images are freed. Evicts nothing if that isn't possible.
+   *
+   * @return true if the bytes fit right now
+   */
+  bool makeRoom(VkDeviceSize memory, uint32_t keep);
+
+  // Drop the streamed levels of `texture`, sampling its tail again
+  void evict(uint32_t texture);
+
+  // Retire the streamed image of `texture`, if any
+  void retireStreamed(Texture& texture);
+
+  // The bindless texture slot frames should sample for `texture`
+  static uint32_t getBoundSlot(uint32_t texture, const Texture& streamed) {
+    return streamed.streamed ? streamed.streamedSlot : texture;
+  }
+
+  // Estimated device memory of an image holding the levels of `file` from `level` down
+  static VkDeviceSize estimateMemory(const Ktx2TextureFile& file, uint32_t level);
+
+  const LogicalDevice& device_;
+  const QueueFamilyRequest& transferQueue_;
+  ThreadPool& threadPool_;
+  BindlessDescriptors& bindless_;
+  VkDeviceSize budget_;
+  size_t frameCount_;
+  QueueFamilyRequests sharingQueues_;
+  uint32_t tailSize_;
+  uint32_t maxUploads_;
+
+  CommandPool commandPool_;  // For tails, uploaded on the calling thread
+  std::mutex queueMutex_;
+
+  std::unordered_map<uint32_t, Texture> textures_;  // By bindless slot
+  std::vector<std::unique_ptr<Upload>> uploads_;
+  std::deque<RetiredImage> retired_;
+  std::vector<FrameTables> frames_;  // Per frame in flight
+
+  uint64_t frame_ = 0;  // beginFrame() calls so far
+  VkDeviceSize usedMemory_ = 0;
+  VkDeviceSize retiredMemory_ = 0;  // Part of usedMemory_ waiting in retired_
+};
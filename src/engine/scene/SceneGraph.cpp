@@ -0,0 +1,683 @@
+#include "SceneGraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <engine/utils/cpu.hpp>
+#include <fmtlog/Log.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_GRAPH_SSE 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SCENE_GRAPH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts AVX intrinsics anywhere. GCC and Clang need the functions using them marked, so the
+// rest of the library keeps building for the baseline instruction set
+#if defined(SCENE_GRAPH_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define SCENE_GRAPH_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define SCENE_GRAPH_AVX2_TARGET
+#endif
+
+namespace {
+
+alignas(16) const float IDENTITY[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,  // Column 0
+    0.0f, 1.0f, 0.0f, 0.0f,  // Column 1
+    0.0f, 0.0f, 1.0f, 0.0f,  // Column 2
+    0.0f, 0.0f, 0.0f, 1.0f,  // Column 3
+};
+
+// Local matrices are affine, so they're passed around as 12 floats: the three rotation columns
+// multiplied by the scale, then the translation
+constexpr size_t LOCAL_ENTRIES = 12;
+
+// A store to a world matrix that isn't cached waits for its line to be read first. Touching the
+// matrices this many nodes ahead overlaps those reads with the math
+constexpr size_t PREFETCH_DISTANCE = 32;
+
+struct TrsArrays {
+  const float* translationX;
+  const float* translationY;
+  const float* translationZ;
+  const float* rotationX;
+  const float* rotationY;
+  const float* rotationZ;
+  const float* rotationW;
+  const float* scaleX;
+  const float* scaleY;
+  const float* scaleZ;
+};
+
+// World matrix of the parent of `slot`, or the identity for roots
+inline const float* getParentWorld(const uint32_t* parents, const float* world, size_t slot) {
+  return parents[slot] == SceneGraph::NO_NODE ? IDENTITY : world + size_t(parents[slot]) * 16;
+}
+
+// Local matrix of slot `i`, each entry `stride` floats after the previous one
+void composeLocal(const TrsArrays& trs, size_t i, float* local, size_t stride) {
+  float x = trs.rotationX[i], y = trs.rotationY[i], z = trs.rotationZ[i], w = trs.rotationW[i];
+  float x2 = x + x, y2 = y + y, z2 = z + z;
+  float xx = x * x2, yy = y * y2, zz = z * z2;
+  float xy = x * y2, xz = x * z2, yz = y * z2;
+  float wx = w * x2, wy = w * y2, wz = w * z2;
+
+  const float entries[LOCAL_ENTRIES] = {
+      (1.0f - (yy + zz)) * trs.scaleX[i],
+      (xy + wz) * trs.scaleX[i],
+      (xz - wy) * trs.scaleX[i],
+      (xy - wz) * trs.scaleY[i],
+      (1.0f - (xx + zz)) * trs.scaleY[i],
+      (yz + wx) * trs.scaleY[i],
+      (xz + wy) * trs.scaleZ[i],
+      (yz - wx) * trs.scaleZ[i],
+      (1.0f - (xx + yy)) * trs.scaleZ[i],
+      trs.translationX[i],
+      trs.translationY[i],
+      trs.translationZ[i],
+  };
+
+  for (size_t e = 0; e < LOCAL_ENTRIES; e++) {
+    local[e * stride] = entries[e];
+  }
+}
+
+#if defined(SCENE_GRAPH_SSE)
+
+// composeLocal() for slots [i, i + 4), one slot per lane: entry e of lane l is local[e * 4 + l]
+void composeLocal4(const TrsArrays& trs, size_t i, float* local) {
+  __m128 x = _mm_loadu_ps(trs.rotationX + i), y = _mm_loadu_ps(trs.rotationY + i);
+  __m128 z = _mm_loadu_ps(trs.rotationZ + i), w = _mm_loadu_ps(trs.rotationW + i);
+  __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+  __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+  __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+  __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+  __m128 one = _mm_set1_ps(1.0f);
+
+  __m128 sx = _mm_loadu_ps(trs.scaleX + i);
+  __m128 sy = _mm_loadu_ps(trs.scaleY + i);
+  __m128 sz = _mm_loadu_ps(trs.scaleZ + i);
+
+  _mm_store_ps(local + 0, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx));
+  _mm_store_ps(local + 4, _mm_mul_ps(_mm_add_ps(xy, wz), sx));
+  _mm_store_ps(local + 8, _mm_mul_ps(_mm_sub_ps(xz, wy), sx));
+  _mm_store_ps(local + 12, _mm_mul_ps(_mm_sub_ps(xy, wz), sy));
+  _mm_store_ps(local + 16, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy));
+  _mm_store_ps(local + 20, _mm_mul_ps(_mm_add_ps(yz, wx), sy));
+  _mm_store_ps(local + 24, _mm_mul_ps(_mm_add_ps(xz, wy), sz));
+  _mm_store_ps(local + 28, _mm_mul_ps(_mm_sub_ps(yz, wx), sz));
+  _mm_store_ps(local + 32, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz));
+  _mm_store_ps(local + 36, _mm_loadu_ps(trs.translationX + i));
+  _mm_store_ps(local + 40, _mm_loadu_ps(trs.translationY + i));
+  _mm_store_ps(local + 44, _mm_loadu_ps(trs.translationZ + i));
+}
+
+// Column of parent * local, for a column (x, y, z, 0) of the local matrix
+inline __m128 transformColumn(__m128 p0, __m128 p1, __m128 p2, const float* l, size_t stride) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(l[0])),
+                               _mm_mul_ps(p1, _mm_set1_ps(l[stride]))),
+                    _mm_mul_ps(p2, _mm_set1_ps(l[2 * stride])));
+}
+
+// world = parent * local, with both matrices column-major and 16-byte aligned
+inline void multiplyAffine(const float* parent, const float* local, size_t stride, float* world) {
+  __m128 p0 = _mm_load_ps(parent);
+  __m128 p1 = _mm_load_ps(parent + 4);
+  __m128 p2 = _mm_load_ps(parent + 8);
+  __m128 p3 = _mm_load_ps(parent + 12);
+
+  _mm_store_ps(world, transformColumn(p0, p1, p2, local, stride));
+  _mm_store_ps(world + 4, transformColumn(p0, p1, p2, local + 3 * stride, stride));
+  _mm_store_ps(world + 8, transformColumn(p0, p1, p2, local + 6 * stride, stride));
+
+  // The implicit last row of the local matrix is (0, 0, 0, 1)
+  _mm_store_ps(world + 12,
+               _mm_add_ps(transformColumn(p0, p1, p2, local + 9 * stride, stride), p3));
+}
+
+void updateSlotsSse(const TrsArrays& trs,
+                    const uint32_t* parents,
+                    float* world,
+                    size_t begin,
+                    size_t end) {
+  size_t slot = begin;
+
+  // Local matrices of four nodes at once. The multiplies stay in order, since a node's parent may
+  // be one of the three before it
+  alignas(16) float local[LOCAL_ENTRIES * 4];
+  for (; slot + 4 <= end; slot += 4) {
+    _mm_prefetch(reinterpret_cast<const char*>(world + (slot + PREFETCH_DISTANCE) * 16),
+                 _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(world + (slot + PREFETCH_DISTANCE + 2) * 16),
+                 _MM_HINT_T0);
+    composeLocal4(trs, slot, local);
+
+    for (size_t lane = 0; lane < 4; lane++) {
+      multiplyAffine(
+          getParentWorld(parents, world, slot + lane), local + lane, 4, world + (slot + lane) * 16);
+    }
+  }
+
+  for (; slot < end; slot++) {
+    composeLocal(trs, slot, local, 1);
+    multiplyAffine(getParentWorld(parents, world, slot), local, 1, world + slot * 16);
+  }
+}
+
+// composeLocal4() for the first `lanes` of slots [i, i + 8). The loads are masked, so a short
+// range doesn't read past the end of the arrays, or fall back to SSE code that would pay for
+// mixing it with AVX
+SCENE_GRAPH_AVX2_TARGET void composeLocal8(const TrsArrays& trs,
+                                           size_t i,
+                                           size_t lanes,
+                                           float* local) {
+  __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(lanes)),
+                                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+  __m256 x = _mm256_maskload_ps(trs.rotationX + i, mask);
+  __m256 y = _mm256_maskload_ps(trs.rotationY + i, mask);
+  __m256 z = _mm256_maskload_ps(trs.rotationZ + i, mask);
+  __m256 w = _mm256_maskload_ps(trs.rotationW + i, mask);
+  __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+  __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+  __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+  __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  __m256 sx = _mm256_maskload_ps(trs.scaleX + i, mask);
+  __m256 sy = _mm256_maskload_ps(trs.scaleY + i, mask);
+  __m256 sz = _mm256_maskload_ps(trs.scaleZ + i, mask);
+
+  _mm256_store_ps(local + 0, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx));
+  _mm256_store_ps(local + 8, _mm256_mul_ps(_mm256_add_ps(xy, wz), sx));
+  _mm256_store_ps(local + 16, _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx));
+  _mm256_store_ps(local + 24, _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy));
+  _mm256_store_ps(local + 32, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy));
+  _mm256_store_ps(local + 40, _mm256_mul_ps(_mm256_add_ps(yz, wx), sy));
+  _mm256_store_ps(local + 48, _mm256_mul_ps(_mm256_add_ps(xz, wy), sz));
+  _mm256_store_ps(local + 56, _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz));
+  _mm256_store_ps(local + 64, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz));
+  _mm256_store_ps(local + 72, _mm256_maskload_ps(trs.translationX + i, mask));
+  _mm256_store_ps(local + 80, _mm256_maskload_ps(trs.translationY + i, mask));
+  _mm256_store_ps(local + 88, _mm256_maskload_ps(trs.translationZ + i, mask));
+}
+
+// transformColumn() with FMA, broadcasting the local entries straight from memory
+SCENE_GRAPH_AVX2_TARGET inline __m128
+transformColumnFma(__m128 p0, __m128 p1, __m128 p2, __m128 base, const float* l, size_t stride) {
+  __m128 result = _mm_fmadd_ps(p0, _mm_broadcast_ss(l), base);
+  result = _mm_fmadd_ps(p1, _mm_broadcast_ss(l + stride), result);
+  return _mm_fmadd_ps(p2, _mm_broadcast_ss(l + 2 * stride), result);
+}
+
+SCENE_GRAPH_AVX2_TARGET inline void multiplyAffineFma(const float* parent,
+                                                      const float* local,
+                                                      size_t stride,
+                                                      float* world) {
+  __m128 p0 = _mm_load_ps(parent);
+  __m128 p1 = _mm_load_ps(parent + 4);
+  __m128 p2 = _mm_load_ps(parent + 8);
+  __m128 p3 = _mm_load_ps(parent + 12);
+  __m128 zero = _mm_setzero_ps();
+
+  _mm_store_ps(world, transformColumnFma(p0, p1, p2, zero, local, stride));
+  _mm_store_ps(world + 4, transformColumnFma(p0, p1, p2, zero, local + 3 * stride, stride));
+  _mm_store_ps(world + 8, transformColumnFma(p0, p1, p2, zero, local + 6 * stride, stride));
+  _mm_store_ps(world + 12, transformColumnFma(p0, p1, p2, p3, local + 9 * stride, stride));
+}
+
+// updateSlotsSse(), eight nodes at a time
+SCENE_GRAPH_AVX2_TARGET void updateSlotsAvx2(const TrsArrays& trs,
+                                             const uint32_t* parents,
+                                             float* world,
+                                             size_t begin,
+                                             size_t end) {
+  alignas(32) float local[LOCAL_ENTRIES * 8];
+  for (size_t slot = begin; slot < end; slot += 8) {
+    size_t lanes = std::min<size_t>(end - slot, 8);
+
+    for (size_t lane = 0; lane < 8; lane += 2) {
+      _mm_prefetch(reinterpret_cast<const char*>(world + (slot + PREFETCH_DISTANCE + lane) * 16),
+                   _MM_HINT_T0);
+    }
+    composeLocal8(trs, slot, lanes, local);
+
+    for (size_t lane = 0; lane < lanes; lane++) {
+      multiplyAffineFma(
+          getParentWorld(parents, world, slot + lane), local + lane, 8, world + (slot + lane) * 16);
+    }
+  }
+}
+
+#elif defined(SCENE_GRAPH_NEON)
+
+void composeLocal4(const TrsArrays& trs, size_t i, float* local) {
+  float32x4_t x = vld1q_f32(trs.rotationX + i), y = vld1q_f32(trs.rotationY + i);
+  float32x4_t z = vld1q_f32(trs.rotationZ + i), w = vld1q_f32(trs.rotationW + i);
+  float32x4_t x2 = vaddq_f32(x, x), y2 = vaddq_f32(y, y), z2 = vaddq_f32(z, z);
+  float32x4_t xx = vmulq_f32(x, x2), yy = vmulq_f32(y, y2), zz = vmulq_f32(z, z2);
+  float32x4_t xy = vmulq_f32(x, y2), xz = vmulq_f32(x, z2), yz = vmulq_f32(y, z2);
+  float32x4_t wx = vmulq_f32(w, x2), wy = vmulq_f32(w, y2), wz = vmulq_f32(w, z2);
+  float32x4_t one = vdupq_n_f32(1.0f);
+
+  float32x4_t sx = vld1q_f32(trs.scaleX + i);
+  float32x4_t sy = vld1q_f32(trs.scaleY + i);
+  float32x4_t sz = vld1q_f32(trs.scaleZ + i);
+
+  vst1q_f32(local + 0, vmulq_f32(vsubq_f32(one, vaddq_f32(yy, zz)), sx));
+  vst1q_f32(local + 4, vmulq_f32(vaddq_f32(xy, wz), sx));
+  vst1q_f32(local + 8, vmulq_f32(vsubq_f32(xz, wy), sx));
+  vst1q_f32(local + 12, vmulq_f32(vsubq_f32(xy, wz), sy));
+  vst1q_f32(local + 16, vmulq_f32(vsubq_f32(one, vaddq_f32(xx, zz)), sy));
+  vst1q_f32(local + 20, vmulq_f32(vaddq_f32(yz, wx), sy));
+  vst1q_f32(local + 24, vmulq_f32(vaddq_f32(xz, wy), sz));
+  vst1q_f32(local + 28, vmulq_f32(vsubq_f32(yz, wx), sz));
+  vst1q_f32(local + 32, vmulq_f32(vsubq_f32(one, vaddq_f32(xx, yy)), sz));
+  vst1q_f32(local + 36, vld1q_f32(trs.translationX + i));
+  vst1q_f32(local + 40, vld1q_f32(trs.translationY + i));
+  vst1q_f32(local + 44, vld1q_f32(trs.translationZ + i));
+}
+
+void multiplyAffine(const float* parent, const float* local, size_t stride, float* world) {
+  float32x4_t p0 = vld1q_f32(parent);
+  float32x4_t p1 = vld1q_f32(parent + 4);
+  float32x4_t p2 = vld1q_f32(parent + 8);
+  float32x4_t p3 = vld1q_f32(parent + 12);
+
+  for (size_t column = 0; column < 4; column++) {
+    const float* l = local + column * 3 * stride;
+    float32x4_t result = column == 3 ? p3 : vdupq_n_f32(0.0f);
+    result = vmlaq_n_f32(result, p0, l[0]);
+    result = vmlaq_n_f32(result, p1, l[stride]);
+    result = vmlaq_n_f32(result, p2, l[2 * stride]);
+    vst1q_f32(world + column * 4, result);
+  }
+}
+
+void updateSlotsNeon(const TrsArrays& trs,
+                     const uint32_t* parents,
+                     float* world,
+                     size_t begin,
+                     size_t end) {
+  size_t slot = begin;
+
+  // Local matrices of four nodes at once. The multiplies stay in order, since a node's parent may
+  // be one of the three before it
+  alignas(16) float local[LOCAL_ENTRIES * 4];
+  for (; slot + 4 <= end; slot += 4) {
+    composeLocal4(trs, slot, local);
+
+    for (size_t lane = 0; lane < 4; lane++) {
+      multiplyAffine(
+          getParentWorld(parents, world, slot + lane), local + lane, 4, world + (slot + lane) * 16);
+    }
+  }
+
+  for (; slot < end; slot++) {
+    composeLocal(trs, slot, local, 1);
+    multiplyAffine(getParentWorld(parents, world, slot), local, 1, world + slot * 16);
+  }
+}
+
+#else
+
+void multiplyAffine(const float* parent, const float* local, size_t stride, float* world) {
+  for (size_t column = 0; column < 4; column++) {
+    const float* l = local + column * 3 * stride;
+    for (size_t row = 0; row < 4; row++) {
+      world[column * 4 + row] = parent[row] * l[0] + parent[4 + row] * l[stride] +
+                                parent[8 + row] * l[2 * stride] +
+                                (column == 3 ? parent[12 + row] : 0.0f);
+    }
+  }
+}
+
+void updateSlotsScalar(const TrsArrays& trs,
+                       const uint32_t* parents,
+                       float* world,
+                       size_t begin,
+                       size_t end) {
+  float local[LOCAL_ENTRIES];
+  for (size_t slot = begin; slot < end; slot++) {
+    composeLocal(trs, slot, local, 1);
+    multiplyAffine(getParentWorld(parents, world, slot), local, 1, world + slot * 16);
+  }
+}
+
+#endif
+
+glm::quat normalizeRotation(const glm::quat& rotation) {
+  float length = std::sqrt(rotation.x * rotation.x + rotation.y * rotation.y +
+                           rotation.z * rotation.z + rotation.w * rotation.w);
+  if (length <= 0.0f) {
+    return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  }
+
+  return glm::quat(
+      rotation.w / length, rotation.x / length, rotation.y / length, rotation.z / length);
+}
+
+}  // namespace
+
+SceneNode SceneGraph::addNode(SceneNode parent,
+                              const glm::vec3& translation,
+                              const glm::quat& rotation,
+                              const glm::vec3& scale) {
+  uint32_t slot = static_cast<uint32_t>(slots_.size());
+  uint32_t parentSlot = parent == NO_NODE ? NO_NODE : getSlot(parent);
+
+  // Appending keeps the depth-first order only if the parent's subtree is the last one
+  if (parentSlot != NO_NODE && subtreeEnds_[parentSlot] != slot) {
+    layoutDirty_ = true;
+  }
+
+  glm::quat unitRotation = normalizeRotation(rotation);
+
+  translationX_.push_back(translation.x);
+  translationY_.push_back(translation.y);
+  translationZ_.push_back(translation.z);
+  rotationX_.push_back(unitRotation.x);
+  rotationY_.push_back(unitRotation.y);
+  rotationZ_.push_back(unitRotation.z);
+  rotationW_.push_back(unitRotation.w);
+  scaleX_.push_back(scale.x);
+  scaleY_.push_back(scale.y);
+  scaleZ_.push_back(scale.z);
+  world_.push_back(glm::mat4(1.0f));
+  parents_.push_back(parentSlot);
+  subtreeEnds_.push_back(slot + 1);
+  dirty_.push_back(1);
+
+  SceneNode node = static_cast<SceneNode>(slots_.size());
+  nodes_.push_back(node);
+  slots_.push_back(slot);
+
+  if (!layoutDirty_) {
+    for (uint32_t ancestor = parentSlot; ancestor != NO_NODE; ancestor = parents_[ancestor]) {
+      subtreeEnds_[ancestor] = slot + 1;
+    }
+  }
+
+  return node;
+}
+
+SceneNode SceneGraph::getParent(SceneNode node) const {
+  uint32_t parentSlot = parents_[getSlot(node)];
+  return parentSlot == NO_NODE ? NO_NODE : nodes_[parentSlot];
+}
+
+void SceneGraph::setTranslation(SceneNode node, const glm::vec3& translation) {
+  uint32_t slot = getSlot(node);
+  translationX_[slot] = translation.x;
+  translationY_[slot] = translation.y;
+  translationZ_[slot] = translation.z;
+  markDirty(slot);
+}
+
+void SceneGraph::setRotation(SceneNode node, const glm::quat& rotation) {
+  uint32_t slot = getSlot(node);
+  glm::quat unitRotation = normalizeRotation(rotation);
+  rotationX_[slot] = unitRotation.x;
+  rotationY_[slot] = unitRotation.y;
+  rotationZ_[slot] = unitRotation.z;
+  rotationW_[slot] = unitRotation.w;
+  markDirty(slot);
+}
+
+void SceneGraph::setScale(SceneNode node, const glm::vec3& scale) {
+  uint32_t slot = getSlot(node);
+  scaleX_[slot] = scale.x;
+  scaleY_[slot] = scale.y;
+  scaleZ_[slot] = scale.z;
+  markDirty(slot);
+}
+
+glm::vec3 SceneGraph::getTranslation(SceneNode node) const {
+  uint32_t slot = getSlot(node);
+  return glm::vec3(translationX_[slot], translationY_[slot], translationZ_[slot]);
+}
+
+glm::quat SceneGraph::getRotation(SceneNode node) const {
+  uint32_t slot = getSlot(node);
+  return glm::quat(rotationW_[slot], rotationX_[slot], rotationY_[slot], rotationZ_[slot]);
+}
+
+glm::vec3 SceneGraph::getScale(SceneNode node) const {
+  uint32_t slot = getSlot(node);
+  return glm::vec3(scaleX_[slot], scaleY_[slot], scaleZ_[slot]);
+}
+
+const glm::mat4& SceneGraph::getWorldTransform(SceneNode node) const {
+  return world_[getSlot(node)];
+}
+
+uint32_t SceneGraph::getSlot(SceneNode node) const {
+  if (node >= slots_.size()) {
+    LOG_F("Scene node {} does not exist, the graph has {} nodes", node, slots_.size());
+  }
+
+  return slots_[node];
+}
+
+void SceneGraph::update(ThreadPool* threadPool) {
+  if (layoutDirty_) {
+    relayout();
+  }
+
+  // Topmost dirty nodes: each one's subtree is recomputed whole, so the scan skips past it
+  pending_.clear();
+  updatedCount_ = 0;
+
+  const uint8_t* dirty = dirty_.data();
+  size_t count = dirty_.size();
+  size_t slot = 0;
+  while (slot < count) {
+    const void* found = std::memchr(dirty + slot, 1, count - slot);
+    if (!found) {
+      break;
+    }
+
+    uint32_t root = static_cast<uint32_t>(static_cast<const uint8_t*>(found) - dirty);
+    pending_.push_back({root, subtreeEnds_[root]});
+    updatedCount_ += subtreeEnds_[root] - root;
+    slot = subtreeEnds_[root];
+  }
+
+  if (!threadPool || updatedCount_ <= TASK_SIZE) {
+    for (const auto& range : pending_) {
+      updateRange(range);
+    }
+    return;
+  }
+
+  ranges_.clear();
+  for (const auto& range : pending_) {
+    if (range.end - range.begin > TASK_SIZE) {
+      splitRange(range);
+    } else {
+      ranges_.push_back(range);
+    }
+  }
+
+  // Group consecutive ranges into tasks of about TASK_SIZE nodes
+  taskStarts_.assign(1, 0);
+  size_t taskNodes = 0;
+  for (size_t i = 0; i < ranges_.size(); i++) {
+    taskNodes += ranges_[i].end - ranges_[i].begin;
+    if (taskNodes >= TASK_SIZE || i + 1 == ranges_.size()) {
+      taskStarts_.push_back(i + 1);
+      taskNodes = 0;
+    }
+  }
+
+  threadPool->parallelFor(taskStarts_.size() - 1, 1, [this](size_t begin, size_t end) {
+    for (size_t task = begin; task < end; task++) {
+      for (size_t i = taskStarts_[task]; i < taskStarts_[task + 1]; i++) {
+        updateRange(ranges_[i]);
+      }
+    }
+  });
+}
+
+void SceneGraph::splitRange(SlotRange range) {
+  // Iterative, since a long chain of nodes would otherwise recurse once per node
+  std::vector<SlotRange> subtrees = {range};
+
+  while (!subtrees.empty()) {
+    SlotRange subtree = subtrees.back();
+    subtrees.pop_back();
+
+    if (subtree.end - subtree.begin <= TASK_SIZE) {
+      ranges_.push_back(subtree);
+      continue;
+    }
+
+    // Update the root now, which makes its children's subtrees independent of each other. Small
+    // neighbouring children are batched into one range, large ones are split further
+    updateRange({subtree.begin, subtree.begin + 1});
+
+    uint32_t batchBegin = subtree.begin + 1;
+    for (uint32_t child = subtree.begin + 1; child < subtree.end; child = subtreeEnds_[child]) {
+      uint32_t childEnd = subtreeEnds_[child];
+
+      if (childEnd - child > TASK_SIZE) {
+        if (child > batchBegin) {
+          ranges_.push_back({batchBegin, child});
+        }
+        subtrees.push_back({child, childEnd});
+        batchBegin = childEnd;
+      } else if (childEnd - batchBegin > TASK_SIZE) {
+        ranges_.push_back({batchBegin, child});
+        batchBegin = child;
+      }
+    }
+
+    if (subtree.end > batchBegin) {
+      ranges_.push_back({batchBegin, subtree.end});
+    }
+  }
+}
+
+void SceneGraph::updateRange(SlotRange range) {
+  const TrsArrays trs = {translationX_.data(),
+                         translationY_.data(),
+                         translationZ_.data(),
+                         rotationX_.data(),
+                         rotationY_.data(),
+                         rotationZ_.data(),
+                         rotationW_.data(),
+                         scaleX_.data(),
+                         scaleY_.data(),
+                         scaleZ_.data()};
+
+#if defined(SCENE_GRAPH_SSE)
+  static const bool avx2 = cpuSupportsAvx2();
+  if (avx2) {
+    updateSlotsAvx2(trs, parents_.data(), &world_[0][0][0], range.begin, range.end);
+  } else {
+    updateSlotsSse(trs, parents_.data(), &world_[0][0][0], range.begin, range.end);
+  }
+#elif defined(SCENE_GRAPH_NEON)
+  updateSlotsNeon(trs, parents_.data(), &world_[0][0][0], range.begin, range.end);
+#else
+  updateSlotsScalar(trs, parents_.data(), &world_[0][0][0], range.begin, range.end);
+#endif
+
+  std::memset(dirty_.data() + range.begin, 0, range.end - range.begin);
+}
+
+void SceneGraph::relayout() {
+  size_t count = nodes_.size();
+
+  // Children of every slot, in slot order (compressed rows)
+  std::vector<uint32_t> childStarts(count + 1, 0);
+  for (uint32_t parent : parents_) {
+    if (parent != NO_NODE) {
+      childStarts[parent + 1]++;
+    }
+  }
+  for (size_t slot = 0; slot < count; slot++) {
+    childStarts[slot + 1] += childStarts[slot];
+  }
+
+  std::vector<uint32_t> children(childStarts[count]);
+  std::vector<uint32_t> nextChild(childStarts.begin(), childStarts.end() - 1);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    if (parents_[slot] != NO_NODE) {
+      children[nextChild[parents_[slot]]++] = slot;
+    }
+  }
+
+  // Depth-first order, keeping siblings (and roots) in the order they were in
+  std::vector<uint32_t> order;
+  order.reserve(count);
+  std::vector<uint32_t> stack;
+  for (uint32_t slot = static_cast<uint32_t>(count); slot-- > 0;) {
+    if (parents_[slot] == NO_NODE) {
+      stack.push_back(slot);
+    }
+  }
+
+  while (!stack.empty()) {
+    uint32_t slot = stack.back();
+    stack.pop_back();
+    order.push_back(slot);
+
+    for (uint32_t i = childStarts[slot + 1]; i-- > childStarts[slot];) {
+      stack.push_back(children[i]);
+    }
+  }
+
+  std::vector<uint32_t> newSlots(count);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    newSlots[order[slot]] = slot;
+  }
+
+  auto permute = [&order](auto& values) {
+    auto permuted = values;
+    for (size_t slot = 0; slot < order.size(); slot++) {
+      permuted[slot] = values[order[slot]];
+    }
+    values.swap(permuted);
+  };
+
+  permute(translationX_);
+  permute(translationY_);
+  permute(translationZ_);
+  permute(rotationX_);
+  permute(rotationY_);
+  permute(rotationZ_);
+  permute(rotationW_);
+  permute(scaleX_);
+  permute(scaleY_);
+  permute(scaleZ_);
+  permute(world_);
+  permute(dirty_);
+  permute(nodes_);
+  permute(parents_);
+
+  for (uint32_t& parent : parents_) {
+    if (parent != NO_NODE) {
+      parent = newSlots[parent];
+    }
+  }
+
+  // Children come after their parent, so one backwards pass pushes every subtree's end up
+  for (uint32_t slot = 0; slot < count; slot++) {
+    subtreeEnds_[slot] = slot + 1;
+  }
+  for (size_t slot = count; slot-- > 0;) {
+    if (parents_[slot] != NO_NODE) {
+      subtreeEnds_[parents_[slot]] = std::max(subtreeEnds_[parents_[slot]], subtreeEnds_[slot]);
+    }
+  }
+
+  for (uint32_t slot = 0; slot < count; slot++) {
+    slots_[nodes_[slot]] = slot;
+  }
+
+  layoutDirty_ = false;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <engine/utils/AlignedAllocator.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+// Handle to a node of a SceneGraph. Stays valid for the lifetime of the graph
+using SceneNode = uint32_t;
+
+/**
+ * @brief Transform hierarchy: every node has a local translation / rotation / scale relative to
+ * its parent, and a world matrix recomputed by update().
+ *
+ *   SceneNode arm = graph.addNode(body, {0.5f, 1.0f, 0.0f});
+ *   SceneNode hand = graph.addNode(arm, {0.0f, -0.6f, 0.0f});
+ *   graph.setRotation(arm, swing);   // marks arm, and with it hand, dirty
+ *   graph.update(&threadPool);
+ *   drawList.add(handMesh, {graph.getWorldTransform(hand)});
+ *
+ * Nodes are stored as flat arrays (one per TRS component, plus world matrices, parents and dirty
+ * flags) in depth-first order, so parents come before their children and every subtree is a
+ * contiguous range. update() scans the dirty flags, recomputes each dirty subtree front to back,
+ * and skips everything else. Large subtrees are cut into independent pieces that run in parallel,
+ * and the local matrices are composed from the SoA components before being multiplied with the
+ * parent's world matrix: four nodes at a time with SSE or NEON, or eight with AVX2 and FMA when
+ * the CPU has them.
+ *
+ * Adding a node under the last subtree of the graph (the usual depth-first construction) keeps the
+ * order as is; anything else re-sorts the arrays on the next update(). Handles don't change either
+ * way.
+ */
+class SceneGraph {
+ public:
+  static constexpr SceneNode NO_NODE = UINT32_MAX;
+
+  SceneGraph() = default;
+  SceneGraph(SceneGraph& other) = delete;
+
+  // Add a node under `parent`, or a new root for NO_NODE. The node starts out dirty
+  SceneNode addNode(SceneNode parent = NO_NODE,
+                    const glm::vec3& translation = glm::vec3(0.0f),
+                    const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                    const glm::vec3& scale = glm::vec3(1.0f));
+
+  size_t getNodeCount() const { return slots_.size(); }
+
+  SceneNode getParent(SceneNode node) const;
+
+  void setTranslation(SceneNode node, const glm::vec3& translation);
+  void setRotation(SceneNode node, const glm::quat& rotation);
+  void setScale(SceneNode node, const glm::vec3& scale);
+
+  glm::vec3 getTranslation(SceneNode node) const;
+  glm::quat getRotation(SceneNode node) const;
+  glm::vec3 getScale(SceneNode node) const;
+
+  /**
+   * @brief Recompute the world matrix of every dirty node and of everything below it. Given a
+   * thread pool, dirty subtrees above TASK_SIZE nodes are split up and spread over it.
+   */
+  void update(ThreadPool* threadPool = nullptr);
+
+  // As of the last update()
+  const glm::mat4& getWorldTransform(SceneNode node) const;
+
+  // Number of world matrices the last update() recomputed
+  size_t getUpdatedCount() const { return updatedCount_; }
+
+  // Nodes per parallel task: enough to amortize scheduling, small enough to balance the load
+  static constexpr size_t TASK_SIZE = 4096;
+
+ private:
+  // A contiguous run of slots whose parents are all up to date, or inside the run
+  struct SlotRange {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  uint32_t getSlot(SceneNode node) const;
+  void markDirty(uint32_t slot) { dirty_[slot] = 1; }
+
+  // Re-sort every array into depth-first order
+  void relayout();
+
+  // Cut the dirty subtree [begin, end) into ranges of about TASK_SIZE nodes, updating the nodes
+  // above them on the way
+  void splitRange(SlotRange range);
+
+  void updateRange(SlotRange range);
+
+ private:
+  // Per slot, in depth-first order
+  AlignedVector<float> translationX_, translationY_, translationZ_;
+  AlignedVector<float> rotationX_, rotationY_, rotationZ_, rotationW_;
+  AlignedVector<float> scaleX_, scaleY_, scaleZ_;
+  AlignedVector<glm::mat4, 64> world_;  // One cache line each
+  std::vector<uint32_t> parents_;      // Slot of the parent, NO_NODE for roots
+  std::vector<uint32_t> subtreeEnds_;  // One past the last slot of the node's subtree
+  std::vector<uint8_t> dirty_;
+  std::vector<SceneNode> nodes_;  // Handle of each slot
+
+  // Slot of each handle
+  std::vector<uint32_t> slots_;
+
+  bool layoutDirty_ = false;
+
+  // Reused by update()
+  std::vector<SlotRange> ranges_;
+  std::vector<SlotRange> pending_;
+  std::vector<size_t> taskStarts_;
+  size_t updatedCount_ = 0;
+};
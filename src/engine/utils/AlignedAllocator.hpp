@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * @brief std::allocator replacement that aligns every allocation to `Alignment` bytes, so SIMD
+ * kernels can use aligned loads on the start of a std::vector.
+ */
+template <class T, size_t Alignment>
+struct AlignedAllocator {
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+                "Alignment must be a power of two, at least the alignment of T");
+
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* pointer, size_t) { ::operator delete(pointer, std::align_val_t(Alignment)); }
+
+  template <class U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const {
+    return true;
+  }
+
+  template <class U>
+  bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+    return false;
+  }
+};
+
+// 32 bytes covers one AVX register, or two SSE / NEON registers
+template <class T, size_t Alignment = 32>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
@@ -0,0 +1,374 @@
+#include "Inflate.hpp"
+
+#include <cstring>
+
+namespace {
+
+constexpr int MAX_CODE_BITS = 15;
+constexpr int LENGTH_CODES = 29;
+constexpr int DISTANCE_CODES = 30;
+constexpr int FIXED_LITERAL_CODES = 288;
+constexpr int MAX_LITERAL_CODES = 286;
+constexpr int CODE_LENGTH_CODES = 19;
+
+// Base value and extra bits of each length symbol past 256, and of each distance symbol
+constexpr uint16_t LENGTH_BASE[LENGTH_CODES] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                                15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                                67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LENGTH_EXTRA[LENGTH_CODES] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t DISTANCE_BASE[DISTANCE_CODES] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t DISTANCE_EXTRA[DISTANCE_CODES] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                                    4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                                    9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order in which a dynamic block sends the code lengths of its code length alphabet
+constexpr uint8_t CODE_LENGTH_ORDER[CODE_LENGTH_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Canonical Huffman code: how many codes have each length, and the symbols sorted by code
+struct HuffmanCode {
+  uint16_t counts[MAX_CODE_BITS + 1];
+  uint16_t symbols[FIXED_LITERAL_CODES];
+
+  /**
+   * @brief Build the code from the bit length of each of `count` symbols.
+   *
+   * @return 0 for a complete code, a positive number for an incomplete one and a negative one for
+   * an over-subscribed (invalid) one
+   */
+  int build(const uint8_t* lengths, int count) {
+    std::memset(counts, 0, sizeof(counts));
+    for (int symbol = 0; symbol < count; symbol++) {
+      counts[lengths[symbol]]++;
+    }
+
+    if (counts[0] == count) {
+      return 0;  // No codes: complete, though any attempt to decode fails
+    }
+
+    int left = 1;
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+      left = (left << 1) - counts[length];
+      if (left < 0) {
+        return left;
+      }
+    }
+
+    uint16_t offsets[MAX_CODE_BITS + 1];
+    offsets[1] = 0;
+    for (int length = 1; length < MAX_CODE_BITS; length++) {
+      offsets[length + 1] = offsets[length] + counts[length];
+    }
+
+    for (int symbol = 0; symbol < count; symbol++) {
+      if (lengths[symbol] != 0) {
+        symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+      }
+    }
+
+    return left;
+  }
+};
+
+class Inflater {
+ public:
+  Inflater(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+      : src_(src), srcSize_(srcSize), dst_(dst), dstSize_(dstSize) {}
+
+  // Decode every DEFLATE block, up to and including the final one
+  bool run() {
+    bool last;
+    do {
+      last = bits(1);
+      uint32_t type = bits(2);
+
+      bool ok;
+      switch (type) {
+        case 0:
+          ok = stored();
+          break;
+        case 1:
+          ok = fixed();
+          break;
+        case 2:
+          ok = dynamic();
+          break;
+        default:
+          ok = false;
+          break;
+      }
+
+      if (!ok || overrun_) {
+        return false;
+      }
+    } while (!last);
+
+    return true;
+  }
+
+  // Bytes consumed so far, counting a partially read byte as consumed
+  size_t getSourcePosition() const { return srcPos_; }
+
+  size_t getOutputSize() const { return dstPos_; }
+
+ private:
+  uint32_t bits(int count) {
+    while (bitCount_ < count) {
+      if (srcPos_ == srcSize_) {
+        overrun_ = true;
+        return 0;
+      }
+      bitBuffer_ |= static_cast<uint32_t>(src_[srcPos_++]) << bitCount_;
+      bitCount_ += 8;
+    }
+
+    uint32_t value = bitBuffer_ & ((1u << count) - 1);
+    bitBuffer_ >>= count;
+    bitCount_ -= count;
+    return value;
+  }
+
+  // The next symbol of `code`, read one bit at a time, or -1
+  int decode(const HuffmanCode& code) {
+    int value = 0;   // Bits read so far
+    int first = 0;   // First code of the current length
+    int index = 0;   // Index of that first code in code.symbols
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+      value |= bits(1);
+      int count = code.counts[length];
+      if (value - count < first) {
+        return code.symbols[index + (value - first)];
+      }
+      index += count;
+      first = (first + count) << 1;
+      value <<= 1;
+    }
+
+    return -1;
+  }
+
+  bool stored() {
+    // Stored blocks start on a byte boundary
+    bitBuffer_ = 0;
+    bitCount_ = 0;
+
+    if (srcPos_ + 4 > srcSize_) {
+      return false;
+    }
+
+    uint32_t length = src_[srcPos_] | (src_[srcPos_ + 1] << 8);
+    uint32_t complement = src_[srcPos_ + 2] | (src_[srcPos_ + 3] << 8);
+    srcPos_ += 4;
+
+    if (length != (~complement & 0xffff) || srcPos_ + length > srcSize_ ||
+        dstPos_ + length > dstSize_) {
+      return false;
+    }
+
+    std::memcpy(dst_ + dstPos_, src_ + srcPos_, length);
+    srcPos_ += length;
+    dstPos_ += length;
+    return true;
+  }
+
+  bool codes(const HuffmanCode& literals, const HuffmanCode& distances) {
+    while (true) {
+      int symbol = decode(literals);
+      if (symbol < 0 || overrun_) {
+        return false;
+      }
+
+      if (symbol < 256) {
+        if (dstPos_ == dstSize_) {
+          return false;
+        }
+        dst_[dstPos_++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+
+      if (symbol == 256) {
+        return true;
+      }
+
+      symbol -= 257;
+      if (symbol >= LENGTH_CODES) {
+        return false;
+      }
+      size_t length = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+
+      symbol = decode(distances);
+      if (symbol < 0 || symbol >= DISTANCE_CODES) {
+        return false;
+      }
+      size_t distance = DISTANCE_BASE[symbol] + bits(DISTANCE_EXTRA[symbol]);
+
+      if (overrun_ || distance > dstPos_ || dstPos_ + length > dstSize_) {
+        return false;
+      }
+
+      // Byte by byte: the source may overlap what is being written
+      for (size_t i = 0; i < length; i++, dstPos_++) {
+        dst_[dstPos_] = dst_[dstPos_ - distance];
+      }
+    }
+  }
+
+  bool fixed() {
+    static HuffmanCode literals;
+    static HuffmanCode distances;
+    static bool built = [] {
+      uint8_t lengths[FIXED_LITERAL_CODES];
+      int symbol = 0;
+      for (; symbol < 144; symbol++) lengths[symbol] = 8;
+      for (; symbol < 256; symbol++) lengths[symbol] = 9;
+      for (; symbol < 280; symbol++) lengths[symbol] = 7;
+      for (; symbol < FIXED_LITERAL_CODES; symbol++) lengths[symbol] = 8;
+      literals.build(lengths, FIXED_LITERAL_CODES);
+
+      std::memset(lengths, 5, DISTANCE_CODES);
+      distances.build(lengths, DISTANCE_CODES);
+      return true;
+    }();
+    (void)built;
+
+    return codes(literals, distances);
+  }
+
+  bool dynamic() {
+    int literalCount = bits(5) + 257;
+    int distanceCount = bits(5) + 1;
+    int codeLengthCount = bits(4) + 4;
+    if (literalCount > MAX_LITERAL_CODES || distanceCount > DISTANCE_CODES) {
+      return false;
+    }
+
+    uint8_t lengths[MAX_LITERAL_CODES + DISTANCE_CODES] = {};
+    for (int i = 0; i < codeLengthCount; i++) {
+      lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(bits(3));
+    }
+
+    HuffmanCode codeLengths;
+    if (codeLengths.build(lengths, CODE_LENGTH_CODES) != 0) {
+      return false;  // The code length code must be complete
+    }
+
+    int total = literalCount + distanceCount;
+    for (int index = 0; index < total;) {
+      int symbol = decode(codeLengths);
+      if (symbol < 0 || overrun_) {
+        return false;
+      }
+
+      if (symbol < 16) {
+        lengths[index++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+
+      uint8_t length = 0;
+      int repeat;
+      if (symbol == 16) {
+        if (index == 0) {
+          return false;  // Nothing to repeat
+        }
+        length = lengths[index - 1];
+        repeat = 3 + bits(2);
+      } else if (symbol == 17) {
+        repeat = 3 + bits(3);
+      } else {
+        repeat = 11 + bits(7);
+      }
+
+      if (index + repeat > total) {
+        return false;
+      }
+      std::memset(lengths + index, length, repeat);
+      index += repeat;
+    }
+
+    if (lengths[256] == 0) {
+      return false;  // No end of block code
+    }
+
+    // Incomplete codes are only allowed when they have a single symbol
+    HuffmanCode literals;
+    int left = literals.build(lengths, literalCount);
+    if (left < 0 || (left > 0 && literalCount - literals.counts[0] != 1)) {
+      return false;
+    }
+
+    HuffmanCode distances;
+    left = distances.build(lengths + literalCount, distanceCount);
+    if (left < 0 || (left > 0 && distanceCount - distances.counts[0] != 1)) {
+      return false;
+    }
+
+    return codes(literals, distances);
+  }
+
+ private:
+  const uint8_t* src_;
+  size_t srcSize_;
+  size_t srcPos_ = 0;
+
+  uint8_t* dst_;
+  size_t dstSize_;
+  size_t dstPos_ = 0;
+
+  uint32_t bitBuffer_ = 0;
+  int bitCount_ = 0;
+  bool overrun_ = false;  // Set when a read ran past the end of the source
+};
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+  constexpr uint32_t MOD_ADLER = 65521;
+  constexpr size_t MAX_RUN = 5552;  // Bytes that can be summed before b can overflow 32 bits
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    size_t run = size < MAX_RUN ? size : MAX_RUN;
+    size -= run;
+    for (size_t i = 0; i < run; i++) {
+      a += *data++;
+      b += a;
+    }
+    a %= MOD_ADLER;
+    b %= MOD_ADLER;
+  }
+
+  return (b << 16) | a;
+}
+
+}  // namespace
+
+bool inflateZlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+  // Two header bytes and the Adler-32 trailer
+  if (srcSize < 6) {
+    return false;
+  }
+
+  uint8_t method = src[0];
+  uint8_t flags = src[1];
+  bool hasPresetDictionary = flags & 0x20;
+  if ((method & 0x0f) != 8 || (method >> 4) > 7 || (method * 256 + flags) % 31 != 0 ||
+      hasPresetDictionary) {
+    return false;
+  }
+
+  Inflater inflater(src + 2, srcSize - 6, dst, dstSize);
+  if (!inflater.run() || inflater.getOutputSize() != dstSize) {
+    return false;
+  }
+
+  const uint8_t* trailer = src + 2 + inflater.getSourcePosition();
+  if (trailer + 4 > src + srcSize) {
+    return false;
+  }
+
+  uint32_t checksum = (uint32_t(trailer[0]) << 24) | (uint32_t(trailer[1]) << 16) |
+                      (uint32_t(trailer[2]) << 8) | uint32_t(trailer[3]);
+  return checksum == adler32(dst, dstSize);
+}
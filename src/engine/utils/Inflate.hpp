@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Decompress a zlib stream (RFC 1950 around RFC 1951 DEFLATE data) into `dst`, which must be
+ * exactly as large as the uncompressed data, e.g. a KTX2 level's uncompressedByteLength.
+ *
+ * Decoding straight into the destination lets callers inflate into mapped staging memory without
+ * an intermediate buffer.
+ *
+ * @return false if the stream is malformed, fails its Adler-32 check, or doesn't decompress to
+ * exactly `dstSize` bytes
+ */
+bool inflateZlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
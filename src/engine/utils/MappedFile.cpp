@@ -0,0 +1,116 @@
+#include <MappedFile.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) : data_(other.data_), size_(other.size_) {
+#if defined(_WIN32)
+  fileHandle_ = other.fileHandle_;
+  mappingHandle_ = other.mappingHandle_;
+  other.fileHandle_ = nullptr;
+  other.mappingHandle_ = nullptr;
+#endif
+
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::filesystem::path& file) {
+  HANDLE fileHandle = CreateFileW(file.wstring().c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                  nullptr);
+
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(fileHandle);
+    return;
+  }
+
+  HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle == nullptr) {
+    CloseHandle(fileHandle);
+    return;
+  }
+
+  void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    return;
+  }
+
+  fileHandle_ = fileHandle;
+  mappingHandle_ = mappingHandle;
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+
+  if (mappingHandle_) {
+    CloseHandle(mappingHandle_);
+  }
+
+  if (fileHandle_) {
+    CloseHandle(fileHandle_);
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& file) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat fileStat {};
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return;
+  }
+
+  void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping holds its own reference to the file
+  close(fd);
+
+  if (view == MAP_FAILED) {
+    return;
+  }
+
+  // Assets are read front to back while uploading
+  madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(fileStat.st_size);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+#endif
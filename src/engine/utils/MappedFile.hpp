@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The mapping starts on a page boundary, so any data placed at an aligned offset within the file
+ * is equally aligned in memory and can be read in place.
+ */
+class MappedFile {
+ public:
+  MappedFile() = delete;
+  MappedFile(MappedFile& other) = delete;
+  MappedFile(const MappedFile& other) = delete;
+
+  MappedFile(MappedFile&& other);
+
+  // Check isOpen() afterwards: the mapping fails for missing or empty files
+  explicit MappedFile(const std::filesystem::path& file);
+
+  ~MappedFile();
+
+  bool isOpen() const { return data_ != nullptr; }
+
+  const uint8_t* data() const { return data_; }
+
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+
+#if defined(_WIN32)
+  void* fileHandle_ = nullptr;
+  void* mappingHandle_ = nullptr;
+#endif
+};
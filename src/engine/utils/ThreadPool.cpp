@@ -0,0 +1,138 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+size_t ThreadPool::defaultThreadCount() {
+  size_t hardwareThreads = std::thread::hardware_concurrency();
+
+  // hardware_concurrency() is allowed to return 0 if it can't tell
+  if (hardwareThreads <= 1) {
+    return 1;
+  }
+
+  return hardwareThreads - 1;
+}
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  workers_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+
+  condition_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::packaged_task<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+
+      // Drain the queue before exiting, so nobody is left waiting on a future
+      if (stopping_ && tasks_.empty()) {
+        return;
+      }
+
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+
+    task();
+  }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packagedTask(std::move(task));
+  std::future<void> future = packagedTask.get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push(std::move(packagedTask));
+  }
+
+  condition_.notify_one();
+  return future;
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             size_t chunkSize,
+                             const std::function<void(size_t begin, size_t end)>& fn) {
+  if (count == 0) {
+    return;
+  }
+
+  chunkSize = std::max<size_t>(chunkSize, 1);
+  size_t numChunks = (count + chunkSize - 1) / chunkSize;
+
+  if (numChunks == 1 || workers_.empty()) {
+    fn(0, count);
+    return;
+  }
+
+  // Chunks are claimed from a shared counter rather than handed out up front. Helpers that only
+  // get scheduled after all chunks are claimed find nothing to do and return immediately, which
+  // means we only ever wait on chunks that are actually being worked on.
+  struct State {
+    std::atomic<size_t> nextChunk{0};
+    size_t doneChunks = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+
+  auto state = std::make_shared<State>();
+
+  auto work = [state, numChunks, chunkSize, count, &fn]() {
+    size_t chunk;
+    while ((chunk = state->nextChunk.fetch_add(1)) < numChunks) {
+      size_t begin = chunk * chunkSize;
+      size_t end = std::min(begin + chunkSize, count);
+
+      std::exception_ptr error;
+      try {
+        fn(begin, end);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (error && !state->error) {
+        state->error = error;
+      }
+
+      if (++state->doneChunks == numChunks) {
+        state->done.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = std::min(workers_.size(), numChunks - 1);
+  for (size_t i = 0; i < helpers; i++) {
+    submit(work);
+  }
+
+  work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state, numChunks] { return state->doneChunks == numChunks; });
+
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed-size pool of worker threads.
+ *
+ * Used by the engine for CPU-side work that scales with the number of processors: asset decoding,
+ * uploads, culling and transform updates. Work is either submitted as individual tasks, or split
+ * across the pool with parallelFor().
+ */
+class ThreadPool {
+ public:
+  ThreadPool(ThreadPool& other) = delete;
+  ThreadPool(const ThreadPool& other) = delete;
+
+  // Defaults to one worker per hardware thread, minus the calling thread
+  explicit ThreadPool(size_t threadCount = defaultThreadCount());
+
+  ~ThreadPool();
+
+  size_t getThreadCount() const { return workers_.size(); }
+
+  /**
+   * @brief Queue a task on the pool. The returned future becomes ready when the task has run, and
+   * re-throws anything the task threw.
+   */
+  std::future<void> submit(std::function<void()> task);
+
+  /**
+   * @brief Run fn(begin, end) over [0, count) split into chunks of at most chunkSize elements,
+   * using the pool and the calling thread. Blocks until every chunk has completed.
+   *
+   * The calling thread takes part in the work, so it is safe to call parallelFor() from inside a
+   * pool task: if every worker is busy the caller simply processes all chunks itself.
+   */
+  void parallelFor(size_t count,
+                   size_t chunkSize,
+                   const std::function<void(size_t begin, size_t end)>& fn);
+
+  static size_t defaultThreadCount();
+
+ private:
+  void workerLoop();
+
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::packaged_task<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_ = false;
+};
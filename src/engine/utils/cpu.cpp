@@ -0,0 +1,34 @@
+#include <cpu.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+bool cpuSupportsAvx2() {
+#if defined(CPU_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // The OS has to save the YMM registers too (OSXSAVE, then XCR0 bits 1 and 2)
+  __cpuid(info, 1);
+  bool fma = (info[2] & (1 << 12)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif defined(CPU_X86)
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Whether the CPU has AVX2 and FMA, and the OS saves the YMM registers. Always false outside x86
+bool cpuSupportsAvx2();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Mix the hash of `value` into `seed`, boost::hash_combine style
+template <class T>
+inline void hashCombine(size_t& seed, const T& value) {
+  seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+// FNV-1a over a raw block of bytes. Used for hashing blobs like SPIR-V and
+// specialization constant data where std::hash has no overload.
+inline size_t hashBytes(const void* data, size_t size, size_t seed = 0xcbf29ce484222325ull) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return static_cast<size_t>(hash);
+}
@@ -0,0 +1,76 @@
+#include <memory.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#endif
+
+size_t getPeakResidentMemory() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return counters.PeakWorkingSetSize;
+  }
+  return 0;
+#elif defined(__linux__)
+  struct rusage usage {};
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Linux reports kilobytes
+  }
+  return 0;
+#elif defined(__APPLE__)
+  struct rusage usage {};
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return static_cast<size_t>(usage.ru_maxrss);  // macOS reports bytes
+  }
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+size_t getCurrentResidentMemory() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return counters.WorkingSetSize;
+  }
+  return 0;
+#elif defined(__linux__)
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+
+  long pages = 0;
+  long residentPages = 0;
+  if (fscanf(statm, "%ld %ld", &pages, &residentPages) != 2) {
+    residentPages = 0;
+  }
+  fclose(statm);
+
+  return static_cast<size_t>(residentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#elif defined(__APPLE__)
+  mach_task_basic_info info{};
+  mach_msg_type_number_t infoCount = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &infoCount) == KERN_SUCCESS) {
+    return info.resident_size;
+  }
+  return 0;
+#else
+  return 0;
+#endif
+}
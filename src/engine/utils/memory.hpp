@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Peak resident set size of the current process, in bytes. Returns 0 if the
+// platform doesn't expose it.
+size_t getPeakResidentMemory();
+
+// Current resident set size of the current process, in bytes. Returns 0 if the
+// platform doesn't expose it.
+size_t getCurrentResidentMemory();
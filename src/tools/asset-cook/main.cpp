@@ -0,0 +1,121 @@
+#include <fmt/core.h>
+
+#include <CLI/App.hpp>
+#include <CLI/Config.hpp>
+#include <CLI/Formatter.hpp>
+#include <chrono>
+#include <engine/assets/CookedMesh.hpp>
+#include <engine/assets/GltfLoader.hpp>
+#include <engine/assets/MeshOptimizer.hpp>
+#include <engine/utils/ThreadPool.hpp>
+#include <filesystem>
+#include <fmtlog/Log.hpp>
+#include <limits>
+#include <string>
+
+/**
+ * asset-cook: converts source assets (glTF 2.0) into the engine's cooked binary formats, so the
+ * runtime never has to parse JSON or convert accessors.
+ *
+ *   asset-cook -i Sponza.gltf -o Sponza.vkmesh
+ */
+int main(int argc, char** argv) {
+  CLI::App app{"Vulkan Engine asset cooker"};
+
+  std::string input;
+  std::string output;
+  bool noOptimize = false;
+  bool split16 = false;
+  bool allowUint8 = false;
+
+  app.add_option("-i,--input", input, "Source glTF 2.0 scene (.gltf or .glb)")->required();
+  app.add_option("-o,--output", output, "Cooked mesh file to write (defaults to <input>.vkmesh)");
+  app.add_flag("--no-optimize", noOptimize, "Skip vertex cache / overdraw / fetch optimization");
+  app.add_flag("--split-16", split16, "Split meshes so every piece fits 16-bit indices");
+  app.add_flag("--allow-uint8",
+               allowUint8,
+               "Store 8-bit indices for meshes with at most 256 vertices "
+               "(needs VK_EXT_index_type_uint8 at runtime, widened otherwise)");
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (output.empty()) {
+    output = std::filesystem::path(input).replace_extension(".vkmesh").generic_string();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  ThreadPool threadPool;
+  GltfLoader loader(threadPool);
+  GltfLoadStats stats;
+
+  GltfScene scene = loader.load(input, &stats);
+  stats.log();
+
+  if (!noOptimize) {
+    auto optimizeStart = std::chrono::steady_clock::now();
+
+    // Totals weighted by what each ratio is per: triangles for the ACMR, vertices for the ATVR.
+    // Welding changes the vertex counts, so they are summed again after optimizing
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t totalTriangles = 0;
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+
+    for (const auto& mesh : scene.meshes) {
+      VertexCacheStats meshStats = analyzeVertexCache(mesh.indices, mesh.getVertexCount());
+      before.acmr += meshStats.acmr * (mesh.getIndexCount() / 3);
+      before.atvr += meshStats.atvr * mesh.getVertexCount();
+      totalTriangles += mesh.getIndexCount() / 3;
+      verticesBefore += mesh.getVertexCount();
+    }
+
+    threadPool.parallelFor(scene.meshes.size(), 1, [&scene](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        optimizeMesh(scene.meshes[i]);
+      }
+    });
+
+    for (const auto& mesh : scene.meshes) {
+      VertexCacheStats meshStats = analyzeVertexCache(mesh.indices, mesh.getVertexCount());
+      after.acmr += meshStats.acmr * (mesh.getIndexCount() / 3);
+      after.atvr += meshStats.atvr * mesh.getVertexCount();
+      verticesAfter += mesh.getVertexCount();
+    }
+
+    double optimizeMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - optimizeStart)
+                            .count();
+
+    if (totalTriangles > 0) {
+      LOG_I("Optimized {} meshes in {:.2f} ms: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+            scene.meshes.size(),
+            optimizeMs,
+            before.acmr / totalTriangles,
+            after.acmr / totalTriangles,
+            before.atvr / verticesBefore,
+            after.atvr / verticesAfter);
+    }
+  }
+
+  if (split16) {
+    // After optimization, so each piece keeps the optimized triangle order
+    splitSceneMeshes(scene, std::numeric_limits<uint16_t>::max() + size_t(1));
+  }
+
+  size_t written = writeCookedMeshFile(output, scene, allowUint8);
+
+  double elapsedMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  LOG_I("Cooked {} of {} meshes ({} instances) from '{}' into '{}' in {:.2f} ms",
+        written,
+        scene.meshes.size(),
+        scene.instances.size(),
+        input,
+        output,
+        elapsedMs);
+
+  return 0;
+}